@@ -65,6 +65,29 @@ void read_inode(diskfs_sb_t *disksb, diskfs_inode_t *inode, diskfs_ino_t ino) {
 
 }
 
+diskfs_blk_t get_extent_block(diskfs_sb_t *sb,
+                              diskfs_inode_t *inode,
+                              diskfs_blk_t blk_off) {
+
+    /* walk down the extent tree of the inode: */
+    diskfs_ext_head_t *head = DISKFS_EXT_ROOT(inode->ptr);
+    diskfs_extent_t *ext;
+
+    while (ext = diskfs_ext_find(head, blk_off)) {
+        if (!head->depth) {
+            if (blk_off < ext->lblk || blk_off - ext->lblk >= ext->len)
+                return 0; /* hole */
+            return ext->start + (blk_off - ext->lblk);
+        }
+        read_cluster(sb, ext->start, buffer);
+        head = (diskfs_ext_head_t *) buffer;
+    }
+
+    /* empty: */
+    return 0;
+
+}
+
 diskfs_blk_t get_file_block(diskfs_sb_t *sb,
                             diskfs_inode_t *inode,
                             diskfs_blk_t blk_off) {
@@ -79,6 +102,11 @@ diskfs_blk_t get_file_block(diskfs_sb_t *sb,
     diskfs_blk_t *ptr;
     int32_t i;
 
+    /* extents? */
+    if (sb->revision >= QUAFS_REVISION_EXTENTS &&
+        (inode->flags & DISKFS_INODE_EXTENTS))
+        return get_extent_block(sb, inode, blk_off);
+
     for (i = 0; i <= lvl.level; i++) {
 
         /* load the table into memory: */
@@ -105,9 +133,21 @@ void read_file_block(diskfs_sb_t *sb,
                      diskfs_blk_t blk_off,
                      void *buf) {
 
-    diskfs_blk_t blk = get_file_block(sb, inode, blk_off);
+    diskfs_blk_t blk;
+    int32_t i;
+
+    /* the data is inside the inode? */
+    if (sb->revision >= QUAFS_REVISION_INLINE &&
+        (inode->flags & DISKFS_INODE_INLINE)) {
+        for(i = 0; i < sb->block_size; i++)
+            ((uint8_t *) buf)[i] = 0;
+        for(i = 0; !blk_off && i < inode->size && i < DISKFS_INLINE_MAX; i++)
+            ((uint8_t *) buf)[i] = ((uint8_t *) inode->ptr)[i];
+        return;
+    }
+
+    blk = get_file_block(sb, inode, blk_off);
     if (!blk) {
-        int32_t i;
         for(i = 0; i < sb->block_size; i++)
             ((uint8_t *) buf)[i] = 0;
     } else {
@@ -115,6 +155,36 @@ void read_file_block(diskfs_sb_t *sb,
     }
 }
 
+diskfs_ino_t dx_lookup(diskfs_sb_t *sb, diskfs_inode_t *inode, char *name) {
+
+    diskfs_dirent_t *dirents = (diskfs_dirent_t *) buffer;
+    diskfs_dx_head_t *head = DISKFS_DX_ROOT(buffer);
+    uint32_t hash = diskfs_dx_hash(name);
+    diskfs_blk_t blk;
+    int32_t i;
+
+    /* root: */
+    read_file_block(sb, inode, 0, buffer);
+    for (i = 0; i < 2; i++)
+        if (!strcmp(dirents[i].name, name))
+            return dirents[i].ino;
+    blk = diskfs_dx_find(head, hash)->blk;
+
+    /* index node: */
+    if (head->depth == 2) {
+        read_file_block(sb, inode, blk, buffer);
+        blk = diskfs_dx_find((diskfs_dx_head_t *) buffer, hash)->blk;
+    }
+
+    /* leaf: */
+    read_file_block(sb, inode, blk, buffer);
+    for (i = 0; i < DIRENT_COUNT(sb->block_size); i++)
+        if (dirents[i].ino > 1 && !strcmp(dirents[i].name, name))
+            return dirents[i].ino;
+    return 0;
+
+}
+
 diskfs_ino_t lookup(diskfs_sb_t *sb, diskfs_inode_t *inode, char *name) {
 
     diskfs_dirent_t *dirents = (diskfs_dirent_t *) buffer;
@@ -122,6 +192,11 @@ diskfs_ino_t lookup(diskfs_sb_t *sb, diskfs_inode_t *inode, char *name) {
     int32_t i = 0; /* counter for blocks. */
     int32_t j = 0; /* counter for dirents per block. */
 
+    /* indexed directory? */
+    if (sb->revision >= QUAFS_REVISION_DXDIR &&
+        (inode->flags & DISKFS_INODE_DXDIR))
+        return dx_lookup(sb, inode, name);
+
     /* loop on dirents. */
     while(1) {
         /* beginning of a new block? */
@@ -191,6 +266,9 @@ void diskfs_loadfile(char *path, uint32_t base) {
     /* load kernel */
     printf("Loading %s (inode %d) to 0x%x...", path, ino, base);
     read_inode(sb, &inode, ino);
+    if (sb->revision >= QUAFS_REVISION_INLINE &&
+        (inode.flags & DISKFS_INODE_INLINE))
+        inode.blocks = 1; /* the data is in the inode. */
     for (i = 0; i < inode.blocks; i++) {
         uint8_t *dest = (uint8_t *)(base+i*sb->block_size);
         read_file_block(sb,&inode, i, buffer);
@@ -0,0 +1,120 @@
+/*
+ *        +----------------------------------------------------------+
+ *        | +------------------------------------------------------+ |
+ *        | |  Quafios Core Utilities.                             | |
+ *        | |  -> copybench.                                       | |
+ *        | +------------------------------------------------------+ |
+ *        +----------------------------------------------------------+
+ *
+ * This file is part of Quafios 2.0.1 source code.
+ * Copyright (C) 2015  Mostafa Abd El-Aziz Mohamed.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Quafios.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Visit http://www.quafios.com/ for contact information.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <api/fs.h>
+#include <api/sys.h>
+
+/* the files copied, and the default size in MB: */
+#define SRC_PATH        "/tmp/copybench.src"
+#define DST_PATH        "/tmp/copybench.dst"
+#define DEFAULT_MB      16
+
+/* bytes per copy_file_range(), and per read() and write(): */
+#define COPY_SIZE       (1024*1024)
+#define CHUNK           (64*1024)
+
+static char buf[CHUNK];
+
+static int open_empty(char *path) {
+
+    /* create the file, or empty it */
+    mknod(path, FT_REGULAR, 0);
+    if (truncate(path, 0) < 0)
+        return -1;
+    return open(path, 0);
+
+}
+
+static int bench(char *name, int use_range, int mb) {
+
+    /* copy SRC_PATH to DST_PATH and print the rate */
+    int in, out, start, ms;
+    ssize_t n;
+
+    if ((in = open(SRC_PATH, 0)) < 0 || (out = open_empty(DST_PATH)) < 0) {
+        fprintf(stderr, "copybench: can't open the files\n");
+        return -1;
+    }
+    start = uptime();
+    if (use_range) {
+        while ((n = copy_file_range(in, NULL, out, NULL, COPY_SIZE)) > 0);
+    } else {
+        while ((n = read(in, buf, CHUNK)) > 0 && write(out, buf, n) == n);
+    }
+    ms = uptime() - start;
+    close(in);
+    close(out);
+    if (n) {
+        fprintf(stderr, "copybench: %s failed\n", name);
+        return -1;
+    }
+    if (!ms)
+        ms = 1;
+    printf("%-16s %d MB in %5d ms: %8.2f MB/s\n",
+           name, mb, ms, (double) mb*1000/ms);
+    return 0;
+
+}
+
+int main(int argc, char *argv[], char *envp[]) {
+
+    int mb = argc > 1 ? (int) strtod(argv[1], NULL) : DEFAULT_MB;
+    int fd, i, err = 0;
+
+    if (mb <= 0) {
+        fprintf(stderr, "Invalid arguments!\n");
+        return -1;
+    }
+
+    /* make the source file */
+    if ((fd = open_empty(SRC_PATH)) < 0) {
+        fprintf(stderr, "copybench: can't create %s\n", SRC_PATH);
+        return -1;
+    }
+    for (i = 0; i < CHUNK; i++)
+        buf[i] = (char) i;
+    for (i = 0; i < mb*(1024*1024/CHUNK) && !err; i++)
+        err = write(fd, buf, CHUNK) != CHUNK;
+    close(fd);
+    if (err)
+        fprintf(stderr, "copybench: can't write %s\n", SRC_PATH);
+
+    /* in the kernel, then through this process */
+    if (!err)
+        err = bench("copy_file_range", 1, mb) || bench("read/write", 0, mb);
+
+    /* clean up */
+    unlink(SRC_PATH);
+    unlink(DST_PATH);
+
+    /* done */
+    return err ? -1 : 0;
+
+}
@@ -0,0 +1,118 @@
+/*
+ *        +----------------------------------------------------------+
+ *        | +------------------------------------------------------+ |
+ *        | |  Quafios Core Utilities.                             | |
+ *        | |  -> ipcbench.                                        | |
+ *        | +------------------------------------------------------+ |
+ *        +----------------------------------------------------------+
+ *
+ * This file is part of Quafios 2.0.1 source code.
+ * Copyright (C) 2015  Mostafa Abd El-Aziz Mohamed.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Quafios.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Visit http://www.quafios.com/ for contact information.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <api/proc.h>
+#include <api/sys.h>
+
+/* message sizes, from MIN_SIZE up to MAX_SIZE in steps of 4x: */
+#define MIN_SIZE        16
+#define MAX_SIZE        (1024*1024)
+
+/* time spent on each size, in milliseconds: */
+#define RUN_TIME        1000
+
+/* a message of this size tells the server to quit: */
+#define QUIT_SIZE       1
+
+#define PAGE_SIZE       4096
+
+static void server(char *buf) {
+
+    /* answer every call with a short acknowledgement */
+    msg_t msg, reply;
+    int ack = 0;
+
+    msg.buf   = buf;
+    msg.cap   = MAX_SIZE;
+    reply.buf  = &ack;
+    reply.size = sizeof(ack);
+
+    if (receive(&msg, 1))
+        exit(-1);
+    while (msg.size != QUIT_SIZE)
+        if (reply_wait(msg.sender, &reply, &msg))
+            exit(-1);
+    reply_wait(msg.sender, &reply, NULL);
+    exit(0);
+
+}
+
+int main(int argc, char *argv[], char *envp[]) {
+
+    msg_t msg, reply;
+    char *mem, *buf;
+    unsigned int size, calls;
+    int pid, status, ack, start, ms;
+
+    /* page-aligned buffer, so big messages can be remapped: */
+    if (!(mem = malloc(MAX_SIZE + PAGE_SIZE))) {
+        fprintf(stderr, "ipcbench: out of memory\n");
+        return -1;
+    }
+    buf = (char *) (((unsigned int) mem + PAGE_SIZE - 1) & ~(PAGE_SIZE-1));
+
+    /* start the server */
+    if ((pid = fork()) < 0) {
+        fprintf(stderr, "ipcbench: can't fork\n");
+        return -1;
+    }
+    if (!pid)
+        server(buf);
+
+    /* call it with messages of every size */
+    msg.buf   = buf;
+    reply.buf = &ack;
+    reply.cap = sizeof(ack);
+    printf("    size      calls/s         MB/s\n");
+    for (size = MIN_SIZE; size <= MAX_SIZE; size *= 4) {
+        msg.size = size;
+        calls = 0;
+        start = uptime();
+        do {
+            if (call(pid, &msg, &reply)) {
+                fprintf(stderr, "ipcbench: call failed\n");
+                return -1;
+            }
+            calls++;
+        } while ((ms = uptime() - start) < RUN_TIME);
+        printf("%8u %12u %12.2f\n", size, calls*1000/ms,
+               (double) calls*size*1000/ms/(1024*1024));
+    }
+
+    /* stop the server */
+    msg.size = QUIT_SIZE;
+    call(pid, &msg, &reply);
+    waitpid(pid, &status);
+
+    /* done */
+    free(mem);
+    return 0;
+
+}
@@ -0,0 +1,105 @@
+/*
+ *        +----------------------------------------------------------+
+ *        | +------------------------------------------------------+ |
+ *        | |  Quafios Core Utilities.                             | |
+ *        | |  -> openbench.                                       | |
+ *        | +------------------------------------------------------+ |
+ *        +----------------------------------------------------------+
+ *
+ * This file is part of Quafios 2.0.1 source code.
+ * Copyright (C) 2015  Mostafa Abd El-Aziz Mohamed.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Quafios.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Visit http://www.quafios.com/ for contact information.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <api/fs.h>
+#include <api/sys.h>
+
+/* the tree is BASE_PATH/dir/dir/.../file, DEFAULT_DEPTH levels deep
+ * unless another depth is given. BASE_PATH/file is the shallow case.
+ */
+#define BASE_PATH       "/tmp/openbench"
+#define DEFAULT_DEPTH   16
+#define MAX_DEPTH       200
+
+/* time spent on each path, in milliseconds: */
+#define RUN_TIME        1000
+
+static char path[sizeof(BASE_PATH) + 4*MAX_DEPTH + 8];
+
+static int bench(char *file, int depth) {
+
+    /* open() and close() "file" over and over, print the rate */
+    unsigned int opens = 0;
+    int fd, start, ms;
+
+    start = uptime();
+    do {
+        if ((fd = open(file, 0)) < 0) {
+            fprintf(stderr, "openbench: can't open %s\n", file);
+            return -1;
+        }
+        close(fd);
+        opens++;
+    } while ((ms = uptime() - start) < RUN_TIME);
+    printf("depth %3d: %8u opens/s, %6u us per open\n",
+           depth, opens*1000/ms, ms*1000/opens);
+    return 0;
+
+}
+
+int main(int argc, char *argv[], char *envp[]) {
+
+    int depth = argc > 1 ? (int) strtod(argv[1], NULL) : DEFAULT_DEPTH;
+    int i, err;
+
+    if (depth <= 0 || depth > MAX_DEPTH) {
+        fprintf(stderr, "Invalid arguments!\n");
+        return -1;
+    }
+
+    /* build the tree */
+    mkdir(BASE_PATH, FT_DIR);
+    mknod(BASE_PATH "/file", FT_REGULAR, 0);
+    strcpy(path, BASE_PATH);
+    for (i = 0; i < depth; i++) {
+        strcat(path, "/dir");
+        mkdir(path, FT_DIR);
+    }
+    strcat(path, "/file");
+    mknod(path, FT_REGULAR, 0);
+
+    /* shallow, then deep */
+    err = bench(BASE_PATH "/file", 1) || bench(path, depth + 1);
+
+    /* remove the tree, from the bottom up */
+    unlink(path);
+    path[strlen(path) - strlen("/file")] = 0;
+    for (i = 0; i < depth; i++) {
+        rmdir(path);
+        path[strlen(path) - strlen("/dir")] = 0;
+    }
+    unlink(BASE_PATH "/file");
+    rmdir(BASE_PATH);
+
+    /* done */
+    return err ? -1 : 0;
+
+}
@@ -0,0 +1,118 @@
+/*
+ *        +----------------------------------------------------------+
+ *        | +------------------------------------------------------+ |
+ *        | |  Quafios Core Utilities.                             | |
+ *        | |  -> pipebench.                                       | |
+ *        | +------------------------------------------------------+ |
+ *        +----------------------------------------------------------+
+ *
+ * This file is part of Quafios 2.0.1 source code.
+ * Copyright (C) 2015  Mostafa Abd El-Aziz Mohamed.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Quafios.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Visit http://www.quafios.com/ for contact information.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <api/fs.h>
+#include <api/proc.h>
+#include <api/sys.h>
+
+/* the file pushed through the pipe, and its default size in MB: */
+#define FILE_PATH       "/tmp/pipebench"
+#define DEFAULT_MB      16
+
+/* bytes per read() and write(): */
+#define CHUNK           (64*1024)
+
+static char buf[CHUNK];
+
+int main(int argc, char *argv[], char *envp[]) {
+
+    /* time "cat FILE | sink": the writer is the real cat, the sink
+     * reads the pipe and throws the data away (there is no
+     * /dev/null to redirect a second cat to).
+     */
+    char *cat_argv[] = {"cat", FILE_PATH, NULL};
+    int mb = argc > 1 ? (int) strtod(argv[1], NULL) : DEFAULT_MB;
+    int fd, fds[2], writer, reader, status, start, ms, i;
+    unsigned int total = 0;
+    ssize_t n;
+
+    if (mb <= 0) {
+        fprintf(stderr, "Invalid arguments!\n");
+        return -1;
+    }
+
+    /* make the input file */
+    mknod(FILE_PATH, FT_REGULAR, 0);
+    if (truncate(FILE_PATH, 0) < 0 || (fd = open(FILE_PATH, 0)) < 0) {
+        fprintf(stderr, "pipebench: can't create %s\n", FILE_PATH);
+        return -1;
+    }
+    for (i = 0; i < CHUNK; i++)
+        buf[i] = (char) i;
+    for (i = 0; i < mb*(1024*1024/CHUNK); i++) {
+        if (write(fd, buf, CHUNK) != CHUNK) {
+            fprintf(stderr, "pipebench: can't write %s\n", FILE_PATH);
+            close(fd);
+            unlink(FILE_PATH);
+            return -1;
+        }
+    }
+    close(fd);
+
+    /* run the pipeline */
+    if (pipe(fds) < 0) {
+        fprintf(stderr, "pipebench: can't create a pipe\n");
+        unlink(FILE_PATH);
+        return -1;
+    }
+    start = uptime();
+    if (!(writer = fork())) {
+        dup2(fds[1], 1);
+        close(fds[0]);
+        close(fds[1]);
+        execve("/bin/cat", cat_argv, envp);
+        _exit(-1);
+    }
+    if (!(reader = fork())) {
+        close(fds[1]);
+        while ((n = read(fds[0], buf, CHUNK)) > 0)
+            total += n;
+        _exit(total == mb*1024*1024 ? 0 : -1);
+    }
+    close(fds[0]);
+    close(fds[1]);
+    waitpid(writer, &status);
+    waitpid(reader, &status);
+    ms = uptime() - start;
+    unlink(FILE_PATH);
+
+    /* report */
+    if (writer < 0 || reader < 0 || status) {
+        fprintf(stderr, "pipebench: the data didn't go through\n");
+        return -1;
+    }
+    if (!ms)
+        ms = 1;
+    printf("%d MB in %d ms: %.2f MB/s\n", mb, ms, (double) mb*1000/ms);
+
+    /* done */
+    return 0;
+
+}
@@ -88,8 +88,11 @@ typedef struct wm_event {
     unsigned int data[8];
 } __attribute__((packed)) wm_event_t;
 
+extern int event_sender;
+
 int wm_req(void *req, int size);
 void set_receiver(void (*rec)(void *packet));
+void set_timeout(int ms, void (*handler)());
 void gui_loop();
 
 #endif
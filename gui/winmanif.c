@@ -29,9 +29,16 @@
 #include <gui.h>
 #include <api/proc.h>
 #include <api/fs.h>
+#include <api/sys.h>
 
 void (*receiver)(void *packet) = NULL;
 
+/* one-shot timeout of the event loop */
+void (*timeout_handler)() = NULL;
+int timeout_when = 0; /* uptime() at which it expires */
+
+int event_sender = 0; /* pid of the sender of the packet being handled */
+
 int winman_pid = 0;
 
 int wm_req(void *req, int size) {
@@ -55,15 +62,29 @@ void set_receiver(void (*rec)(void *packet)) {
     receiver = rec;
 }
 
+void set_timeout(int ms, void (*handler)()) {
+    /* call handler from the event loop after ms milliseconds,
+     * in place of any timeout that is pending.
+     */
+    timeout_when = uptime() + ms;
+    timeout_handler = handler;
+}
+
 void gui_loop() {
 
     /* message structures */
     msg_t msg;
     unsigned char packet[256];
     extern window_t *firstwin;
+    pollfd_t inbox;
+    void (*handler)();
+    int left, ready;
 
     /* initialize msg */
     msg.buf = &packet;
+    msg.cap = sizeof(packet);
+    inbox.fd = POLL_INBOX;
+    inbox.events = POLLIN;
 
     /* check the inbox */
     while (1) {
@@ -73,7 +94,21 @@ void gui_loop() {
             return;
         }
 
-        receive(&msg, 1);
+        /* sleep until a message arrives or the timeout expires */
+        left = -1;
+        if (timeout_handler && (left = timeout_when - uptime()) < 0)
+            left = 0;
+        ready = poll(&inbox, 1, left);
+
+        /* fire an expired timeout even when messages keep coming */
+        if ((handler = timeout_handler) && timeout_when - uptime() <= 0) {
+            timeout_handler = NULL;
+            handler();
+        }
+
+        if (ready <= 0 || receive(&msg, 0))
+            continue; /* no message, or too big for the packet buffer */
+        event_sender = msg.sender;
 
         if (packet[0] == PREFIX_WINMAN) {
             /* an event from winman */
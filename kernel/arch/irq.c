@@ -135,6 +135,7 @@ void irq_handler(uint32_t n) {
     /* call scheduler? */
     if (n == scheduler_irq) {
         ticks++;
+        waitq_tick();
         scheduler();
     }
 
@@ -30,6 +30,8 @@
 #include <sys/error.h>
 #include <sys/mm.h>
 #include <sys/scheduler.h>
+#include <sys/pcache.h>
+#include <sys/icache.h>
 
 #include <i386/asm.h>
 #include <i386/protect.h>
@@ -317,6 +319,54 @@ uint32_t arch_vmpage_map(umem_t *umem, uint32_t vaddr, uint32_t user) {
     return ESUCCESS;
 }
 
+int32_t page_writeback(arch_umem_t *arch_umem, uint32_t *entry,
+                       uint32_t vaddr, file_mem_t *region) {
+
+    /* if the page at vaddr was written since the last time, copy it
+     * back to the file that it maps. only shared mappings are written
+     * back, and only if the page is not already the file's own page.
+     * the part of the page beyond the end of the file is dropped.
+     */
+    uint64_t size = region->file->inode->size;
+    uint32_t len = PAGE_SIZE;
+    int32_t err;
+    ssize_t done;
+    void *buf;
+
+    /* clean? */
+    if (!(*entry & PAGE_ENTRY_P) || !(*entry & PAGE_ENTRY_D))
+        return ESUCCESS;
+
+    /* clear the dirty bit before copying, so that writes done from now
+     * on mark the page dirty again.
+     */
+    *entry &= ~PAGE_ENTRY_D;
+    if (get_cr3() == arch_umem->page_dir_phys)
+        set_cr3(get_cr3());
+
+    /* anything to write? */
+    if (!region->shared || region->direct || region->pos >= size)
+        return ESUCCESS;
+    if (size - region->pos < PAGE_SIZE)
+        len = (uint32_t) (size - region->pos);
+
+    /* write through the page cache */
+    if (get_cr3() == arch_umem->page_dir_phys) {
+        err = file_pwrite(region->file, (void *) vaddr, len,
+                          region->pos, &done);
+    } else {
+        /* not the current address space, copy the frame first */
+        if (!(buf = kmalloc(PAGE_SIZE)))
+            return ENOMEM;
+        pmem_read(buf, (void *) (*entry & PAGE_BASE_MASK), len);
+        err = file_pwrite(region->file, buf, len, region->pos, &done);
+        kfree(buf);
+    }
+
+    return err;
+
+}
+
 uint32_t arch_vmpage_unmap(umem_t *umem, int32_t vaddr) {
 
     /* unmaps a page, CPU level...
@@ -335,16 +385,28 @@ uint32_t arch_vmpage_unmap(umem_t *umem, int32_t vaddr) {
     pe = (vaddr >> 12) & 0x3FF; /* page entry; */
 
     if (arch_umem.region_dir[pde] && arch_umem.region_dir[pde]->region[pe]) {
-        arch_umem.region_dir[pde]->region[pe]->ref--;
-        if (!arch_umem.region_dir[pde]->region[pe]->ref) {
-            file_t *file = arch_umem.region_dir[pde]->region[pe]->file;
-            if (arch_umem.region_dir[pde]->region[pe]->paddr) {
-                ppfree(arch_umem.region_dir[pde]->region[pe]->paddr);
+        file_mem_t *region = arch_umem.region_dir[pde]->region[pe];
+        /* flush what this process has written to a shared mapping */
+        page_writeback(&arch_umem, &pagetbl[pe], vaddr, region);
+        if (!region->shared) {
+            /* a private page might have been copied on write, so
+             * release whatever frame is actually mapped.
+             */
+            if (pagetbl[pe] & PAGE_ENTRY_P)
+                ppfree(pagetbl[pe] & PAGE_BASE_MASK);
+            region->paddr = 0;
+        }
+        region->ref--;
+        if (!region->ref) {
+            file_t *file = region->file;
+            if (region->paddr) {
+                ppfree(region->paddr);
             }
-            linkedlist_aremove(&(file->inode->sma),
-                arch_umem.region_dir[pde]->region[pe]);
-            kfree(arch_umem.region_dir[pde]->region[pe]);
-            file_close(arch_umem.region_dir[pde]->region[pe]->file);
+            if (region->shared) {
+                linkedlist_aremove(&(file->inode->sma), region);
+            }
+            kfree(region);
+            file_close(file);
         }
         arch_umem.region_dir[pde]->region[pe] = 0;
     } else {
@@ -375,6 +437,35 @@ uint32_t arch_vmpage_unmap(umem_t *umem, int32_t vaddr) {
 
 }
 
+int32_t arch_vmpage_sync(umem_t *umem, uint32_t vaddr, file_t **file) {
+
+    /* write the page at vaddr back to its file if it belongs to a
+     * shared file mapping and is dirty. the mapped file is returned
+     * in *file (NULL if the page is not part of a shared mapping).
+     */
+    arch_umem_t arch_umem;
+    uint32_t pde, *pagetbl, pe;
+    file_mem_t *region;
+
+    /* get arch_umem structure: */
+    arch_umem = get_arch_umem_t(umem);
+    *file = NULL;
+
+    /* get the region of the page: */
+    pde = (vaddr >> 22) & 0x3FF; /* page dir entry */
+    if (!(arch_umem.page_dir[pde] & PAGE_ENTRY_P) || !arch_umem.region_dir[pde])
+        return ESUCCESS;
+    pagetbl = (uint32_t *) (arch_umem.page_dir_ext[pde]&PAGE_BASE_MASK);
+    pe = (vaddr >> 12) & 0x3FF; /* page entry; */
+    if (!(region = arch_umem.region_dir[pde]->region[pe]) || !region->shared)
+        return ESUCCESS;
+
+    /* write back: */
+    *file = region->file;
+    return page_writeback(&arch_umem, &pagetbl[pe], vaddr, region);
+
+}
+
 void arch_set_page(umem_t *umem, uint32_t vaddr, uint32_t paddr) {
 
     /* used to gain direct access to physical memory */
@@ -426,6 +517,98 @@ void arch_vmpage_attach_file(umem_t *umem,
 
 }
 
+uint32_t arch_vmpage_share(umem_t *umem, uint32_t vaddr,
+                           uint32_t count, uint32_t *frames) {
+
+    /* turn "count" present pages starting at vaddr into copy-on-write
+     * pages and take an extra reference to each of their frames, so
+     * that the frames can be handed over to someone else (IPC).
+     * nothing is changed unless all of the pages can be shared.
+     */
+    arch_umem_t arch_umem;
+    uint32_t pde, *pagetbl, pe, i;
+
+    /* get arch_umem structure: */
+    arch_umem = get_arch_umem_t(umem);
+
+    /* all pages must be present and anonymous */
+    for (i = 0; i < count; i++) {
+        pde = ((vaddr + i*PAGE_SIZE) >> 22) & 0x3FF;
+        pe  = ((vaddr + i*PAGE_SIZE) >> 12) & 0x3FF;
+        if (!(arch_umem.page_dir[pde] & PAGE_ENTRY_P) ||
+            !arch_umem.region_dir[pde] || arch_umem.region_dir[pde]->region[pe])
+            return EINVAL;
+        pagetbl = (uint32_t *) (arch_umem.page_dir_ext[pde]&PAGE_BASE_MASK);
+        if (!(pagetbl[pe] & PAGE_ENTRY_P))
+            return EINVAL;
+    }
+
+    /* write-protect them and collect the frames */
+    for (i = 0; i < count; i++) {
+        pde = ((vaddr + i*PAGE_SIZE) >> 22) & 0x3FF;
+        pe  = ((vaddr + i*PAGE_SIZE) >> 12) & 0x3FF;
+        pagetbl = (uint32_t *) (arch_umem.page_dir_ext[pde]&PAGE_BASE_MASK);
+        pagetbl[pe] &= ~PAGE_ENTRY_RW;
+        pagetbl[pe] |= PAGE_ENTRY_COW;
+        frames[i] = pagetbl[pe] & PAGE_BASE_MASK;
+        ppref((void *) frames[i]);
+    }
+
+    /* update CPU caches. */
+    if (get_cr3() == arch_umem.page_dir_phys)
+        set_cr3(get_cr3());
+
+    return ESUCCESS;
+
+}
+
+uint32_t arch_vmpage_attach(umem_t *umem, uint32_t vaddr,
+                            uint32_t count, uint32_t *frames, uint32_t cow) {
+
+    /* replace "count" mapped pages starting at vaddr with the given
+     * frames, either as copy-on-write pages or as writable pages that
+     * stay shared with whoever else maps the frames. the references
+     * to the frames are inherited from the caller. the old frames are
+     * released.
+     */
+    arch_umem_t arch_umem;
+    uint32_t pde, *pagetbl, pe, i;
+
+    /* get arch_umem structure: */
+    arch_umem = get_arch_umem_t(umem);
+
+    /* all pages must be mapped and anonymous */
+    for (i = 0; i < count; i++) {
+        pde = ((vaddr + i*PAGE_SIZE) >> 22) & 0x3FF;
+        pe  = ((vaddr + i*PAGE_SIZE) >> 12) & 0x3FF;
+        if (!(arch_umem.page_dir[pde] & PAGE_ENTRY_P) ||
+            !arch_umem.region_dir[pde] || arch_umem.region_dir[pde]->region[pe])
+            return EINVAL;
+        pagetbl = (uint32_t *) (arch_umem.page_dir_ext[pde]&PAGE_BASE_MASK);
+        if (!(pagetbl[pe] & (PAGE_ENTRY_P | PAGE_ENTRY_AF)))
+            return EINVAL;
+    }
+
+    /* swap the frames */
+    for (i = 0; i < count; i++) {
+        pde = ((vaddr + i*PAGE_SIZE) >> 22) & 0x3FF;
+        pe  = ((vaddr + i*PAGE_SIZE) >> 12) & 0x3FF;
+        pagetbl = (uint32_t *) (arch_umem.page_dir_ext[pde]&PAGE_BASE_MASK);
+        if (pagetbl[pe] & PAGE_ENTRY_P)
+            ppfree((void *) (pagetbl[pe] & PAGE_BASE_MASK));
+        pagetbl[pe] &= PAGE_FLAG_MASK & ~(PAGE_ENTRY_AF | PAGE_ENTRY_RW);
+        pagetbl[pe] |= frames[i] | PAGE_ENTRY_P;
+        pagetbl[pe] |= cow ? PAGE_ENTRY_COW : PAGE_ENTRY_RW;
+    }
+
+    /* update CPU caches. */
+    if (get_cr3() == arch_umem.page_dir_phys)
+        set_cr3(get_cr3());
+
+    return ESUCCESS;
+
+}
+
 /****************************************************************************/
 /*                        Virtual Memory Organization                       */
 /****************************************************************************/
@@ -505,11 +688,6 @@ int32_t page_fault(uint32_t err) {
     uint32_t pde, *pagetbl, pe, paddr, read = 0;
     file_mem_t *region = NULL;
 
-    /* error source must be page not present:  */
-    /* --------------------------------------- */
-    if (err & PAGE_ENTRY_P)
-        return -1;
-
     /* get umem structures of current process:  */
     /* ---------------------------------------- */
     arch_umem = get_arch_umem_t(NULL);
@@ -522,6 +700,28 @@ int32_t page_fault(uint32_t err) {
     pagetbl = (uint32_t *) (arch_umem.page_dir_ext[pde]&PAGE_BASE_MASK);
     pe = (get_cr2() >> 12) & 0x3FF; /* page entry; */
 
+    /* write to a copy-on-write page?  */
+    /* ------------------------------- */
+    if (err & PAGE_ENTRY_P) {
+        if (!(err & PAGE_ENTRY_RW) || !(pagetbl[pe] & PAGE_ENTRY_COW))
+            return -1;
+        paddr = pagetbl[pe] & PAGE_BASE_MASK;
+        if (ppcount((void *) paddr) > 1) {
+            /* frame is shared, give this page its own copy */
+            uint32_t copy = (uint32_t) ppalloc();
+            if (!copy)
+                return -1; /* out of memory */
+            pmem_write((void *) copy,
+                       (void *) (get_cr2() & PAGE_BASE_MASK), PAGE_SIZE);
+            ppfree((void *) paddr);
+            paddr = copy;
+        }
+        pagetbl[pe] &= PAGE_FLAG_MASK & ~PAGE_ENTRY_COW;
+        pagetbl[pe] |= paddr | PAGE_ENTRY_RW;
+        set_cr3(get_cr3());
+        return 0;
+    }
+
     /* validate the page fault:  */
     /* ------------------------- */
     if ((pagetbl[pe] & PAGE_ENTRY_P) || !(pagetbl[pe] & PAGE_ENTRY_AF))
@@ -535,13 +735,29 @@ int32_t page_fault(uint32_t err) {
     /* allocate memory:  */
     /* ----------------- */
     if (region == NULL) {
+        /* user memory has priority over cached pages: */
+        if (get_cr2() < KERNEL_MEMORY_BASE && pcache_low()) {
+            pcache_shrink(PCACHE_BATCH);
+            icache_shrink(ICACHE_BATCH);
+        }
         paddr = ppalloc();
     } else {
         /* a mapped file */
         if (!region->paddr) {
-            region->paddr = ppalloc();
-            /* consider reading */
-            read = 1;
+            fsd_t *fsdriver = region->file->mp->sb->fsdriver;
+            /* use the file's own page if the filesystem keeps its
+             * data in memory.
+             */
+            if (fsdriver->getpage &&
+                !fsdriver->getpage(region->file->inode, region->pos,
+                                   &region->paddr)) {
+                region->direct = 1;
+            } else {
+                region->paddr = ppalloc();
+                region->direct = 0;
+                /* consider reading */
+                read = 1;
+            }
         }
         paddr = region->paddr;
     }
@@ -551,6 +767,11 @@ int32_t page_fault(uint32_t err) {
     pagetbl[pe] |= paddr;
     pagetbl[pe] |= PAGE_ENTRY_P;
     pagetbl[pe] &= ~PAGE_ENTRY_AF;
+    if (region && region->direct && !region->shared) {
+        /* private mapping of the file's page: copy on first write */
+        pagetbl[pe] &= ~PAGE_ENTRY_RW;
+        pagetbl[pe] |= PAGE_ENTRY_COW;
+    }
 
     /* update cache:  */
     /* -------------- */
@@ -559,10 +780,12 @@ int32_t page_fault(uint32_t err) {
     /* read from disk:  */
     /* ---------------- */
     if (read) {
-        fsd_t *fsdriver = region->file->mp->sb->fsdriver;
         void * buf = (void *)(get_cr2() & PAGE_BASE_MASK);
-        fsdriver->seek(region->file, region->pos);
-        fsdriver->read(region->file, buf, PAGE_SIZE);
+        ssize_t done;
+        file_pread(region->file, buf, PAGE_SIZE, region->pos, &done);
+        /* filling the page is not a write to the mapping */
+        pagetbl[pe] &= ~PAGE_ENTRY_D;
+        set_cr3(get_cr3());
     }
 
     /* return:  */
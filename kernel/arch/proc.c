@@ -90,6 +90,18 @@ void arch_proc_switch(proc_t *oldproc, proc_t *newproc) {
         return;
     }
 
+    /* special case: a kernel task that runs for the first time: */
+    if (newproc->kmain) {
+        /* clear after fork flag */
+        newproc->after_fork = 0;
+
+        /* start on an empty stack with interrupts enabled */
+        __asm__("mov %%eax, %%esp; \n\
+                 sti;              \n\
+                 call *%%ebx;"::"a"(&newproc->kstack[KERNEL_STACK_SIZE]),
+                                "b"(newproc->kmain));
+    }
+
     /* special case: a process that has just forked: */
     if (!is_in_synctest()) {
         /* clear after fork flag */
@@ -35,38 +35,106 @@
 
 void spinlock_init(spinlock_t *spinlock) {
     /* initialize spinlock to 0 (currently not acquired) */
-    *spinlock = 0;
+    spinlock->owner = 0;
+    spinlock->next  = 0;
 }
 
-void spinlock_acquire(spinlock_t *spinlock) {
-    /* x86 bts (bit test and set) instruction just works as follows:
-     * load the current value of the targeted bit into CF flag (test)
-     * set the value of the targeted bit to 1 (set).
-     * LOCK prefix guarantees that this operation is atomic and no
-     * memory access by any other CPU happens between the set
-     * and test operation (it actually locks the bus).
+static void ticket_acquire(spinlock_t *spinlock, void *site) {
+    /* take a ticket, then wait for our turn. x86 xadd (exchange
+     * and add) instruction loads the old value of the counter
+     * and stores the incremented value in one step; the LOCK
+     * prefix makes that atomic with respect to other CPUs.
+     * tickets are served in the order they are taken, so no
+     * CPU can starve as with the old test and set lock.
      *
-     * You may refer to the OS bible (2.2.3 - mutual exclusion) for
-     * information about test and set lock (TSL) instructions. BTS
-     * is also equivalent in some sense to the compare_and_swap()
-     * instruction described in Stallings (5.2, 7th edition) with
-     * *word = *spinlock, testval = 0, and newval = 1.
+     * pause tells the CPU we are in a spin-wait loop: it saves
+     * power and avoids the memory order violation penalty when
+     * the lock is finally released.
      */
-    /*if (scheduler_enabled && !(get_eflags() & 0x200)) {
-        Regs regs = {0};
-        __asm__("mov ., %%eax":"=a"(regs.eip));
-        __asm__("mov %%ebp, %%eax":"=a"(regs.ebp));
-        panic(&regs, "Error: spinlock_acquire() from interrupt context!");
-    }*/
+    uint16_t ticket = 1;
+    uint64_t start = LOCKPROF_CLOCK();
+    int32_t contended;
+    __asm__ __volatile__("lock xaddw %0, %1"
+                         :"+r"(ticket), "+m"(spinlock->next)
+                         ::"memory");
+    contended = spinlock->owner != ticket;
+    while (spinlock->owner != ticket)
+        arch_cpu_relax();
+    __asm__ __volatile__("":::"memory");
+    LOCKPROF_ACQUIRED(spinlock, LOCK_SPIN, site, contended, start);
+}
 
-    __asm__("1: lock bts $0, (%%esi);\n"
-            "   jc       1b         ;\n"::"S"(spinlock));
+void spinlock_acquire(spinlock_t *spinlock) {
+    ticket_acquire(spinlock, __builtin_return_address(0));
 }
 
+int32_t spinlock_tryacquire(spinlock_t *spinlock) {
+    /* acquire the lock only if it is free, returns nonzero
+     * on success. the ticket is only taken if it would be
+     * served immediately.
+     */
+    uint32_t old, val;
+    old = *((volatile uint32_t *) spinlock);
+    if ((old & 0xFFFF) != (old >> 16))
+        return 0;
+    val = old + 0x10000;
+    if (arch_atomic_cmpxchg((volatile int32_t *) spinlock, old, val) != old)
+        return 0;
+    LOCKPROF_ACQUIRED(spinlock, LOCK_SPIN, __builtin_return_address(0),
+                      0, LOCKPROF_CLOCK());
+    return 1;
+}
 
 void spinlock_release(spinlock_t *spinlock) {
-    /* set spinlock to zero to let other processes
-     * be able to hold it by spinlock_acquire().
+    /* serve the next ticket. only the holder writes owner, so
+     * a plain store after a compiler barrier is enough: x86 does
+     * not reorder stores with older loads or stores.
+     */
+    LOCKPROF_RELEASED(spinlock);
+    __asm__ __volatile__("":::"memory");
+    spinlock->owner++;
+}
+
+int32_t spinlock_acquire_irqsave(spinlock_t *spinlock) {
+    /* disable local interrupts then acquire the lock, for locks
+     * that are also taken by interrupt handlers. returns the
+     * previous interrupt status.
+     */
+    int32_t status = arch_get_int_status();
+    arch_disable_interrupts();
+    ticket_acquire(spinlock, __builtin_return_address(0));
+    return status;
+}
+
+void spinlock_release_irqrestore(spinlock_t *spinlock, int32_t status) {
+    spinlock_release(spinlock);
+    arch_set_int_status(status);
+}
+
+/***************************************************************************/
+/*                              Atomic Primitives                          */
+/***************************************************************************/
+
+int32_t arch_atomic_xchg(volatile int32_t *ptr, int32_t val) {
+    /* xchg with a memory operand is always locked */
+    __asm__ __volatile__("xchgl %0, %1"
+                         :"+r"(val), "+m"(*ptr)
+                         ::"memory");
+    return val;
+}
+
+int32_t arch_atomic_cmpxchg(volatile int32_t *ptr, int32_t old, int32_t val) {
+    /* store val in *ptr if *ptr equals old, returns
+     * the value *ptr had before.
      */
-    *spinlock = 0;
+    int32_t prev;
+    __asm__ __volatile__("lock cmpxchgl %2, %1"
+                         :"=a"(prev), "+m"(*ptr)
+                         :"r"(val), "0"(old)
+                         :"memory");
+    return prev;
+}
+
+void arch_cpu_relax() {
+    __asm__ __volatile__("pause":::"memory");
 }
@@ -1 +1,4 @@
 #define QUAFIOS_KERNEL
+
+/* kernel options: */
+/* #define CONFIG_LOCKPROF */ /* lock profiler, reports in /sys/locks. */
@@ -124,3 +124,18 @@ uint32_t sputd(char *buf, int32_t value) {
         return count+1;
     }
 }
+
+uint32_t sputx(char *buf, uint32_t value) {
+    int32_t i;
+    for (i = 7; i >= 0; i--)
+        buf[7-i] = "0123456789ABCDEF"[(value >> (i*4)) & 0x0F];
+    return 8;
+}
+
+uint32_t sputq(char *buf, uint64_t value) {
+    uint32_t count = 0;
+    if (value >= 10)
+        count = sputq(buf, value / 10);
+    buf[count] = (value % 10)+'0';
+    return count+1;
+}
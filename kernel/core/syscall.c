@@ -75,8 +75,29 @@ int32_t syscall(int32_t number, ...) {
         case SYS_SEND:      {ret=DO_CALL(send             ); break;}
         case SYS_RECEIVE:   {ret=DO_CALL(receive          ); break;}
         case SYS_GETPID:    {ret=DO_CALL(getpid           ); break;}
-        case SYS_REBOOT:    {ret=DO_CALL(legacy_reboot    ); break;}
+        case SYS_REBOOT:    {sync_all(); ret=DO_CALL(legacy_reboot); break;}
         case SYS_MUNMAP:    {ret=DO_CALL(munmap           ); break;}
+        case SYS_CALL:      {ret=DO_CALL(call             ); break;}
+        case SYS_REPLY_WAIT:{ret=DO_CALL(reply_wait       ); break;}
+        case SYS_CHAN_CREATE:{ret=DO_CALL(chan_create     ); break;}
+        case SYS_CHAN_MAP:  {ret=DO_CALL(chan_map         ); break;}
+        case SYS_CHAN_WAIT: {ret=DO_CALL(chan_wait        ); break;}
+        case SYS_CHAN_NOTIFY:{ret=DO_CALL(chan_notify     ); break;}
+        case SYS_CHAN_CLOSE:{ret=DO_CALL(chan_close       ); break;}
+        case SYS_POLL:      {ret=DO_CALL(poll             ); break;}
+        case SYS_PIPE:      {ret=DO_CALL(pipe             ); break;}
+        case SYS_SPLICE:    {ret=DO_CALL(splice           ); break;}
+        case SYS_SYNC:      {ret=DO_CALL(sync             ); break;}
+        case SYS_FSYNC:     {ret=DO_CALL(fsync            ); break;}
+        case SYS_GETDENTS:  {ret=DO_CALL(getdents         ); break;}
+        case SYS_PREAD:     {ret=DO_CALL(pread            ); break;}
+        case SYS_PWRITE:    {ret=DO_CALL(pwrite           ); break;}
+        case SYS_READV:     {ret=DO_CALL(readv            ); break;}
+        case SYS_WRITEV:    {ret=DO_CALL(writev           ); break;}
+        case SYS_COPY_RANGE:{ret=DO_CALL(copy_file_range  ); break;}
+        case SYS_MSYNC:     {ret=DO_CALL(msync            ); break;}
+        case SYS_UPTIME:    {ret=DO_CALL(uptime           ); break;}
+        case SYS_CHAN_GRANT:{ret=DO_CALL(chan_grant       ); break;}
         default:            {ret=-EINVAL                   ; break;}
     }
 
@@ -37,6 +37,7 @@
 #include <sys/bootinfo.h>
 #include <sys/scheduler.h>
 #include <sys/semaphore.h>
+#include <sys/mutex.h>
 #include <pci/pci.h>
 #include <storage/disk.h>
 #include <ata/ide.h>
@@ -68,7 +69,7 @@ driver_t atadisk_driver = {
 typedef struct {
     device_t *dev;
     ata_drive_t *drive;
-    uint32_t cache_lock;
+    mutex_t  cache_lock;
     uint64_t cache_sect;
     char     cache_data[512];
     semaphore_t sema;
@@ -107,15 +108,16 @@ static int32_t read_sector_part(info_t *info,
                                 uint32_t size,
                                 char *buf) {
     int32_t err, i;
-    while(info->cache_lock);
-    info->cache_lock = 1;
+    mutex_lock(&info->cache_lock);
     if (info->cache_sect != lba) {
-        if (err = read_sectors(info, 1, lba, info->cache_data))
+        if (err = read_sectors(info, 1, lba, info->cache_data)) {
+            mutex_unlock(&info->cache_lock);
             return err;
+        }
     }
     for (i = off; i < off+size; i++)
         *buf++ = info->cache_data[i];
-    info->cache_lock = 0;
+    mutex_unlock(&info->cache_lock);
     return 0;
 }
 
@@ -141,7 +143,7 @@ uint32_t atadisk_probe(device_t *dev, void *drive_ptr) {
     info->dev = dev;
 
     /* initialize buffer */
-    info->cache_lock = 0;
+    mutex_init(&info->cache_lock);
     info->cache_sect = -1;
 
     /* initialize semaphore */
@@ -0,0 +1,302 @@
+/*
+ *        +----------------------------------------------------------+
+ *        | +------------------------------------------------------+ |
+ *        | |  Quafios Kernel 2.0.1.                               | |
+ *        | |  -> ATAPI CD-ROM Device Driver.                      | |
+ *        | +------------------------------------------------------+ |
+ *        +----------------------------------------------------------+
+ *
+ * This file is part of Quafios 2.0.1 source code.
+ * Copyright (C) 2015  Mostafa Abd El-Aziz Mohamed.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Quafios.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Visit http://www.quafios.com/ for contact information.
+ *
+ */
+
+#include <arch/type.h>
+#include <lib/linkedlist.h>
+#include <sys/error.h>
+#include <sys/printk.h>
+#include <sys/mm.h>
+#include <sys/class.h>
+#include <sys/resource.h>
+#include <sys/device.h>
+#include <sys/scheduler.h>
+#include <sys/semaphore.h>
+#include <sys/mutex.h>
+#include <storage/disk.h>
+#include <ata/ide.h>
+
+/* Prototypes: */
+uint32_t atapicd_probe(device_t *, void *);
+uint32_t atapicd_read (device_t *, uint64_t, uint32_t, char *);
+uint32_t atapicd_write(device_t *, uint64_t, uint32_t, char *);
+uint32_t atapicd_ioctl(device_t *, uint32_t, void *);
+uint32_t atapicd_irq  (device_t *, uint32_t);
+
+/* Classes supported: */
+static class_t classes[] = {
+    {BUS_IDE, BASE_ATAPI_CDROM, SUB_ATAPI_CDROM_GENERIC, IF_ANY}
+};
+
+/* driver_t structure that identifies this driver: */
+driver_t atapicd_driver = {
+    /* cls_count: */ sizeof(classes)/sizeof(class_t),
+    /* cls:       */ classes,
+    /* alias:     */ "atapicd",
+    /* probe:     */ atapicd_probe,
+    /* read:      */ atapicd_read,
+    /* write:     */ atapicd_write,
+    /* ioctl:     */ atapicd_ioctl,
+    /* irq:       */ atapicd_irq
+};
+
+/* sectors read by one command */
+#define MAX_SECCOUNT    32
+
+/* attempts per command; the first command after a medium change
+ * fails with a unit attention.
+ */
+#define RETRIES         3
+
+typedef struct {
+    device_t *dev;
+    ata_drive_t *drive;
+    mutex_t  cache_lock;
+    uint64_t cache_sect;
+    char     cache_data[ATAPI_SECTOR_SIZE];
+    uint64_t sectors; /* size of the medium, 0 if unknown. */
+    semaphore_t sema;
+    disk_t  *disk;
+} info_t;
+
+/* ================================================================= */
+/*                           ATAPI Interface                         */
+/* ================================================================= */
+
+static int32_t send_packet(info_t *info,
+                           uint8_t *packet,
+                           uint32_t size,
+                           char *buf) {
+    ata_req_t req;
+    req.protocol  = ATA_PROTO_PACKET;
+    req.channel   = info->drive->channel;
+    req.drvnum    = info->drive->drvnum;
+    req.packet    = packet;
+    req.buf       = (uint8_t *) buf;
+    req.bufsize   = size;
+    req.drqsize   = ATAPI_SECTOR_SIZE;
+    req.direction = ATA_DIR_READ;
+    req.wmode     = ATA_WMODE_IRQ;
+    return dev_ioctl(info->dev->parent_bus->ctl, 0, &req);
+}
+
+static void request_sense(info_t *info) {
+    /* fetch (and so clear) the error condition of the drive */
+    uint8_t packet[ATAPI_PACKET_SIZE] = {0};
+    char sense[18];
+    packet[0] = ATAPI_CMD_REQUEST_SENSE;
+    packet[4] = sizeof(sense);
+    send_packet(info, packet, sizeof(sense), sense);
+}
+
+static int32_t read_capacity(info_t *info) {
+    /* find out how many sectors the medium has. the first command
+     * after a medium change fails with a unit attention, TEST UNIT
+     * READY takes that.
+     */
+    uint8_t packet[ATAPI_PACKET_SIZE] = {0};
+    uint8_t cap[8];
+    uint32_t last, secsize;
+    int32_t err, i;
+
+    /* TEST UNIT READY */
+    for (i = 0; i < RETRIES; i++) {
+        packet[0] = ATAPI_CMD_TEST_UNIT;
+        if (!(err = send_packet(info, packet, 0, NULL)))
+            break;
+        request_sense(info);
+    }
+    if (err)
+        return err; /* no medium */
+
+    /* READ CAPACITY: last sector and sector size, big endian */
+    packet[0] = ATAPI_CMD_READ_CAPACITY;
+    if (err = send_packet(info, packet, sizeof(cap), (char *) cap)) {
+        request_sense(info);
+        return err;
+    }
+    last    = (cap[0]<<24)|(cap[1]<<16)|(cap[2]<<8)|cap[3];
+    secsize = (cap[4]<<24)|(cap[5]<<16)|(cap[6]<<8)|cap[7];
+    if (secsize != ATAPI_SECTOR_SIZE)
+        return EIO;
+    info->sectors = ((uint64_t) last) + 1;
+    return 0;
+}
+
+static int32_t read_sectors(info_t *info,
+                            uint32_t seccount,
+                            uint64_t lba,
+                            char *buf) {
+    uint8_t packet[ATAPI_PACKET_SIZE] = {0};
+    int32_t err, i;
+
+    /* past the end of the medium? (it may have been changed) */
+    if (info->sectors && lba + seccount > info->sectors &&
+        (read_capacity(info) || lba + seccount > info->sectors))
+        return EIO;
+
+    /* READ (10) */
+    packet[0] = ATAPI_CMD_READ10;
+    packet[2] = (lba>>24)&0xFF;
+    packet[3] = (lba>>16)&0xFF;
+    packet[4] = (lba>> 8)&0xFF;
+    packet[5] = (lba>> 0)&0xFF;
+    packet[7] = (seccount>>8)&0xFF;
+    packet[8] = (seccount>>0)&0xFF;
+
+    for (i = 0; i < RETRIES; i++) {
+        if (!(err = send_packet(info, packet, seccount*ATAPI_SECTOR_SIZE,
+                                buf)))
+            return 0;
+        request_sense(info);
+    }
+    return err;
+}
+
+static int32_t read_sector_part(info_t *info,
+                                uint64_t lba,
+                                uint32_t off,
+                                uint32_t size,
+                                char *buf) {
+    int32_t err, i;
+    mutex_lock(&info->cache_lock);
+    if (info->cache_sect != lba) {
+        if (err = read_sectors(info, 1, lba, info->cache_data)) {
+            info->cache_sect = -1;
+            mutex_unlock(&info->cache_lock);
+            return err;
+        }
+        info->cache_sect = lba;
+    }
+    for (i = off; i < off+size; i++)
+        *buf++ = info->cache_data[i];
+    mutex_unlock(&info->cache_lock);
+    return 0;
+}
+
+/* ================================================================= */
+/*                             Interface                             */
+/* ================================================================= */
+
+uint32_t atapicd_probe(device_t *dev, void *drive_ptr) {
+
+    /* create info_t structure: */
+    info_t *info = (info_t *) kmalloc(sizeof(info_t));
+    dev->drvreg = (uint32_t) info;
+    if (info == NULL)
+        return ENOMEM;
+
+    /* splash */
+    printk("- ATAPI CD-ROM DRIVER (%d)\n", dev->devid);
+
+    /* store drive and device pointers in info structure */
+    info->drive = drive_ptr;
+    info->dev = dev;
+
+    /* initialize buffer */
+    mutex_init(&info->cache_lock);
+    info->cache_sect = -1;
+
+    /* initialize semaphore */
+    sema_init(&info->sema, 1);
+
+    /* size of the medium, if there is one */
+    info->sectors = 0;
+    read_capacity(info);
+
+    /* register disk, CDs are not partitioned */
+    info->disk = kmalloc(sizeof(disk_t));
+    info->disk->dev = dev;
+    add_disk(info->disk, "cd", 0);
+
+    /* done */
+    return ESUCCESS;
+
+}
+
+uint32_t atapicd_read(device_t *dev, uint64_t off, uint32_t size, char *buff){
+
+    info_t *info = (info_t *) dev->drvreg;
+    uint32_t part, sects;
+
+    sema_down(&info->sema);
+
+    /* head: offset is not sector aligned */
+    if (size && off % ATAPI_SECTOR_SIZE) {
+        part = ATAPI_SECTOR_SIZE - off%ATAPI_SECTOR_SIZE;
+        if (part > size)
+            part = size;
+        if (read_sector_part(info, off/ATAPI_SECTOR_SIZE,
+                             off%ATAPI_SECTOR_SIZE, part, buff)) {
+            sema_up(&info->sema);
+            return EIO;
+        }
+        off  += part;
+        buff += part;
+        size -= part;
+    }
+
+    /* body: whole sectors */
+    while (size >= ATAPI_SECTOR_SIZE) {
+        sects = size/ATAPI_SECTOR_SIZE;
+        if (sects > MAX_SECCOUNT)
+            sects = MAX_SECCOUNT;
+        if (read_sectors(info, sects, off/ATAPI_SECTOR_SIZE, buff)) {
+            sema_up(&info->sema);
+            return EIO;
+        }
+        off  += sects*ATAPI_SECTOR_SIZE;
+        buff += sects*ATAPI_SECTOR_SIZE;
+        size -= sects*ATAPI_SECTOR_SIZE;
+    }
+
+    /* tail */
+    if (size) {
+        if (read_sector_part(info, off/ATAPI_SECTOR_SIZE, 0, size, buff)) {
+            sema_up(&info->sema);
+            return EIO;
+        }
+    }
+
+    /* done */
+    sema_up(&info->sema);
+    return ESUCCESS;
+
+}
+
+uint32_t atapicd_write(device_t *dev, uint64_t off, uint32_t size,char *buff){
+    /* read-only medium */
+    return EREADONLY;
+}
+
+uint32_t atapicd_ioctl(device_t *dev, uint32_t cmd, void *data) {
+    return ESUCCESS;
+}
+
+uint32_t atapicd_irq(device_t *dev, uint32_t irqn) {
+    return ESUCCESS;
+}
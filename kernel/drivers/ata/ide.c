@@ -570,6 +570,90 @@ int32_t pio_data(info_t *info,
 
 }
 
+int32_t packet_data(info_t *info,
+                    uint32_t channel,
+                    uint32_t drvnum,
+                    uint8_t  *packet,
+                    uint8_t  *buf,
+                    uint32_t bufsize,
+                    uint32_t drqsize,
+                    uint32_t wmode) {
+
+    /* ATAPI PIO data-in: the drive takes a 12-byte command packet
+     * and hands the data over in DRQ blocks of at most drqsize bytes,
+     * every block tells its own size.
+     */
+    int32_t err, i;
+    uint32_t bytes, done = 0;
+    uint16_t word;
+    uint32_t drivesel = DEVSEL_MASK_ONE0 | DEVSEL_MASK_ONE1;
+
+    /* 1: select the drive, no DMA, set the byte count limit */
+    if (drvnum)
+        drivesel |= DEVSEL_MASK_SLAVE;
+    write_reg(info, channel, ATA_REG_HEAD_DRIVE_SEL, drivesel);
+    delay_400ns(info, channel);
+    write_reg(info, channel, ATA_REG_FEATURES_ERRORS, 0);
+    write_reg(info, channel, ATA_REG_CYLINDER_LOW, (drqsize>>0)&0xFF);
+    write_reg(info, channel, ATA_REG_CYLINDER_HIGH, (drqsize>>8)&0xFF);
+    info->channels[channel].is_active = 1;
+
+    /* 2: send the command, and wait until the drive asks for
+     *    the packet. reading the status clears any IRQ raised
+     *    for that.
+     */
+    write_cmd(info, channel, ATA_CMD_PACKET);
+    delay_400ns(info, channel);
+    if ((err = wait_not_busy_alt(info, channel)) ||
+        (err = wait_drq_err_alt(info, channel))) {
+        info->channels[channel].is_active = 0;
+        return err;
+    }
+    read_status(info, channel);
+
+    /* 3: send the packet */
+    if (wmode == ATA_WMODE_IRQ)
+        enable_irq(info, channel);
+    for (i = 0; i < ATAPI_PACKET_SIZE/2; i++)
+        write_data2(info, channel, ((uint16_t *) packet)[i]);
+
+    /* 4: transfer the data block by block */
+    while (done < bufsize) {
+        if ((err = wait_for_drq(info, channel, wmode)) ||
+            (err = wait_not_busy_alt(info, channel)))
+            break;
+        if (!(read_status_alt(info, channel) & STATUS_MASK_DRQ))
+            break; /* the drive has nothing more to send */
+        bytes = (read_cylinder_high(info, channel) << 8) |
+                 read_cylinder_low(info, channel);
+        if (!bytes || bytes > bufsize - done) {
+            err = 2; /* not what was asked for */
+            break;
+        }
+        /* the data port is 16 bits wide, an odd count is padded: */
+        for (i = 0; i < bytes; i += 2) {
+            word = read_data2(info, channel);
+            buf[done+i] = word & 0xFF;
+            if (i+1 < bytes)
+                buf[done+i+1] = word >> 8;
+        }
+        done += bytes;
+    }
+
+    /* 5: wait for the command to complete */
+    if (!err && (err = wait_not_busy(info, channel)) == 0 &&
+        (read_status(info, channel) & STATUS_MASK_ERR || done < bufsize))
+        err = 2;
+
+    /* 6: disable interrupts */
+    disable_irq(info, channel);
+    info->channels[channel].is_active = 0;
+
+    /* 7: done */
+    return err;
+
+}
+
 /* ================================================================= */
 /*                             Interface                             */
 /* ================================================================= */
@@ -935,7 +1019,9 @@ uint32_t ide_ioctl(device_t *dev, uint32_t cmd, void *data) {
                             req->bufsize, req->drqsize, req->direction,
                             req->wmode);
         case ATA_PROTO_PACKET:
-            return 2;
+            return packet_data(info, req->channel, req->drvnum, req->packet,
+                               req->buf, req->bufsize, req->drqsize,
+                               req->wmode);
         default:
             return 2; /* error */
     }
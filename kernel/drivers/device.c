@@ -36,6 +36,7 @@
 #include <sys/error.h>
 #include <sys/mm.h>
 #include <sys/device.h>
+#include <sys/poll.h>
 
 /* Supported Drivers:  */
 /* ------------------- */
@@ -56,6 +57,7 @@ driver_t *drivers[] = {
     &vga_driver,
     &ide_driver,
     &atadisk_driver,
+    &atapicd_driver,
     &ahci_driver,
     &uhci_driver,
     &ehci_driver,
@@ -214,6 +216,23 @@ uint32_t dev_ioctl(device_t *dev, uint32_t cmd, void *data) {
 
 }
 
+/* ================================================================= */
+/*                            dev_poll()                             */
+/* ================================================================= */
+
+uint32_t dev_poll(device_t *dev, struct poll_table *pt) {
+
+    if (dev == NULL || dev->driver == NULL)
+        return POLLERR;
+
+    /* devices that never block are always ready */
+    if (dev->driver->poll == NULL)
+        return POLLIN | POLLOUT;
+
+    return dev->driver->poll(dev, pt);
+
+}
+
 /* ================================================================= */
 /*                            dev_irq()                              */
 /* ================================================================= */
@@ -99,6 +99,8 @@ uint32_t ramdisk_read(device_t *dev, uint64_t off, uint32_t size, char *buff) {
     info_t *info = (info_t *) dev->drvreg;
     if (info == NULL)
         return ENOMEM;
+    if (!info->size)
+        return EIO; /* released */
 
     while (size--) {
         if (off > info->size)
@@ -115,6 +117,8 @@ uint32_t ramdisk_write(device_t *dev, uint64_t off, uint32_t size, char *buff){
     info_t *info = (info_t *) dev->drvreg;
     if (info == NULL)
         return ENOMEM;
+    if (!info->size)
+        return EIO; /* released */
 
     while (size--) {
         if (off > info->size)
@@ -127,6 +131,9 @@ uint32_t ramdisk_write(device_t *dev, uint64_t off, uint32_t size, char *buff){
 }
 
 uint32_t ramdisk_ioctl(device_t *dev, uint32_t cmd, void *data) {
+    info_t *info = (info_t *) dev->drvreg;
+    if (info && cmd == RAMDISK_RELEASE)
+        info->size = 0; /* its memory is about to be reused */
     return ESUCCESS;
 }
 
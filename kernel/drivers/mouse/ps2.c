@@ -40,6 +40,7 @@
 #include <mouse/generic.h>
 #include <sys/bootinfo.h>
 #include <sys/scheduler.h>
+#include <sys/chan.h>
 
 /* Prototypes: */
 uint32_t ps2mouse_probe(device_t *, void *);
@@ -65,6 +66,7 @@ int32_t y_of      = 0;
 int32_t mouse_counter = 0; /* packet counter */
 static int32_t listener_pid = -1;
 static uint8_t listener_prefix = -1;
+static int32_t listener_chan = -1;
 static bootinfo_t *bootinfo = (bootinfo_t *) 0x10000;
 extern uint32_t legacy_lfb_enabled;
 
@@ -163,6 +165,19 @@ uint32_t ps2mouse_ioctl(device_t *dev, uint32_t cmd, void *data) {
             listener_pid    = curproc->pid;
             listener_prefix = (uint8_t) data;
             break;
+        case MOUSE_CHAN:
+            /* packets go to a shared ring from now on */
+            if (listener_chan < 0) {
+                int32_t id = chan_alloc(sizeof(mouse_packet_t),
+                                        MOUSE_CHAN_SLOTS, -1);
+                if (id < 0)
+                    return -id;
+                listener_chan = id;
+            }
+            /* the caller is the one to map it */
+            chan_allow(listener_chan, -1, curproc->pid);
+            *((int32_t *) data) = listener_chan;
+            break;
         default:
             break;
     }
@@ -223,7 +238,8 @@ uint32_t ps2mouse_irq(device_t *dev, uint32_t irqn) {
     else if (mouse_y >= bootinfo->vga_height)
         mouse_y = bootinfo->vga_height-1;
 
-    if (mouse_counter == 2 && listener_pid != -1 && !legacy_lfb_enabled) {
+    if (mouse_counter == 2 && (listener_pid != -1 || listener_chan != -1) &&
+        !legacy_lfb_enabled) {
 
         /* send a packet to the listening program */
         mouse_packet_t packet;
@@ -239,12 +255,19 @@ uint32_t ps2mouse_irq(device_t *dev, uint32_t irqn) {
         packet.right_btn = right_btn;
         packet.time      = ticks*10;
 
-        /* initialize msg */
-        msg.size = sizeof(packet);
-        msg.buf  = &packet;
+        if (listener_chan != -1) {
+            /* put it in the ring, the listener is only woken up
+             * if it is sleeping on the channel.
+             */
+            chan_push(listener_chan, &packet);
+        } else {
+            /* initialize msg */
+            msg.size = sizeof(packet);
+            msg.buf  = &packet;
 
-        /* do the send! */
-        send(listener_pid, &msg);
+            /* do the send! */
+            send(listener_pid, &msg);
+        }
 
     }
 
@@ -37,6 +37,7 @@
 #include <sys/bootinfo.h>
 #include <sys/scheduler.h>
 #include <sys/semaphore.h>
+#include <sys/mutex.h>
 #include <storage/disk.h>
 #include <scsi/scsi.h>
 
@@ -68,7 +69,7 @@ typedef struct {
     device_t    *dev;
     device_t    *ctrlr;
     int32_t      lun;
-    uint32_t     cache_lock;
+    mutex_t      cache_lock;
     uint64_t     cache_sect;
     char         cache_data[512];
     semaphore_t  sema;
@@ -121,15 +122,16 @@ static int32_t read_sector_part(info_t *info,
                                 char *buf) {
 
     int32_t err, i;
-    while(info->cache_lock);
-    info->cache_lock = 1;
+    mutex_lock(&info->cache_lock);
     if (info->cache_sect != lba) {
-        if (err = read_sectors(info, 1, lba, info->cache_data))
+        if (err = read_sectors(info, 1, lba, info->cache_data)) {
+            mutex_unlock(&info->cache_lock);
             return err;
+        }
     }
     for (i = off; i < off+size; i++)
         *buf++ = info->cache_data[i];
-    info->cache_lock = 0;
+    mutex_unlock(&info->cache_lock);
     return 0;
 }
 
@@ -153,7 +155,7 @@ uint32_t scsidisk_probe(device_t *dev, void *config) {
     /* initialize info structure */
     info->ctrlr      = scsi_config->ctrlr;
     info->lun        = scsi_config->lun;
-    info->cache_lock = 0;
+    mutex_init(&info->cache_lock);
     info->cache_sect = -1;
     sema_init(&info->sema, 1);
 
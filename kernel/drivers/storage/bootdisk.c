@@ -31,8 +31,10 @@
 #include <sys/device.h>
 #include <storage/disk.h>
 #include <fs/diskfs.h>
+#include <fs/iso9660.h>
 #include <sys/mm.h>
 #include <sys/bootinfo.h>
+#include <mem/ramdisk.h>
 
 extern bootinfo_t *bootinfo;
 
@@ -74,3 +76,62 @@ int32_t detect_bootdisk() {
     }
     return -1;
 }
+
+/* volume id of live CDs, set by "make isolive": */
+#define LIVE_VOLUME_ID  "QUAFIOS_LIVE"
+
+int iso9660_islive(device_t *dev) {
+    iso9660_pvd_t *pvd;
+    char *id = LIVE_VOLUME_ID;
+    int32_t i;
+    int32_t ret = -1;
+    if (!(pvd = kmalloc(ISO9660_SECTOR)))
+        return ret;
+    if (!dev_read(dev, (int64_t) ISO9660_VD_START*ISO9660_SECTOR,
+                  ISO9660_SECTOR, (char *) pvd) &&
+        pvd->type == ISO9660_VD_PRIMARY && pvd->id[0] == 'C' &&
+        pvd->id[1] == 'D' && pvd->id[2] == '0' && pvd->id[3] == '0' &&
+        pvd->id[4] == '1') {
+        /* padded with spaces */
+        for (i = 0; id[i] && pvd->volume_id[i] == id[i]; i++);
+        if (!id[i] && (i == 32 || pvd->volume_id[i] == ' '))
+            ret = 0;
+    }
+    kfree(pvd);
+    return ret;
+}
+
+int32_t detect_bootcd() {
+    /* the live CD the system was booted from, if it is reachable.
+     * it is mounted instead of the ramdisk, its files are read in
+     * as they are used.
+     */
+    extern linkedlist devices;
+    device_t *dev = (device_t *) devices.first;
+    if (!bootinfo->live)
+        return -1;
+    while (dev) {
+        disk_t *disk = (disk_t *) get_disk_by_devid(dev->devid);
+        if (disk && !disk->partitioned && !iso9660_islive(dev))
+            return dev->devid;
+        dev = dev->next;
+    }
+    return -1;
+}
+
+void release_ramdisk() {
+    /* the ramdisk of a live CD only served to boot the kernel once
+     * the CD itself is root. it is shut off, and its memory is given
+     * back.
+     */
+    extern linkedlist devices;
+    device_t *dev = (device_t *) devices.first;
+    if (!bootinfo->live)
+        return;
+    while (dev) {
+        if (dev->driver == &ramdisk_driver)
+            dev_ioctl(dev, RAMDISK_RELEASE, NULL);
+        dev = dev->next;
+    }
+    pmem_release(BI_RAMDISK);
+}
@@ -36,6 +36,9 @@
 #include <sys/device.h>
 #include <sys/bootinfo.h>
 #include <sys/scheduler.h>
+#include <sys/pcache.h>
+#include <lib/string.h>
+#include <arch/page.h>
 #include <storage/disk.h>
 
 disk_t *disks = NULL;
@@ -81,3 +84,174 @@ void add_disk(disk_t *disk, char *prefix, int partition) {
     if (partition)
         partprobe(disk);
 }
+
+/* ================================================================= */
+/*                          Cached block I/O                         */
+/* ================================================================= */
+
+uint32_t blkdev_read(device_t *dev, uint64_t off, uint32_t size, char *buff) {
+
+    /* read through the page cache, whole pages are read from
+     * the device on a miss.
+     */
+    page_t *page;
+    uint32_t index, poff, chunk, err;
+
+    while (size) {
+        index = off / PAGE_SIZE;
+        poff  = off % PAGE_SIZE;
+        chunk = size < PAGE_SIZE-poff ? size : PAGE_SIZE-poff;
+        if (!(page = pcache_get(dev, 0, index))) {
+            /* no memory for caching */
+            return dev_read(dev, off, size, buff);
+        }
+        if (!(page->flags & PG_VALID)) {
+            err = dev_read(dev, (uint64_t) index*PAGE_SIZE, PAGE_SIZE,
+                           (char *) page->data);
+            pcache_ready(page, !err);
+            if (err) {
+                pcache_put(page);
+                return err;
+            }
+        }
+        memcpy(buff, &page->data[poff], chunk);
+        pcache_put(page);
+        off  += chunk;
+        buff += chunk;
+        size -= chunk;
+    }
+
+    return ESUCCESS;
+
+}
+
+uint32_t blkdev_write(device_t *dev, uint64_t off, uint32_t size, char *buff) {
+
+    /* write into the cache only, the dirty sectors go to the device
+     * when blkdev_sync() runs. pages that are partly written are
+     * read in first. without memory for caching, write through.
+     */
+    page_t *page;
+    uint32_t index, poff, chunk, err;
+
+    while (size) {
+        index = off / PAGE_SIZE;
+        poff  = off % PAGE_SIZE;
+        chunk = size < PAGE_SIZE-poff ? size : PAGE_SIZE-poff;
+        if (!(page = pcache_get(dev, 0, index))) {
+            /* no memory for caching */
+            return dev_write(dev, off, size, buff);
+        }
+        if (!(page->flags & PG_VALID)) {
+            err = ESUCCESS;
+            if (chunk != PAGE_SIZE)
+                err = dev_read(dev, (uint64_t) index*PAGE_SIZE, PAGE_SIZE,
+                               (char *) page->data);
+            pcache_ready(page, !err);
+            if (err) {
+                pcache_put(page);
+                return err;
+            }
+        }
+        memcpy(&page->data[poff], buff, chunk);
+        pcache_dirty(page, poff, chunk);
+        pcache_put(page);
+        off  += chunk;
+        buff += chunk;
+        size -= chunk;
+    }
+
+    return ESUCCESS;
+
+}
+
+uint32_t blkdev_write_direct(device_t *dev, uint64_t off, uint32_t size,
+                             char *buff) {
+
+    /* write straight to the device; for data that is cached by
+     * somebody else (file pages). in that order, a page that is
+     * being filled meanwhile either reads the new data or gets
+     * patched here. patched sectors are clean now, otherwise an
+     * old change to them would be written back over the new data.
+     */
+    page_t *page;
+    uint32_t index, poff, chunk, err;
+
+    if (err = dev_write(dev, off, size, buff))
+        return err;
+
+    while (size) {
+        index = off / PAGE_SIZE;
+        poff  = off % PAGE_SIZE;
+        chunk = size < PAGE_SIZE-poff ? size : PAGE_SIZE-poff;
+        if (page = pcache_find(dev, 0, index)) {
+            memcpy(&page->data[poff], buff, chunk);
+            pcache_clean(page, poff, chunk);
+            pcache_put(page);
+        }
+        off  += chunk;
+        buff += chunk;
+        size -= chunk;
+    }
+
+    return ESUCCESS;
+
+}
+
+uint32_t blkdev_sync(device_t *dev) {
+
+    /* write the dirty sectors of dev back, in order of offset.
+     * sectors that follow each other are written in one request,
+     * across pages too, up to BLKDEV_SYNC_PAGES pages at once.
+     */
+    page_t *list[BLKDEV_SYNC_PAGES], *page;
+    uint32_t n, i, j, s, mask, len = 0, err = ESUCCESS, e;
+    uint64_t start = 0, off;
+    char *buf;
+
+    if (!(buf = kmalloc(BLKDEV_SYNC_PAGES*PAGE_SIZE)))
+        return ENOMEM;
+
+    while (n = pcache_collect(dev, 0, list, BLKDEV_SYNC_PAGES)) {
+
+        /* sort the batch by index */
+        for (i = 1; i < n; i++) {
+            page = list[i];
+            for (j = i; j && list[j-1]->index > page->index; j--)
+                list[j] = list[j-1];
+            list[j] = page;
+        }
+
+        /* copy dirty sectors out, writing each run as it ends */
+        for (i = 0; i < n; i++) {
+            page = list[i];
+            mask = pcache_clean(page, 0, PAGE_SIZE);
+            for (s = 0; s < PAGE_SIZE/PCACHE_SECTOR; s++) {
+                if (!(mask & (1 << s)))
+                    continue;
+                off = (uint64_t) page->index*PAGE_SIZE + s*PCACHE_SECTOR;
+                if (len && (off != start+len ||
+                            len == BLKDEV_SYNC_PAGES*PAGE_SIZE)) {
+                    if (e = dev_write(dev, start, len, buf))
+                        err = e;
+                    len = 0;
+                }
+                if (!len)
+                    start = off;
+                memcpy(&buf[len], &page->data[s*PCACHE_SECTOR],
+                       PCACHE_SECTOR);
+                len += PCACHE_SECTOR;
+            }
+            pcache_put(page);
+        }
+
+    }
+
+    /* the last run */
+    if (len && (e = dev_write(dev, start, len, buf)))
+        err = e;
+
+    kfree(buf);
+    return err;
+
+}
@@ -37,6 +37,8 @@
 #include <sys/ipc.h>
 #include <tty/vtty.h>
 #include <tty/pstty.h>
+#include <sys/waitq.h>
+#include <sys/poll.h>
 
 /* Prototypes: */
 uint32_t pstty_probe(device_t *, void *);
@@ -44,6 +46,7 @@ uint32_t pstty_read (device_t *, uint64_t, uint32_t, char *);
 uint32_t pstty_write(device_t *, uint64_t, uint32_t, char *);
 uint32_t pstty_ioctl(device_t *, uint32_t, void *);
 uint32_t pstty_irq  (device_t *, uint32_t);
+uint32_t pstty_poll (device_t *, poll_table_t *);
 
 #define BUFSIZE         4096
 
@@ -67,11 +70,8 @@ typedef struct info {
     int pid;
     char prefix;
 
-    /* 1 when cursor changes */
-    int cursor_set;
-
-    /* blocked process */
-    int32_t blocked_pid;
+    /* processes waiting for input */
+    waitq_t readers;
 
 } info_t;
 
@@ -89,7 +89,8 @@ driver_t pstty_driver = {
     /* read:      */ pstty_read,
     /* write:     */ pstty_write,
     /* ioctl:     */ pstty_ioctl,
-    /* irq:       */ pstty_irq
+    /* irq:       */ pstty_irq,
+    /* poll:      */ pstty_poll
 };
 
 static void putc(info_t *info, char c) {
@@ -129,9 +130,9 @@ static void change_attr(info_t *info, char attr) {
 }
 
 static void get_cursor(info_t *info, char *x, char *y) {
-    /* send a packet to the owner process */
-    pstty_packet_t packet = {0};
-    msg_t msg;
+    /* ask the owner process */
+    pstty_packet_t packet = {0}, answer;
+    msg_t msg, reply;
 
     /* initialize packet */
     packet.prefix = info->prefix;
@@ -140,15 +141,16 @@ static void get_cursor(info_t *info, char *x, char *y) {
     /* initialize msg */
     msg.size = sizeof(packet);
     msg.buf  = &packet;
+    reply.buf = &answer;
+    reply.cap = sizeof(answer);
 
-    /* do the send! */
-    send(info->pid, &msg);
-
-    /* wait until we receive the reply */
-    while (!info->cursor_set);
+    /* do the call and wait until we receive the reply */
+    if (!call(info->pid, &msg, &reply) && reply.size == sizeof(answer)) {
+        info->x = answer.x;
+        info->y = answer.y;
+    }
 
     /* return */
-    info->cursor_set = 0;
     *x = info->x;
     *y = info->y;
 }
@@ -199,7 +201,6 @@ static void set_cursor(info_t *info, char x, char y) {
     msg_t msg;
     info->x = x;
     info->y = y;
-    info->cursor_set = 1;
 
     /* initialize packet */
     packet.prefix = info->prefix;
@@ -290,16 +291,24 @@ uint32_t pstty_probe(device_t *dev, void *config) {
     info->buflines   = 0;
     info->pid        = ((pstty_init_t *) config)->pid;
     info->prefix     = ((pstty_init_t *) config)->prefix;
-    info->cursor_set = 0;
-    info->blocked_pid = -1;
+    info->x          = 0;
+    info->y          = 0;
+    waitq_init(&(info->readers));
 
     /* done */
     return ESUCCESS;
 }
 
+static int32_t readable(info_t *info) {
+    if (info->bufbyline)
+        return info->buflines;
+    else
+        return info->buffront != info->bufback;
+}
+
 uint32_t pstty_read(device_t *dev, uint64_t off, uint32_t size, char *buff) {
 
-    int32_t count = size;
+    int32_t count = size, status;
     int i = 0;
     extern uint32_t flag;
 
@@ -310,19 +319,12 @@ uint32_t pstty_read(device_t *dev, uint64_t off, uint32_t size, char *buff) {
 
     /* loop and read from the buffer */
     while(count--) {
-        if (info->bufbyline) {
-            while(!info->buflines) {
-                /* block the process */
-                info->blocked_pid = getpid();
-                block();
-            }
-        } else {
-            while(info->buffront == info->bufback) {
-                /* buffer is empty. */
-                info->blocked_pid = getpid();
-                block();
-            }
-        }
+        /* block the process until there is input */
+        status = arch_get_int_status();
+        arch_disable_interrupts();
+        while (!readable(info))
+            waitq_sleep(&(info->readers));
+        arch_set_int_status(status);
         *(buff++) = info->inbuf[info->buffront];
         if (info->bufbyline && info->inbuf[info->buffront] == '\n')
             info->buflines--;
@@ -363,11 +365,8 @@ uint32_t pstty_ioctl(device_t *dev, uint32_t cmd, void *data) {
         case TTY_PRESS:
             /* the keyboard calls this when a key is pressed */
             press(info, *((uint8_t *) data));
-            /* unblock the waiting process */
-            if (info->blocked_pid != -1) {
-                unblock(info->blocked_pid);
-                info->blocked_pid = -1;
-            }
+            /* unblock the waiting processes */
+            wake_up(&(info->readers));
             break;
         case TTY_ATTR:
             change_attr(info, *((uint8_t *) data));
@@ -425,3 +424,16 @@ uint32_t pstty_ioctl(device_t *dev, uint32_t cmd, void *data) {
 uint32_t pstty_irq(device_t *dev, uint32_t irqn) {
     return ESUCCESS;
 }
+
+uint32_t pstty_poll(device_t *dev, poll_table_t *pt) {
+
+    /* get info_t structure: */
+    info_t *info = (info_t *) dev->drvreg;
+    if (info == NULL)
+            return POLLERR;
+
+    /* wait for input */
+    poll_wait(pt, &(info->readers));
+    return readable(info) ? POLLIN | POLLOUT : POLLOUT;
+
+}
@@ -36,6 +36,8 @@
 #include <sys/scheduler.h>
 #include <tty/vtty.h>
 #include <tty/pstty.h>
+#include <sys/waitq.h>
+#include <sys/poll.h>
 
 /* Prototypes: */
 uint32_t vtty_probe(device_t *, void *);
@@ -43,6 +45,7 @@ uint32_t vtty_read (device_t *, uint64_t, uint32_t, char *);
 uint32_t vtty_write(device_t *, uint64_t, uint32_t, char *);
 uint32_t vtty_ioctl(device_t *, uint32_t, void *);
 uint32_t vtty_irq  (device_t *, uint32_t);
+uint32_t vtty_poll (device_t *, poll_table_t *);
 
 /* legacy variables */
 extern uint32_t legacy_lfb_enabled;
@@ -57,7 +60,8 @@ int32_t buffront = 0;
 int32_t bufback = 0;
 int32_t buflines = 0; /* count of lines buffered... */
 
-static int32_t blocked_pid = -1;
+/* processes waiting for input */
+static waitq_t readers = {NULL, NULL, 0};
 
 /* Classes supported: */
 static class_t classes[] = {
@@ -73,7 +77,8 @@ driver_t vtty_driver = {
     /* read:      */ vtty_read,
     /* write:     */ vtty_write,
     /* ioctl:     */ vtty_ioctl,
-    /* irq:       */ vtty_irq
+    /* irq:       */ vtty_irq,
+    /* poll:      */ vtty_poll
 };
 
 static void print_char(char c) {
@@ -150,21 +155,22 @@ uint32_t vtty_probe(device_t *dev, void *config) {
     return ESUCCESS;
 }
 
+static int32_t readable() {
+    if (bufbyline)
+        return buflines;
+    else
+        return buffront != bufback;
+}
+
 uint32_t vtty_read(device_t *dev, uint64_t off, uint32_t size, char *buff) {
-    int32_t count = size;
+    int32_t count = size, status;
     while(count--) {
-        if (bufbyline) {
-            while(!buflines) {
-                blocked_pid = curproc->pid;
-                block();
-            }
-        } else {
-            while (buffront == bufback) {
-                /* buffer is empty. */
-                blocked_pid = curproc->pid;
-                block();
-            }
-        }
+        /* wait for input */
+        status = arch_get_int_status();
+        arch_disable_interrupts();
+        while (!readable())
+            waitq_sleep(&readers);
+        arch_set_int_status(status);
         *(buff++) = inbuf[buffront];
         if (bufbyline && inbuf[buffront] == '\n')
             buflines--;
@@ -190,10 +196,7 @@ uint32_t vtty_ioctl(device_t *dev, uint32_t cmd, void *data) {
     switch (cmd) {
         case TTY_PRESS:
             press(*((uint8_t *) data));
-            if (blocked_pid != -1) {
-                unblock(blocked_pid);
-                blocked_pid = -1;
-            }
+            wake_up(&readers);
             break;
         case TTY_ATTR:
             legacy_video_attr(*((uint8_t *) data));
@@ -262,3 +265,8 @@ uint32_t vtty_ioctl(device_t *dev, uint32_t cmd, void *data) {
 uint32_t vtty_irq(device_t *dev, uint32_t irqn) {
     return ESUCCESS;
 }
+
+uint32_t vtty_poll(device_t *dev, poll_table_t *pt) {
+    poll_wait(pt, &readers);
+    return readable() ? POLLIN | POLLOUT : POLLOUT;
+}
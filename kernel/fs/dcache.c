@@ -0,0 +1,292 @@
+/*
+ *        +----------------------------------------------------------+
+ *        | +------------------------------------------------------+ |
+ *        | |  Quafios Kernel 2.0.1.                               | |
+ *        | |  -> Directory entry cache.                           | |
+ *        | +------------------------------------------------------+ |
+ *        +----------------------------------------------------------+
+ *
+ * This file is part of Quafios 2.0.1 source code.
+ * Copyright (C) 2015  Mostafa Abd El-Aziz Mohamed.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Quafios.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Visit http://www.quafios.com/ for contact information.
+ *
+ */
+
+#include <arch/type.h>
+#include <arch/spinlock.h>
+#include <lib/string.h>
+#include <sys/mm.h>
+#include <sys/fs.h>
+#include <sys/printk.h>
+#include <sys/dcache.h>
+
+/* results of filesystem lookups, hashed by (super block, directory
+ * inode, name). a hit saves the directory scan; negative entries
+ * remember names that don't exist. the VFS drops entries whenever
+ * it changes a directory, and every change bumps dcache_seq so that
+ * a lookup that raced with it doesn't cache what it saw.
+ */
+#define DCACHE_HASH     1024
+#define DCACHE_MAX      2048 /* entries, the oldest is recycled after. */
+
+static dentry_t *htable[DCACHE_HASH];
+static dentry_t *lru_first = NULL; /* least recently used. */
+static dentry_t *lru_last  = NULL; /* most recently used.  */
+static spinlock_t dcache_lock;
+static uint32_t dcache_seq = 0;
+
+/* statistics */
+static uint32_t entries   = 0;
+static uint32_t hits      = 0;
+static uint32_t neg_hits  = 0;
+static uint32_t misses    = 0;
+
+/***************************************************************************/
+/*                              Helpers                                    */
+/***************************************************************************/
+
+static uint32_t namehash(char *name) {
+    /* FNV-1a */
+    uint32_t h = 2166136261U;
+    while (*name)
+        h = (h ^ (uint8_t) *name++) * 16777619U;
+    return h;
+}
+
+static uint32_t hashfn(super_block_t *sb, ino_t dir, uint32_t hash) {
+    return ((((uint32_t) sb) >> 4) ^ (dir*2654435761U) ^ hash) %
+           DCACHE_HASH;
+}
+
+static dentry_t *lookup(super_block_t *sb, ino_t dir,
+                        uint32_t hash, char *name) {
+    dentry_t *d = htable[hashfn(sb, dir, hash)];
+    while (d && (d->sb != sb || d->dir != dir ||
+                 d->hash != hash || strcmp(d->name, name)))
+        d = d->hnext;
+    return d;
+}
+
+static void hash_add(dentry_t *d) {
+    uint32_t h = hashfn(d->sb, d->dir, d->hash);
+    d->hnext = htable[h];
+    htable[h] = d;
+}
+
+static void hash_del(dentry_t *d) {
+    dentry_t **p = &htable[hashfn(d->sb, d->dir, d->hash)];
+    while (*p != d)
+        p = &(*p)->hnext;
+    *p = d->hnext;
+}
+
+static void lru_add(dentry_t *d) {
+    d->next = NULL;
+    d->prev = lru_last;
+    if (lru_last)
+        lru_last->next = d;
+    else
+        lru_first = d;
+    lru_last = d;
+}
+
+static void lru_del(dentry_t *d) {
+    if (d->prev)
+        d->prev->next = d->next;
+    else
+        lru_first = d->next;
+    if (d->next)
+        d->next->prev = d->prev;
+    else
+        lru_last = d->prev;
+}
+
+static void insert(inode_t *dir, char *name, uint32_t hash,
+                   ino_t ino, uint32_t seq) {
+
+    /* cache the result of a lookup that started at seq */
+    dentry_t *d = NULL;
+    int32_t status;
+
+    /* allocate while the cache is still growing: */
+    if (entries < DCACHE_MAX)
+        d = kmalloc(sizeof(dentry_t));
+
+    status = spinlock_acquire_irqsave(&dcache_lock);
+    if (seq != dcache_seq || lookup(dir->sb, dir->ino, hash, name)) {
+        /* directory changed meanwhile, or someone was faster. */
+        spinlock_release_irqrestore(&dcache_lock, status);
+        if (d)
+            kfree(d);
+        return;
+    }
+    if (d) {
+        entries++;
+    } else if (d = lru_first) {
+        /* recycle the oldest entry */
+        hash_del(d);
+        lru_del(d);
+    } else {
+        spinlock_release_irqrestore(&dcache_lock, status);
+        return;
+    }
+    d->sb   = dir->sb;
+    d->dir  = dir->ino;
+    d->hash = hash;
+    d->ino  = ino;
+    strcpy(d->name, name);
+    hash_add(d);
+    lru_add(d);
+    spinlock_release_irqrestore(&dcache_lock, status);
+
+}
+
+/***************************************************************************/
+/*                              Interface                                  */
+/***************************************************************************/
+
+int32_t dlookup(inode_t *dir, char *name, inode_t **ret) {
+
+    /* look up name in dir, through the cache */
+    uint32_t hash, seq;
+    dentry_t *d;
+    ino_t ino;
+    int32_t status, err;
+
+    /* names too long to cache go to the filesystem directly: */
+    if (strlen(name) >= DNAME_LEN)
+        return dir->sb->fsdriver->lookup(dir, name, ret);
+
+    hash = namehash(name);
+    status = spinlock_acquire_irqsave(&dcache_lock);
+    if (d = lookup(dir->sb, dir->ino, hash, name)) {
+        /* hit */
+        lru_del(d);
+        lru_add(d);
+        ino = d->ino;
+        if (ino)
+            hits++;
+        else
+            neg_hits++;
+        spinlock_release_irqrestore(&dcache_lock, status);
+        if (!ino)
+            return ENOENT;
+        if (!(*ret = (inode_t *) iget(dir->sb, ino)))
+            return ENOMEM;
+        return ESUCCESS;
+    }
+    misses++;
+    seq = dcache_seq;
+    spinlock_release_irqrestore(&dcache_lock, status);
+
+    /* miss, ask the filesystem: */
+    err = dir->sb->fsdriver->lookup(dir, name, ret);
+    if (!err)
+        insert(dir, name, hash, (*ret)->ino, seq);
+    else if (err == ENOENT)
+        insert(dir, name, hash, 0, seq);
+    return err;
+
+}
+
+void dcache_invalidate(inode_t *dir, char *name) {
+
+    /* name in dir is about to change or has just changed */
+    dentry_t *d = NULL;
+    int32_t status;
+
+    status = spinlock_acquire_irqsave(&dcache_lock);
+    dcache_seq++;
+    if (strlen(name) < DNAME_LEN &&
+        (d = lookup(dir->sb, dir->ino, namehash(name), name))) {
+        hash_del(d);
+        lru_del(d);
+        entries--;
+    }
+    spinlock_release_irqrestore(&dcache_lock, status);
+    if (d)
+        kfree(d);
+
+}
+
+void dcache_purge(super_block_t *sb, ino_t dir) {
+
+    /* drop all entries of directory dir (or of all directories
+     * with DCACHE_ANY) in sb. used when a directory is removed
+     * and when a filesystem is unmounted.
+     */
+    dentry_t *d, *next, *dead = NULL;
+    int32_t status;
+
+    status = spinlock_acquire_irqsave(&dcache_lock);
+    dcache_seq++;
+    for (d = lru_first; d; d = next) {
+        next = d->next;
+        if (d->sb == sb && (dir == DCACHE_ANY || d->dir == dir)) {
+            hash_del(d);
+            lru_del(d);
+            entries--;
+            d->hnext = dead;
+            dead = d;
+        }
+    }
+    spinlock_release_irqrestore(&dcache_lock, status);
+
+    while (d = dead) {
+        dead = d->hnext;
+        kfree(d);
+    }
+
+}
+
+/***************************************************************************/
+/*                              sysfs file                                 */
+/***************************************************************************/
+
+static char *dcache_stats(uint32_t *size) {
+    uint32_t total = hits + neg_hits + misses;
+    char *buf = kmalloc(256);
+    *size = 0;
+    *size += sputs(&buf[*size], "entries hits neg_hits misses hit_ratio\n");
+    *size += sputd(&buf[*size], entries);
+    *size += sputs(&buf[*size], " ");
+    *size += sputd(&buf[*size], hits);
+    *size += sputs(&buf[*size], " ");
+    *size += sputd(&buf[*size], neg_hits);
+    *size += sputs(&buf[*size], " ");
+    *size += sputd(&buf[*size], misses);
+    *size += sputs(&buf[*size], " ");
+    *size += sputd(&buf[*size], total ? (uint32_t)
+                   ((uint64_t) (hits+neg_hits)*100/total) : 0);
+    *size += sputs(&buf[*size], "%\n");
+    buf[*size] = 0;
+    return buf;
+}
+
+void dcache_init() {
+
+    int32_t i;
+
+    /* initialize the hash table */
+    for (i = 0; i < DCACHE_HASH; i++)
+        htable[i] = NULL;
+    spinlock_init(&dcache_lock);
+
+    /* register in sysfs */
+    sysfs_reg("dcache", dcache_stats);
+
+}
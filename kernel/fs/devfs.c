@@ -30,6 +30,7 @@
 #include <lib/string.h>
 #include <sys/mm.h>
 #include <sys/fs.h>
+#include <sys/dcache.h>
 #include <fs/tmpfs.h>
 
 super_block_t *devfs_sb = NULL;
@@ -197,6 +198,24 @@ int32_t devfs_write(file_t *file, void *buf, int32_t size) {
     return tmpfs_write(file, buf, size);
 }
 
+/***************************************************************************/
+/*                                 pread()                                 */
+/***************************************************************************/
+
+int32_t devfs_pread(file_t *file, void *buf, int32_t size, pos_t pos,
+                    int32_t *done) {
+    return tmpfs_pread(file, buf, size, pos, done);
+}
+
+/***************************************************************************/
+/*                                pwrite()                                 */
+/***************************************************************************/
+
+int32_t devfs_pwrite(file_t *file, void *buf, int32_t size, pos_t pos,
+                     int32_t *done) {
+    return tmpfs_pwrite(file, buf, size, pos, done);
+}
+
 /***************************************************************************/
 /*                                 seek()                                  */
 /***************************************************************************/
@@ -213,6 +232,15 @@ int32_t devfs_readdir(file_t *file, dirent_t *dirent) {
     return tmpfs_readdir(file, dirent);
 }
 
+/***************************************************************************/
+/*                               getdents()                                */
+/***************************************************************************/
+
+int32_t devfs_getdents(file_t *file, void *buf, int32_t size,
+                       int32_t *done) {
+    return tmpfs_getdents(file, buf, size, done);
+}
+
 /***************************************************************************/
 /*                                 ioctl()                                 */
 /***************************************************************************/
@@ -250,7 +278,10 @@ fsd_t devfs_t = {
     /* read:         */ devfs_read,
     /* write:        */ devfs_write,
     /* seek:         */ devfs_seek,
+    /* pread:        */ devfs_pread,
+    /* pwrite:       */ devfs_pwrite,
     /* readdir:      */ devfs_readdir,
+    /* getdents:     */ devfs_getdents,
     /* ioctl:        */ devfs_ioctl
 
 };
@@ -264,6 +295,7 @@ void devfs_reg(char *name, int32_t devid) {
         /* create node normally */
         inode_t *root = (inode_t *) iget(devfs_sb, devfs_sb->root_ino);
         tmpfs_mknod(root, name, FT_SPECIAL, devid);
+        dcache_invalidate(root, name);
         iput(root);
     } else {
         /* add to staging */
@@ -293,6 +325,7 @@ void devfs_unreg(char *name) {
         /* create node normally */
         inode_t *root = (inode_t *) iget(devfs_sb, devfs_sb->root_ino);
         tmpfs_unlink(root, name);
+        dcache_invalidate(root, name);
         iput(root);
     } else {
         /* remove from staging */
@@ -27,10 +27,184 @@
  */
 
 #include <arch/type.h>
+#include <arch/page.h>
+#include <lib/string.h>
 #include <sys/fs.h>
 #include <sys/mm.h>
+#include <sys/pcache.h>
+#include <sys/waitq.h>
+#include <storage/disk.h>
 #include <fs/diskfs.h>
 
+/***************************************************************************/
+/*                                bitmaps                                  */
+/***************************************************************************/
+
+#define MAP_NONE        0xFFFFFFFF
+
+static int32_t map_init(diskfs_map_t *map, diskfs_blk_t start,
+                        diskfs_blk_t blocks, uint32_t bits) {
+
+    /* set up an empty cache for a bitmap on disk: */
+    diskfs_blk_t i;
+
+    map->start  = start;
+    map->blocks = blocks;
+    map->bits   = bits;
+    map->buf    = kmalloc(blocks*sizeof(uint8_t *));
+    map->dirty  = kmalloc(blocks);
+    if (!map->buf || !map->dirty)
+        return ENOMEM;
+    for (i = 0; i < blocks; i++) {
+        map->buf[i]   = NULL;
+        map->dirty[i] = 0;
+    }
+    return ESUCCESS;
+
+}
+
+static void map_put(diskfs_map_t *map) {
+
+    /* drop the cached blocks of a bitmap, flushed or not: */
+    diskfs_blk_t i;
+
+    if (map->buf) {
+        for (i = 0; i < map->blocks; i++)
+            if (map->buf[i])
+                kfree(map->buf[i]);
+        kfree(map->buf);
+    }
+    if (map->dirty)
+        kfree(map->dirty);
+    map->buf   = NULL;
+    map->dirty = NULL;
+
+}
+
+static uint8_t *map_block(super_block_t *sb, diskfs_map_t *map,
+                          uint32_t bit) {
+
+    /* the cached block holding a bit, read on first use: */
+    diskfs_blk_t i = bit/(sb->blksize*8);
+
+    if (!map->buf[i]) {
+        if (!(map->buf[i] = kmalloc(sb->blksize)))
+            return NULL;
+        diskfs_read_cluster(sb, map->start + i, map->buf[i]);
+    }
+    return map->buf[i];
+
+}
+
+static int32_t map_test(super_block_t *sb, diskfs_map_t *map, uint32_t bit) {
+
+    /* is the bit set? (bits that can't be read are) */
+    uint8_t *buf = map_block(sb, map, bit);
+    uint32_t off = bit%(sb->blksize*8);
+    return !buf || (buf[off/8] & (1 << (off%8)));
+
+}
+
+static int32_t map_set(super_block_t *sb, diskfs_map_t *map,
+                       uint32_t bit, uint32_t count, int32_t val) {
+
+    /* set or clear count bits from bit on: */
+    uint8_t *buf;
+    uint32_t off;
+
+    for (; count--; bit++) {
+        if (!(buf = map_block(sb, map, bit)))
+            return ENOMEM;
+        off = bit%(sb->blksize*8);
+        if (val)
+            buf[off/8] |= 1 << (off%8);
+        else
+            buf[off/8] &= ~(1 << (off%8));
+        map->dirty[bit/(sb->blksize*8)] = 1;
+        sb->info.diskfs.dirty = 1;
+    }
+    return ESUCCESS;
+
+}
+
+static uint32_t map_find(super_block_t *sb, diskfs_map_t *map,
+                         uint32_t from) {
+
+    /* the first clear bit at or after "from", wrapping around
+     * at the end of the map. MAP_NONE if all bits are set.
+     */
+    uint32_t bit = from, n, off;
+    uint8_t *buf;
+
+    for (n = 0; n < map->bits; n++, bit++) {
+        if (bit >= map->bits)
+            bit = 0;
+        if (!(buf = map_block(sb, map, bit)))
+            return MAP_NONE;
+        off = bit%(sb->blksize*8);
+        if (!(off%8) && bit+8 <= map->bits && buf[off/8] == 0xFF) {
+            /* skip a full byte at once: */
+            n += 7;
+            bit += 7;
+        } else if (!(buf[off/8] & (1 << (off%8)))) {
+            return bit;
+        }
+    }
+    return MAP_NONE;
+
+}
+
+static uint32_t map_run(super_block_t *sb, diskfs_map_t *map,
+                        uint32_t bit, uint32_t max) {
+
+    /* count of clear bits from bit on, at most max: */
+    uint32_t n = 0;
+
+    while (n < max && bit+n < map->bits && !map_test(sb, map, bit+n))
+        n++;
+    return n;
+
+}
+
+static void map_flush(super_block_t *sb, diskfs_map_t *map) {
+
+    /* write back the blocks of the map that changed: */
+    diskfs_blk_t i;
+
+    for (i = 0; i < map->blocks; i++) {
+        if (map->dirty[i]) {
+            diskfs_write_cluster(sb, map->start + i, map->buf[i]);
+            map->dirty[i] = 0;
+        }
+    }
+
+}
+
+/***************************************************************************/
+/*                                flush()                                  */
+/***************************************************************************/
+
+int32_t diskfs_flush(super_block_t *sb) {
+
+    /* the bitmaps and the counters in the super block are kept
+     * in memory; they are written back when an operation that
+     * changes them is done, not on every single allocation.
+     */
+    diskfs_sb_info_t *info = &sb->info.diskfs;
+
+    if (!info->dirty)
+        return ESUCCESS;
+
+    map_flush(sb, &info->imap);
+    map_flush(sb, &info->dmap);
+    diskfs_write_super(sb);
+    info->dirty = 0;
+
+    /* done */
+    return ESUCCESS;
+
+}
+
 /***************************************************************************/
 /*                              read_super()                               */
 /***************************************************************************/
@@ -40,6 +214,8 @@ super_block_t *diskfs_read_super(device_t *dev) {
     /* definitions */
     super_block_t *sb;
     diskfs_sb_t *disksb;
+    diskfs_sb_info_t *info;
+    int32_t err;
 
     /* allocate superblock: */
     sb = kmalloc(sizeof(super_block_t));
@@ -65,7 +241,7 @@ super_block_t *diskfs_read_super(device_t *dev) {
     disksb = kmalloc(512);
     if (disksb == NULL) {
         kfree(sb);
-        return sb;
+        return NULL;
     }
 
     /* set disksb of superblock structure: */
@@ -77,6 +253,23 @@ super_block_t *diskfs_read_super(device_t *dev) {
     /* disk block size: */
     sb->blksize = disksb->block_size;
 
+    /* the bitmaps are cached as they are used: */
+    info = &sb->info.diskfs;
+    info->dirty = 0;
+    info->locked = 0;
+    info->dirty_inodes = NULL;
+    err  = map_init(&info->imap, disksb->inode_map_start,
+                    disksb->inode_map_blocks, disksb->total_inodes);
+    err |= map_init(&info->dmap, disksb->data_map_start,
+                    disksb->data_map_blocks, disksb->data_blocks);
+    if (err) {
+        map_put(&info->imap);
+        map_put(&info->dmap);
+        kfree(disksb);
+        kfree(sb);
+        return NULL;
+    }
+
     /* return the superblock: */
     return sb;
 
@@ -89,7 +282,7 @@ super_block_t *diskfs_read_super(device_t *dev) {
 int32_t diskfs_write_super(super_block_t *sb) {
 
     /* write 512 sector: */
-    dev_write(sb->dev, (int64_t) 1024, 512, (void *) sb->disksb);
+    blkdev_write(sb->dev, (int64_t) 1024, 512, (void *) sb->disksb);
 
     /* done */
     return ESUCCESS;
@@ -106,6 +299,15 @@ int32_t diskfs_put_super(super_block_t *sb) {
     if (sb->icount)
         return EBUSY;
 
+    /* write back and drop the bitmaps: */
+    diskfs_flush(sb);
+    blkdev_sync(sb->dev);
+    map_put(&sb->info.diskfs.imap);
+    map_put(&sb->info.diskfs.dmap);
+
+    /* drop cached file pages: */
+    pcache_invalidate(sb, PCACHE_ANY, 0);
+
     /* unallocate super block: */
     kfree(sb->disksb);
     kfree(sb);
@@ -121,8 +323,11 @@ int32_t diskfs_put_super(super_block_t *sb) {
 
 int32_t diskfs_read_cluster(super_block_t *sb, pos_t clus, void *buf) {
 
+    /* metadata and directory blocks are read through the block
+     * device cache, file data through diskfs_read_page().
+     */
     pos_t offset = 1024 + clus*sb->blksize;
-    return dev_read(sb->dev, offset, sb->blksize, buf)/sb->blksize;
+    return blkdev_read(sb->dev, offset, sb->blksize, buf)/sb->blksize;
 
 }
 
@@ -133,7 +338,7 @@ int32_t diskfs_read_cluster(super_block_t *sb, pos_t clus, void *buf) {
 int32_t diskfs_write_cluster(super_block_t *sb, pos_t clus, void *buf) {
 
     pos_t offset = 1024 + clus*sb->blksize;
-    return dev_write(sb->dev, offset, sb->blksize, buf)/sb->blksize;
+    return blkdev_write(sb->dev, offset, sb->blksize, buf)/sb->blksize;
 
 }
 
@@ -181,6 +386,21 @@ int32_t diskfs_read_inode(inode_t *inode) {
     for (i = 0; i < DISKFS_PTRS; i++)
         inode->info.diskfs.ptr[i] = disk_inode->ptr[i];
 
+    /* flags: */
+    if (disksb->revision >= QUAFS_REVISION_DXDIR)
+        inode->info.diskfs.flags = disk_inode->flags;
+    else
+        inode->info.diskfs.flags = 0;
+
+    /* no blocks are preallocated yet: */
+    inode->info.diskfs.pa_lblk = 0;
+    inode->info.diskfs.pa_len  = 0;
+    inode->info.diskfs.pa_size = 0;
+
+    /* nothing to write back: */
+    inode->info.diskfs.dirty  = 0;
+    inode->info.diskfs.listed = 0;
+
     /* no need for the buffer: */
     kfree(buf);
 
@@ -232,6 +452,10 @@ int32_t diskfs_update_inode(inode_t *inode) {
     for (i = 0; i < DISKFS_PTRS; i++)
         disk_inode->ptr[i] = inode->info.diskfs.ptr[i];
 
+    /* flags: */
+    if (disksb->revision >= QUAFS_REVISION_DXDIR)
+        disk_inode->flags = inode->info.diskfs.flags;
+
     /* do the update! */
     buf[inode->ino%inodes_per_cluster] = *disk_inode;
 
@@ -255,80 +479,25 @@ diskfs_ino_t diskfs_imap_alloc(super_block_t *sb) {
     /* use the inode map to allocate a disk inode.
      * this will just allocate. no initialization is performed.
      */
-    diskfs_sb_t *disksb;
-    uint8_t *buf;
-    int32_t found;
-    int32_t bits_per_block;
-    diskfs_blk_t cluster;
-    int32_t bit_offset;
-    int32_t byte;
-    int32_t bit;
-    diskfs_blk_t loadedClus;
-    diskfs_ino_t ino;
-
-    /* read disk superblock: */
-    disksb = sb->disksb;
+    diskfs_sb_t *disksb = sb->disksb;
+    diskfs_map_t *map = &sb->info.diskfs.imap;
+    uint32_t ino;
 
     /* is there any free inode? */
     if (disksb->free_inodes == 0)
         return 0;
 
-    /* allocate buffer: */
-    buf = kmalloc(disksb->block_size);
-    if (!buf)
+    /* find a free inode and reserve it: */
+    ino = map_find(sb, map, disksb->next_free_inode);
+    if (ino == MAP_NONE || map_set(sb, map, ino, 1, 1))
         return 0;
 
-    /* some variables that we will use: */
-    found = 0; /* flag. */
-    bits_per_block = disksb->block_size*8;
-    loadedClus = 0; /* currently loaded cluster. */
-    ino; /* the number of the found inode. */
-
-    /* loop till finding a free inode... */
-    while(!found) {
-
-        /* the cluster that contains the matching bit. */
-        cluster = disksb->inode_map_start +
-                               disksb->next_free_inode / bits_per_block;
-
-        /* Make sure the desired cluster is loaded. */
-        if (cluster != loadedClus)
-            diskfs_read_cluster(sb, loadedClus=cluster, buf);
-
-        /* which byte & bit in the cluster? */
-        bit_offset = disksb->next_free_inode % bits_per_block;
-        byte = bit_offset / 8;
-        bit =  bit_offset % 8;
-
-        /* Read the bit! */
-        if (!(buf[byte] & (1 << bit))) {
-            /* free node detected, reserve it! */
-            buf[byte] |= 1 << bit;
-
-            /* update the cluster on disk! */
-            diskfs_write_cluster(sb, cluster, buf);
-
-            /* yet another inode is reserved: */
-            disksb->free_inodes--;
-
-            /* set ino: */
-            ino = disksb->next_free_inode;
-
-            /* we are done. */
-            found = 1;
-        }
-
-        /* update next free inode value.. */
-        if (++disksb->next_free_inode == disksb->total_inodes)
-            disksb->next_free_inode = 0;
-
-    }
-
-    /* now update super block: */
-    diskfs_write_super(sb);
+    /* yet another inode is reserved: */
+    disksb->free_inodes--;
 
-    /* free the buffer: */
-    kfree(buf);
+    /* update next free inode value.. */
+    if ((disksb->next_free_inode = ino+1) == disksb->total_inodes)
+        disksb->next_free_inode = 0;
 
     /* done: */
     return ino;
@@ -342,254 +511,765 @@ diskfs_ino_t diskfs_imap_alloc(super_block_t *sb) {
 int32_t diskfs_imap_free(super_block_t *sb, diskfs_ino_t ino) {
 
     /* free the entry index (ino) from the map. */
-    diskfs_sb_t *disksb;
-    uint8_t *buf;
-    int32_t bits_per_block;
-    diskfs_blk_t cluster;
-    int32_t bit_offset;
-    int32_t byte;
-    int32_t bit;
-
-    /* super block: */
-    disksb = sb->disksb;
-
-    /* allocate buffer: */
-    buf = kmalloc(disksb->block_size);
-    if (!buf)
-        return ENOMEM;
-
-    /* some variables that we will use: */
-    bits_per_block = disksb->block_size*8;
-    cluster = disksb->inode_map_start + ino/bits_per_block;
-    bit_offset = ino % bits_per_block;
-    byte = bit_offset / 8;
-    bit  = bit_offset % 8;
-
-    /* load cluster: */
-    diskfs_read_cluster(sb, cluster, buf);
+    diskfs_sb_t *disksb = sb->disksb;
+    int32_t err;
 
     /* free the desired bit: */
-    buf[byte] &= ~(1 << bit);
-
-    /* update the cluster on disk! */
-    diskfs_write_cluster(sb, cluster, buf);
+    if (err = map_set(sb, &sb->info.diskfs.imap, ino, 1, 0))
+        return err;
 
-    /* yet another inode is reserved: */
+    /* yet another inode is free: */
     disksb->free_inodes++;
 
-    /* now update super block: */
-    diskfs_write_super(sb);
-
-    /* free the buffer */
-    kfree(buf);
-
     /* done: */
     return ESUCCESS;
 
 }
 
 /****************************************************************************/
-/*                             bmap_alloc()                                 */
+/*                            bmap_alloc_run()                              */
 /****************************************************************************/
 
-diskfs_blk_t diskfs_bmap_alloc(super_block_t *sb) {
-
-    /* definitions */
-    diskfs_sb_t *disksb;
-    uint8_t *buf;
-    int32_t found;
-    int32_t bits_per_block;
-    diskfs_blk_t loadedClus;
-    diskfs_blk_t blk;
-    int32_t bit_offset;
-    int32_t byte;
-    int32_t bit;
-    int32_t i;
+diskfs_blk_t diskfs_bmap_alloc_run(super_block_t *sb, diskfs_blk_t goal,
+                                   diskfs_blk_t want, diskfs_blk_t *count) {
 
-    /* get disk superblock: */
-    disksb = sb->disksb;
+    /* allocate the first free data block at or after goal, if goal
+     * is a valid data block, or after the last allocation otherwise.
+     * *count is set to the number of free blocks in a row from there
+     * on, at most "want", but only the first one is taken: the rest
+     * is just where the caller would like to go on. searches without
+     * a goal start after that run next time. the block is not
+     * initialized. returns the block, 0 if the disk is full.
+     */
+    diskfs_sb_t *disksb = sb->disksb;
+    diskfs_map_t *map = &sb->info.diskfs.dmap;
+    int32_t has_goal;
+    uint32_t bit, n;
 
     /* is there any free data cluster? */
     if (disksb->free_data_blocks == 0)
         return 0;
 
-    /* allocate buffer: */
-    buf = kmalloc(disksb->block_size);
-    if (!buf)
-        return 0;
+    /* where to start searching? */
+    has_goal = goal >= disksb->data_start &&
+               goal < disksb->data_start + disksb->data_blocks;
+    bit = has_goal ? goal - disksb->data_start : disksb->next_free_block;
 
-    /* some variables that we will use: */
-    found = 0; /* flag. */
-    bits_per_block = disksb->block_size*8;
-    loadedClus = 0; /* currently loaded cluster. */
+    /* find a free block and the free blocks after it: */
+    if ((bit = map_find(sb, map, bit)) == MAP_NONE)
+        return 0;
+    n = map_run(sb, map, bit, want);
+    if (map_set(sb, map, bit, 1, 1))
+        return 0;
 
-    /* loop till finding a free block... */
-    while(!found) {
+    /* yet another block is reserved: */
+    disksb->free_data_blocks--;
 
-        /* the cluster that contains the matching bit. */
-        diskfs_blk_t cluster = disksb->data_map_start +
-                               disksb->next_free_block / bits_per_block;
+    /* update next free block value.. */
+    if (!has_goal && (disksb->next_free_block = bit+n) == disksb->data_blocks)
+        disksb->next_free_block = 0;
 
-        /* Make sure the desired cluster is loaded. */
-        if (cluster != loadedClus)
-            diskfs_read_cluster(sb, loadedClus=cluster, buf);
+    /* done: */
+    *count = n;
+    return bit + disksb->data_start;
 
-        /* which byte & bit in the cluster? */
-        bit_offset = disksb->next_free_block % bits_per_block;
-        byte = bit_offset / 8;
-        bit  = bit_offset % 8;
+}
 
-        /* Read the bit! */
-        if (!(buf[byte] & (1 << bit))) {
-            /* free block detected, reserve it! */
-            buf[byte] |= 1 << bit;
+/****************************************************************************/
+/*                             bmap_alloc()                                 */
+/****************************************************************************/
 
-            /* update the cluster on disk! */
-            diskfs_write_cluster(sb, cluster, buf);
+diskfs_blk_t diskfs_bmap_alloc(super_block_t *sb, diskfs_blk_t goal) {
 
-            /* yet another block is reserved: */
-            disksb->free_data_blocks--;
+    /* allocate a single data block, see bmap_alloc_run(). */
+    diskfs_blk_t count;
+    return diskfs_bmap_alloc_run(sb, goal, 1, &count);
 
-            /* set blk: */
-            blk = disksb->next_free_block + disksb->data_start;
+}
 
-            /* we are done. */
-            found = 1;
-        }
+/****************************************************************************/
+/*                             bmap_free()                                  */
+/****************************************************************************/
 
-        /* update next free free block value.. */
-        if (++disksb->next_free_block == disksb->data_blocks)
-            disksb->next_free_block = 0;
+int32_t diskfs_bmap_free(super_block_t *sb, diskfs_blk_t blk) {
 
-    }
+    /* free the entry of (blk) on the data block map. */
+    diskfs_sb_t *disksb = sb->disksb;
+    int32_t err;
 
-    /* now update super block: */
-    diskfs_write_super(sb);
+    /* a data block? */
+    if (blk < disksb->data_start ||
+        blk >= disksb->data_start + disksb->data_blocks)
+        return EINVAL;
 
-    /* zeroise buffer */
-    for (i = 0; i < sb->blksize; i++)
-        buf[i] = 0;
+    /* free the desired bit: */
+    if (err = map_set(sb, &sb->info.diskfs.dmap,
+                      blk - disksb->data_start, 1, 0))
+        return err;
 
-    /* write the zeros to the allocated cluster */
-    diskfs_write_cluster(sb, blk, buf);
+    /* yet another data block is free: */
+    disksb->free_data_blocks++;
 
-    /* free the buffer: */
-    kfree(buf);
+    /* done: */
+    return ESUCCESS;
 
-    /* return: */
-    return blk;
 }
 
 /****************************************************************************/
-/*                             bmap_free()                                  */
+/*                             preallocation                                */
 /****************************************************************************/
 
-int32_t diskfs_bmap_free(super_block_t *sb, diskfs_blk_t blk) {
-
-    /* free the entry of (blk) on the data block map. */
-    diskfs_sb_t *disksb;
-    uint8_t *buf;
-    int32_t bits_per_block;
-    diskfs_blk_t cluster;
-    int32_t bit_offset;
-    int32_t byte;
-    int32_t bit;
+static void pa_release(inode_t *inode) {
 
-    /* super block: */
-    disksb = sb->disksb;
+    /* forget the preallocation window, it holds no blocks: */
+    inode->info.diskfs.pa_len = 0;
 
-    /* allocate buffer: */
-    buf = kmalloc(disksb->block_size);
-    if (!buf)
-        return ENOMEM;
+}
 
-    /* some variables that we will use: */
-    bits_per_block = disksb->block_size*8;
-    cluster = disksb->data_map_start+(blk-disksb->data_start)/bits_per_block;
-    bit_offset = (blk-disksb->data_start) % bits_per_block;
-    byte = bit_offset / 8;
-    bit  = bit_offset % 8;
+static diskfs_blk_t pa_alloc(inode_t *inode, diskfs_blk_t lblk,
+                             diskfs_blk_t goal) {
+
+    /* allocate the disk block for file block lblk. regular files
+     * take it from their preallocation window, a run of free blocks
+     * kept for the file blocks that follow the last one that was
+     * allocated. a new window is made whenever lblk isn't the next
+     * block, so a file that is written sequentially gets its blocks
+     * in a row, even while other files grow too: their searches
+     * start after the window. windows double in size as long as the
+     * file grows in order. a window lives in memory only, its blocks
+     * stay free on disk and in the counters until they are taken,
+     * and another file may take them once the disk is nearly full.
+     */
+    diskfs_inode_info_t *info = &inode->info.diskfs;
+    diskfs_blk_t blk, count, size, want;
 
-    /* load cluster: */
-    diskfs_read_cluster(sb, cluster, buf);
+    /* other files don't grow that way: */
+    if ((inode->mode & FT_MASK) != FT_REGULAR)
+        return diskfs_bmap_alloc(inode->sb, goal);
 
-    /* free the desired bit: */
-    buf[byte] &= ~(1 << bit);
+    if (info->pa_len && info->pa_lblk == lblk) {
+        /* next block of the window (or the nearest free one): */
+        size = info->pa_size;
+        goal = info->pa_start;
+        want = info->pa_len;
+    } else {
+        /* how large should the new window be? */
+        if (info->pa_lblk == lblk && info->pa_size)
+            size = info->pa_size*2; /* the last one was used up. */
+        else
+            size = DISKFS_PREALLOC;
+        if (size > DISKFS_PREALLOC_MAX)
+            size = DISKFS_PREALLOC_MAX;
+        want = size;
+    }
 
-    /* update the cluster on disk! */
-    diskfs_write_cluster(sb, cluster, buf);
+    /* take the block, the free run after it is the window: */
+    pa_release(inode);
+    blk = diskfs_bmap_alloc_run(inode->sb, goal, want, &count);
+    if (blk) {
+        info->pa_lblk  = lblk+1;
+        info->pa_start = blk+1;
+        info->pa_len   = count-1;
+        info->pa_size  = size;
+    }
+    return blk;
 
-    /* yet another inode is reserved: */
-    disksb->free_inodes++;
+}
 
-    /* now update super block: */
-    diskfs_write_super(sb);
+/****************************************************************************/
+/*                              inline data                                 */
+/****************************************************************************/
 
-    /* free the buffer */
-    kfree(buf);
+static int32_t inline_enabled(inode_t *inode) {
 
-    /* done: */
-    return ESUCCESS;
+    /* does the inode hold the data of the file? */
+    diskfs_sb_t *disksb = inode->sb->disksb;
+    return disksb->revision >= QUAFS_REVISION_INLINE &&
+           (inode->info.diskfs.flags & DISKFS_INODE_INLINE);
 
 }
 
 /****************************************************************************/
-/*                              read_fileblk()                              */
+/*                                extents                                   */
 /****************************************************************************/
 
-int32_t diskfs_read_fileblk(inode_t *inode,
-                            diskfs_blk_t blk_off,
-                            void *buf) {
+static int32_t ext_enabled(inode_t *inode) {
 
-    /* convert blk_off (which is relative to file)
-     * to a block number relative to the beginning
-     * of the filesystem, then read that block!
-     */
+    /* is the inode mapped by an extent tree? */
+    diskfs_sb_t *disksb = inode->sb->disksb;
+    return disksb->revision >= QUAFS_REVISION_EXTENTS &&
+           (inode->info.diskfs.flags & DISKFS_INODE_EXTENTS);
 
-    /* calculate level & loop parameters: */
-    diskfs_lvl_t lvl = diskfs_blk_to_lvl(inode->sb->disksb, blk_off);
-    diskfs_blk_t  blk;
-    diskfs_blk_t *ptr;
+}
+
+static void ext_init(inode_t *inode) {
+
+    /* start an empty extent tree in ptr[] of a new inode: */
+    diskfs_ext_head_t *root = DISKFS_EXT_ROOT(inode->info.diskfs.ptr);
     int32_t i;
 
-    /* loop on all levels: */
-    for (i = 0; i <= lvl.level; i++) {
+    for (i = 0; i < DISKFS_PTRS; i++)
+        inode->info.diskfs.ptr[i] = 0;
+    root->magic = DISKFS_EXT_MAGIC;
+    root->count = 0;
+    root->depth = 0;
+    inode->info.diskfs.flags |= DISKFS_INODE_EXTENTS;
 
-        /* load the table into memory: */
-        if (!i) {
-            ptr = inode->info.diskfs.ptr;
-        } else {
-            diskfs_read_cluster(inode->sb, blk, buf);
-            ptr = (diskfs_blk_t *) buf;
-        }
+}
 
-        /* get pointer for next level (if there isn't): */
-        if (!(blk = ptr[lvl.ptr[i]])) {
-            break; /* exit the loop. */
-        }
+static void ext_store(inode_t *inode, diskfs_blk_t blk,
+                      diskfs_ext_head_t *head) {
+
+    /* write a node back: the root lives in the inode. */
+    if (!blk)
+        diskfs_update_inode(inode);
+    else
+        diskfs_write_cluster(inode->sb, blk, head);
+
+}
 
+static void ext_insert(diskfs_ext_head_t *head, diskfs_extent_t *new) {
+
+    /* insert an entry in a node that has room for it: */
+    diskfs_extent_t *ent = (diskfs_extent_t *) &head[1];
+    int32_t i = head->count++;
+
+    while (i > 0 && ent[i-1].lblk > new->lblk) {
+        ent[i] = ent[i-1];
+        i--;
     }
+    ent[i] = *new;
 
-    /* zero? */
-    if (!blk) {
-        for(i = 0; i < inode->sb->blksize; i++)
-            ((uint8_t *) buf)[i] = 0;
-    } else {
-        diskfs_read_cluster(inode->sb, blk, buf);
+}
+
+static diskfs_blk_t ext_map(inode_t *inode, diskfs_blk_t lblk,
+                            void *tmp, diskfs_blk_t *count) {
+
+    /* map file block lblk to a disk block, 0 for a hole. if count
+     * isn't NULL, it is set to the number of blocks mapped one after
+     * the other from lblk on (1 for a hole). tmp is a block sized
+     * buffer for the nodes of the tree.
+     */
+    diskfs_ext_head_t *head = DISKFS_EXT_ROOT(inode->info.diskfs.ptr);
+    diskfs_extent_t *ext;
+    int32_t depth = head->depth;
+
+    /* walk down to the leaf: */
+    while (head->magic == DISKFS_EXT_MAGIC && head->depth == depth &&
+           (ext = diskfs_ext_find(head, lblk))) {
+        if (!depth--) {
+            /* the extent that should contain lblk: */
+            if (lblk < ext->lblk || lblk - ext->lblk >= ext->len)
+                break;
+            if (count)
+                *count = ext->len - (lblk - ext->lblk);
+            return ext->start + (lblk - ext->lblk);
+        }
+        diskfs_read_cluster(inode->sb, ext->start, tmp);
+        head = (diskfs_ext_head_t *) tmp;
     }
 
-    /* done: */
-    return ESUCCESS;
+    /* a hole: */
+    if (count)
+        *count = 1;
+    return 0;
 
 }
 
-/****************************************************************************/
-/*                             write_fileblk()                              */
-/****************************************************************************/
-
-int32_t diskfs_write_fileblk(inode_t *inode,
-                             diskfs_blk_t blk_off,
-                             void *buf) {
+static diskfs_blk_t ext_alloc(inode_t *inode, diskfs_blk_t lblk) {
+
+    /* map file block lblk, which is a hole, to a new disk block.
+     * the block right after the one of lblk-1 is tried first, so
+     * that writing a file sequentially just grows its last extent.
+     * full nodes are split on the way back up, a full root moves
+     * into a new block and the tree becomes one level deeper.
+     * returns 0 if there is no space.
+     */
+    super_block_t *sb = inode->sb;
+    diskfs_sb_t *disksb = sb->disksb;
+    int32_t bs = inode->blksize;
+    diskfs_ext_head_t *head[DISKFS_EXT_MAX_DEPTH+1], *spare;
+    diskfs_blk_t node[DISKFS_EXT_MAX_DEPTH+1];
+    diskfs_extent_t *ext, new;
+    diskfs_blk_t blk = 0, goal = 0, key, nblk;
+    int32_t depth, level, full, half;
+
+    /* the root: */
+    head[0] = DISKFS_EXT_ROOT(inode->info.diskfs.ptr);
+    node[0] = 0;
+    depth = head[0]->depth;
+    if (head[0]->magic != DISKFS_EXT_MAGIC || depth > DISKFS_EXT_MAX_DEPTH)
+        return 0;
+    for (level = 1; level <= depth; level++)
+        head[level] = NULL;
+
+    /* a buffer for splitting: */
+    if (!(spare = kmalloc(bs)))
+        return 0;
+
+    /* load the path down to the leaf: */
+    for (level = 0; level < depth; level++) {
+        if (!(ext = diskfs_ext_find(head[level], lblk)) ||
+            !(head[level+1] = kmalloc(bs)))
+            goto out;
+        node[level+1] = ext->start;
+        diskfs_read_cluster(sb, node[level+1], head[level+1]);
+        if (head[level+1]->magic != DISKFS_EXT_MAGIC ||
+            head[level+1]->depth != depth-level-1)
+            goto out;
+    }
+
+    /* make sure all the blocks needed are there before any change: */
+    for (full = 0; full <= depth; full++)
+        if (head[depth-full]->count <
+            (depth-full ? DISKFS_EXT_NODE_LIMIT(bs) : DISKFS_EXT_ROOT_LIMIT))
+            break;
+    if (disksb->free_data_blocks < full+1 ||
+        (full > depth && depth == DISKFS_EXT_MAX_DEPTH))
+        goto out;
+
+    /* allocate the block: */
+    ext = diskfs_ext_find(head[depth], lblk);
+    if (ext && ext->lblk < lblk)
+        goal = ext->start + (lblk - ext->lblk);
+    if (!(blk = pa_alloc(inode, lblk, goal)))
+        goto out;
+
+    /* just grow the extent of lblk-1? */
+    if (ext && ext->lblk + ext->len == lblk &&
+        ext->start + ext->len == blk) {
+        ext->len++;
+        ext_store(inode, node[depth], head[depth]);
+        goto out;
+    }
+
+    /* insert a new extent: */
+    new.lblk  = lblk;
+    new.start = blk;
+    new.len   = 1;
+    for (level = depth; level >= 0; level--) {
+
+        /* room for it? */
+        if (head[level]->count <
+            (level ? DISKFS_EXT_NODE_LIMIT(bs) : DISKFS_EXT_ROOT_LIMIT)) {
+            ext_insert(head[level], &new);
+            ext_store(inode, node[level], head[level]);
+            break;
+        }
+
+        if (!level) {
+            /* the root is full, move it down into a new block: */
+            memcpy(spare, head[0], sizeof(diskfs_ext_head_t) +
+                   head[0]->count*sizeof(diskfs_extent_t));
+            ext_insert(spare, &new);
+            nblk = diskfs_bmap_alloc(sb, blk);
+            diskfs_write_cluster(sb, nblk, spare);
+            ext = (diskfs_extent_t *) &head[0][1];
+            ext->lblk  = ((diskfs_extent_t *) &spare[1])->lblk;
+            ext->start = nblk;
+            ext->len   = 0;
+            head[0]->count = 1;
+            head[0]->depth++;
+            diskfs_update_inode(inode);
+            break;
+        }
+
+        /* split the node, the upper half goes into a new block: */
+        ext = (diskfs_extent_t *) &head[level][1];
+        half = head[level]->count/2;
+        key = ext[half].lblk;
+        spare->magic = DISKFS_EXT_MAGIC;
+        spare->count = head[level]->count - half;
+        spare->depth = head[level]->depth;
+        spare->unused = 0;
+        memcpy(&spare[1], &ext[half], spare->count*sizeof(diskfs_extent_t));
+        head[level]->count = half;
+        ext_insert(new.lblk < key ? head[level] : spare, &new);
+        nblk = diskfs_bmap_alloc(sb, node[level]);
+        diskfs_write_cluster(sb, nblk, spare);
+        ext_store(inode, node[level], head[level]);
+
+        /* and the parent gets an entry for it: */
+        new.lblk  = key;
+        new.start = nblk;
+        new.len   = 0;
+
+    }
+
+out:
+    for (level = 1; level <= depth; level++)
+        if (head[level])
+            kfree(head[level]);
+    kfree(spare);
+    return blk;
+
+}
+
+static int32_t ext_trunc_node(inode_t *inode, diskfs_ext_head_t *head,
+                              diskfs_blk_t from) {
+
+    /* free the blocks mapping file blocks >= from under head,
+     * returns nonzero if head has changed.
+     */
+    diskfs_extent_t *ent = (diskfs_extent_t *) &head[1], *e;
+    diskfs_ext_head_t *child;
+    diskfs_blk_t i, keep;
+    int32_t changed = 0;
+
+    /* the entries are sorted, start from the last: */
+    while (head->count) {
+        e = &ent[head->count-1];
+        if (head->depth) {
+            /* an index entry, truncate the node below: */
+            if (!(child = kmalloc(inode->blksize)))
+                break;
+            diskfs_read_cluster(inode->sb, e->start, child);
+            if (child->magic != DISKFS_EXT_MAGIC) {
+                kfree(child);
+                break;
+            }
+            if (ext_trunc_node(inode, child, from))
+                diskfs_write_cluster(inode->sb, e->start, child);
+            keep = child->count;
+            kfree(child);
+            if (keep)
+                break;
+            diskfs_bmap_free(inode->sb, e->start);
+        } else {
+            /* an extent, free its blocks from "from" on: */
+            keep = e->lblk < from ? from - e->lblk : 0;
+            if (keep >= e->len)
+                break;
+            for (i = keep; i < e->len; i++)
+                diskfs_bmap_free(inode->sb, e->start + i);
+            if (keep) {
+                e->len = keep;
+                changed = 1;
+                break;
+            }
+        }
+        head->count--;
+        changed = 1;
+    }
+
+    return changed;
+
+}
+
+static void ext_truncate(inode_t *inode, diskfs_blk_t from) {
+
+    /* free all blocks of the file from block "from" on: */
+    diskfs_ext_head_t *root = DISKFS_EXT_ROOT(inode->info.diskfs.ptr);
+
+    if (root->magic != DISKFS_EXT_MAGIC)
+        return;
+    if (ext_trunc_node(inode, root, from)) {
+        if (!root->count)
+            root->depth = 0;
+        diskfs_update_inode(inode);
+    }
+
+}
+
+/****************************************************************************/
+/*                                 bmap()                                   */
+/****************************************************************************/
+
+diskfs_blk_t diskfs_bmap(inode_t *inode, diskfs_blk_t blk_off, void *tmp) {
+
+    /* convert blk_off (which is relative to file)
+     * to a block number relative to the beginning
+     * of the filesystem, 0 if there is no such block.
+     * tmp is a block sized buffer for indirect tables.
+     */
+
+    /* calculate level & loop parameters: */
+    diskfs_lvl_t lvl = diskfs_blk_to_lvl(inode->sb->disksb, blk_off);
+    diskfs_blk_t  blk;
+    diskfs_blk_t *ptr;
+    int32_t i;
+
+    /* no blocks at all? */
+    if (inline_enabled(inode))
+        return 0;
+
+    /* extents? */
+    if (ext_enabled(inode))
+        return ext_map(inode, blk_off, tmp, NULL);
+
+    /* loop on all levels: */
+    for (i = 0; i <= lvl.level; i++) {
+
+        /* load the table into memory: */
+        if (!i) {
+            ptr = inode->info.diskfs.ptr;
+        } else {
+            diskfs_read_cluster(inode->sb, blk, tmp);
+            ptr = (diskfs_blk_t *) tmp;
+        }
+
+        /* get pointer for next level (if there isn't): */
+        if (!(blk = ptr[lvl.ptr[i]])) {
+            break; /* exit the loop. */
+        }
+
+    }
+
+    /* done: */
+    return blk;
+
+}
+
+/****************************************************************************/
+/*                               bmap_run()                                 */
+/****************************************************************************/
+
+diskfs_blk_t diskfs_bmap_run(inode_t *inode, diskfs_blk_t blk_off,
+                             void *tmp, diskfs_blk_t *count) {
+
+    /* like bmap(), but also tells how many blocks from blk_off
+     * on lie one after the other on disk: *count is the most
+     * the caller wants on entry, and the length of the run on
+     * return (1 for a hole).
+     */
+    diskfs_blk_t blk, n;
+
+    /* extents know their length: */
+    if (ext_enabled(inode)) {
+        blk = ext_map(inode, blk_off, tmp, &n);
+        if (n < *count)
+            *count = n;
+        return blk;
+    }
+
+    /* block pointers have to be compared: */
+    blk = diskfs_bmap(inode, blk_off, tmp);
+    for (n = 1; blk && n < *count; n++)
+        if (diskfs_bmap(inode, blk_off+n, tmp) != blk+n)
+            break;
+    *count = n;
+    return blk;
+
+}
+
+/****************************************************************************/
+/*                              read_fileblk()                              */
+/****************************************************************************/
+
+int32_t diskfs_read_fileblk(inode_t *inode,
+                            diskfs_blk_t blk_off,
+                            void *buf) {
+
+    /* find the block and read it! */
+    diskfs_blk_t blk = diskfs_bmap(inode, blk_off, buf);
+    int32_t i;
+
+    /* zero? */
+    if (!blk) {
+        for(i = 0; i < inode->sb->blksize; i++)
+            ((uint8_t *) buf)[i] = 0;
+    } else {
+        diskfs_read_cluster(inode->sb, blk, buf);
+    }
+
+    /* done: */
+    return ESUCCESS;
+
+}
+
+/****************************************************************************/
+/*                               read_page()                                */
+/****************************************************************************/
+
+int32_t diskfs_read_page(inode_t *inode, page_t *page) {
+
+    /* fill in a page of file data. data blocks go straight from
+     * the device to the page, they are cached here only. blocks
+     * that follow each other on disk are read in one request.
+     */
+    int32_t blksize = inode->blksize;
+    diskfs_blk_t count = PAGE_SIZE/blksize, i, n;
+    diskfs_blk_t first = page->index*count, blk, eof;
+    uint8_t *tmp, *buf;
+    int32_t err = ESUCCESS;
+
+    /* the data is in the inode? */
+    if (inline_enabled(inode)) {
+        memset(page->data, 0, PAGE_SIZE);
+        if (!page->index && inode->size <= DISKFS_INLINE_MAX)
+            memcpy(page->data, inode->info.diskfs.ptr, inode->size);
+        return ESUCCESS;
+    }
+
+    /* buffer for indirect tables: */
+    tmp = kmalloc(blksize);
+    if (!tmp)
+        return ENOMEM;
+
+    /* blocks of the file: */
+    eof = (inode->size + blksize - 1)/blksize;
+
+    /* read run by run: */
+    for (i = 0; i < count && !err; i += n) {
+        buf = &page->data[i*blksize];
+        n = count - i;
+        if (first+i >= eof) {
+            /* beyond EOF */
+            memset(buf, 0, n*blksize);
+            continue;
+        }
+        if (n > eof - (first+i))
+            n = eof - (first+i);
+        if (!(blk = diskfs_bmap_run(inode, first+i, tmp, &n))) {
+            /* a hole */
+            memset(buf, 0, n*blksize);
+        } else {
+            err = dev_read(inode->sb->dev, 1024 + (pos_t) blk*blksize,
+                           n*blksize, (char *) buf);
+        }
+    }
+
+    /* done: */
+    kfree(tmp);
+    return err;
+
+}
+
+/****************************************************************************/
+/*                               get_page()                                 */
+/****************************************************************************/
+
+page_t *diskfs_get_page(inode_t *inode, uint32_t index, int32_t fill) {
+
+    /* get a cached page of the file, pinned. if the page is not
+     * valid, it is read from disk unless fill is zero (the caller
+     * is going to overwrite all of it). the page is valid as soon
+     * as it is returned, so it is cleared rather than left with
+     * whatever the memory held before.
+     */
+    page_t *page = pcache_get(inode->sb, inode->ino, index);
+    int32_t err = ESUCCESS;
+
+    if (!page || (page->flags & PG_VALID))
+        return page;
+
+    if (fill)
+        err = diskfs_read_page(inode, page);
+    else
+        memset(page->data, 0, PAGE_SIZE);
+    pcache_ready(page, !err);
+    if (err) {
+        pcache_put(page);
+        return NULL;
+    }
+    return page;
+
+}
+
+/****************************************************************************/
+/*                              read_ahead()                                */
+/****************************************************************************/
+
+void diskfs_read_ahead(inode_t *inode, uint32_t index, uint32_t count) {
+
+    /* bring pages index..index+count-1 of the file into the page
+     * cache, skipping those that are cached. pages whose blocks
+     * follow each other on disk are read with a single device
+     * request into a bounce buffer, up to DISKFS_RA_MAX at once.
+     */
+    int32_t blksize = inode->blksize;
+    diskfs_blk_t ppb = PAGE_SIZE/blksize; /* blocks per page. */
+    diskfs_blk_t eof, lblk, blk, nblk;
+    page_t *pages[DISKFS_RA_MAX], *page;
+    uint32_t last, i, n, j, max;
+    uint8_t *tmp, *bounce;
+    int32_t err, bytes;
+
+    /* nothing on disk to read? */
+    if (inline_enabled(inode))
+        return;
+
+    /* pages of the file: */
+    eof  = (inode->size + blksize - 1)/blksize;
+    last = (eof + ppb - 1)/ppb;
+    if (index >= last)
+        return;
+    if (count > last - index)
+        count = last - index;
+
+    /* buffers: */
+    if (!(tmp = kmalloc(blksize)))
+        return;
+    bounce = count > 1 ? kmalloc(DISKFS_RA_MAX*PAGE_SIZE) : NULL;
+    max = bounce ? DISKFS_RA_MAX : 1;
+
+    for (i = 0; i < count; i += n ? n : 1) {
+
+        /* how many whole pages from here on are in a row on disk? */
+        lblk = (index+i)*ppb;
+        nblk = (count-i)*ppb;
+        if (nblk > eof - lblk)
+            nblk = eof - lblk;
+        blk = diskfs_bmap_run(inode, lblk, tmp, &nblk);
+        n = nblk/ppb;
+        if (lblk + nblk == eof && nblk%ppb)
+            n++; /* the last page. */
+        if (n > max)
+            n = max;
+
+        if (!blk || !n) {
+            /* a hole, or blocks apart: read_page() does the page. */
+            if (page = pcache_grab(inode->sb, inode->ino, index+i)) {
+                err = diskfs_read_page(inode, page);
+                pcache_ready(page, !err);
+                pcache_put(page);
+            }
+            n = 1;
+            continue;
+        }
+
+        /* get the pages, up to the first one that is cached: */
+        for (j = 0; j < n; j++)
+            if (!(pages[j] = pcache_grab(inode->sb, inode->ino, index+i+j)))
+                break;
+        if (!(n = j))
+            continue;
+
+        /* read them all: */
+        bytes = n*PAGE_SIZE;
+        if (bytes > (eof - lblk)*blksize)
+            bytes = (eof - lblk)*blksize;
+        err = dev_read(inode->sb->dev, 1024 + (pos_t) blk*blksize, bytes,
+                       n > 1 ? (char *) bounce : (char *) pages[0]->data);
+
+        /* and hand them over: */
+        for (j = 0; j < n; j++) {
+            page = pages[j];
+            if (!err && n > 1)
+                memcpy(page->data, &bounce[j*PAGE_SIZE], PAGE_SIZE);
+            if (!err && bytes < (j+1)*PAGE_SIZE)
+                memset(&page->data[bytes - j*PAGE_SIZE], 0,
+                       (j+1)*PAGE_SIZE - bytes); /* beyond EOF */
+            pcache_ready(page, !err);
+            pcache_put(page);
+        }
+
+    }
+
+    /* done: */
+    if (bounce)
+        kfree(bounce);
+    kfree(tmp);
+
+}
+
+/****************************************************************************/
+/*                             alloc_fileblk()                              */
+/****************************************************************************/
+
+diskfs_blk_t diskfs_alloc_fileblk(inode_t *inode,
+                                  diskfs_blk_t blk_off,
+                                  int32_t *fresh) {
 
     /* allocate a block for the file
      * referenced by "inode". the block
@@ -597,11 +1277,15 @@ int32_t diskfs_write_fileblk(inode_t *inode,
      * from the beginning of the file.
      * if there is already an allocated block,
      * don't allocate another one.
+     * *fresh (if given) tells whether a new
+     * block was allocated; its old contents
+     * are still on the disk then.
+     * returns the block, 0 if the disk is full.
      */
     int32_t ptrs_per_block;
     diskfs_lvl_t lvl;
     uint8_t *tmp;
-    int32_t init = 0, i, j = 0;
+    int32_t init = 0, i, j;
     diskfs_blk_t  blk;
     diskfs_blk_t *ptr;
 
@@ -609,11 +1293,26 @@ int32_t diskfs_write_fileblk(inode_t *inode,
     ptrs_per_block = inode->sb->blksize/sizeof(diskfs_blk_t);
     lvl = diskfs_blk_to_lvl(inode->sb->disksb, blk_off);
 
+    /* nothing allocated yet: */
+    if (fresh)
+        *fresh = 0;
+
     /* allocate buffer: */
     tmp = kmalloc(inode->sb->blksize);
     if (!tmp)
         return 0;
 
+    /* extents? */
+    if (ext_enabled(inode)) {
+        if (!(blk = ext_map(inode, blk_off, tmp, NULL))) {
+            blk = ext_alloc(inode, blk_off);
+            if (fresh)
+                *fresh = blk != 0;
+        }
+        kfree(tmp);
+        return blk;
+    }
+
     for (i = 0; i <= lvl.level; i++) {
 
         /* load the table into memory: */
@@ -626,123 +1325,1050 @@ int32_t diskfs_write_fileblk(inode_t *inode,
 
         /* initialize the table? */
         if (init) {
-            while(j < ptrs_per_block)
-                ptr[j++] = 0;
+            for (j = 0; j < ptrs_per_block; j++)
+                ptr[j] = 0;
             init = 0;
         }
 
         /* allocate a pointer for next level (if there isn't): */
         if (ptr[lvl.ptr[i]]) {
 
-            blk = ptr[lvl.ptr[i]]; /* next level; */
+            blk = ptr[lvl.ptr[i]]; /* next level; */
+
+        } else {
+
+            /* allocate and update: */
+            if (i == lvl.level) {
+                ptr[lvl.ptr[i]] = pa_alloc(inode, blk_off, 0);
+                if (fresh)
+                    *fresh = ptr[lvl.ptr[i]] != 0;
+            } else
+                ptr[lvl.ptr[i]] = diskfs_bmap_alloc(inode->sb, 0);
+
+            /* the new allocated page need to be initialized: */
+            init = 1;
+
+            /* write updates to disk */
+            if (!i)
+                diskfs_t.update_inode(inode);
+            else
+                diskfs_write_cluster(inode->sb, blk, tmp);
+
+            /* set blk to next level; */
+            blk = ptr[lvl.ptr[i]];
+
+            /* NULL? */
+            if (!blk)
+                break;
+
+        }
+    }
+
+    /* no need for tmp: */
+    kfree(tmp);
+
+    /* done */
+    return blk;
+
+}
+
+/****************************************************************************/
+/*                               inline_spill()                             */
+/****************************************************************************/
+
+static int32_t inline_spill(inode_t *inode) {
+
+    /* the file is outgrowing its inode: move the data of an
+     * inline file into a block of its own. the data goes through
+     * page 0 of the file, which is left dirty for write-back.
+     */
+    diskfs_sb_t *disksb = inode->sb->disksb;
+    diskfs_blk_t save[DISKFS_PTRS];
+    uint32_t flags = inode->info.diskfs.flags;
+    page_t *page;
+    int32_t i;
+
+    if (!inline_enabled(inode))
+        return ESUCCESS;
+
+    /* the data, in the cache: */
+    if (!(page = diskfs_get_page(inode, 0, 1)))
+        return ENOMEM;
+
+    /* ptr[] becomes a block map: */
+    for (i = 0; i < DISKFS_PTRS; i++) {
+        save[i] = inode->info.diskfs.ptr[i];
+        inode->info.diskfs.ptr[i] = 0;
+    }
+    inode->info.diskfs.flags &= ~DISKFS_INODE_INLINE;
+    if (disksb->revision >= QUAFS_REVISION_EXTENTS)
+        ext_init(inode);
+
+    /* a block for the data: */
+    if (inode->size) {
+        if (!diskfs_alloc_fileblk(inode, 0, NULL)) {
+            /* disk is full, stay inline. */
+            for (i = 0; i < DISKFS_PTRS; i++)
+                inode->info.diskfs.ptr[i] = save[i];
+            inode->info.diskfs.flags = flags;
+            pcache_put(page);
+            return ENOSPC;
+        }
+        inode->blocks = 1;
+        pcache_dirty(page, 0, inode->blksize);
+    }
+
+    pcache_put(page);
+    inode->info.diskfs.dirty = 1;
+    return ESUCCESS;
+
+}
+
+/****************************************************************************/
+/*                             write_fileblk()                              */
+/****************************************************************************/
+
+int32_t diskfs_write_fileblk(inode_t *inode,
+                             diskfs_blk_t blk_off,
+                             void *buf) {
+
+    /* write a block of a directory, allocating it if needed. file
+     * data is written back from the page cache instead.
+     */
+    diskfs_blk_t blk = diskfs_alloc_fileblk(inode, blk_off, NULL);
+
+    if (!blk)
+        return ENOSPC;
+    diskfs_write_cluster(inode->sb, blk, buf);
+
+    /* done */
+    return ESUCCESS;
+
+}
+
+/****************************************************************************/
+/*                              free_fileblk()                              */
+/****************************************************************************/
+
+void diskfs_free_fileblk(inode_t *inode, diskfs_blk_t blk_off) {
+
+    /* variables that are used */
+    int32_t ptrs_per_block;
+    diskfs_lvl_t lvl;
+    uint8_t *tmp;
+    int32_t init = 0, i, j;
+    diskfs_blk_t  blk[5] = {0};
+    diskfs_blk_t *ptr;
+
+    /* calculate stuff: */
+    ptrs_per_block = inode->sb->blksize/sizeof(diskfs_blk_t);
+    lvl = diskfs_blk_to_lvl(inode->sb->disksb, blk_off);
+
+    /* allocate buffer: */
+    tmp = kmalloc(inode->sb->blksize);
+    if (!tmp)
+        return;
+
+    /* loop on all levels: */
+    for (i = 0; i <= lvl.level; i++) {
+
+        /* load the table into memory: */
+        if (!i) {
+            ptr = inode->info.diskfs.ptr;
+        } else {
+            diskfs_read_cluster(inode->sb, blk[i], tmp);
+            ptr = (diskfs_blk_t *) tmp;
+        }
+
+        /* get pointer for next level (if there isn't): */
+        if (!(blk[i+1] = ptr[lvl.ptr[i]])) {
+            break;
+        }
+    }
+
+
+    for (i = lvl.level+1; i >= 0; i--) {
+        /* start removing blocks & tables level by level. */
+        if (i == lvl.level+1) {
+            if (!blk[i])
+                continue;
+            diskfs_bmap_free(inode->sb, blk[i]);
+        } else if (i > 0) {
+            /* a table. */
+            if (!blk[i])
+                continue;
+            diskfs_read_cluster(inode->sb, blk[i], tmp);
+            ptr = (diskfs_blk_t *) tmp;
+            ptr[lvl.ptr[i]] = 0;
+            diskfs_write_cluster(inode->sb, blk[i], tmp);
+            /* all zeros? */
+            for (j = 0; j < ptrs_per_block && (!ptr[j]); j++);
+            if (j != ptrs_per_block) {
+                /* omg i can't delete the table.. */
+                break;
+            }
+            diskfs_bmap_free(inode->sb, blk[i]);
+        } else {
+            /* we are at the inode level. */
+            ptr = inode->info.diskfs.ptr;
+            ptr[lvl.ptr[i]] = 0;
+            diskfs_update_inode(inode);
+        }
+    }
+
+    /* done */
+    kfree(tmp);
+    return;
+
+}
+
+/***************************************************************************/
+/*                               write-back                                */
+/***************************************************************************/
+
+static waitq_t lock_wq = {NULL, NULL, 0}; /* waiting for sb locks. */
+
+static void sb_lock(super_block_t *sb) {
+
+    /* writers, truncate() and write-back of a file system take turns,
+     * so that pages are not written back while their blocks are being
+     * allocated or freed.
+     */
+    diskfs_sb_info_t *info = &sb->info.diskfs;
+    int32_t status = arch_get_int_status();
+
+    arch_disable_interrupts();
+    while (info->locked)
+        waitq_sleep(&lock_wq);
+    info->locked = 1;
+    arch_set_int_status(status);
+
+}
+
+static void sb_unlock(super_block_t *sb) {
+
+    int32_t status = arch_get_int_status();
+
+    arch_disable_interrupts();
+    sb->info.diskfs.locked = 0;
+    wake_up(&lock_wq);
+    arch_set_int_status(status);
+
+}
+
+static void mark_dirty(inode_t *inode) {
+
+    /* put an inode whose pages or size changed on the dirty list of
+     * its super block, unless it is there already. called after the
+     * changes are made: if the inode is still listed, the write-back
+     * that takes it off the list is yet to come and will see them.
+     */
+    diskfs_inode_info_t *info = &inode->info.diskfs;
+    diskfs_sb_info_t *sbi = &inode->sb->info.diskfs;
+    int32_t status, listed;
+
+    if (info->listed)
+        return;
+
+    /* the list holds a reference, so the inode stays in memory: */
+    igrab(inode);
+
+    status = arch_get_int_status();
+    arch_disable_interrupts();
+    if (!(listed = info->listed)) {
+        info->listed = 1;
+        info->dirty_next = sbi->dirty_inodes;
+        sbi->dirty_inodes = inode;
+    }
+    arch_set_int_status(status);
+
+    /* somebody else was faster: */
+    if (listed)
+        iput(inode);
+
+}
+
+static inode_t *unlist(super_block_t *sb, inode_t *inode) {
+
+    /* take inode (or the newest one if NULL) off the dirty list.
+     * returns it, NULL if not listed; the caller owns the reference.
+     */
+    diskfs_sb_info_t *sbi = &sb->info.diskfs;
+    inode_t **p;
+    int32_t status;
+
+    status = arch_get_int_status();
+    arch_disable_interrupts();
+    p = &sbi->dirty_inodes;
+    while (*p && inode && *p != inode)
+        p = &(*p)->info.diskfs.dirty_next;
+    if (inode = *p) {
+        *p = inode->info.diskfs.dirty_next;
+        inode->info.diskfs.listed = 0;
+    }
+    arch_set_int_status(status);
+    return inode;
+
+}
+
+static int32_t wb_inode(inode_t *inode) {
+
+    /* write the dirty pages of a file back, then the inode. blocks
+     * that follow each other on disk are written in one request,
+     * across pages too. called with the super block locked.
+     */
+    super_block_t *sb = inode->sb;
+    uint32_t blksize = inode->blksize, per_page = PAGE_SIZE/blksize;
+    uint32_t secs = blksize/PCACHE_SECTOR, bmask = (1 << secs)-1;
+    page_t *list[DISKFS_WB_PAGES], *page;
+    diskfs_blk_t eof, lblk, blk, start = 0, len = 0;
+    uint32_t n, i, j, b, mask;
+    uint8_t *buf, *tmp;
+    int32_t err = ESUCCESS, e;
+
+    /* inline data goes back into the inode: */
+    if (inline_enabled(inode) &&
+        (page = pcache_find(sb, inode->ino, 0))) {
+        if (pcache_clean(page, 0, PAGE_SIZE)) {
+            memcpy(inode->info.diskfs.ptr, page->data, DISKFS_INLINE_MAX);
+            inode->info.diskfs.dirty = 1;
+        }
+        pcache_put(page);
+    }
+
+    /* the inode: */
+    if (inode->info.diskfs.dirty) {
+        inode->info.diskfs.dirty = 0;
+        diskfs_update_inode(inode);
+    }
+
+    /* buffers for the runs and for indirect tables: */
+    buf = kmalloc(DISKFS_WB_PAGES*PAGE_SIZE);
+    tmp = kmalloc(blksize);
+    if (!buf || !tmp) {
+        if (buf)
+            kfree(buf);
+        if (tmp)
+            kfree(tmp);
+        return ENOMEM;
+    }
+
+    /* blocks of the file: */
+    eof = (inode->size + blksize - 1)/blksize;
+
+    while (n = pcache_collect(sb, inode->ino, list, DISKFS_WB_PAGES)) {
+
+        /* sort the batch by index */
+        for (i = 1; i < n; i++) {
+            page = list[i];
+            for (j = i; j && list[j-1]->index > page->index; j--)
+                list[j] = list[j-1];
+            list[j] = page;
+        }
+
+        /* copy dirty blocks out, writing each run as it ends */
+        for (i = 0; i < n; i++) {
+            page = list[i];
+            mask = pcache_clean(page, 0, PAGE_SIZE);
+            for (b = 0; b < per_page; b++) {
+                if (!((mask >> (b*secs)) & bmask))
+                    continue;
+                lblk = page->index*per_page + b;
+                if (lblk >= eof || !(blk = diskfs_bmap(inode, lblk, tmp)))
+                    continue; /* truncated meanwhile. */
+                if (len && (blk != start+len ||
+                            len == DISKFS_WB_PAGES*per_page)) {
+                    if (e = blkdev_write_direct(sb->dev,
+                                                1024 + (pos_t) start*blksize,
+                                                len*blksize, (char *) buf))
+                        err = e;
+                    len = 0;
+                }
+                if (!len)
+                    start = blk;
+                memcpy(&buf[len*blksize], &page->data[b*blksize], blksize);
+                len++;
+            }
+            pcache_put(page);
+        }
+
+    }
+
+    /* the last run */
+    if (len && (e = blkdev_write_direct(sb->dev, 1024 + (pos_t) start*blksize,
+                                        len*blksize, (char *) buf)))
+        err = e;
+
+    kfree(buf);
+    kfree(tmp);
+    return err;
+
+}
+
+/***************************************************************************/
+/*                                 sync()                                  */
+/***************************************************************************/
+
+int32_t diskfs_sync(super_block_t *sb, inode_t *inode) {
+
+    /* write back one file and the metadata, or (inode is NULL) all
+     * files on the dirty list, as many as there were on entry.
+     */
+    inode_t *p;
+    int32_t err = ESUCCESS, e, count = 1, status;
+
+    if (!inode) {
+        status = arch_get_int_status();
+        arch_disable_interrupts();
+        count = 0;
+        for (p = sb->info.diskfs.dirty_inodes; p;
+             p = p->info.diskfs.dirty_next)
+            count++;
+        arch_set_int_status(status);
+    }
+
+    while (count--) {
+        p = unlist(sb, inode);
+        if (!p && !inode)
+            break; /* taken by fsync() meanwhile. */
+        sb_lock(sb);
+        if (e = wb_inode(p ? p : inode))
+            err = e;
+        sb_unlock(sb);
+        if (p)
+            iput(p);
+    }
+
+    /* bitmaps and the super block, then all of it to the disk: */
+    sb_lock(sb);
+    diskfs_flush(sb);
+    sb_unlock(sb);
+    if (e = blkdev_sync(sb->dev))
+        err = e;
+
+    /* done */
+    return err;
+
+}
+
+/***************************************************************************/
+/*                          linear directories                             */
+/***************************************************************************/
+
+static int32_t linear_find(inode_t *dir, char *name, diskfs_ino_t *ino) {
+
+    /* local vars */
+    diskfs_dirent_t *dirents;
+    int32_t dirents_per_block;
+    int32_t i;
+    int32_t j;
+
+    /* allocate buffer: */
+    dirents = kmalloc(dir->blksize);
+    if (!dirents)
+        return ENOMEM;
+
+    /* initialize counters: */
+    dirents_per_block = dir->blksize/sizeof(diskfs_dirent_t);
+    i = 0; /* counter for blocks. */
+    j = 0; /* counter for dirents per block. */
+
+    /* loop on dirents. */
+    while(1) {
+        /* beginning of a new block? */
+        if (j == 0)
+            diskfs_read_fileblk(dir, i++, dirents);
+
+        /* done? */
+        if (dirents[j].ino == 0) {
+            kfree(dirents);
+            return ENOENT;
+        }
+
+        /* name matching? */
+        if (dirents[j].ino > 1 && !strcmp(dirents[j].name, name)) {
+            *ino = dirents[j].ino;
+            kfree(dirents);
+            return ESUCCESS;
+        }
+
+        /* next dirent: */
+        if (++j == dirents_per_block)
+            j = 0;
+    }
+
+}
+
+static int32_t linear_add(inode_t *dir, char *name, diskfs_ino_t ino) {
+
+    /* local vars */
+    diskfs_dirent_t *buf;
+    int32_t dirents_per_block;
+    int32_t i;
+    int32_t j;
+
+    /* allocate buffer: */
+    buf = kmalloc(dir->blksize);
+    if (!buf)
+        return ENOMEM;
+
+    /* insert a new entry in "dir": */
+    dirents_per_block = dir->blksize/sizeof(diskfs_dirent_t);
+    i = 0; /* counter for blocks. */
+    j = 0; /* counter for dirents per block. */
+
+    /* loop on dirents. */
+    while(1) {
+        /* beginning of a new block? */
+        if (j == 0)
+            diskfs_read_fileblk(dir, i++, buf);
+
+        /* a free entry? */
+        if (buf[j].ino == 0 || buf[j].ino == 1) {
+            buf[j].ino = ino;
+            strcpy(buf[j].name, name);
+            diskfs_write_fileblk(dir, i-1, buf);
+            break;
+        }
+
+        /* next dirent: */
+        if (++j == dirents_per_block)
+            j = 0;
+    }
+
+    /* free the buffer: */
+    kfree(buf);
+
+    /* done: */
+    return ESUCCESS;
+
+}
+
+static int32_t linear_remove(inode_t *dir, char *name) {
+
+    /* local vars */
+    diskfs_dirent_t *dirents;
+    int32_t dirents_per_block;
+    int32_t i;
+    int32_t j;
+
+    /* allocate buffer: */
+    dirents = kmalloc(dir->blksize);
+    if (!dirents)
+        return ENOMEM;
+
+    /* initialize counters: */
+    dirents_per_block = dir->blksize/sizeof(diskfs_dirent_t);
+    i = 0; /* counter for blocks. */
+    j = 0; /* counter for dirents per block. */
+
+    /* loop on dirents. */
+    while(1) {
+        /* beginning of a new block? */
+        if (j == 0)
+            diskfs_read_fileblk(dir, i++, dirents);
+
+        /* done? */
+        if (dirents[j].ino == 0) {
+            kfree(dirents);
+            return ENOENT;
+        }
+
+        /* name matching? */
+        if (dirents[j].ino > 1 && !strcmp(dirents[j].name, name)) {
+            /* remove entry: */
+            dirents[j].ino = 1;
+            diskfs_write_fileblk(dir, i-1, dirents);
+            kfree(dirents);
+            return ESUCCESS;
+        }
+
+        /* next dirent: */
+        if (++j == dirents_per_block)
+            j = 0;
+    }
+
+}
+
+static diskfs_blk_t linear_blocks(inode_t *dir) {
+
+    /* count of blocks of a linear directory, up to the 0 entry. */
+    diskfs_dirent_t *dirents;
+    int32_t dirents_per_block;
+    int32_t i = 0; /* counter for blocks. */
+    int32_t j = 0; /* counter for dirents per block. */
+
+    /* allocate buffer: */
+    dirents = kmalloc(dir->blksize);
+    if (!dirents)
+        return 0;
+
+    /* loop on dirents. */
+    dirents_per_block = dir->blksize/sizeof(diskfs_dirent_t);
+    while(1) {
+        /* beginning of a new block? */
+        if (j == 0)
+            diskfs_read_fileblk(dir, i++, dirents);
+
+        /* done? */
+        if (dirents[j].ino == 0)
+            break;
+
+        /* next dirent: */
+        if (++j == dirents_per_block)
+            j = 0;
+    }
+
+    /* now i contains the count of blocks: */
+    kfree(dirents);
+    return i;
+
+}
+
+/***************************************************************************/
+/*                          indexed directories                            */
+/***************************************************************************/
+
+static int32_t dx_enabled(inode_t *dir) {
+    diskfs_sb_t *disksb = (diskfs_sb_t *) dir->sb->disksb;
+    return disksb->revision >= QUAFS_REVISION_DXDIR &&
+           (dir->info.diskfs.flags & DISKFS_INODE_DXDIR);
+}
+
+static diskfs_blk_t dx_leaf(inode_t *dir, uint32_t hash,
+                            uint8_t *root, uint8_t *node,
+                            diskfs_dx_entry_t **rent,
+                            diskfs_dx_entry_t **nent) {
+
+    /* walk the index from root (already in memory) down to the leaf
+     * that holds hash. with depth 2 the index node is read to node.
+     * returns 0 if the index is broken (block 0 is never a leaf).
+     */
+    diskfs_dx_head_t *head = DISKFS_DX_ROOT(root);
+
+    if (head->magic != DISKFS_DX_MAGIC || !head->count)
+        return 0;
+    *rent = diskfs_dx_find(head, hash);
+    *nent = NULL;
+    if (head->depth == 1)
+        return (*rent)->blk;
+
+    diskfs_read_fileblk(dir, (*rent)->blk, node);
+    head = (diskfs_dx_head_t *) node;
+    if (head->magic != DISKFS_DX_MAGIC || !head->count)
+        return 0;
+    *nent = diskfs_dx_find(head, hash);
+    return (*nent)->blk;
+
+}
+
+static int32_t dx_find(inode_t *dir, char *name, diskfs_ino_t *ino) {
+
+    int32_t bs = dir->blksize, i, err = ENOENT;
+    uint8_t *buf;
+    diskfs_dirent_t *dirents;
+    diskfs_dx_entry_t *rent, *nent;
+    diskfs_blk_t leaf;
+
+    /* allocate buffers (root, node): */
+    buf = kmalloc(2*bs);
+    if (!buf)
+        return ENOMEM;
+    dirents = (diskfs_dirent_t *) buf;
+
+    /* "." and ".." live in the root: */
+    diskfs_read_fileblk(dir, 0, buf);
+    for (i = 0; i < 2; i++) {
+        if (!strcmp(dirents[i].name, name)) {
+            *ino = dirents[i].ino;
+            kfree(buf);
+            return ESUCCESS;
+        }
+    }
+
+    /* find the leaf and scan it: */
+    if (!(leaf = dx_leaf(dir, diskfs_dx_hash(name), buf, buf+bs,
+                         &rent, &nent))) {
+        kfree(buf);
+        return EIO;
+    }
+    diskfs_read_fileblk(dir, leaf, buf);
+    for (i = 0; i < DIRENT_COUNT(bs); i++) {
+        if (dirents[i].ino > 1 && !strcmp(dirents[i].name, name)) {
+            *ino = dirents[i].ino;
+            err = ESUCCESS;
+            break;
+        }
+    }
+
+    /* done: */
+    kfree(buf);
+    return err;
+
+}
+
+static void dx_insert(diskfs_dx_head_t *head, diskfs_dx_entry_t *after,
+                      uint32_t hash, diskfs_blk_t blk) {
+
+    /* insert a new entry next to "after" (which is in head). */
+    diskfs_dx_entry_t *ent = (diskfs_dx_entry_t *) &head[1];
+    int32_t i = head->count++;
+    while (&ent[i-1] != after) {
+        ent[i] = ent[i-1];
+        i--;
+    }
+    ent[i].hash = hash;
+    ent[i].blk  = blk;
+
+}
+
+static int32_t dx_add(inode_t *dir, char *name, diskfs_ino_t ino) {
+
+    int32_t bs = dir->blksize, count = DIRENT_COUNT(bs);
+    uint32_t hash = diskfs_dx_hash(name), h, split;
+    uint8_t *buf, *root, *node, *leaf, *newleaf, *newnode;
+    uint32_t *hv;
+    diskfs_dirent_t *dirents, *target, tmp;
+    diskfs_dx_head_t *rhead, *nhead, *phead;
+    diskfs_dx_entry_t *rent, *nent, *pent;
+    diskfs_blk_t leafblk, newblk, nodeblk = 0;
+    int32_t i, j, mid;
+
+    /* allocate buffers: */
+    buf = kmalloc(5*bs + count*sizeof(uint32_t));
+    if (!buf)
+        return ENOMEM;
+    root    = buf;
+    node    = buf + 1*bs;
+    leaf    = buf + 2*bs;
+    newleaf = buf + 3*bs;
+    newnode = buf + 4*bs;
+    hv = (uint32_t *) (buf + 5*bs);
+
+    /* find the leaf: */
+    diskfs_read_fileblk(dir, 0, root);
+    if (!(leafblk = dx_leaf(dir, hash, root, node, &rent, &nent))) {
+        kfree(buf);
+        return EIO;
+    }
+    diskfs_read_fileblk(dir, leafblk, leaf);
+    dirents = (diskfs_dirent_t *) leaf;
+
+    /* a free entry in the leaf? */
+    for (i = 0; i < count; i++) {
+        if (dirents[i].ino == 0 || dirents[i].ino == 1) {
+            dirents[i].ino = ino;
+            strcpy(dirents[i].name, name);
+            diskfs_write_fileblk(dir, leafblk, leaf);
+            kfree(buf);
+            return ESUCCESS;
+        }
+    }
+
+    /* the leaf is full, sort it by hash so it can be split in two: */
+    for (i = 0; i < count; i++) {
+        hv[i] = diskfs_dx_hash(dirents[i].name);
+        for (j = i; j > 0 && hv[j-1] > hv[j]; j--) {
+            h = hv[j]; hv[j] = hv[j-1]; hv[j-1] = h;
+            tmp = dirents[j]; dirents[j] = dirents[j-1]; dirents[j-1] = tmp;
+        }
+    }
+
+    /* split point: names of the same hash stay together. */
+    mid = count/2;
+    while (mid < count && hv[mid] == hv[mid-1])
+        mid++;
+    if (mid == count) {
+        mid = count/2;
+        while (mid > 0 && hv[mid] == hv[mid-1])
+            mid--;
+    }
+    if (!mid) {
+        /* all names in the leaf have the same hash. */
+        kfree(buf);
+        return ENOSPC;
+    }
+    split = hv[mid];
+
+    /* where does the new index entry go? */
+    rhead = DISKFS_DX_ROOT(root);
+    nhead = (diskfs_dx_head_t *) node;
+    if (rhead->depth == 1) {
+        phead = rhead;
+        pent  = rent;
+    } else {
+        phead = nhead;
+        pent  = nent;
+        if (nhead->count == DISKFS_DX_NODE_LIMIT(bs) &&
+            rhead->count == DISKFS_DX_ROOT_LIMIT(bs)) {
+            /* the index is full. */
+            kfree(buf);
+            return ENOSPC;
+        }
+    }
+
+    /* move the upper half to a new leaf: */
+    for (i = 0; i < bs; i++)
+        newleaf[i] = 0;
+    for (i = mid; i < count; i++) {
+        ((diskfs_dirent_t *) newleaf)[i-mid] = dirents[i];
+        dirents[i].ino = 0;
+        for (j = 0; j < sizeof(dirents[i].name); j++)
+            dirents[i].name[j] = 0;
+    }
+    newblk = dir->blocks++;
+
+    /* the new entry goes to one of them: */
+    target = hash < split ? &dirents[mid] :
+                            &((diskfs_dirent_t *) newleaf)[count-mid];
+    target->ino = ino;
+    strcpy(target->name, name);
+
+    /* add the leaf to the index: */
+    if (rhead->depth == 1 && rhead->count == DISKFS_DX_ROOT_LIMIT(bs)) {
+        /* root is full, move its entries to a new node (depth 2). */
+        nodeblk = dir->blocks++;
+        nhead->magic = DISKFS_DX_MAGIC;
+        nhead->depth = 0;
+        nhead->count = rhead->count;
+        for (i = 0; i < rhead->count; i++)
+            ((diskfs_dx_entry_t *) &nhead[1])[i] =
+                ((diskfs_dx_entry_t *) &rhead[1])[i];
+        pent  = &((diskfs_dx_entry_t *) &nhead[1])[pent -
+                  (diskfs_dx_entry_t *) &rhead[1]];
+        phead = nhead;
+        rhead->depth = 2;
+        rhead->count = 1;
+        rent = (diskfs_dx_entry_t *) &rhead[1];
+        rent->hash = 0;
+        rent->blk  = nodeblk;
+        dx_insert(phead, pent, split, newblk);
+    } else if (phead == nhead && nhead->count == DISKFS_DX_NODE_LIMIT(bs)) {
+        /* node is full, split it too. */
+        diskfs_dx_head_t *nnhead = (diskfs_dx_head_t *) newnode;
+        diskfs_dx_entry_t *ent = (diskfs_dx_entry_t *) &nhead[1];
+        diskfs_dx_entry_t *nnent = (diskfs_dx_entry_t *) &nnhead[1];
+        int32_t half = nhead->count/2;
+        nnhead->magic = DISKFS_DX_MAGIC;
+        nnhead->depth = 0;
+        nnhead->count = nhead->count - half;
+        for (i = half; i < nhead->count; i++)
+            nnent[i-half] = ent[i];
+        nhead->count = half;
+        nodeblk = dir->blocks++;
+        dx_insert(rhead, rent, nnent[0].hash, nodeblk);
+        if (pent - ent < half)
+            dx_insert(nhead, pent, split, newblk);
+        else
+            dx_insert(nnhead, &nnent[pent-ent-half], split, newblk);
+        diskfs_write_fileblk(dir, nodeblk, newnode);
+        nodeblk = rent->blk;
+    } else {
+        dx_insert(phead, pent, split, newblk);
+        if (phead == nhead)
+            nodeblk = rent->blk;
+    }
+
+    /* write everything: */
+    diskfs_write_fileblk(dir, leafblk, leaf);
+    diskfs_write_fileblk(dir, newblk, newleaf);
+    if (nodeblk)
+        diskfs_write_fileblk(dir, nodeblk, node);
+    diskfs_write_fileblk(dir, 0, root);
+    dir->size = dir->blocks*bs;
+    diskfs_update_inode(dir);
+
+    /* done: */
+    kfree(buf);
+    return ESUCCESS;
+
+}
+
+static int32_t dx_remove(inode_t *dir, char *name) {
+
+    int32_t bs = dir->blksize, i, err = ENOENT;
+    uint8_t *buf;
+    diskfs_dirent_t *dirents;
+    diskfs_dx_entry_t *rent, *nent;
+    diskfs_blk_t leaf;
+
+    /* allocate buffers (root, node): */
+    buf = kmalloc(2*bs);
+    if (!buf)
+        return ENOMEM;
+    dirents = (diskfs_dirent_t *) buf;
+
+    /* find the leaf: */
+    diskfs_read_fileblk(dir, 0, buf);
+    if (!(leaf = dx_leaf(dir, diskfs_dx_hash(name), buf, buf+bs,
+                         &rent, &nent))) {
+        kfree(buf);
+        return EIO;
+    }
+
+    /* remove the entry (leaves are never merged): */
+    diskfs_read_fileblk(dir, leaf, buf);
+    for (i = 0; i < DIRENT_COUNT(bs); i++) {
+        if (dirents[i].ino > 1 && !strcmp(dirents[i].name, name)) {
+            dirents[i].ino = 1;
+            diskfs_write_fileblk(dir, leaf, buf);
+            err = ESUCCESS;
+            break;
+        }
+    }
+
+    /* done: */
+    kfree(buf);
+    return err;
+
+}
+
+static int32_t dx_init(inode_t *inode, diskfs_ino_t parent) {
+
+    /* make inode an empty indexed directory: the root and one leaf. */
+    int32_t bs = inode->blksize, i;
+    uint8_t *buf;
+    diskfs_dirent_t *dirents;
+    diskfs_dx_head_t *head;
+    diskfs_dx_entry_t *ent;
+
+    /* allocate buffer: */
+    buf = kmalloc(bs);
+    if (!buf)
+        return ENOMEM;
+    dirents = (diskfs_dirent_t *) buf;
+
+    /* the leaf: */
+    for (i = 0; i < bs; i++)
+        buf[i] = 0;
+    diskfs_write_fileblk(inode, 1, buf);
+
+    /* the root: */
+    dirents[0].ino = inode->ino;
+    strcpy(dirents[0].name, ".");
+    dirents[1].ino = parent;
+    strcpy(dirents[1].name, "..");
+    head = DISKFS_DX_ROOT(buf);
+    head->magic = DISKFS_DX_MAGIC;
+    head->depth = 1;
+    head->count = 1;
+    ent = (diskfs_dx_entry_t *) &head[1];
+    ent->hash = 0;
+    ent->blk  = 1;
+    diskfs_write_fileblk(inode, 0, buf);
 
-        } else {
+    /* update the inode: */
+    inode->blocks = 2;
+    inode->size   = 2*bs;
+    inode->info.diskfs.flags |= DISKFS_INODE_DXDIR;
+    diskfs_update_inode(inode);
 
-            /* allocate and update: */
-            ptr[lvl.ptr[i]] = diskfs_bmap_alloc(inode->sb);
+    /* done: */
+    kfree(buf);
+    return ESUCCESS;
 
-            /* the new allocated page need to be initialized: */
-            init = 1;
+}
 
-            /* write updates to disk */
-            if (!i)
-                diskfs_t.update_inode(inode);
-            else
-                diskfs_write_cluster(inode->sb, blk, tmp);
+static int32_t dx_empty(inode_t *dir) {
 
-            /* set blk to next level; */
-            blk = ptr[lvl.ptr[i]];
+    /* does the directory have entries other than "." and ".."? */
+    int32_t bs = dir->blksize, i;
+    diskfs_blk_t b;
+    diskfs_dirent_t *dirents;
 
-            /* NULL? */
-            if (!blk)
-                return 0;
+    /* allocate buffer: */
+    dirents = kmalloc(bs);
+    if (!dirents)
+        return ENOMEM;
 
+    /* scan leaves: */
+    for (b = 1; b < dir->blocks; b++) {
+        diskfs_read_fileblk(dir, b, dirents);
+        if (dirents[0].ino == DISKFS_DX_MAGIC)
+            continue; /* index node. */
+        for (i = 0; i < DIRENT_COUNT(bs); i++) {
+            if (dirents[i].ino > 1) {
+                kfree(dirents);
+                return ENOTEMPTY;
+            }
         }
     }
 
-    /* no need for tmp: */
-    kfree(tmp);
+    /* done: */
+    kfree(dirents);
+    return ESUCCESS;
 
-    /* write block: */
-    diskfs_write_cluster(inode->sb, blk, buf);
+}
 
-    /* done */
-    return ESUCCESS;
+/***************************************************************************/
+/*                            directory entries                            */
+/***************************************************************************/
 
+static int32_t dir_find(inode_t *dir, char *name, diskfs_ino_t *ino) {
+    if (dx_enabled(dir))
+        return dx_find(dir, name, ino);
+    else
+        return linear_find(dir, name, ino);
 }
 
-/****************************************************************************/
-/*                              free_fileblk()                              */
-/****************************************************************************/
+static int32_t dir_add(inode_t *dir, char *name, diskfs_ino_t ino) {
+    if (dx_enabled(dir))
+        return dx_add(dir, name, ino);
+    else
+        return linear_add(dir, name, ino);
+}
 
-void diskfs_free_fileblk(inode_t *inode, diskfs_blk_t blk_off) {
+static int32_t dir_remove(inode_t *dir, char *name) {
+    if (dx_enabled(dir))
+        return dx_remove(dir, name);
+    else
+        return linear_remove(dir, name);
+}
 
-    /* variables that are used */
-    int32_t ptrs_per_block;
-    diskfs_lvl_t lvl;
-    uint8_t *tmp;
-    int32_t init = 0, i, j;
-    diskfs_blk_t  blk[5] = {0};
-    diskfs_blk_t *ptr;
+static int32_t dir_empty(inode_t *dir) {
 
-    /* calculate stuff: */
-    ptrs_per_block = inode->sb->blksize/sizeof(diskfs_blk_t);
-    lvl = diskfs_blk_to_lvl(inode->sb->disksb, blk_off);
+    /* linear directory: count entries. */
+    diskfs_dirent_t *buf;
+    int32_t dirents_per_block;
+    int32_t i, j;
+    pos_t entcount;
+
+    if (dx_enabled(dir))
+        return dx_empty(dir);
 
     /* allocate buffer: */
-    tmp = kmalloc(inode->sb->blksize);
-    if (!tmp)
-        return;
+    buf = kmalloc(dir->blksize);
+    if (!buf)
+        return ENOMEM;
 
-    /* loop on all levels: */
-    for (i = 0; i <= lvl.level; i++) {
+    /* get count of entries in the target: */
+    dirents_per_block = dir->blksize/sizeof(diskfs_dirent_t);
+    i = 0; /* counter for blocks. */
+    j = 0; /* counter for dirents per block. */
+    entcount = 0;
 
-        /* load the table into memory: */
-        if (!i) {
-            ptr = inode->info.diskfs.ptr;
-        } else {
-            diskfs_read_cluster(inode->sb, blk[i-1], tmp);
-            ptr = (diskfs_blk_t *) tmp;
-        }
+    /* loop on dirents. */
+    while(1) {
+        /* beginning of a new block? */
+        if (j == 0)
+            diskfs_read_fileblk(dir, i++, buf);
 
-        /* get pointer for next level (if there isn't): */
-        if (!(blk[i+1] = ptr[lvl.ptr[i]])) {
+        /* done? */
+        if (buf[j].ino == 0)
             break;
-        }
-    }
 
+        /* valid entry */
+        if (buf[j].ino > 1)
+            entcount++;
 
-    for (i = lvl.level+1; i >= 0; i--) {
-        /* start removing blocks & tables level by level. */
-        if (i == lvl.level+1) {
-            if (!blk[i])
-                continue;
-            diskfs_bmap_free(inode->sb, blk[i]);
-        } else if (i > 0) {
-            /* a table. */
-            if (!blk[i])
-                continue;
-            diskfs_read_cluster(inode->sb, blk[i], tmp);
-            ptr = (diskfs_blk_t *) tmp;
-            ptr[lvl.ptr[i]] = 0;
-            diskfs_write_cluster(inode->sb, blk[i], tmp);
-            /* all zeros? */
-            for (j = 0; j < ptrs_per_block && (!ptr[j]); j++);
-            if (j != ptrs_per_block) {
-                /* omg i can't delete the table.. */
-                break;
-            }
-            diskfs_bmap_free(inode->sb, blk[i]);
-        } else {
-            /* we are at the inode level. */
-            ptr = inode->info.diskfs.ptr;
-            ptr[lvl.ptr[i]] = 0;
-            diskfs_update_inode(inode);
-        }
+        /* next dirent: */
+        if (++j == dirents_per_block)
+            j = 0;
     }
 
-    /* done */
-    return;
+    /* directory is not empty? */
+    kfree(buf);
+    return entcount > 2 ? ENOTEMPTY : ESUCCESS;
 
 }
 
@@ -754,54 +2380,32 @@ int32_t diskfs_put_inode(inode_t *inode) {
 
     /* local vars */
     diskfs_blk_t blocks;
-    int32_t dirents_per_block;
-    int32_t i = 0; /* counter for blocks. */
-    int32_t j = 0; /* counter for dirents per block. */
     diskfs_blk_t b;
-    diskfs_dirent_t *dirents;
+
+    /* the last handle is gone? give back preallocated blocks: */
+    if (!inode->icount)
+        pa_release(inode);
 
     /* inode is still referenced? */
     if (inode->icount || inode->ref)
-        return ESUCCESS;
+        return diskfs_flush(inode->sb);
 
     /* remove the inode 3:) */
     blocks = 0;
 
     /* get count of blocks: */
-    if ((inode->mode & FT_MASK) == FT_DIR) {
-        /* calculate count of directory blocks: */
-        dirents = kmalloc(inode->blksize);
-        if (!dirents) {
-            return ENOMEM;
-        }
-
-        /* initialize counters: */
-        dirents_per_block = inode->blksize/sizeof(diskfs_dirent_t);
-        i = 0; /* counter for blocks. */
-        j = 0; /* counter for dirents per block. */
-
-        /* loop on dirents. */
-        while(1) {
-            /* beginning of a new block? */
-            if (j == 0)
-                diskfs_read_fileblk(inode, i++, (uint8_t *) dirents);
-
-            /* done? */
-            if (dirents[j].ino == 0)
-                break;
-
-            /* next dirent: */
-            if (++j == dirents_per_block)
-                j = 0;
-        }
-
-        /* now i contains the count of blocks to free: */
-        blocks = i;
-
-        /* deallocate the buffer: */
-        kfree(dirents);
+    if (inline_enabled(inode)) {
+        /* nothing outside the inode: */
+        blocks = 0;
+    } else if (ext_enabled(inode)) {
+        /* extents are freed all at once: */
+        blocks = 0;
+        ext_truncate(inode, 0);
+    } else if ((inode->mode & FT_MASK) == FT_DIR && !dx_enabled(inode)) {
+        /* linear directories end at the first 0 entry: */
+        blocks = linear_blocks(inode);
     } else {
-        /* just a file: */
+        /* just a file, or an indexed directory: */
         blocks = inode->blocks;
     }
 
@@ -814,11 +2418,14 @@ int32_t diskfs_put_inode(inode_t *inode) {
     /*    printk("%d: %x\n", i, inode->info.diskfs.ptr[i]); */
     /*printk("=======================================\n"); */
 
+    /* forget cached data: */
+    pcache_invalidate(inode->sb, inode->ino, 0);
+
     /* now free the inode itself. */
     diskfs_imap_free(inode->sb, inode->ino);
 
     /* done */
-    return ESUCCESS;
+    return diskfs_flush(inode->sb);
 
 }
 
@@ -828,52 +2435,23 @@ int32_t diskfs_put_inode(inode_t *inode) {
 
 int32_t diskfs_lookup(inode_t *dir, char *name, inode_t **ret) {
 
-    /* local vars */
-    diskfs_dirent_t *dirents;
-    int32_t dirents_per_block;
-    int32_t i;
-    int32_t j;
-
-    /* allocate buffer: */
-    dirents = kmalloc(dir->blksize);
-    if (!dirents)
-        return ENOMEM;
-
-    /* initialize counters: */
-    dirents_per_block = dir->blksize/sizeof(diskfs_dirent_t);
-    i = 0; /* counter for blocks. */
-    j = 0; /* counter for dirents per block. */
-
-    /* loop on dirents. */
-    while(1) {
-        /* beginning of a new block? */
-        if (j == 0)
-            diskfs_read_fileblk(dir, i++, dirents);
-
-        /* done? */
-        if (dirents[j].ino == 0) {
-            kfree(dirents);
-            return ENOENT;
-        }
+    diskfs_ino_t ino;
+    int32_t err;
 
-        /* name matching? */
-        if (dirents[j].ino > 1 && !strcmp(dirents[j].name, name)) {
-            if (ret) {
-                *ret = (inode_t *) iget(dir->sb, dirents[j].ino);
-                if (!(*ret)) {
-                    kfree(dirents);
-                    return ENOMEM;
-                }
-            }
-            kfree(dirents);
-            return ESUCCESS;
-        }
+    /* search the directory: */
+    if (err = dir_find(dir, name, &ino))
+        return err;
 
-        /* next dirent: */
-        if (++j == dirents_per_block)
-            j = 0;
+    /* get the inode: */
+    if (ret) {
+        *ret = (inode_t *) iget(dir->sb, ino);
+        if (!(*ret))
+            return ENOMEM;
     }
 
+    /* done: */
+    return ESUCCESS;
+
 }
 
 /***************************************************************************/
@@ -882,12 +2460,10 @@ int32_t diskfs_lookup(inode_t *dir, char *name, inode_t **ret) {
 
 int32_t diskfs_mknod(inode_t *dir, char *name, int32_t mode, int32_t devid) {
 
-    int32_t i, j;
+    int32_t i;
     int32_t err;
-    diskfs_dirent_t *buf;
     diskfs_ino_t ino;
     inode_t *inode;
-    int32_t dirents_per_block;
 
     /* dir must be directory: */
     if ((dir->mode & FT_MASK) != FT_DIR)
@@ -904,11 +2480,6 @@ int32_t diskfs_mknod(inode_t *dir, char *name, int32_t mode, int32_t devid) {
     else if (err != ENOENT)
         return err;
 
-    /* allocate buffer: */
-    buf = kmalloc(dir->blksize);
-    if (!buf)
-        return ENOMEM;
-
     /* allocate a disk inode: */
     ino = diskfs_imap_alloc(dir->sb);
     if (!ino)
@@ -927,42 +2498,26 @@ int32_t diskfs_mknod(inode_t *dir, char *name, int32_t mode, int32_t devid) {
     inode->devid = devid;
     for (i = 0; i < DISKFS_PTRS; i++)
         inode->info.diskfs.ptr[i] = 0;
+    inode->info.diskfs.flags = 0;
+    if (((diskfs_sb_t *) dir->sb->disksb)->revision >= QUAFS_REVISION_INLINE &&
+        (mode & FT_MASK) == FT_REGULAR)
+        inode->info.diskfs.flags = DISKFS_INODE_INLINE;
+    else if (((diskfs_sb_t *) dir->sb->disksb)->revision >=
+             QUAFS_REVISION_EXTENTS)
+        ext_init(inode);
 
     /* update the inode: */
     diskfs_update_inode(inode);
 
     /* insert a new entry in "dir": */
-    dirents_per_block = inode->blksize/sizeof(diskfs_dirent_t);
-    i = 0; /* counter for blocks. */
-    j = 0; /* counter for dirents per block. */
-
-    /* loop on dirents. */
-    while(1) {
-        /* beginning of a new block? */
-        if (j == 0)
-            diskfs_read_fileblk(dir, i++, buf);
-
-        /* a free entry? */
-        if (buf[j].ino == 0 || buf[j].ino == 1) {
-            buf[j].ino = ino;
-            strcpy(buf[j].name, name);
-            diskfs_write_fileblk(dir, i-1, buf);
-            break;
-        }
-
-        /* next dirent: */
-        if (++j == dirents_per_block)
-            j = 0;
-    }
+    if (err = dir_add(dir, name, ino))
+        inode->ref = 0; /* iput() will free it. */
 
     /* put the inode: */
     iput(inode);
 
-    /* free the buffer: */
-    kfree(buf);
-
     /* done: */
-    return ESUCCESS;
+    return err;
 
 }
 
@@ -974,10 +2529,6 @@ int32_t diskfs_link(inode_t *inode, inode_t *dir, char *name) {
 
     /* local vars */
     int32_t err;
-    diskfs_dirent_t *buf;
-    int32_t dirents_per_block;
-    int32_t i;
-    int32_t j;
 
     /* dir must be directory: */
     if ((dir->mode & FT_MASK) != FT_DIR)
@@ -997,45 +2548,19 @@ int32_t diskfs_link(inode_t *inode, inode_t *dir, char *name) {
     /* inode should not be directory: */
     if ((inode->mode & FT_MASK) == FT_DIR)
         return EISDIR;
-
-    /* allocate buffer: */
-    buf = kmalloc(dir->blksize);
-    if (!buf)
-        return ENOMEM;
-
-    /* increase references count: */
-    inode->ref++;
-    diskfs_update_inode(inode);
-
-    /* insert a new entry in "dir": */
-    dirents_per_block = inode->blksize/sizeof(diskfs_dirent_t);
-    i = 0; /* counter for blocks. */
-    j = 0; /* counter for dirents per block. */
-
-    /* loop on dirents. */
-    while(1) {
-        /* beginning of a new block? */
-        if (j == 0)
-            diskfs_read_fileblk(dir, i++, buf);
-
-        /* a free entry? */
-        if (buf[j].ino == 0 || buf[j].ino == 1) {
-            buf[j].ino = inode->ino;
-            strcpy(buf[j].name, name);
-            diskfs_write_fileblk(dir, i-1, buf);
-            break;
-        }
-
-        /* next dirent: */
-        if (++j == dirents_per_block)
-            j = 0;
+
+    /* insert a new entry in "dir": */
+    if (!(err = dir_add(dir, name, inode->ino))) {
+        /* increase references count: */
+        inode->ref++;
+        diskfs_update_inode(inode);
     }
 
-    /* free the buffer: */
-    kfree(buf);
+    /* write back the bitmaps: */
+    diskfs_flush(dir->sb);
 
     /* done: */
-    return ESUCCESS;
+    return err;
 }
 
 /***************************************************************************/
@@ -1045,10 +2570,8 @@ int32_t diskfs_link(inode_t *inode, inode_t *dir, char *name) {
 int32_t diskfs_unlink(inode_t *dir, char *name) {
 
     /* local vars */
-    diskfs_dirent_t *dirents;
-    int32_t dirents_per_block;
-    int32_t i;
-    int32_t j;
+    inode_t *inode;
+    int32_t err;
 
     /* dir must be directory: */
     if ((dir->mode & FT_MASK) != FT_DIR)
@@ -1058,63 +2581,31 @@ int32_t diskfs_unlink(inode_t *dir, char *name) {
     if (!(dir->ref))
         return ENOENT;
 
-    /* allocate buffer: */
-    dirents = kmalloc(dir->blksize);
-    if (!dirents)
-        return ENOMEM;
-
-    /* initialize counters: */
-    dirents_per_block = dir->blksize/sizeof(diskfs_dirent_t);
-    i = 0; /* counter for blocks. */
-    j = 0; /* counter for dirents per block. */
-
-    /* loop on dirents. */
-    while(1) {
-        /* beginning of a new block? */
-        if (j == 0)
-            diskfs_read_fileblk(dir, i++, (char *) dirents);
-
-        /* done? */
-        if (dirents[j].ino == 0) {
-            kfree(dirents);
-            return ENOENT;
-        }
-
-        /* name matching? */
-        if (dirents[j].ino > 1 && !strcmp(dirents[j].name, name)) {
-
-            /* get the inode: */
-            inode_t *inode = (inode_t *) iget(dir->sb,
-                                  dirents[j].ino);
-
-            /* directory? */
-            if ((inode->mode & FT_MASK) == FT_DIR) {
-                iput(inode);
-                kfree(dirents);
-                return EISDIR;
-            }
-
-            /* decrease references: */
-            inode->ref--;
-            diskfs_update_inode(inode);
+    /* get the inode: */
+    if (err = diskfs_lookup(dir, name, &inode))
+        return err;
 
-            /* remove entry: */
-            dirents[j].ino = 1;
-            diskfs_write_fileblk(dir, i-1, dirents);
-            kfree(dirents);
+    /* directory? */
+    if ((inode->mode & FT_MASK) == FT_DIR) {
+        iput(inode);
+        return EISDIR;
+    }
 
-            /* put the inode: */
-            iput(inode);
+    /* remove entry: */
+    if (err = dir_remove(dir, name)) {
+        iput(inode);
+        return err;
+    }
 
-            /* done: */
-            return ESUCCESS;
+    /* decrease references: */
+    inode->ref--;
+    diskfs_update_inode(inode);
 
-        }
+    /* put the inode: */
+    iput(inode);
 
-        /* next dirent: */
-        if (++j == dirents_per_block)
-            j = 0;
-    }
+    /* done: */
+    return ESUCCESS;
 
 }
 
@@ -1125,12 +2616,11 @@ int32_t diskfs_unlink(inode_t *dir, char *name) {
 int32_t diskfs_mkdir(inode_t *dir, char *name, int32_t mode) {
 
     /* local vars */
-    int32_t i, j;
+    int32_t i;
     int32_t err;
     diskfs_dirent_t *buf;
     diskfs_ino_t ino;
     inode_t *inode;
-    int32_t dirents_per_block;
 
     /* dir must be directory: */
     if ((dir->mode & FT_MASK) != FT_DIR)
@@ -1147,11 +2637,6 @@ int32_t diskfs_mkdir(inode_t *dir, char *name, int32_t mode) {
     else if (err != ENOENT)
         return err;
 
-    /* allocate buffer: */
-    buf = kmalloc(dir->blksize);
-    if (!buf)
-        return ENOMEM;
-
     /* allocate a disk inode: */
     ino = diskfs_imap_alloc(dir->sb);
     if (!ino)
@@ -1170,54 +2655,46 @@ int32_t diskfs_mkdir(inode_t *dir, char *name, int32_t mode) {
     inode->devid = 0;
     for (i = 0; i < DISKFS_PTRS; i++)
         inode->info.diskfs.ptr[i] = 0;
+    inode->info.diskfs.flags = 0;
+    if (((diskfs_sb_t *) dir->sb->disksb)->revision >= QUAFS_REVISION_EXTENTS)
+        ext_init(inode);
 
     /* update the inode: */
     diskfs_update_inode(inode);
 
-    /* insert "dot" and "dotdot": */
-    for (i = 0; i < inode->blksize; i++)
-        ((char *) buf)[i] = 0;
-    buf[0].ino = inode->ino;
-    buf[0].name[0] = '.';
-    buf[0].name[1] = 0;
-    buf[1].ino = dir->ino;
-    buf[1].name[0] = '.';
-    buf[1].name[1] = '.';
-    buf[1].name[2] = 0;
-    diskfs_write_fileblk(inode, 0, buf);
-
-    /* insert a new entry in "dir": */
-    dirents_per_block = inode->blksize/sizeof(diskfs_dirent_t);
-    i = 0; /* counter for blocks. */
-    j = 0; /* counter for dirents per block. */
-
-    /* loop on dirents. */
-    while(1) {
-        /* beginning of a new block? */
-        if (j == 0)
-            diskfs_read_fileblk(dir, i++, buf);
-
-        /* a free entry? */
-        if (buf[j].ino == 0 || buf[j].ino == 1) {
-            buf[j].ino = ino;
-            strcpy(buf[j].name, name);
-            diskfs_write_fileblk(dir, i-1, buf);
-            break;
+    if (((diskfs_sb_t *) dir->sb->disksb)->revision >= QUAFS_REVISION_DXDIR) {
+        /* new directories are indexed: */
+        err = dx_init(inode, dir->ino);
+    } else {
+        /* insert "dot" and "dotdot": */
+        buf = kmalloc(dir->blksize);
+        if (buf) {
+            for (i = 0; i < inode->blksize; i++)
+                ((char *) buf)[i] = 0;
+            buf[0].ino = inode->ino;
+            buf[0].name[0] = '.';
+            buf[0].name[1] = 0;
+            buf[1].ino = dir->ino;
+            buf[1].name[0] = '.';
+            buf[1].name[1] = '.';
+            buf[1].name[2] = 0;
+            diskfs_write_fileblk(inode, 0, buf);
+            kfree(buf);
+            err = ESUCCESS;
+        } else {
+            err = ENOMEM;
         }
-
-        /* next dirent: */
-        if (++j == dirents_per_block)
-            j = 0;
     }
 
+    /* insert a new entry in "dir": */
+    if (err || (err = dir_add(dir, name, ino)))
+        inode->ref = 0; /* iput() will free it. */
+
     /* put the inode: */
     iput(inode);
 
-    /* free the buffer: */
-    kfree(buf);
-
     /* done: */
-    return ESUCCESS;
+    return err;
 
 }
 
@@ -1227,12 +2704,8 @@ int32_t diskfs_mkdir(inode_t *dir, char *name, int32_t mode) {
 
 int32_t diskfs_rmdir(inode_t *dir, char *name) {
 
-    int32_t i, j;
     int32_t err;
     inode_t *inode;
-    diskfs_dirent_t *buf;
-    int32_t dirents_per_block;
-    pos_t entcount;
 
     /* dir must be directory: */
     if ((dir->mode & FT_MASK) != FT_DIR)
@@ -1253,75 +2726,16 @@ int32_t diskfs_rmdir(inode_t *dir, char *name) {
         return ENOTDIR;
     }
 
-    /* allocate buffer: */
-    buf = kmalloc(dir->blksize);
-    if (!buf) {
-        iput(inode);
-        return ENOMEM;
-    }
-
-    /* get count of entries in the target: */
-    dirents_per_block = dir->blksize/sizeof(diskfs_dirent_t);
-    i = 0; /* counter for blocks. */
-    j = 0; /* counter for dirents per block. */
-    entcount = 0;
-
-    /* loop on dirents. */
-    while(1) {
-        /* beginning of a new block? */
-        if (j == 0)
-            diskfs_read_fileblk(inode, i++, buf);
-
-        /* done? */
-        if (buf[j].ino == 0)
-            break;
-
-        /* valid entry */
-        if (buf[j].ino > 1)
-            entcount++;
-
-        /* next dirent: */
-        if (++j == dirents_per_block)
-            j = 0;
-    }
-
     /* directory is not empty? */
-    if (entcount > 2) {
+    if (err = dir_empty(inode)) {
         iput(inode);
-        kfree(buf);
-        return ENOTEMPTY;
+        return err;
     }
 
     /* remove entry from parent directory: */
-    i = 0; /* counter for blocks. */
-    j = 0; /* counter for dirents per block. */
-
-    /* loop on dirents. */
-    while(1) {
-        /* beginning of a new block? */
-        if (j == 0)
-            diskfs_read_fileblk(dir, i++, buf);
-
-        /* done? */
-        if (buf[j].ino == 0) {
-            iput(inode);
-            kfree(buf);
-            return ENOENT;
-        }
-
-        /* name matching? */
-        if (buf[j].ino > 1 && !strcmp(buf[j].name, name)) {
-
-            /* remove entry: */
-            buf[j].ino = 1;
-            diskfs_write_fileblk(dir, i-1, buf);
-            break;
-
-        }
-
-        /* next dirent: */
-        if (++j == dirents_per_block)
-            j = 0;
+    if (err = dir_remove(dir, name)) {
+        iput(inode);
+        return err;
     }
 
     /* decrease references: */
@@ -1331,9 +2745,6 @@ int32_t diskfs_rmdir(inode_t *dir, char *name) {
     /* put the inode: */
     iput(inode);
 
-    /* free the buffer: */
-    kfree(buf);
-
     /* done: */
     return ESUCCESS;
 
@@ -1351,28 +2762,73 @@ int32_t diskfs_truncate(inode_t *inode, pos_t length) {
     pos_t newsize;
     diskfs_blk_t last_blk;
     diskfs_blk_t start_blk;
+    page_t *page = NULL;
+    uint32_t poff;
+    int32_t spilled = 0, err;
 
     /* inode should be a regular file */
     if ((inode->mode & FT_MASK) != FT_REGULAR)
         return EINVAL;
 
+    /* no write-back while blocks go away: */
+    sb_lock(inode->sb);
+
+    /* too big to stay inside the inode? */
+    if (inline_enabled(inode) && length > DISKFS_INLINE_MAX) {
+        if (err = inline_spill(inode)) {
+            sb_unlock(inode->sb);
+            return err;
+        }
+        spilled = 1;
+    }
+
     /* initialize data */
     oldsize   = inode->size;
     newsize   = length;
     last_blk  = oldsize/inode->blksize;
     start_blk = newsize/inode->blksize + (newsize%inode->blksize ? 1 : 0);
 
+    /* the window is beyond the end now: */
+    pa_release(inode);
+
     /* delete truncated blocks: */
-    for (i = start_blk; i <= last_blk; i++)
-        diskfs_free_fileblk(inode, i);
+    if (inline_enabled(inode)) {
+        memset((uint8_t *) inode->info.diskfs.ptr + newsize, 0,
+               DISKFS_INLINE_MAX - newsize);
+    } else if (ext_enabled(inode)) {
+        ext_truncate(inode, start_blk);
+    } else {
+        for (i = start_blk; i <= last_blk; i++)
+            diskfs_free_fileblk(inode, i);
+    }
+
+    /* cached pages past the new end are no longer valid. the page
+     * the file now ends in may hold changes that are not written
+     * back yet, so it is kept, with the part past the end cleared
+     * (and written back too) in case the file grows again.
+     */
+    pcache_invalidate(inode->sb, inode->ino,
+                      (newsize + PAGE_SIZE - 1)/PAGE_SIZE);
+    if ((poff = newsize%PAGE_SIZE) && newsize < oldsize &&
+        (page = pcache_find(inode->sb, inode->ino, newsize/PAGE_SIZE))) {
+        memset(&page->data[poff], 0, PAGE_SIZE-poff);
+        pcache_dirty(page, poff, PAGE_SIZE-poff);
+        pcache_put(page);
+    }
 
     /* update file size... */
     inode->size = newsize;
     inode->blocks = (inode->size/inode->blksize) +
                     ((inode->size%inode->blksize) ? 1:0);
+    if (inline_enabled(inode))
+        inode->blocks = 0;
     diskfs_update_inode(inode);
 
     /* done: */
+    diskfs_flush(inode->sb);
+    sb_unlock(inode->sb);
+    if (page || spilled)
+        mark_dirty(inode);
     return ESUCCESS;
 
 }
@@ -1386,6 +2842,11 @@ int32_t diskfs_open(file_t *file) {
     /* mark buffer as empty: */
     file->info.diskfs.buf_empty = 1;
 
+    /* no read-ahead yet: */
+    file->info.diskfs.ra_next = 0;
+    file->info.diskfs.ra_size = 0;
+    file->info.diskfs.ra_end  = 0;
+
     /* done */
     return ESUCCESS;
 
@@ -1410,73 +2871,69 @@ int32_t diskfs_release(file_t *file) {
 /*                                 read()                                  */
 /***************************************************************************/
 
-int32_t diskfs_read(file_t *file, void *buf, int32_t size) {
+static int32_t read_at(file_t *file, void *buf, int32_t size, pos_t *pos) {
 
-    pos_t off = file->pos;
+    pos_t off = *pos;
     int32_t rem = size; /* remaining */
-    int32_t blksize = file->inode->blksize;
-    int32_t i, j;
+    inode_t *inode = file->inode;
+    diskfs_file_info_t *info = &file->info.diskfs;
+    page_t *page;
     pos_t tsize; /* size of the transfer */
-    int32_t count;
+    uint32_t first, end;
 
     if (size <= 0)
         return EINVAL; /* invalid */
 
-    if (off >= file->inode->size)
+    if (off >= inode->size)
         return 0; /* EOF. */
 
-    if (off + rem > file->inode->size)
-        rem = file->inode->size - off;
+    if (off + rem > inode->size)
+        rem = inode->size - off;
+
+    /* pages to be read: */
+    first = off/PAGE_SIZE;
+    end   = (off+rem+PAGE_SIZE-1)/PAGE_SIZE;
+
+    if (first == info->ra_next) {
+        /* sequential: keep ahead of the reader, with a window
+         * that grows every time the reader gets close to its end.
+         */
+        if (end + info->ra_size/2 >= info->ra_end) {
+            if ((info->ra_size *= 2) < DISKFS_RA_MIN)
+                info->ra_size = DISKFS_RA_MIN;
+            if (info->ra_size > DISKFS_RA_MAX)
+                info->ra_size = DISKFS_RA_MAX;
+            if (info->ra_end < first)
+                info->ra_end = first;
+            diskfs_read_ahead(inode, info->ra_end,
+                              end + info->ra_size - info->ra_end);
+            info->ra_end = end + info->ra_size;
+        }
+    } else {
+        /* random: just read the pages needed, in as few requests
+         * as possible.
+         */
+        info->ra_size = 0;
+        info->ra_end  = 0;
+        if (end - first > 1)
+            diskfs_read_ahead(inode, first, end - first);
+    }
+    info->ra_next = (off+rem)/PAGE_SIZE;
 
-    /* read block by block.. */
+    /* read page by page through the page cache.. */
     while(rem) {
 
-        /* try to not skip current block. */
-        if ((tsize = blksize-off%blksize) > rem)
+        /* try to not skip current page. */
+        if ((tsize = PAGE_SIZE-off%PAGE_SIZE) > rem)
             tsize = rem;
 
-        /* do the read! */
-        if (tsize == blksize) {
-            /* read the whole block! */
-            diskfs_read_fileblk(file->inode, off/blksize, buf);
-        } else {
-            /* we need to make use of the temp buffer... */
-            if (file->info.diskfs.buf_empty) {
-                /* allocate buffer: */
-                file->info.diskfs.buffer = kmalloc(blksize);
-                if (!(file->info.diskfs.buffer))
-                    return ENOMEM; /* no memory. */
-
-                /* load current cluster into the buffer. */
-                diskfs_read_fileblk(file->inode,
-                                    off/blksize,
-                                    file->info.diskfs.buffer);
-
-                /* update current buffered cluster value: */
-                file->info.diskfs.buf_blk = off/blksize;
-
-                /* buffer is not empty now: */
-                file->info.diskfs.buf_empty = 0;
-            } else if (file->info.diskfs.buf_blk != off/blksize) {
-                /* shame on the buffer! another cluster is loaded! */
-
-                /* load current cluster into the buffer. */
-                diskfs_read_fileblk(file->inode,
-                                    off/blksize,
-                                    file->info.diskfs.buffer);
-
-                /* update current buffered cluster value: */
-                file->info.diskfs.buf_blk = off/blksize;
-            }
-
-            /* now it is guaranteed that the buffer
-             * contains the desired cluster.
-             * copy data byte by byte.
-             */
-            for (i=off%blksize,j=0; i<off%blksize+tsize; i++,j++)
-                ((uint8_t *)buf)[j] = file->info.diskfs.buffer[i];
+        /* get the page: */
+        if (!(page = diskfs_get_page(inode, off/PAGE_SIZE, 1)))
+            break;
 
-        }
+        /* copy the data: */
+        memcpy(buf, &page->data[off%PAGE_SIZE], tsize);
+        pcache_put(page);
 
         /* update remaining: */
         rem -= tsize;
@@ -1485,91 +2942,112 @@ int32_t diskfs_read(file_t *file, void *buf, int32_t size) {
 
     }
 
-    /* how much has been transfered? */
-    count = off - file->pos;
-    file->pos = off;
+    /* nothing read? */
+    if (off == *pos)
+        return EIO;
+
+    /* update position: */
+    *pos = off;
     return ESUCCESS;
 
 }
 
+int32_t diskfs_read(file_t *file, void *buf, int32_t size) {
+    return read_at(file, buf, size, &file->pos);
+}
+
+/***************************************************************************/
+/*                                 pread()                                 */
+/***************************************************************************/
+
+int32_t diskfs_pread(file_t *file, void *buf, int32_t size, pos_t pos,
+                     int32_t *done) {
+
+    /* like read(), at "pos" and leaving file->pos alone */
+    pos_t off = pos;
+    int32_t err = read_at(file, buf, size, &off);
+
+    *done = (int32_t) (off - pos);
+    return err;
+
+}
+
 /***************************************************************************/
 /*                                 write()                                 */
 /***************************************************************************/
 
-int32_t diskfs_write(file_t *file, void *buf, int32_t size) {
+static int32_t write_at(file_t *file, void *buf, int32_t size, pos_t *pos) {
 
-    pos_t off = file->pos;
+    /* data goes to the page cache only, and is written back later
+     * by diskfs_sync(). blocks are allocated right away though, so
+     * that a full disk is reported here.
+     */
+    pos_t off = *pos;
     int32_t rem = size; /* remaining */
-    int32_t blksize = file->inode->blksize;
-    int32_t i, j;
+    inode_t *inode = file->inode;
+    int32_t blksize = inode->blksize;
+    page_t *page;
     pos_t tsize;
-    int32_t count;
+    pos_t blk;
+    uint32_t first, last, fresh_mask;
+    int32_t err = ESUCCESS, spilled = 0, fresh;
 
     if (size <= 0)
         return EINVAL; /* invalid */
 
-    if (off + rem > file->inode->size) {
-        /* update file size... */
-        file->inode->size = off+rem;
-        file->inode->blocks = (file->inode->size/blksize) +
-                              ((file->inode->size%blksize) ? 1:0);
-        diskfs_update_inode(file->inode);
+    /* no write-back while blocks are being allocated: */
+    sb_lock(inode->sb);
+
+    /* a tiny file stays inside its inode as long as it fits: */
+    if (inline_enabled(inode) && off+rem > DISKFS_INLINE_MAX) {
+        if (err = inline_spill(inode))
+            rem = 0;
+        else
+            spilled = 1;
     }
 
-    /* write block by block.. */
+    /* write page by page.. */
     while(rem) {
 
-        /* try to not skip current block. */
-        if ((tsize = blksize-off%blksize) > rem)
+        /* try to not skip current page. */
+        if ((tsize = PAGE_SIZE-off%PAGE_SIZE) > rem)
             tsize = rem;
 
-        /* do the write! */
-        if (tsize == blksize) {
-            /* write the whole block! */
-            diskfs_write_fileblk(file->inode, off/blksize, buf);
-        } else {
-            /* we need to make use of the temp buffer... */
-            if (file->info.diskfs.buf_empty) {
-                /* allocate buffer: */
-                file->info.diskfs.buffer = kmalloc(blksize);
-                if (!(file->info.diskfs.buffer))
-                    return ENOMEM; /* no memory. */
-
-                /* load current cluster into the buffer. */
-                diskfs_read_fileblk(file->inode,
-                                    off/blksize,
-                                    file->info.diskfs.buffer);
-
-                /* update current buffered cluster value: */
-                file->info.diskfs.buf_blk = off/blksize;
-
-                /* buffer is not empty now: */
-                file->info.diskfs.buf_empty = 0;
-            } else if (file->info.diskfs.buf_blk != off/blksize) {
-                /* shame on the buffer! another cluster is loaded! */
-
-                /* load current cluster into the buffer. */
-                diskfs_read_fileblk(file->inode,
-                                    off/blksize,
-                                    file->info.diskfs.buffer);
-
-                /* update current buffered cluster value: */
-                file->info.diskfs.buf_blk = off/blksize;
-            }
+        /* allocate the affected blocks (inline data has none),
+         * remembering which of them are new in this page:
+         */
+        fresh_mask = 0;
+        for (blk = off/blksize; blk*blksize < off+tsize; blk++) {
+            if (inline_enabled(inode))
+                continue;
+            if (!diskfs_alloc_fileblk(inode, blk, &fresh))
+                break;
+            if (fresh)
+                fresh_mask |= 1 << (blk % (PAGE_SIZE/blksize));
+        }
+        if (blk*blksize < off+tsize) {
+            err = ENOSPC;
+            break;
+        }
 
-            /* now it is guaranteed that the temp buffer
-             * contains the desired cluster.
-             * copy data byte by byte to the temp buffer.
-             */
-            for (i=off%blksize,j=0; i<off%blksize+tsize; i++,j++)
-                file->info.diskfs.buffer[i] = ((uint8_t *) buf)[j];
+        /* get the page, reading it first unless it is all overwritten */
+        if (!(page = diskfs_get_page(inode, off/PAGE_SIZE,
+                                     tsize != PAGE_SIZE))) {
+            err = ENOMEM;
+            break;
+        }
 
-            /* now write the block: */
-            diskfs_write_fileblk(file->inode,
-                                 off/blksize,
-                                 file->info.diskfs.buffer);
+        /* new blocks hold whatever was on the disk, clear them: */
+        for (first = 0; fresh_mask; first++, fresh_mask >>= 1)
+            if (fresh_mask & 1)
+                memset(&page->data[first*blksize], 0, blksize);
 
-        }
+        /* update the cached copy, the blocks it touched are dirty: */
+        memcpy(&page->data[off%PAGE_SIZE], buf, tsize);
+        first = (off%PAGE_SIZE)/blksize*blksize;
+        last  = (off%PAGE_SIZE+tsize+blksize-1)/blksize*blksize;
+        pcache_dirty(page, first, last-first);
+        pcache_put(page);
 
         /* update remaining: */
         rem -= tsize;
@@ -1578,10 +3056,47 @@ int32_t diskfs_write(file_t *file, void *buf, int32_t size) {
 
     }
 
-    /* how much has been transfered? */
-    count = off - file->pos;
-    file->pos = off;
-    return 0;
+    /* update file size, the inode is written back later: */
+    if (off > inode->size) {
+        inode->size = off;
+        inode->blocks = (inode->size/blksize) +
+                        ((inode->size%blksize) ? 1:0);
+        if (inline_enabled(inode))
+            inode->blocks = 0;
+        inode->info.diskfs.dirty = 1;
+    }
+
+    /* bitmaps, and the file itself if too much is waiting: */
+    diskfs_flush(inode->sb);
+    if (pcache_congested())
+        wb_inode(inode);
+    sb_unlock(inode->sb);
+    if (off != *pos || spilled)
+        mark_dirty(inode);
+
+    /* update position: */
+    *pos = off;
+    return err;
+
+}
+
+int32_t diskfs_write(file_t *file, void *buf, int32_t size) {
+    return write_at(file, buf, size, &file->pos);
+}
+
+/***************************************************************************/
+/*                                pwrite()                                 */
+/***************************************************************************/
+
+int32_t diskfs_pwrite(file_t *file, void *buf, int32_t size, pos_t pos,
+                      int32_t *done) {
+
+    /* like write(), at "pos" and leaving file->pos alone */
+    pos_t off = pos;
+    int32_t err = write_at(file, buf, size, &off);
+
+    *done = (int32_t) (off - pos);
+    return err;
 
 }
 
@@ -1601,12 +3116,15 @@ int32_t diskfs_seek(file_t *file, pos_t newpos) {
 /*                                 readdir()                               */
 /***************************************************************************/
 
-int32_t diskfs_readdir(file_t *file, dirent_t *dirent) {
+static diskfs_dirent_t *dir_next(file_t *file) {
 
-    /* loop on directory entries until find a proper entry, or null. */
+    /* loop on directory entries until find a proper entry, or null.
+     * file->pos is left at the entry, the caller steps over it.
+     */
     diskfs_blk_t blk;
     int32_t off;
     diskfs_dirent_t *ent;
+    int32_t dx = dx_enabled(file->inode);
 
     while(1) {
         /* calculate current block: */
@@ -1615,12 +3133,16 @@ int32_t diskfs_readdir(file_t *file, dirent_t *dirent) {
         /* calculate current offset inside the block: */
         off = file->pos % file->inode->blksize;
 
+        /* end of an indexed directory? */
+        if (dx && blk >= file->inode->blocks)
+            return NULL;
+
         /* buffer is ready? */
         if (file->info.diskfs.buf_empty) {
             /* allocate buffer: */
             file->info.diskfs.buffer = kmalloc(file->inode->blksize);
             if (!(file->info.diskfs.buffer))
-                return 0; /* no memory. */
+                return NULL; /* no memory. */
 
             /* load current cluster into the buffer. */
             diskfs_read_fileblk(file->inode,
@@ -1647,17 +3169,21 @@ int32_t diskfs_readdir(file_t *file, dirent_t *dirent) {
         /* get current entry: */
         ent = (diskfs_dirent_t *) &file->info.diskfs.buffer[off];
 
+        /* skip the index of an indexed directory: */
+        if (dx && ((!blk && off >= 2*sizeof(diskfs_dirent_t)) ||
+                   ((diskfs_dirent_t *) file->info.diskfs.buffer)->ino ==
+                   DISKFS_DX_MAGIC)) {
+            file->pos = (blk+1)*file->inode->blksize;
+            continue;
+        }
+
         /* done? */
-        if (ent->ino == 0)
-            return 0; /* no more entries. */
+        if (ent->ino == 0 && !dx)
+            return NULL; /* no more entries. */
 
         /* a proper entry? */
-        if (ent->ino > 1) {
-            dirent->ino = ent->ino;
-            strcpy(dirent->name, ent->name);
-            file->pos += sizeof(diskfs_dirent_t);
-            return 1;
-        }
+        if (ent->ino > 1)
+            return ent;
 
         /* just update pos and continue the loop: */
         file->pos += sizeof(diskfs_dirent_t);
@@ -1666,6 +3192,40 @@ int32_t diskfs_readdir(file_t *file, dirent_t *dirent) {
 
 }
 
+int32_t diskfs_readdir(file_t *file, dirent_t *dirent) {
+
+    /* read next entry */
+    diskfs_dirent_t *ent = dir_next(file);
+
+    if (!ent)
+        return 0;
+    dirent->ino = ent->ino;
+    strcpy(dirent->name, ent->name);
+    file->pos += sizeof(diskfs_dirent_t);
+    return 1;
+
+}
+
+/***************************************************************************/
+/*                               getdents()                                */
+/***************************************************************************/
+
+int32_t diskfs_getdents(file_t *file, void *buf, int32_t size,
+                        int32_t *done) {
+
+    /* pack entries as long as they fit */
+    diskfs_dirent_t *ent;
+
+    *done = 0;
+    while ((ent = dir_next(file)) &&
+           dirent_pack(buf, size, done, ent->ino, ent->name))
+        file->pos += sizeof(diskfs_dirent_t);
+
+    /* not even one entry fits? */
+    return (ent && !*done) ? EINVAL : ESUCCESS;
+
+}
+
 /***************************************************************************/
 /*                                 ioctl()                                 */
 /***************************************************************************/
@@ -1747,7 +3307,12 @@ fsd_t diskfs_t = {
     /* read:         */ diskfs_read,
     /* write:        */ diskfs_write,
     /* seek:         */ diskfs_seek,
+    /* pread:        */ diskfs_pread,
+    /* pwrite:       */ diskfs_pwrite,
     /* readdir:      */ diskfs_readdir,
-    /* ioctl:        */ diskfs_ioctl
+    /* getdents:     */ diskfs_getdents,
+    /* ioctl:        */ diskfs_ioctl,
+    /* poll:         */ NULL,
+    /* sync:         */ diskfs_sync
 
 };
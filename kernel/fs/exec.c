@@ -253,8 +253,7 @@ int32_t execve(char *filename, char *argv[], char *envp[]) {
     /* ========================= */
     for (i = 0; i < header.e_phnum; i++) {
         pos_t newpos = (pos_t)(header.e_phoff+(header.e_phentsize*i));
-        file_seek(file, newpos, NULL, SEEK_SET);
-        file_read(file, &pheader, sizeof(pheader), &done);
+        file_pread(file, &pheader, sizeof(pheader), newpos, &done);
 
         if (pheader.p_type != PT_LOAD)
             continue;
@@ -268,9 +267,7 @@ int32_t execve(char *filename, char *argv[], char *envp[]) {
         mmap(vaddr, memsz, MMAP_TYPE_ANONYMOUS, 0, 0, 0);
 
         /* load data from the file to the region: */
-        newpos = offset;
-        file_seek(file, newpos, NULL, SEEK_SET);
-        file_read(file, (char *) vaddr, filesz, &done);
+        file_pread(file, (char *) vaddr, filesz, (pos_t) offset, &done);
 
         /* update heap start: */
         if (vaddr + memsz > curproc->umem.heap_start)
@@ -37,6 +37,8 @@ void fs_init() {
 
     /* initialize caches: */
     icache_init();
+    pcache_init();
+    dcache_init();
     
     /* mount tmpfs to the root. */
     mount("", "/", "tmpfs", 0, NULL);
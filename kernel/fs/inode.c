@@ -27,78 +27,130 @@
  */
 
 #include <arch/type.h>
+#include <arch/spinlock.h>
 #include <sys/mm.h>
 #include <sys/fs.h>
 #include <sys/semaphore.h>
+#include <sys/slab.h>
+#include <sys/pcache.h>
+#include <sys/icache.h>
 #include <lib/linkedlist.h>
 
-#define IHASH_COUNT     0x40000
+/* inodes in memory, hashed by (super block, inode number). when the
+ * last handle of an inode is put, the inode stays in the table and
+ * goes to the end of an LRU list, so that opening the file again
+ * doesn't read it from disk. the oldest unused inodes are dropped
+ * when there are more than ICACHE_MAX of them or memory is short.
+ * inodes that are gone from the filesystem are freed right away.
+ *
+ * sem serializes iget() and iput(), which call the filesystem and
+ * may sleep. icache_lock protects the table and the LRU list, so
+ * that unused inodes can be dropped from anywhere.
+ */
+static inode_t *htable[ICACHE_HASH];
+static inode_t *lru_first = NULL; /* least recently used. */
+static inode_t *lru_last  = NULL; /* most recently used.  */
+static slab_cache_t inode_slab;
+static spinlock_t icache_lock;
+static semaphore_t sem;
 
-typedef _linkedlist(inode_t) ill; /* inode linked list. */
+/* statistics */
+static uint32_t inodes    = 0;
+static uint32_t unused    = 0;
+static uint32_t hits      = 0;
+static uint32_t misses    = 0;
+static uint32_t reclaims  = 0;
+
+/***************************************************************************/
+/*                              Helpers                                    */
+/***************************************************************************/
+
+static uint32_t hashfn(super_block_t *sb, ino_t ino) {
+    /* mix both keys, then keep the top bits of the product */
+    uint32_t key = (((uint32_t) sb >> 4) * 2246822519U) ^ ino;
+    return (key * 2654435761U) >> (32 - ICACHE_BITS);
+}
 
-ill *ihashtable[IHASH_COUNT]; /* hash table of inode. */
+static inode_t *lookup(super_block_t *sb, ino_t ino) {
+    inode_t *p = htable[hashfn(sb, ino)];
+    while (p && (p->sb != sb || p->ino != ino))
+        p = p->next;
+    return p;
+}
 
-static semaphore_t sem;
+static void hash_add(inode_t *p) {
+    uint32_t h = hashfn(p->sb, p->ino);
+    p->next = htable[h];
+    htable[h] = p;
+}
 
-void icache_init() {
-    /* initalize the hash table */
-    int32_t i;
-    for (i = 0; i < IHASH_COUNT; i++)
-        ihashtable[i] = NULL;
-    sema_init(&sem, 1);
+static void hash_del(inode_t *p) {
+    inode_t **q = &htable[hashfn(p->sb, p->ino)];
+    while (*q != p)
+        q = &(*q)->next;
+    *q = p->next;
+}
+
+static void lru_add(inode_t *p) {
+    p->lru_next = NULL;
+    p->lru_prev = lru_last;
+    if (lru_last)
+        lru_last->lru_next = p;
+    else
+        lru_first = p;
+    lru_last = p;
+    unused++;
 }
 
-int32_t hash(super_block_t *sb, ino_t ino) {
-    /* the hashing function */
-    uint32_t isb = (uint32_t) sb;
-    int32_t  ret = 0;
-    ret += (ino>> 0) & 0xFFFF;
-    ret += (ino>>16) & 0xFFFF;
-    ret += (isb>> 0) & 0xFFFF;
-    ret += (isb>>16) & 0xFFFF;
-    return ret;
+static void lru_del(inode_t *p) {
+    if (p->lru_prev)
+        p->lru_prev->lru_next = p->lru_next;
+    else
+        lru_first = p->lru_next;
+    if (p->lru_next)
+        p->lru_next->lru_prev = p->lru_prev;
+    else
+        lru_last = p->lru_prev;
+    unused--;
 }
 
+/***************************************************************************/
+/*                              Interface                                  */
+/***************************************************************************/
+
 inode_t *iget(super_block_t *sb, ino_t ino) {
 
     /* get the inode_t structure. */
-    int32_t h;
     inode_t *p;
+    int32_t status;
 
     /* enter region */
     sema_down(&sem);
 
-    /* get the hashing value */
-    h = hash(sb, ino);
-
-    if (ihashtable[h] == NULL) {
-        /* allocate the linkedlist. */
-        if (!(ihashtable[h] = kmalloc(sizeof(ill)))) {
-            sema_up(&sem);
-            return NULL;
-        }
-
-        /* initialize the linked list. */
-        linkedlist_init(ihashtable[h]);
+    /* look up the table, an unused inode is in use again: */
+    status = spinlock_acquire_irqsave(&icache_lock);
+    if (p = lookup(sb, ino)) {
+        if (!p->icount)
+            lru_del(p);
+        hits++;
+    } else {
+        misses++;
     }
+    spinlock_release_irqrestore(&icache_lock, status);
 
-    /* loop on the linked list until we find the inode: */
-    p = ihashtable[h]->first;
-    while(p && (p->sb != sb || p->ino != ino))
-        p = p->next;
-
-    /* the desired inode doesn't exist? allocate it! */
+    /* the desired inode isn't in memory? allocate it! */
     if (!p) {
 
+        /* make room first if memory is short: */
+        if (pcache_low())
+            icache_shrink(ICACHE_BATCH);
+
         /* allocate: */
-        if (!(p = kmalloc(sizeof(inode_t)))) {
+        if (!(p = slab_alloc(&inode_slab))) {
             sema_up(&sem);
             return NULL;
         }
 
-        /* add to the linked list */
-        linkedlist_addlast(ihashtable[h], p);
-
         /* initialize: */
         p->sb  = sb;
         p->ino = ino;
@@ -109,6 +161,12 @@ inode_t *iget(super_block_t *sb, ino_t ino) {
         /* initialized sma */
         linkedlist_init(&(p->sma));
 
+        /* add to the hash table */
+        status = spinlock_acquire_irqsave(&icache_lock);
+        hash_add(p);
+        inodes++;
+        spinlock_release_irqrestore(&icache_lock, status);
+
         /* read from disk: */
         sb->fsdriver->read_inode(p);
 
@@ -129,9 +187,23 @@ inode_t *iget(super_block_t *sb, ino_t ino) {
 
 }
 
+inode_t *igrab(inode_t *p) {
+
+    /* take another reference to an inode we already hold,
+     * without going through the hash table.
+     */
+    sema_down(&sem);
+    p->icount++;
+    p->sb->icount++;
+    sema_up(&sem);
+    return p;
+
+}
+
 void iput(inode_t *p) {
 
-    int32_t h;
+    inode_t *dead = NULL;
+    int32_t status;
 
     /* detect bugs */
     if (!p) {
@@ -154,22 +226,127 @@ void iput(inode_t *p) {
         return;
     }
 
-    /* get the hash value: */
-    h = hash(p->sb, p->ino); /* get the hashing value */
+    status = spinlock_acquire_irqsave(&icache_lock);
+    if (p->ref) {
+        /* keep it for later, maybe dropping the oldest one: */
+        lru_add(p);
+        if (unused > ICACHE_MAX) {
+            dead = lru_first;
+            lru_del(dead);
+            reclaims++;
+        }
+    } else {
+        /* the filesystem has freed it: */
+        dead = p;
+    }
+    if (dead) {
+        hash_del(dead);
+        inodes--;
+    }
+    spinlock_release_irqrestore(&icache_lock, status);
+
+    /* leave critical region */
+    sema_up(&sem);
+
+    /* unallocate the inode structure */
+    if (dead)
+        slab_free(&inode_slab, dead);
 
-    /* remove from linked list: */
-    linkedlist_aremove(ihashtable[h], p);
+}
 
-    /* linked list is free? */
-    if (!(ihashtable[h]->count)) {
-        kfree(ihashtable[h]);
-        ihashtable[h] = NULL;
+void icache_purge(super_block_t *sb) {
+
+    /* drop the unused inodes of sb, which is being unmounted. */
+    inode_t *p, *next, *dead = NULL;
+    int32_t status;
+
+    status = spinlock_acquire_irqsave(&icache_lock);
+    for (p = lru_first; p; p = next) {
+        next = p->lru_next;
+        if (p->sb == sb) {
+            lru_del(p);
+            hash_del(p);
+            inodes--;
+            p->next = dead;
+            dead = p;
+        }
     }
+    spinlock_release_irqrestore(&icache_lock, status);
 
-    /* unallocate the inode structure */
-    kfree(p);
+    while (p = dead) {
+        dead = p->next;
+        slab_free(&inode_slab, p);
+    }
 
-    /* leave critical region */
-    sema_up(&sem);
+}
+
+uint32_t icache_shrink(uint32_t count) {
+
+    /* give up to count unused inodes back to the system */
+    inode_t *p, *dead = NULL;
+    int32_t status;
+    uint32_t done = 0;
+
+    status = spinlock_acquire_irqsave(&icache_lock);
+    while (done < count && (p = lru_first)) {
+        lru_del(p);
+        hash_del(p);
+        inodes--;
+        reclaims++;
+        p->next = dead;
+        dead = p;
+        done++;
+    }
+    spinlock_release_irqrestore(&icache_lock, status);
+
+    while (p = dead) {
+        dead = p->next;
+        slab_free(&inode_slab, p);
+    }
+    return done;
+
+}
+
+/***************************************************************************/
+/*                              sysfs file                                 */
+/***************************************************************************/
+
+static char *icache_stats(uint32_t *size) {
+    uint32_t total = hits + misses;
+    char *buf = kmalloc(256);
+    *size = 0;
+    *size += sputs(&buf[*size],
+                   "inodes unused slabs hits misses reclaims hit_ratio\n");
+    *size += sputd(&buf[*size], inodes);
+    *size += sputs(&buf[*size], " ");
+    *size += sputd(&buf[*size], unused);
+    *size += sputs(&buf[*size], " ");
+    *size += sputd(&buf[*size], inode_slab.slabs);
+    *size += sputs(&buf[*size], " ");
+    *size += sputd(&buf[*size], hits);
+    *size += sputs(&buf[*size], " ");
+    *size += sputd(&buf[*size], misses);
+    *size += sputs(&buf[*size], " ");
+    *size += sputd(&buf[*size], reclaims);
+    *size += sputs(&buf[*size], " ");
+    *size += sputd(&buf[*size], total ? (uint32_t)
+                                ((uint64_t) hits*100/total) : 0);
+    *size += sputs(&buf[*size], "%\n");
+    buf[*size] = 0;
+    return buf;
+}
+
+void icache_init() {
+
+    /* initalize the hash table */
+    int32_t i;
+    for (i = 0; i < ICACHE_HASH; i++)
+        htable[i] = NULL;
+    slab_init(&inode_slab, sizeof(inode_t));
+    spinlock_init(&icache_lock);
+    sema_init(&sem, 1);
+
+    /* register in sysfs */
+    sysfs_reg("icache", icache_stats);
 
 }
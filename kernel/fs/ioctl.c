@@ -39,6 +39,7 @@ int32_t file_ioctl(file_t *file, uint32_t cmd, void *data) {
     switch(file->inode->mode & FT_MASK) {
         case FT_REGULAR:
         case FT_DIR:
+        case FT_FIFO:
         return file->inode->sb->fsdriver->ioctl(file, cmd, data);
 
         case FT_SPECIAL:
@@ -0,0 +1,899 @@
+/*
+ *        +----------------------------------------------------------+
+ *        | +------------------------------------------------------+ |
+ *        | |  Quafios Kernel 2.0.1.                               | |
+ *        | |  -> ISO9660 filesystem (read-only).                  | |
+ *        | +------------------------------------------------------+ |
+ *        +----------------------------------------------------------+
+ *
+ * This file is part of Quafios 2.0.1 source code.
+ * Copyright (C) 2015  Mostafa Abd El-Aziz Mohamed.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Quafios.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Visit http://www.quafios.com/ for contact information.
+ *
+ */
+
+#include <arch/type.h>
+#include <arch/page.h>
+#include <lib/string.h>
+#include <sys/fs.h>
+#include <sys/mm.h>
+#include <sys/pcache.h>
+#include <storage/disk.h>
+#include <fs/iso9660.h>
+
+/* inode numbers are byte offsets of directory records on the volume.
+ * a directory is known by its "." record (the start of its extent),
+ * so that every name of it leads to the same inode. a regular file
+ * is known by its record in the directory that holds it.
+ */
+#define SECT_INO(lba)   ((ino_t) (lba)*ISO9660_SECTOR)
+
+/***************************************************************************/
+/*                              read_super()                               */
+/***************************************************************************/
+
+static int32_t rr_parse(super_block_t *sb, iso9660_dirrec_t *rec,
+                        uint32_t skip, iso9660_rr_t *rr);
+
+super_block_t *iso9660_read_super(device_t *dev) {
+
+    /* definitions */
+    super_block_t *sb;
+    iso9660_pvd_t *pvd;
+    iso9660_dirrec_t *root;
+    uint8_t *buf, *su;
+    uint32_t i;
+
+    /* allocate superblock: */
+    sb = kmalloc(sizeof(super_block_t));
+    if (!sb)
+        return sb;
+
+    /* a buffer for volume descriptors: */
+    buf = kmalloc(ISO9660_SECTOR);
+    if (!buf) {
+        kfree(sb);
+        return NULL;
+    }
+
+    /* look for the primary volume descriptor: */
+    pvd = (iso9660_pvd_t *) buf;
+    for (i = 0; i < ISO9660_VD_MAX; i++) {
+        if (blkdev_read(dev, (uint64_t) (ISO9660_VD_START+i)*ISO9660_SECTOR,
+                        ISO9660_SECTOR, (char *) buf) ||
+            pvd->id[0] != 'C' || pvd->id[1] != 'D' || pvd->id[2] != '0' ||
+            pvd->id[3] != '0' || pvd->id[4] != '1' ||
+            pvd->type == ISO9660_VD_END) {
+            i = ISO9660_VD_MAX;
+            break;
+        }
+        if (pvd->type == ISO9660_VD_PRIMARY)
+            break;
+    }
+    if (i == ISO9660_VD_MAX || pvd->block_size != ISO9660_SECTOR) {
+        /* not an ISO9660 volume. */
+        kfree(buf);
+        kfree(sb);
+        return NULL;
+    }
+
+    /* filesystem driver: */
+    sb->fsdriver = &iso9660_t;
+
+    /* device structure: */
+    sb->dev = dev;
+
+    /* no on-disk superblock is kept: */
+    sb->disksb = NULL;
+
+    /* logical block size: */
+    sb->blksize = ISO9660_SECTOR;
+
+    /* root inode number: */
+    root = (iso9660_dirrec_t *) pvd->root;
+    sb->root_ino = SECT_INO(root->lba + root->ext_len);
+
+    /* no inodes are open: */
+    sb->icount = 0;
+
+    /* mounts: */
+    sb->mounts = 1;
+
+    /* Rock Ridge? the "." record of the root directory starts its
+     * system use area with an "SP" entry if SUSP is in use.
+     */
+    sb->info.iso9660.rr = 0;
+    sb->info.iso9660.rr_skip = 0;
+    if (!blkdev_read(dev, (uint64_t) sb->root_ino, ISO9660_SECTOR,
+                     (char *) buf)) {
+        root = (iso9660_dirrec_t *) buf;
+        su = &buf[33 + root->id_len + !(root->id_len & 1)];
+        if (root->len >= ISO9660_DIRREC_MIN && su + 7 <= &buf[root->len] &&
+            su[0] == 'S' && su[1] == 'P' && su[4] == 0xBE && su[5] == 0xEF) {
+            sb->info.iso9660.rr = 1;
+            sb->info.iso9660.rr_skip = su[6];
+        }
+    }
+
+    /* done: */
+    kfree(buf);
+    return sb;
+
+}
+
+/***************************************************************************/
+/*                             write_super()                               */
+/***************************************************************************/
+
+int32_t iso9660_write_super(super_block_t *sb) {
+
+    /* read-only, nothing to write. */
+    return ESUCCESS;
+
+}
+
+/***************************************************************************/
+/*                              put_super()                                */
+/***************************************************************************/
+
+int32_t iso9660_put_super(super_block_t *sb) {
+
+    /* all file descriptors must be closed first: */
+    if (sb->icount)
+        return EBUSY;
+
+    /* drop cached file pages: */
+    pcache_invalidate(sb, PCACHE_ANY, 0);
+
+    /* unallocate super block: */
+    kfree(sb);
+
+    /* done: */
+    return ESUCCESS;
+
+}
+
+/***************************************************************************/
+/*                               Rock Ridge                                */
+/***************************************************************************/
+
+static uint32_t get32(uint8_t *p) {
+
+    /* little endian half of a both-endian number: */
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t) p[3] << 24);
+
+}
+
+static int32_t rr_parse(super_block_t *sb, iso9660_dirrec_t *rec,
+                        uint32_t skip, iso9660_rr_t *rr) {
+
+    /* walk through the SUSP entries of a directory record and its
+     * continuation areas, picking up the Rock Ridge ones we use.
+     * rr->name must point at a NAME_MAX+1 buffer already.
+     */
+    uint8_t *p, *end, *ce = NULL;
+    uint32_t ce_lba = 0, ce_off = 0, ce_len = 0, n, hops = 0;
+    int32_t name_done = 0;
+
+    rr->namelen = 0;
+    rr->nlink   = 0;
+    rr->cl      = 0;
+    rr->pl      = 0;
+    rr->re      = 0;
+
+    /* the system use area comes after the identifier: */
+    p   = (uint8_t *) rec->id + rec->id_len + !(rec->id_len & 1) + skip;
+    end = (uint8_t *) rec + rec->len;
+
+    while (1) {
+
+        /* entries of the current area: */
+        while (p + 4 <= end && p[2] >= 4 && p + p[2] <= end) {
+            if (p[0] == 'N' && p[1] == 'M' && p[2] >= 5 && !name_done) {
+                /* alternate name, maybe in pieces: */
+                if (!(p[4] & 0x06)) {
+                    n = p[2] - 5;
+                    if (n > NAME_MAX - rr->namelen)
+                        n = NAME_MAX - rr->namelen;
+                    memcpy(&rr->name[rr->namelen], &p[5], n);
+                    rr->namelen += n;
+                }
+                if (!(p[4] & 0x01))
+                    name_done = 1;
+            } else if (p[0] == 'P' && p[1] == 'X' && p[2] >= 20) {
+                rr->nlink = get32(&p[12]);
+            } else if (p[0] == 'C' && p[1] == 'E' && p[2] >= 28) {
+                ce_lba = get32(&p[4]);
+                ce_off = get32(&p[12]);
+                ce_len = get32(&p[20]);
+            } else if (p[0] == 'C' && p[1] == 'L' && p[2] >= 12) {
+                rr->cl = get32(&p[4]);
+            } else if (p[0] == 'P' && p[1] == 'L' && p[2] >= 12) {
+                rr->pl = get32(&p[4]);
+            } else if (p[0] == 'R' && p[1] == 'E') {
+                rr->re = 1;
+            } else if (p[0] == 'S' && p[1] == 'T') {
+                break;
+            }
+            p += p[2];
+        }
+
+        /* go on in a continuation area? */
+        if (!ce_len || hops++ == ISO9660_CE_MAX ||
+            ce_off >= ISO9660_SECTOR)
+            break;
+        if (ce_len > ISO9660_SECTOR - ce_off)
+            ce_len = ISO9660_SECTOR - ce_off;
+        if (!ce && !(ce = kmalloc(ISO9660_SECTOR)))
+            break;
+        if (blkdev_read(sb->dev, (uint64_t) ce_lba*ISO9660_SECTOR + ce_off,
+                        ce_len, (char *) ce))
+            break;
+        p   = ce;
+        end = ce + ce_len;
+        ce_len = 0;
+
+    }
+
+    /* done: */
+    if (ce)
+        kfree(ce);
+    rr->name[rr->namelen] = 0;
+    return ESUCCESS;
+
+}
+
+/***************************************************************************/
+/*                              read_inode()                               */
+/***************************************************************************/
+
+int32_t iso9660_read_inode(inode_t *inode) {
+
+    /* definitions */
+    super_block_t *sb = inode->sb;
+    iso9660_dirrec_t *rec;
+    iso9660_rr_t rr;
+    uint8_t *buf;
+    uint32_t off = inode->ino % ISO9660_SECTOR;
+
+    /* whatever happens, the inode is not to be deleted on iput(): */
+    inode->ref     = 1;
+    inode->mode    = FT_REGULAR;
+    inode->devid   = 0;
+    inode->size    = 0;
+    inode->blksize = ISO9660_SECTOR;
+    inode->blocks  = 0;
+    inode->info.iso9660.lba = 0;
+
+    /* allocate a buffer: */
+    buf = kmalloc(ISO9660_SECTOR + NAME_MAX + 1);
+    if (!buf)
+        return ENOMEM;
+
+    /* read the sector holding the record: */
+    if (blkdev_read(sb->dev, (uint64_t) inode->ino - off, ISO9660_SECTOR,
+                    (char *) buf)) {
+        kfree(buf);
+        return EIO;
+    }
+    rec = (iso9660_dirrec_t *) &buf[off];
+    if (rec->len < ISO9660_DIRREC_MIN || off + rec->len > ISO9660_SECTOR) {
+        kfree(buf);
+        return EIO;
+    }
+
+    /* extract info: */
+    inode->mode    = (rec->flags & ISO9660_FLAG_DIR) ? FT_DIR : FT_REGULAR;
+    inode->size    = rec->size;
+    inode->blocks  = (rec->size + ISO9660_SECTOR - 1)/ISO9660_SECTOR;
+    inode->info.iso9660.lba = rec->lba + rec->ext_len;
+
+    /* link count: */
+    if (sb->info.iso9660.rr) {
+        rr.name = (char *) &buf[ISO9660_SECTOR];
+        rr_parse(sb, rec, sb->info.iso9660.rr_skip, &rr);
+        if (rr.nlink)
+            inode->ref = rr.nlink;
+    }
+
+    /* done */
+    kfree(buf);
+    return ESUCCESS;
+
+}
+
+/***************************************************************************/
+/*                             update_inode()                              */
+/***************************************************************************/
+
+int32_t iso9660_update_inode(inode_t *inode) {
+
+    /* read-only, nothing to update. */
+    return ESUCCESS;
+
+}
+
+/***************************************************************************/
+/*                               put_inode()                               */
+/***************************************************************************/
+
+int32_t iso9660_put_inode(inode_t *inode) {
+
+    /* nothing is ever freed on the volume. */
+    return ESUCCESS;
+
+}
+
+/***************************************************************************/
+/*                              directories                                */
+/***************************************************************************/
+
+static iso9660_dirrec_t *dir_rec(inode_t *dir, pos_t *pos, uint8_t *buf,
+                                 int32_t *buf_sect) {
+
+    /* the record at *pos or after it, NULL at the end. records do
+     * not cross sectors, the rest of a sector after the last one is
+     * zero padding. buf holds sector *buf_sect of the directory.
+     */
+    iso9660_dirrec_t *rec;
+    uint32_t sect, off;
+
+    while (*pos < dir->size) {
+
+        sect = *pos / ISO9660_SECTOR;
+        off  = *pos % ISO9660_SECTOR;
+
+        /* no room for a record here? */
+        if (off > ISO9660_SECTOR - ISO9660_DIRREC_MIN) {
+            *pos = (pos_t) (sect+1)*ISO9660_SECTOR;
+            continue;
+        }
+
+        /* load the sector: */
+        if (*buf_sect != sect) {
+            if (blkdev_read(dir->sb->dev,
+                            (uint64_t) (dir->info.iso9660.lba+sect)*
+                            ISO9660_SECTOR, ISO9660_SECTOR, (char *) buf))
+                return NULL;
+            *buf_sect = sect;
+        }
+
+        /* padding? */
+        rec = (iso9660_dirrec_t *) &buf[off];
+        if (rec->len < ISO9660_DIRREC_MIN || off + rec->len > ISO9660_SECTOR) {
+            *pos = (pos_t) (sect+1)*ISO9660_SECTOR;
+            continue;
+        }
+
+        /* a record: */
+        return rec;
+
+    }
+
+    /* no more records: */
+    return NULL;
+
+}
+
+static int32_t rec_entry(inode_t *dir, iso9660_dirrec_t *rec, pos_t pos,
+                         char *name, ino_t *ino) {
+
+    /* name and inode number of the directory entry "rec" found
+     * at "pos" in "dir". returns 0 for records that are not listed.
+     */
+    super_block_t *sb = dir->sb;
+    iso9660_rr_t rr;
+    uint32_t i, len;
+
+    /* Rock Ridge entries: */
+    rr.name = name;
+    rr.namelen = 0;
+    rr.cl = rr.pl = rr.re = 0;
+    if (sb->info.iso9660.rr)
+        rr_parse(sb, rec, sb->info.iso9660.rr_skip, &rr);
+
+    /* parts of files bigger than 4GB, or directories moved away
+     * from their place (they are found through CL):
+     */
+    if ((rec->flags & ISO9660_FLAG_MULTI) || rr.re)
+        return 0;
+
+    if (rec->id_len == 1 && rec->id[0] == 0) {
+        /* "." */
+        strcpy(name, ".");
+        *ino = dir->ino;
+    } else if (rec->id_len == 1 && rec->id[0] == 1) {
+        /* ".." */
+        strcpy(name, "..");
+        *ino = SECT_INO(rr.pl ? rr.pl : rec->lba + rec->ext_len);
+    } else {
+        /* name, as is in Rock Ridge, or cut down from "NAME.EXT;1": */
+        if (!rr.namelen) {
+            len = rec->id_len;
+            for (i = 0; i < len; i++)
+                if (rec->id[i] == ';')
+                    len = i;
+            if (len > 1 && rec->id[len-1] == '.')
+                len--;
+            for (i = 0; i < len; i++)
+                name[i] = (rec->id[i] >= 'A' && rec->id[i] <= 'Z') ?
+                          rec->id[i] - 'A' + 'a' : rec->id[i];
+            name[len] = 0;
+        }
+        if (rr.cl)
+            *ino = SECT_INO(rr.cl);
+        else if (rec->flags & ISO9660_FLAG_DIR)
+            *ino = SECT_INO(rec->lba + rec->ext_len);
+        else
+            *ino = SECT_INO(dir->info.iso9660.lba) + (ino_t) pos;
+    }
+
+    /* listed: */
+    return 1;
+
+}
+
+/***************************************************************************/
+/*                                lookup()                                 */
+/***************************************************************************/
+
+int32_t iso9660_lookup(inode_t *dir, char *name, inode_t **ret) {
+
+    iso9660_dirrec_t *rec;
+    uint8_t *buf;
+    char *ent;
+    int32_t buf_sect = -1;
+    pos_t pos = 0;
+    ino_t ino;
+
+    /* buffers for a sector and a name: */
+    buf = kmalloc(ISO9660_SECTOR + NAME_MAX + 1);
+    if (!buf)
+        return ENOMEM;
+    ent = (char *) &buf[ISO9660_SECTOR];
+
+    /* search the directory: */
+    while ((rec = dir_rec(dir, &pos, buf, &buf_sect)) &&
+           !(rec_entry(dir, rec, pos, ent, &ino) && !strcmp(ent, name)))
+        pos += rec->len;
+    kfree(buf);
+    if (!rec)
+        return ENOENT;
+
+    /* get the inode: */
+    if (ret) {
+        *ret = (inode_t *) iget(dir->sb, ino);
+        if (!(*ret))
+            return ENOMEM;
+    }
+
+    /* done: */
+    return ESUCCESS;
+
+}
+
+/***************************************************************************/
+/*                        mknod(), link(), unlink()..                      */
+/***************************************************************************/
+
+int32_t iso9660_mknod(inode_t *dir, char *name, int32_t mode, int32_t devid) {
+    return EREADONLY;
+}
+
+int32_t iso9660_link(inode_t *inode, inode_t *dir, char *name) {
+    return EREADONLY;
+}
+
+int32_t iso9660_unlink(inode_t *dir, char *name) {
+    return EREADONLY;
+}
+
+int32_t iso9660_mkdir(inode_t *dir, char *name, int32_t mode) {
+    return EREADONLY;
+}
+
+int32_t iso9660_rmdir(inode_t *dir, char *name) {
+    return EREADONLY;
+}
+
+int32_t iso9660_truncate(inode_t *inode, pos_t length) {
+    return EREADONLY;
+}
+
+/***************************************************************************/
+/*                                 open()                                  */
+/***************************************************************************/
+
+int32_t iso9660_open(file_t *file) {
+
+    /* no directory sector is buffered: */
+    file->info.iso9660.buffer   = NULL;
+    file->info.iso9660.buf_sect = -1;
+
+    /* no read-ahead yet: */
+    file->info.iso9660.ra_next = 0;
+    file->info.iso9660.ra_size = 0;
+    file->info.iso9660.ra_end  = 0;
+
+    /* done */
+    return ESUCCESS;
+
+}
+
+/***************************************************************************/
+/*                                release()                                */
+/***************************************************************************/
+
+int32_t iso9660_release(file_t *file) {
+
+    /* free the buffer: */
+    if (file->info.iso9660.buffer)
+        kfree(file->info.iso9660.buffer);
+
+    /* done */
+    return ESUCCESS;
+
+}
+
+/***************************************************************************/
+/*                               get_page()                                */
+/***************************************************************************/
+
+static int32_t read_page(inode_t *inode, page_t *page) {
+
+    /* fill in a page of file data, straight from the extent: */
+    pos_t off = (pos_t) page->index*PAGE_SIZE;
+    uint32_t valid = PAGE_SIZE, bytes = PAGE_SIZE;
+
+    if (off >= inode->size) {
+        memset(page->data, 0, PAGE_SIZE);
+        return ESUCCESS;
+    }
+    if (off + PAGE_SIZE > inode->size) {
+        valid = inode->size - off;
+        bytes = (valid + ISO9660_SECTOR - 1)/ISO9660_SECTOR*ISO9660_SECTOR;
+        memset(&page->data[valid], 0, PAGE_SIZE - valid); /* beyond EOF */
+    }
+    return dev_read(inode->sb->dev,
+                    (uint64_t) inode->info.iso9660.lba*ISO9660_SECTOR + off,
+                    bytes, (char *) page->data);
+
+}
+
+static page_t *get_page(inode_t *inode, uint32_t index) {
+
+    /* get a cached page of the file, pinned, reading it if needed: */
+    page_t *page = pcache_get(inode->sb, inode->ino, index);
+    int32_t err;
+
+    if (!page || (page->flags & PG_VALID))
+        return page;
+
+    err = read_page(inode, page);
+    pcache_ready(page, !err);
+    if (err) {
+        pcache_put(page);
+        return NULL;
+    }
+    return page;
+
+}
+
+static void read_ahead(inode_t *inode, uint32_t index, uint32_t count) {
+
+    /* bring pages index..index+count-1 of the file into the page
+     * cache, skipping those that are cached. an extent is all in a
+     * row on the volume, so the pages missing in a row are read with
+     * a single device request into a bounce buffer, up to
+     * ISO9660_RA_MAX at once.
+     */
+    page_t *pages[ISO9660_RA_MAX], *page;
+    uint32_t last, i, n, j, valid, bytes;
+    uint8_t *bounce;
+    pos_t off;
+    int32_t err;
+
+    /* pages of the file: */
+    last = (inode->size + PAGE_SIZE - 1)/PAGE_SIZE;
+    if (index >= last)
+        return;
+    if (count > last - index)
+        count = last - index;
+
+    /* a bounce buffer, if more than a page is read: */
+    bounce = count > 1 ? kmalloc(ISO9660_RA_MAX*PAGE_SIZE) : NULL;
+
+    for (i = 0; i < count; i += n ? n : 1) {
+
+        /* get the pages, up to the first one that is cached: */
+        for (n = 0; i+n < count && n < (bounce ? ISO9660_RA_MAX : 1); n++)
+            if (!(pages[n] = pcache_grab(inode->sb, inode->ino, index+i+n)))
+                break;
+        if (!n)
+            continue;
+        if (n == 1) {
+            /* just one. */
+            err = read_page(inode, pages[0]);
+            pcache_ready(pages[0], !err);
+            pcache_put(pages[0]);
+            continue;
+        }
+
+        /* read them all, in whole sectors: */
+        off   = (pos_t) (index+i)*PAGE_SIZE;
+        valid = bytes = n*PAGE_SIZE;
+        if (off + valid > inode->size) {
+            valid = inode->size - off;
+            bytes = (valid + ISO9660_SECTOR - 1)/
+                    ISO9660_SECTOR*ISO9660_SECTOR;
+        }
+        err = dev_read(inode->sb->dev,
+                       (uint64_t) inode->info.iso9660.lba*ISO9660_SECTOR+off,
+                       bytes, (char *) bounce);
+
+        /* and hand them over: */
+        for (j = 0; j < n; j++) {
+            page = pages[j];
+            if (!err)
+                memcpy(page->data, &bounce[j*PAGE_SIZE], PAGE_SIZE);
+            if (!err && valid < (j+1)*PAGE_SIZE)
+                memset(&page->data[valid - j*PAGE_SIZE], 0,
+                       (j+1)*PAGE_SIZE - valid); /* beyond EOF */
+            pcache_ready(page, !err);
+            pcache_put(page);
+        }
+
+    }
+
+    /* done: */
+    if (bounce)
+        kfree(bounce);
+
+}
+
+/***************************************************************************/
+/*                                 read()                                  */
+/***************************************************************************/
+
+static int32_t read_at(file_t *file, void *buf, int32_t size, pos_t *pos) {
+
+    pos_t off = *pos;
+    int32_t rem = size; /* remaining */
+    inode_t *inode = file->inode;
+    iso9660_file_info_t *info = &file->info.iso9660;
+    page_t *page;
+    pos_t tsize; /* size of the transfer */
+    uint32_t first, end;
+
+    if (size <= 0)
+        return EINVAL; /* invalid */
+
+    if (off >= inode->size)
+        return 0; /* EOF. */
+
+    if (off + rem > inode->size)
+        rem = inode->size - off;
+
+    /* pages to be read: */
+    first = off/PAGE_SIZE;
+    end   = (off+rem+PAGE_SIZE-1)/PAGE_SIZE;
+
+    if (first == info->ra_next) {
+        /* sequential: keep ahead of the reader, with a window
+         * that grows every time the reader gets close to its end.
+         */
+        if (end + info->ra_size/2 >= info->ra_end) {
+            if ((info->ra_size *= 2) < ISO9660_RA_MIN)
+                info->ra_size = ISO9660_RA_MIN;
+            if (info->ra_size > ISO9660_RA_MAX)
+                info->ra_size = ISO9660_RA_MAX;
+            if (info->ra_end < first)
+                info->ra_end = first;
+            read_ahead(inode, info->ra_end,
+                       end + info->ra_size - info->ra_end);
+            info->ra_end = end + info->ra_size;
+        }
+    } else {
+        /* random: just read the pages needed, in one request. */
+        info->ra_size = 0;
+        info->ra_end  = 0;
+        read_ahead(inode, first, end - first);
+    }
+    info->ra_next = (off+rem)/PAGE_SIZE;
+
+    /* read page by page through the page cache.. */
+    while(rem) {
+
+        /* try to not skip current page. */
+        if ((tsize = PAGE_SIZE-off%PAGE_SIZE) > rem)
+            tsize = rem;
+
+        /* get the page: */
+        if (!(page = get_page(inode, off/PAGE_SIZE)))
+            break;
+
+        /* copy the data: */
+        memcpy(buf, &page->data[off%PAGE_SIZE], tsize);
+        pcache_put(page);
+
+        /* update remaining: */
+        rem -= tsize;
+        off += tsize;
+        buf = ((uint8_t *) buf) + tsize;
+
+    }
+
+    /* nothing read? */
+    if (off == *pos)
+        return EIO;
+
+    /* update position: */
+    *pos = off;
+    return ESUCCESS;
+
+}
+
+int32_t iso9660_read(file_t *file, void *buf, int32_t size) {
+    return read_at(file, buf, size, &file->pos);
+}
+
+/***************************************************************************/
+/*                                 pread()                                 */
+/***************************************************************************/
+
+int32_t iso9660_pread(file_t *file, void *buf, int32_t size, pos_t pos,
+                      int32_t *done) {
+
+    /* like read(), at "pos" and leaving file->pos alone */
+    pos_t off = pos;
+    int32_t err = read_at(file, buf, size, &off);
+
+    *done = (int32_t) (off - pos);
+    return err;
+
+}
+
+/***************************************************************************/
+/*                                 write()                                 */
+/***************************************************************************/
+
+int32_t iso9660_write(file_t *file, void *buf, int32_t size) {
+    return EREADONLY;
+}
+
+/***************************************************************************/
+/*                                 seek()                                  */
+/***************************************************************************/
+
+int32_t iso9660_seek(file_t *file, pos_t newpos) {
+
+    /* just set file->pos, no need to update buffers now. */
+    file->pos = newpos;
+    return 0;
+
+}
+
+/***************************************************************************/
+/*                                 readdir()                               */
+/***************************************************************************/
+
+static uint32_t dir_next(file_t *file, char *name, ino_t *ino) {
+
+    /* the next listed entry, with file->pos left at its record.
+     * returns the size of the record for the caller to step over
+     * it, or 0 at the end of the directory.
+     */
+    iso9660_file_info_t *info = &file->info.iso9660;
+    iso9660_dirrec_t *rec;
+
+    /* buffer is ready? */
+    if (!info->buffer && !(info->buffer = kmalloc(ISO9660_SECTOR)))
+        return 0; /* no memory. */
+
+    /* skip records that are not listed: */
+    while ((rec = dir_rec(file->inode, &file->pos, info->buffer,
+                          &info->buf_sect)) &&
+           !rec_entry(file->inode, rec, file->pos, name, ino))
+        file->pos += rec->len;
+
+    return rec ? rec->len : 0;
+
+}
+
+int32_t iso9660_readdir(file_t *file, dirent_t *dirent) {
+
+    /* read next entry */
+    uint32_t len = dir_next(file, dirent->name, &dirent->ino);
+
+    if (!len)
+        return 0;
+    file->pos += len;
+    return 1;
+
+}
+
+/***************************************************************************/
+/*                               getdents()                                */
+/***************************************************************************/
+
+int32_t iso9660_getdents(file_t *file, void *buf, int32_t size,
+                         int32_t *done) {
+
+    /* pack entries as long as they fit */
+    char name[NAME_MAX+1];
+    uint32_t len;
+    ino_t ino;
+
+    *done = 0;
+    while ((len = dir_next(file, name, &ino)) &&
+           dirent_pack(buf, size, done, ino, name))
+        file->pos += len;
+
+    /* not even one entry fits? */
+    return (len && !*done) ? EINVAL : ESUCCESS;
+
+}
+
+/***************************************************************************/
+/*                                 ioctl()                                 */
+/***************************************************************************/
+
+int32_t iso9660_ioctl(file_t *file, int32_t cmd, void *arg) {
+
+    /* currently iso9660 doesn't make use of this... */
+    return EBUSY;
+
+}
+
+/***************************************************************************/
+/*                               fsdriver_t                                */
+/***************************************************************************/
+
+fsd_t iso9660_t = {
+
+    /* alias:        */ "iso9660",
+    /* flags:        */ FSD_REQDEV,
+
+    /* read_super:   */ iso9660_read_super,
+    /* write_super:  */ iso9660_write_super,
+    /* put_super:    */ iso9660_put_super,
+    /* read_inode:   */ iso9660_read_inode,
+    /* update_inode: */ iso9660_update_inode,
+    /* put_inode:    */ iso9660_put_inode,
+
+    /* lookup:       */ iso9660_lookup,
+    /* mknod:        */ iso9660_mknod,
+    /* link:         */ iso9660_link,
+    /* unlink:       */ iso9660_unlink,
+    /* mkdir:        */ iso9660_mkdir,
+    /* rmdir:        */ iso9660_rmdir,
+    /* truncate:     */ iso9660_truncate,
+
+    /* open:         */ iso9660_open,
+    /* release:      */ iso9660_release,
+    /* read:         */ iso9660_read,
+    /* write:        */ iso9660_write,
+    /* seek:         */ iso9660_seek,
+    /* pread:        */ iso9660_pread,
+    /* pwrite:       */ NULL,
+    /* readdir:      */ iso9660_readdir,
+    /* getdents:     */ iso9660_getdents,
+    /* ioctl:        */ iso9660_ioctl,
+    /* poll:         */ NULL,
+    /* sync:         */ NULL
+
+};
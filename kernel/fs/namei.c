@@ -30,53 +30,73 @@
 #include <lib/string.h>
 #include <sys/mm.h>
 #include <sys/fs.h>
+#include <sys/dcache.h>
 #include <sys/scheduler.h>
 
 /***************************************************************************/
-/*                              alloc_path()                               */
+/*                              canon_path()                               */
 /***************************************************************************/
 
-char *alloc_path(char *parent, char *child) {
-    char *ret;
-    if (!strcmp(child, ".")) {
-        /* return the same path of parent. */
-        ret = (char *) kmalloc(strlen(parent)+1);
-        if (!ret)
-            return NULL;
-        strcpy(ret, parent);
-    } else if (!strcmp(child, "..")) {
-        /* trim last component of parent path.
-         * it is guaranteed that parent is not "/";
-         */
-        int32_t len = strlen(parent);
-        while(parent[--len] != '/');
-        if (!len)
-            len = 1; /* cases like "/home" and ".." */
-        ret = (char *) kmalloc(len+1);
-        if (!ret)
-            return NULL;
-        ret[len--] = 0;
-        while(len >= 0)
-            ret[len] = parent[len--];
-    } else if (!strcmp(parent, "/")) {
-        /* "/" with "etc" */
-        ret = (char *) kmalloc(strlen(child)+2);
-        if (!ret)
-            return NULL;
-        ret[0] = '/';
-        strcpy(&ret[1], child);
-    } else {
-        /* concatenate both paths: */
-        int32_t len1 = strlen(parent);
-        int32_t len2 = strlen(child);
-        ret = (char *) kmalloc(len1+1+len2+1);
-        if (!ret)
-            return NULL;
-        strcpy(&ret[0], parent);
-        ret[len1] = '/';
-        strcpy(&ret[len1+1], child);
+static char *canon_path(char *base, char *rel) {
+
+    /* join base (which is already canonical) and rel, resolving
+     * ".", ".." and repeated slashes. this is purely lexical, the
+     * same way namei() walks "..".
+     */
+    int32_t len = 0, i = 0, n;
+    char *ret = kmalloc(strlen(base)+strlen(rel)+2);
+    if (!ret)
+        return NULL;
+
+    /* relative paths start from base: */
+    if (rel[0] != '/') {
+        strcpy(ret, base);
+        if ((len = strlen(ret)) == 1)
+            len = 0; /* base is "/" */
     }
+
+    /* append components one by one: */
+    while (rel[i]) {
+        if (rel[i] == '/') {
+            i++;
+            continue;
+        }
+        for (n = 0; rel[i+n] && rel[i+n] != '/'; n++);
+        if (n == 1 && rel[i] == '.') {
+            /* nothing */
+        } else if (n == 2 && rel[i] == '.' && rel[i+1] == '.') {
+            /* trim last component, if any */
+            while (len > 0 && ret[--len] != '/');
+        } else {
+            ret[len++] = '/';
+            memcpy(&ret[len], &rel[i], n);
+            len += n;
+        }
+        i += n;
+    }
+
+    /* done: */
+    if (!len)
+        ret[len++] = '/';
+    ret[len] = 0;
     return ret;
+
+}
+
+/***************************************************************************/
+/*                              at_vfsroot()                               */
+/***************************************************************************/
+
+static int32_t at_vfsroot(vfsmount_t *mnt) {
+
+    /* is the root of mnt the root of vfs? it is if mnt (or any
+     * mount it is stacked on) is mounted on "/".
+     */
+    while (mnt->mp_inode &&
+           mnt->mp_inode->ino == mnt->vfsparent->sb->root_ino)
+        mnt = mnt->vfsparent;
+    return !mnt->mp_inode;
+
 }
 
 /***************************************************************************/
@@ -172,15 +192,19 @@ int32_t divide_path(char *pathname,
 /*                                namei()                                  */
 /***************************************************************************/
 
-int32_t namei(file_t *start, char *pathname, namei_t *ret) {
+int32_t namei(file_t *start, char *pathname, int32_t flags, namei_t *ret) {
 
-    char *tmp;             /* for temporary storage. */
+    /* resolve pathname to an inode. components are walked in place
+     * and looked up through the dentry cache; nothing is allocated
+     * unless the caller wants the full path (NAMEI_PATH).
+     */
+    char name[NAME_MAX+1]; /* current component. */
     inode_t *inode = NULL; /* current node we are working on. */
-    char *fullpath;        /* full path of the file. */
+    inode_t *child;
+    char *base;            /* path of the starting point. */
     vfsmount_t *mnt;       /* mount point of inode. */
     int32_t err = ESUCCESS;
-    int32_t i = 0;
-    int32_t f = 0; /* ended flag. */
+    int32_t i = 0, len;
 
     /* I) Determine the starting point:  */
     /* ------------------------------- - */
@@ -215,65 +239,27 @@ int32_t namei(file_t *start, char *pathname, namei_t *ret) {
         }
 
         /* path of the currently open inode: */
-        fullpath = "/";
+        base = "/";
 
     } else if (!start) {
 
         /* start point is the current working directory: */
         mnt = curproc->cwd->mp;
-
-        inode = (inode_t *) iget(curproc->cwd->inode->sb,
-                                 curproc->cwd->inode->ino);
-
-        if (!inode)
-            return ENOMEM;
-
-        fullpath = curproc->cwd->path;
+        inode = (inode_t *) igrab(curproc->cwd->inode);
+        base = curproc->cwd->path;
 
     } else {
 
         /* start point is the file opened by "start" */
         mnt = start->mp;
+        inode = (inode_t *) igrab(start->inode);
+        base = start->path;
 
-        inode = (inode_t *) iget(start->inode->sb,
-                                 start->inode->ino);
-
-        if (!inode)
-            return ENOMEM;
-
-        fullpath = start->path;
-    }
-
-    /* II) Copy paths to kernel memory:  */
-    /* --------------------------------- */
-    tmp = kmalloc(strlen(pathname)+1);
-    if (!tmp) {
-        iput(inode);
-        return ENOMEM;
-    }
-    strcpy(tmp, pathname);
-    pathname = tmp;
-
-    tmp = kmalloc(strlen(fullpath)+1);
-    if (!tmp) {
-        iput(inode);
-        kfree(pathname);
-        return ENOMEM;
     }
-    strcpy(tmp, fullpath);
-    fullpath = tmp;
-
-    /* III) Loop on path components ( interesting (Y) ):  */
-    /* -------------------------------------------------- */
-    while(!f) {
 
-        /* i is the offset of next component
-         * in pathname. get component length:
-         */
-        inode_t *child;
-        int32_t j = i;
-        while(pathname[j] != '/' && pathname[j] != 0)
-            j++;
+    /* II) Loop on path components:  */
+    /* ----------------------------- */
+    while(pathname[i]) {
 
         /* currently open inode must be directory: */
         if ((inode->mode & FT_MASK) != FT_DIR) {
@@ -281,65 +267,52 @@ int32_t namei(file_t *start, char *pathname, namei_t *ret) {
             break;
         }
 
-        /* is it last component? */
-        if (!pathname[j]) {
-            f = 1;
-        } else {
-            pathname[j] = 0; /* terminate in \0: */
-        }
-
         /* empty component name? like in //home */
-        if (i == j) {
+        if (pathname[i] == '/') {
             i++;
             continue;
         }
 
-        /* "." within the root of a mounted filesystem? */
-        if (inode->ino == inode->sb->root_ino &&
-            (!strcmp(&pathname[i], "."))) {
-            /* this shouldn't affect "cur": */
-            i += 2;
-            continue;
+        /* copy the component to the stack: */
+        for (len = 0; pathname[i] && pathname[i] != '/'; len++) {
+            if (len == NAME_MAX)
+                break;
+            name[len] = pathname[i++];
+        }
+        if (pathname[i] && pathname[i] != '/') {
+            err = ENAMETOOLONG;
+            break;
         }
+        name[len] = 0;
+
+        /* "." is the same directory: */
+        if (!strcmp(name, "."))
+            continue;
 
         /* ".." within the root of a mounted filesystem? */
-        if (inode->ino == inode->sb->root_ino &&
-            (!strcmp(&pathname[i], ".."))) {
-            if (!strcmp(fullpath, "/")) {
+        if (!strcmp(name, "..")) {
+            if (at_vfsroot(mnt) && inode->ino == inode->sb->root_ino) {
                 /* we are in the root of vfs,
                  * it is like: open("/..")
                  * silly.. isn't it?
                  */
-                i += 3;
                 continue;
-            } else {
-                /* this is kinda tricky: */
-                ino_t ino;
-                super_block_t *sb;
+            }
+            /* climb to the directory the filesystem is mounted on: */
+            while (inode->ino == inode->sb->root_ino) {
                 iput(inode);
-                ino = mnt->mp_inode->ino;
-                sb = (mnt=mnt->vfsparent)->sb;
-                inode = (inode_t *) iget(sb, ino);
-                if (!inode) {
-                    err = ENOMEM;
-                    break;
-                }
-
-                /* parse the ".." again. */
-                if (!f)
-                    pathname[j] = '/';
-                else
-                    f = 0;
-                continue;
-
+                inode = (inode_t *) igrab(mnt->mp_inode);
+                mnt = mnt->vfsparent;
             }
         }
 
-        /* get inode number of this component */
-        err = mnt->sb->fsdriver->lookup(inode, &pathname[i], &child);
+        /* get inode of this component */
+        err = dlookup(inode, name, &child);
         iput(inode);
-        if (err)
+        if (err) {
+            inode = NULL;
             break;
+        }
         inode = child;
 
         /* this component is a mount point? */
@@ -355,27 +328,22 @@ int32_t namei(file_t *start, char *pathname, namei_t *ret) {
         if (err)
             break;
 
-        /* now append the component name to the path: */
-        tmp = alloc_path(fullpath, &pathname[i]);
-        if (!tmp) {
-            iput(inode);
-            err = ENOMEM;
-            break;
-        }
-        kfree(fullpath);
-        fullpath = tmp;
+    }
 
-        /* go to next component */
-        i = j+1;
+    /* III) Build the full path if needed:  */
+    /* ------------------------------------ */
+    ret->path = NULL;
+    if (!err && (flags & NAMEI_PATH) && !(ret->path = canon_path(base,
+                                                             pathname))) {
+        err = ENOMEM;
     }
 
     /* IV) Return:  */
     /* ------------ */
-    kfree(pathname);
     if (err) {
-        kfree(fullpath);
+        if (inode)
+            iput(inode);
     } else {
-        ret->path = fullpath;
         ret->inode = inode;
         ret->mp = mnt;
     }
@@ -401,7 +369,7 @@ int32_t mknod(char *pathname, mode_t mode, uint32_t devid) {
         return -err;
 
     /* get the inode structure of parent: */
-    err = namei(NULL, parent, &namei_data);
+    err = namei(NULL, parent, 0, &namei_data);
     kfree(parent); /* no need anymore. */
     if (err) {
         kfree(child);
@@ -411,10 +379,10 @@ int32_t mknod(char *pathname, mode_t mode, uint32_t devid) {
     /* extract information from namei_data: */
     dir = namei_data.inode;
     sb = dir->sb;
-    kfree(namei_data.path); /* not needed. */
 
     /* call filesystem driver: */
     err = sb->fsdriver->mknod(dir, child, mode, devid);
+    dcache_invalidate(dir, child);
 
     /* that's all! */
     iput(dir);
@@ -448,7 +416,7 @@ int32_t rename(char *oldpath, char *newpath) {
     }
 
     /* get the inode structure of old_parent: */
-    err = namei(NULL, old_parent, &old_data);
+    err = namei(NULL, old_parent, 0, &old_data);
     if (err) {
         kfree(old_parent);
         kfree(old_child);
@@ -457,10 +425,9 @@ int32_t rename(char *oldpath, char *newpath) {
         return -err;
     }
     old_dir = old_data.inode;
-    kfree(old_data.path);
 
     /* get the inode structure of new_parent: */
-    err = namei(NULL, new_parent, &new_data);
+    err = namei(NULL, new_parent, 0, &new_data);
     if (err) {
         iput(old_dir);
         kfree(old_parent);
@@ -470,7 +437,6 @@ int32_t rename(char *oldpath, char *newpath) {
         return -err;
     }
     new_dir = new_data.inode;
-    kfree(new_data.path);
 
     /* both paths must be on the same mount point. */
     if (old_data.mp != new_data.mp) {
@@ -485,6 +451,8 @@ int32_t rename(char *oldpath, char *newpath) {
 
     /* call the filesystem: */
     /* TODO: err = old_dir->sb->fsdriver->rename(); */
+    dcache_invalidate(old_dir, old_child);
+    dcache_invalidate(new_dir, new_child);
 
     /* done: */
     iput(new_dir);
@@ -510,11 +478,10 @@ int32_t link(char *oldpath, char *newpath) {
     int32_t err;
 
     /* get the inode structure of oldpath: */
-    err = namei(NULL, oldpath, &inode_data);
+    err = namei(NULL, oldpath, 0, &inode_data);
     if (err)
         return -err;
     inode = inode_data.inode;
-    kfree(inode_data.path);
 
     /* divide "newpath": */
     if (err = divide_path(newpath, 0, &new_parent, &new_child)) {
@@ -523,7 +490,7 @@ int32_t link(char *oldpath, char *newpath) {
     }
 
     /* get the inode structure of new_parent: */
-    err = namei(NULL, new_parent, &dir_data);
+    err = namei(NULL, new_parent, 0, &dir_data);
     if (err) {
         iput(inode);
         kfree(new_parent);
@@ -531,7 +498,6 @@ int32_t link(char *oldpath, char *newpath) {
         return -err;
     }
     dir = dir_data.inode;
-    kfree(dir_data.path);
 
     /* both paths must be on the same mount point. */
     if (inode_data.mp != dir_data.mp) {
@@ -544,6 +510,7 @@ int32_t link(char *oldpath, char *newpath) {
 
     /* call the filesystem: */
     err = inode->sb->fsdriver->link(inode, dir, new_child);
+    dcache_invalidate(dir, new_child);
 
     /* done: */
     iput(inode);
@@ -572,7 +539,7 @@ int32_t unlink(char *pathname) {
         return -err;
 
     /* get the inode structure of parent: */
-    err = namei(NULL, parent, &namei_data);
+    err = namei(NULL, parent, 0, &namei_data);
     kfree(parent); /* no need anymore. */
     if (err) {
         kfree(child);
@@ -582,10 +549,10 @@ int32_t unlink(char *pathname) {
     /* extract information from namei_data: */
     dir = namei_data.inode;
     sb = dir->sb;
-    kfree(namei_data.path); /* not needed. */
 
     /* call filesystem driver: */
     err = sb->fsdriver->unlink(dir, child);
+    dcache_invalidate(dir, child);
 
     /* that's all! */
     iput(dir);
@@ -612,7 +579,7 @@ int32_t mkdir(char *pathname, mode_t mode) {
         return -err;
 
     /* get the inode structure of parent: */
-    err = namei(NULL, parent, &namei_data);
+    err = namei(NULL, parent, 0, &namei_data);
     kfree(parent); /* no need anymore. */
     if (err) {
         kfree(child);
@@ -622,10 +589,10 @@ int32_t mkdir(char *pathname, mode_t mode) {
     /* extract information from namei_data: */
     dir = namei_data.inode;
     sb = dir->sb;
-    kfree(namei_data.path); /* not needed. */
 
     /* call filesystem driver: */
     err = sb->fsdriver->mkdir(dir, child, mode);
+    dcache_invalidate(dir, child);
 
     /* that's all! */
     iput(dir);
@@ -642,7 +609,8 @@ int32_t rmdir(char *pathname) {
 
     /* rmdir() system call */
     char *parent, *child;
-    inode_t *dir;
+    inode_t *dir, *victim;
+    ino_t ino = 0;
     super_block_t *sb;
     namei_t namei_data;
     int32_t err;
@@ -652,7 +620,7 @@ int32_t rmdir(char *pathname) {
         return -err;
 
     /* get the inode structure of parent: */
-    err = namei(NULL, parent, &namei_data);
+    err = namei(NULL, parent, 0, &namei_data);
     kfree(parent); /* no need anymore. */
     if (err) {
         kfree(child);
@@ -662,10 +630,16 @@ int32_t rmdir(char *pathname) {
     /* extract information from namei_data: */
     dir = namei_data.inode;
     sb = dir->sb;
-    kfree(namei_data.path); /* not needed. */
 
     /* call filesystem driver: */
+    if (!sb->fsdriver->lookup(dir, child, &victim)) {
+        ino = victim->ino;
+        iput(victim);
+    }
     err = sb->fsdriver->rmdir(dir, child);
+    dcache_invalidate(dir, child);
+    if (!err && ino)
+        dcache_purge(sb, ino); /* entries inside the removed directory. */
 
     /* that's all! */
     iput(dir);
@@ -49,7 +49,7 @@ int32_t file_open(char *path, int32_t flags, file_t **ret) {
     }
 
     /* convert path to namei structure: */
-    err = namei(NULL, path, &namei_data);
+    err = namei(NULL, path, NAMEI_PATH, &namei_data);
     if (err) {
         kfree(file);
         return err;
@@ -272,7 +272,7 @@ int32_t truncate(char *pathname, pos_t length) {
 
     /* get the inode structure: */
     /*printk("truncate: %s\n", pathname);*/
-    if (err = namei(NULL, pathname, &namei_data))
+    if (err = namei(NULL, pathname, 0, &namei_data))
         return -err;
 
     /* do the truncate: */
@@ -281,9 +281,6 @@ int32_t truncate(char *pathname, pos_t length) {
     /* drop the inode: */
     iput(namei_data.inode);
 
-    /* free the memory used by namei returned path: */
-    kfree(namei_data.path);
-
     /* done: */
     if (err) {
         return -err;
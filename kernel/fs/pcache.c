@@ -0,0 +1,505 @@
+/*
+ *        +----------------------------------------------------------+
+ *        | +------------------------------------------------------+ |
+ *        | |  Quafios Kernel 2.0.1.                               | |
+ *        | |  -> Page cache.                                      | |
+ *        | +------------------------------------------------------+ |
+ *        +----------------------------------------------------------+
+ *
+ * This file is part of Quafios 2.0.1 source code.
+ * Copyright (C) 2015  Mostafa Abd El-Aziz Mohamed.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Quafios.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Visit http://www.quafios.com/ for contact information.
+ *
+ */
+
+#include <arch/type.h>
+#include <arch/page.h>
+#include <arch/spinlock.h>
+#include <lib/string.h>
+#include <sys/mm.h>
+#include <sys/printk.h>
+#include <sys/waitq.h>
+#include <sys/pcache.h>
+
+/* one cache for block devices and file contents. pages are looked
+ * up through a hash table and reclaimed in LRU order. the cache
+ * grows as long as the physical allocator has more than
+ * PCACHE_RESERVE free frames and the kernel heap, which holds the
+ * pages, is less than PCACHE_HEAP_HIGH full; past either, new pages
+ * recycle the least recently used ones and anonymous memory faults
+ * shrink it. the cache never takes more than PCACHE_MAX pages of the
+ * heap, however much RAM there is. pages that were written to are
+ * kept on a dirty list and are never reclaimed until their owner has
+ * written them back.
+ */
+#define PCACHE_HASH     4096
+#define PCACHE_RESERVE  1024 /* frames (4MB) left for everything else. */
+#define PCACHE_MAX      (KERNEL_MEMORY_SIZE/PAGE_SIZE/2) /* half the heap. */
+#define PCACHE_HEAP_HIGH (KERNEL_MEMORY_SIZE/4*3) /* bytes allocated. */
+
+static page_t *htable[PCACHE_HASH];
+static page_t *lru_first = NULL; /* least recently used. */
+static page_t *lru_last  = NULL; /* most recently used.  */
+static page_t *dirty_first = NULL; /* dirtied first.     */
+static page_t *dirty_last  = NULL;
+static spinlock_t pcache_lock;
+static waitq_t pcache_wq; /* processes waiting for busy pages. */
+
+/* statistics */
+static uint32_t pages     = 0;
+static uint32_t hits      = 0;
+static uint32_t misses    = 0;
+static uint32_t evictions = 0;
+static uint32_t dirty     = 0;
+
+/***************************************************************************/
+/*                              Helpers                                    */
+/***************************************************************************/
+
+static uint32_t hashfn(void *owner, uint32_t id, uint32_t index) {
+    return ((((uint32_t) owner) >> 4) ^ (id*31) ^ (index*2654435761U)) %
+           PCACHE_HASH;
+}
+
+static page_t *lookup(void *owner, uint32_t id, uint32_t index) {
+    page_t *page = htable[hashfn(owner, id, index)];
+    while (page && (page->owner != owner || page->id != id ||
+                    page->index != index))
+        page = page->hnext;
+    return page;
+}
+
+static void hash_add(page_t *page) {
+    uint32_t h = hashfn(page->owner, page->id, page->index);
+    page->hnext = htable[h];
+    htable[h] = page;
+}
+
+static void hash_del(page_t *page) {
+    page_t **p = &htable[hashfn(page->owner, page->id, page->index)];
+    while (*p != page)
+        p = &(*p)->hnext;
+    *p = page->hnext;
+}
+
+static void lru_add(page_t *page) {
+    page->next = NULL;
+    page->prev = lru_last;
+    if (lru_last)
+        lru_last->next = page;
+    else
+        lru_first = page;
+    lru_last = page;
+}
+
+static void lru_del(page_t *page) {
+    if (page->prev)
+        page->prev->next = page->next;
+    else
+        lru_first = page->next;
+    if (page->next)
+        page->next->prev = page->prev;
+    else
+        lru_last = page->prev;
+}
+
+static void dirty_add(page_t *page) {
+    page->dnext = NULL;
+    page->dprev = dirty_last;
+    if (dirty_last)
+        dirty_last->dnext = page;
+    else
+        dirty_first = page;
+    dirty_last = page;
+    dirty++;
+}
+
+static void dirty_del(page_t *page) {
+    if (page->dprev)
+        page->dprev->dnext = page->dnext;
+    else
+        dirty_first = page->dnext;
+    if (page->dnext)
+        page->dnext->dprev = page->dprev;
+    else
+        dirty_last = page->dprev;
+    dirty--;
+}
+
+static uint32_t sectors(uint32_t off, uint32_t size) {
+    /* mask of the sectors that [off, off+size) touches */
+    uint32_t first = off/PCACHE_SECTOR;
+    uint32_t last  = (off+size-1)/PCACHE_SECTOR;
+    if (!size)
+        return 0;
+    return (0xFFFFFFFF >> (31-last)) & ~((1 << first)-1);
+}
+
+static page_t *evict() {
+    /* detach the least recently used page that is not in use */
+    page_t *page = lru_first;
+    while (page && (page->count || (page->flags & PG_DIRTY)))
+        page = page->next;
+    if (page) {
+        hash_del(page);
+        lru_del(page);
+        evictions++;
+    }
+    return page;
+}
+
+static void free_page(page_t *page) {
+    kfree(page->data);
+    kfree(page);
+}
+
+static void sleep_on_busy() {
+    /* wait for a busy page. called and returns with pcache_lock held
+     * and interrupts disabled, so pcache_ready() can't come between
+     * releasing the lock and going to sleep.
+     */
+    spinlock_release(&pcache_lock);
+    waitq_sleep(&pcache_wq);
+    spinlock_acquire(&pcache_lock);
+}
+
+/***************************************************************************/
+/*                              Interface                                  */
+/***************************************************************************/
+
+int32_t pcache_low() {
+    /* is physical memory, or the kernel heap, getting short? */
+    extern uint32_t kalloc_size;
+    return pmem_free_pages() < PCACHE_RESERVE ||
+           kalloc_size > PCACHE_HEAP_HIGH;
+}
+
+page_t *pcache_get(void *owner, uint32_t id, uint32_t index) {
+
+    /* get a page of the cache, pinned. the page is either valid, or
+     * marked busy, in which case the caller is to fill in the data
+     * and then call pcache_ready(). returns NULL if there is no
+     * memory for the page.
+     */
+    page_t *page, *new = NULL;
+    int32_t status;
+
+    status = spinlock_acquire_irqsave(&pcache_lock);
+    while (1) {
+
+        /* look up the cache */
+        if (page = lookup(owner, id, index)) {
+            if (page->flags & PG_BUSY) {
+                /* somebody is filling it in */
+                sleep_on_busy();
+                continue;
+            }
+            page->count++;
+            lru_del(page);
+            lru_add(page);
+            if (page->flags & PG_VALID) {
+                hits++;
+            } else {
+                /* an earlier fill failed, try again */
+                misses++;
+                page->flags |= PG_BUSY;
+            }
+            spinlock_release_irqrestore(&pcache_lock, status);
+            if (new)
+                free_page(new);
+            return page;
+        }
+
+        /* not cached, we need a new page */
+        if (new)
+            break;
+        if ((pcache_low() || pages >= PCACHE_MAX) && (new = evict())) {
+            /* recycle the oldest page */
+            pages--;
+            continue;
+        }
+        spinlock_release_irqrestore(&pcache_lock, status);
+        if (!(new = kmalloc(sizeof(page_t))))
+            return NULL;
+        if (!(new->data = kmalloc(PAGE_SIZE))) {
+            kfree(new);
+            return NULL;
+        }
+        /* the page might have been added meanwhile, look again */
+        status = spinlock_acquire_irqsave(&pcache_lock);
+
+    }
+
+    /* insert the new page */
+    misses++;
+    pages++;
+    new->owner = owner;
+    new->id    = id;
+    new->index = index;
+    new->count = 1;
+    new->flags = PG_BUSY;
+    new->dirty = 0;
+    hash_add(new);
+    lru_add(new);
+    spinlock_release_irqrestore(&pcache_lock, status);
+    return new;
+
+}
+
+page_t *pcache_grab(void *owner, uint32_t id, uint32_t index) {
+
+    /* like pcache_get(), but only for pages that are not cached at
+     * all: returns a new busy page, or NULL if the page is already
+     * there (or being filled) or there is no memory. used for
+     * read-ahead, which has no use for pages that are cached.
+     */
+    page_t *page;
+    int32_t status;
+
+    status = spinlock_acquire_irqsave(&pcache_lock);
+    page = lookup(owner, id, index);
+    spinlock_release_irqrestore(&pcache_lock, status);
+    if (page)
+        return NULL;
+
+    /* pcache_get() looks again, the page might be added meanwhile */
+    page = pcache_get(owner, id, index);
+    if (page && !(page->flags & PG_BUSY)) {
+        pcache_put(page);
+        return NULL;
+    }
+    return page;
+
+}
+
+page_t *pcache_find(void *owner, uint32_t id, uint32_t index) {
+
+    /* get a page only if it is cached and valid, pinned */
+    page_t *page;
+    int32_t status;
+
+    status = spinlock_acquire_irqsave(&pcache_lock);
+    while ((page = lookup(owner, id, index)) && (page->flags & PG_BUSY))
+        sleep_on_busy();
+    if (page && (page->flags & PG_VALID))
+        page->count++;
+    else
+        page = NULL;
+    spinlock_release_irqrestore(&pcache_lock, status);
+    return page;
+
+}
+
+void pcache_ready(page_t *page, int32_t valid) {
+
+    /* the filler is done with a busy page */
+    int32_t status = spinlock_acquire_irqsave(&pcache_lock);
+    page->flags &= ~PG_BUSY;
+    if (valid)
+        page->flags |= PG_VALID;
+    wake_up(&pcache_wq);
+    spinlock_release_irqrestore(&pcache_lock, status);
+
+}
+
+void pcache_put(page_t *page) {
+
+    /* unpin a page */
+    int32_t status, orphan;
+    status = spinlock_acquire_irqsave(&pcache_lock);
+    orphan = !(--page->count) && (page->flags & PG_ORPHAN);
+    spinlock_release_irqrestore(&pcache_lock, status);
+    if (orphan)
+        free_page(page);
+
+}
+
+void pcache_dirty(page_t *page, uint32_t off, uint32_t size) {
+
+    /* the holder of a valid page changed [off, off+size) of it; the
+     * page stays in memory until the owner writes it back.
+     */
+    int32_t status = spinlock_acquire_irqsave(&pcache_lock);
+    if (!(page->flags & PG_ORPHAN)) {
+        if (!(page->flags & PG_DIRTY)) {
+            page->flags |= PG_DIRTY;
+            dirty_add(page);
+        }
+        page->dirty |= sectors(off, size);
+    }
+    spinlock_release_irqrestore(&pcache_lock, status);
+
+    /* too much to write? don't wait for the flusher's next round */
+    if (pcache_congested())
+        sync_wake();
+
+}
+
+uint32_t pcache_clean(page_t *page, uint32_t off, uint32_t size) {
+
+    /* the owner is about to write [off, off+size) of a pinned page
+     * back, or did so by other means. returns the sectors of that
+     * range that were dirty. the data is to be copied out after
+     * this call, so that a change coming in meanwhile marks the
+     * page dirty again rather than being lost.
+     */
+    uint32_t mask = sectors(off, size), ret;
+    int32_t status = spinlock_acquire_irqsave(&pcache_lock);
+    ret = page->dirty & mask;
+    page->dirty &= ~mask;
+    if ((page->flags & PG_DIRTY) && !page->dirty) {
+        page->flags &= ~PG_DIRTY;
+        dirty_del(page);
+    }
+    spinlock_release_irqrestore(&pcache_lock, status);
+    return ret;
+
+}
+
+uint32_t pcache_collect(void *owner, uint32_t id, page_t **list,
+                        uint32_t max) {
+
+    /* pin up to max dirty pages of owner (and id), those dirtied
+     * first come first. returns how many were stored in list.
+     */
+    page_t *page;
+    uint32_t n = 0;
+    int32_t status;
+
+    status = spinlock_acquire_irqsave(&pcache_lock);
+    for (page = dirty_first; page && n < max; page = page->dnext) {
+        if (page->owner != owner || (id != PCACHE_ANY && page->id != id))
+            continue;
+        page->count++;
+        list[n++] = page;
+    }
+    spinlock_release_irqrestore(&pcache_lock, status);
+    return n;
+
+}
+
+int32_t pcache_congested() {
+    /* too much data waiting to be written back? */
+    return dirty > PCACHE_DIRTY_MAX || (pcache_low() && dirty > pages/2);
+}
+
+void pcache_invalidate(void *owner, uint32_t id, uint32_t from) {
+
+    /* drop the pages of owner (and id) from index "from" on; used
+     * when files are truncated or deleted and when devices go away.
+     */
+    page_t *page, *next, *dead = NULL;
+    int32_t status, i;
+
+    status = spinlock_acquire_irqsave(&pcache_lock);
+    for (i = 0; i < PCACHE_HASH; i++) {
+        for (page = htable[i]; page; page = next) {
+            next = page->hnext;
+            if (page->owner != owner || page->index < from ||
+                (id != PCACHE_ANY && page->id != id))
+                continue;
+            hash_del(page);
+            lru_del(page);
+            pages--;
+            if (page->flags & PG_DIRTY) {
+                /* the data is no longer wanted */
+                dirty_del(page);
+                page->flags &= ~PG_DIRTY;
+            }
+            if (page->count) {
+                /* in use, freed by the last pcache_put() */
+                page->flags |= PG_ORPHAN;
+            } else {
+                page->hnext = dead;
+                dead = page;
+            }
+        }
+    }
+    spinlock_release_irqrestore(&pcache_lock, status);
+
+    while (page = dead) {
+        dead = page->hnext;
+        free_page(page);
+    }
+
+}
+
+uint32_t pcache_shrink(uint32_t count) {
+
+    /* give up to count pages back to the system */
+    page_t *page, *dead = NULL;
+    int32_t status;
+    uint32_t done = 0;
+
+    status = spinlock_acquire_irqsave(&pcache_lock);
+    while (done < count && (page = evict())) {
+        pages--;
+        page->hnext = dead;
+        dead = page;
+        done++;
+    }
+    spinlock_release_irqrestore(&pcache_lock, status);
+
+    while (page = dead) {
+        dead = page->hnext;
+        free_page(page);
+    }
+    return done;
+
+}
+
+/***************************************************************************/
+/*                              sysfs file                                 */
+/***************************************************************************/
+
+static char *pcache_stats(uint32_t *size) {
+    uint32_t total = hits + misses;
+    char *buf = kmalloc(256);
+    *size = 0;
+    *size += sputs(&buf[*size],
+                   "pages dirty hits misses evictions hit_ratio\n");
+    *size += sputd(&buf[*size], pages);
+    *size += sputs(&buf[*size], " ");
+    *size += sputd(&buf[*size], dirty);
+    *size += sputs(&buf[*size], " ");
+    *size += sputd(&buf[*size], hits);
+    *size += sputs(&buf[*size], " ");
+    *size += sputd(&buf[*size], misses);
+    *size += sputs(&buf[*size], " ");
+    *size += sputd(&buf[*size], evictions);
+    *size += sputs(&buf[*size], " ");
+    *size += sputd(&buf[*size], total ? (uint32_t)
+                                ((uint64_t) hits*100/total) : 0);
+    *size += sputs(&buf[*size], "%\n");
+    buf[*size] = 0;
+    return buf;
+}
+
+void pcache_init() {
+
+    int32_t i;
+
+    /* initialize the hash table */
+    for (i = 0; i < PCACHE_HASH; i++)
+        htable[i] = NULL;
+    spinlock_init(&pcache_lock);
+    waitq_init(&pcache_wq);
+
+    /* register in sysfs */
+    sysfs_reg("pcache", pcache_stats);
+
+}
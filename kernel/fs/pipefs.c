@@ -0,0 +1,588 @@
+/*
+ *        +----------------------------------------------------------+
+ *        | +------------------------------------------------------+ |
+ *        | |  Quafios Kernel 2.0.1.                               | |
+ *        | |  -> Pipe Filesystem Driver.                          | |
+ *        | +------------------------------------------------------+ |
+ *        +----------------------------------------------------------+
+ *
+ * This file is part of Quafios 2.0.1 source code.
+ * Copyright (C) 2015  Mostafa Abd El-Aziz Mohamed.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Quafios.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Visit http://www.quafios.com/ for contact information.
+ *
+ */
+
+#include <arch/type.h>
+#include <arch/page.h>
+#include <lib/string.h>
+#include <sys/error.h>
+#include <sys/mm.h>
+#include <sys/fs.h>
+#include <sys/scheduler.h>
+#include <sys/semaphore.h>
+#include <sys/waitq.h>
+#include <sys/poll.h>
+
+/* a pipe is a ring of PIPE_PAGES pages. head and tail count the bytes
+ * written and read so far; as the ring size divides 2^32 they can
+ * safely wrap around. the pages are allocated on the first write
+ * into them and are kept until the pipe is destroyed.
+ */
+#define PIPE_SIZE       (PIPE_PAGES*PAGE_SIZE)
+
+typedef struct pipe {
+    uint8_t *page[PIPE_PAGES];
+    uint32_t head;          /* written by writers only.       */
+    uint32_t tail;          /* written by readers only.       */
+    int32_t readers;        /* open read ends.                */
+    int32_t writers;        /* open write ends.               */
+    waitq_t rq;             /* readers waiting for data.      */
+    waitq_t wq;             /* writers waiting for room.      */
+    semaphore_t rsema;      /* one reader at a time.          */
+    semaphore_t wsema;      /* one writer at a time.          */
+} pipe_t;
+
+#define PIPE_OF(file)       ((pipe_t *) (file)->inode->ino)
+#define PIPE_USED(p)        ((p)->head - (p)->tail)
+#define PIPE_ROOM(p)        (PIPE_SIZE - PIPE_USED(p))
+#define PIPE_PAGE(p, pos)   ((p)->page[((pos)/PAGE_SIZE)%PIPE_PAGES])
+#define PIPE_PTR(p, pos)    (PIPE_PAGE(p, pos) + (pos)%PAGE_SIZE)
+#define PIPE_CHUNK(pos, n)  ((n) < PAGE_SIZE - (pos)%PAGE_SIZE ? \
+                             (n) : PAGE_SIZE - (pos)%PAGE_SIZE)
+
+/* pipes are anonymous inodes of this (never mounted) super block */
+static super_block_t pipe_sb = {
+    /* fsdriver: */ &pipefs_t,
+    /* dev:      */ NULL,
+    /* root_ino: */ 0,
+    /* icount:   */ 0,
+    /* mounts:   */ 0,
+    /* blksize:  */ PAGE_SIZE,
+    /* disksb:   */ NULL
+};
+
+/***************************************************************************/
+/*                              Ring Helpers                               */
+/***************************************************************************/
+
+static int32_t wait_data(pipe_t *pipe) {
+    /* wait until the pipe has data, returns 0 on EOF */
+    int32_t status, ret;
+    status = arch_get_int_status();
+    arch_disable_interrupts();
+    while (!PIPE_USED(pipe) && pipe->writers)
+        waitq_sleep(&pipe->rq);
+    ret = PIPE_USED(pipe);
+    arch_set_int_status(status);
+    return ret;
+}
+
+static int32_t wait_room(pipe_t *pipe) {
+    /* wait until the pipe has room, returns 0 if nobody reads */
+    int32_t status, ret;
+    status = arch_get_int_status();
+    arch_disable_interrupts();
+    while (!PIPE_ROOM(pipe) && pipe->readers)
+        waitq_sleep(&pipe->wq);
+    ret = pipe->readers ? PIPE_ROOM(pipe) : 0;
+    arch_set_int_status(status);
+    return ret;
+}
+
+static void consumed(pipe_t *pipe, uint32_t count) {
+    int32_t status = arch_get_int_status();
+    arch_disable_interrupts();
+    pipe->tail += count;
+    wake_up(&pipe->wq);
+    arch_set_int_status(status);
+}
+
+static void produced(pipe_t *pipe, uint32_t count) {
+    int32_t status = arch_get_int_status();
+    arch_disable_interrupts();
+    pipe->head += count;
+    wake_up(&pipe->rq);
+    arch_set_int_status(status);
+}
+
+static uint8_t *head_ptr(pipe_t *pipe) {
+    /* the page under the head, allocated if necessary */
+    if (!PIPE_PAGE(pipe, pipe->head) &&
+        !(PIPE_PAGE(pipe, pipe->head) = kmalloc(PAGE_SIZE)))
+        return NULL;
+    return PIPE_PTR(pipe, pipe->head);
+}
+
+/***************************************************************************/
+/*                              Inode Operations                           */
+/***************************************************************************/
+
+int32_t pipefs_read_inode(inode_t *inode) {
+    inode->ref     = 0;
+    inode->mode    = FT_FIFO;
+    inode->devid   = 0;
+    inode->size    = 0;
+    inode->blksize = PAGE_SIZE;
+    inode->blocks  = 0;
+    return ESUCCESS;
+}
+
+int32_t pipefs_update_inode(inode_t *inode) {
+    return ESUCCESS;
+}
+
+int32_t pipefs_put_inode(inode_t *inode) {
+
+    pipe_t *pipe = (pipe_t *) inode->ino;
+    int32_t i;
+
+    /* still referenced? */
+    if (inode->icount)
+        return ESUCCESS;
+
+    /* destroy the pipe */
+    for (i = 0; i < PIPE_PAGES; i++)
+        if (pipe->page[i])
+            kfree(pipe->page[i]);
+    kfree(pipe);
+    return ESUCCESS;
+
+}
+
+int32_t pipefs_lookup(inode_t *dir, char *name, inode_t **ret) {
+    return ENOTDIR;
+}
+
+int32_t pipefs_mknod(inode_t *dir, char *name, int32_t mode, int32_t devid) {
+    return ENOTDIR;
+}
+
+int32_t pipefs_link(inode_t *inode, inode_t *dir, char *name) {
+    return ENOTDIR;
+}
+
+int32_t pipefs_unlink(inode_t *dir, char *name) {
+    return ENOTDIR;
+}
+
+int32_t pipefs_mkdir(inode_t *dir, char *name, int32_t mode) {
+    return ENOTDIR;
+}
+
+int32_t pipefs_rmdir(inode_t *dir, char *name) {
+    return ENOTDIR;
+}
+
+int32_t pipefs_truncate(inode_t *inode, pos_t length) {
+    return EINVAL;
+}
+
+/***************************************************************************/
+/*                              File Operations                            */
+/***************************************************************************/
+
+int32_t pipefs_open(file_t *file) {
+    return ESUCCESS;
+}
+
+int32_t pipefs_release(file_t *file) {
+
+    /* one end less, let the other side notice */
+    pipe_t *pipe = PIPE_OF(file);
+    int32_t status;
+
+    status = arch_get_int_status();
+    arch_disable_interrupts();
+    if (file->info.pipefs.end == PIPE_READ)
+        pipe->readers--;
+    else
+        pipe->writers--;
+    wake_up(&pipe->rq);
+    wake_up(&pipe->wq);
+    arch_set_int_status(status);
+
+    return ESUCCESS;
+
+}
+
+int32_t pipefs_read(file_t *file, void *buf, int32_t size) {
+
+    /* read whatever is available (at most size bytes), blocks
+     * only if the pipe is empty.
+     */
+    pipe_t *pipe = PIPE_OF(file);
+    uint32_t avail, chunk, done = 0;
+
+    if (file->info.pipefs.end != PIPE_READ || size < 0)
+        return EINVAL;
+
+    sema_down(&pipe->rsema);
+    avail = wait_data(pipe);
+    if (avail > size)
+        avail = size;
+    while (done < avail) {
+        chunk = PIPE_CHUNK(pipe->tail, avail-done);
+        memcpy(((uint8_t *) buf)+done, PIPE_PTR(pipe, pipe->tail), chunk);
+        consumed(pipe, chunk);
+        done += chunk;
+    }
+    sema_up(&pipe->rsema);
+
+    file->pos += done;
+    return ESUCCESS;
+
+}
+
+int32_t pipefs_write(file_t *file, void *buf, int32_t size) {
+
+    /* write all of buf, blocking whenever the pipe is full */
+    pipe_t *pipe = PIPE_OF(file);
+    uint32_t room, chunk, done = 0;
+    uint8_t *ptr;
+    int32_t err = ESUCCESS;
+
+    if (file->info.pipefs.end != PIPE_WRITE || size < 0)
+        return EINVAL;
+
+    sema_down(&pipe->wsema);
+    while (done < size) {
+        if (!(room = wait_room(pipe))) {
+            err = EPIPE;
+            break;
+        }
+        if (!(ptr = head_ptr(pipe))) {
+            err = ENOMEM;
+            break;
+        }
+        chunk = PIPE_CHUNK(pipe->head, room < size-done ? room : size-done);
+        memcpy(ptr, ((uint8_t *) buf)+done, chunk);
+        produced(pipe, chunk);
+        done += chunk;
+    }
+    sema_up(&pipe->wsema);
+
+    /* a partial write is still a success */
+    file->pos += done;
+    return done ? ESUCCESS : err;
+
+}
+
+int32_t pipefs_seek(file_t *file, pos_t newpos) {
+    return EINVAL;
+}
+
+int32_t pipefs_readdir(file_t *dir, dirent_t *dirent) {
+    return ENOTDIR;
+}
+
+int32_t pipefs_getdents(file_t *dir, void *buf, int32_t size,
+                        int32_t *done) {
+    return ENOTDIR;
+}
+
+int32_t pipefs_ioctl(file_t *file, int32_t cmd, void *arg) {
+    return EINVAL;
+}
+
+int32_t pipefs_poll(file_t *file, poll_table_t *pt) {
+
+    pipe_t *pipe = PIPE_OF(file);
+
+    poll_wait(pt, &pipe->rq);
+    poll_wait(pt, &pipe->wq);
+
+    if (file->info.pipefs.end == PIPE_READ)
+        return (PIPE_USED(pipe) ? POLLIN : 0) | (pipe->writers ? 0 : POLLHUP);
+    else
+        return (PIPE_ROOM(pipe) ? POLLOUT : 0) | (pipe->readers ? 0 : POLLERR);
+
+}
+
+/***************************************************************************/
+/*                                pipe()                                   */
+/***************************************************************************/
+
+static file_t *pipe_file(inode_t *inode, int32_t end) {
+
+    /* make an open file for one end of the pipe */
+    file_t *file;
+
+    if (!(file = kmalloc(sizeof(file_t))))
+        return NULL;
+    if (!(file->path = kmalloc(sizeof("pipe:")))) {
+        kfree(file);
+        return NULL;
+    }
+    strcpy(file->path, "pipe:");
+    file->fcount = 1;
+    file->mp     = NULL;
+    file->inode  = inode;
+    file->pos    = 0;
+    file->info.pipefs.end = end;
+    return file;
+
+}
+
+int32_t pipe(int32_t *fds) {
+
+    pipe_t *pipe;
+    inode_t *inode;
+    int32_t rfd, wfd, i;
+
+    /* look for two free descriptors */
+    for (rfd = 0; rfd < FD_MAX && curproc->file[rfd]; rfd++);
+    for (wfd = rfd+1; wfd < FD_MAX && curproc->file[wfd]; wfd++);
+    if (wfd >= FD_MAX)
+        return -EMFILE;
+
+    /* allocate the pipe */
+    if (!(pipe = kmalloc(sizeof(pipe_t))))
+        return -ENOMEM;
+    for (i = 0; i < PIPE_PAGES; i++)
+        pipe->page[i] = NULL;
+    pipe->head    = 0;
+    pipe->tail    = 0;
+    pipe->readers = 1;
+    pipe->writers = 1;
+    waitq_init(&pipe->rq);
+    waitq_init(&pipe->wq);
+    sema_init(&pipe->rsema, 1);
+    sema_init(&pipe->wsema, 1);
+
+    /* get an anonymous inode for it, one reference per end */
+    if (!(inode = (inode_t *) iget(&pipe_sb, (ino_t) pipe))) {
+        kfree(pipe);
+        return -ENOMEM;
+    }
+    iget(&pipe_sb, (ino_t) pipe);
+
+    /* open both ends */
+    curproc->file[rfd] = pipe_file(inode, PIPE_READ);
+    curproc->file[wfd] = pipe_file(inode, PIPE_WRITE);
+    if (!curproc->file[rfd] || !curproc->file[wfd]) {
+        for (i = 0; i < 2; i++) {
+            int32_t fd = i ? wfd : rfd;
+            if (curproc->file[fd]) {
+                kfree(curproc->file[fd]->path);
+                kfree(curproc->file[fd]);
+                curproc->file[fd] = NULL;
+            }
+        }
+        iput(inode);
+        iput(inode);
+        return -ENOMEM;
+    }
+
+    /* done */
+    fds[0] = rfd;
+    fds[1] = wfd;
+    return ESUCCESS;
+
+}
+
+/***************************************************************************/
+/*                               splice()                                  */
+/***************************************************************************/
+
+static int32_t is_pipe(file_t *file, int32_t end) {
+    return (file->inode->mode & FT_MASK) == FT_FIFO &&
+           file->info.pipefs.end == end;
+}
+
+static int32_t splice_to_file(pipe_t *pipe, file_t *out, uint32_t size) {
+
+    /* write pipe pages straight to the file */
+    uint32_t avail, chunk, moved = 0;
+    ssize_t done;
+    int32_t err = ESUCCESS;
+
+    avail = wait_data(pipe);
+    if (avail > size)
+        avail = size;
+    while (moved < avail) {
+        chunk = PIPE_CHUNK(pipe->tail, avail-moved);
+        if (err = file_write(out, PIPE_PTR(pipe, pipe->tail), chunk, &done))
+            break;
+        consumed(pipe, done);
+        moved += done;
+        if (done < chunk)
+            break;
+    }
+
+    return moved ? moved : -err;
+
+}
+
+static int32_t splice_from_file(file_t *in, pipe_t *pipe, uint32_t size) {
+
+    /* read from the file straight into pipe pages */
+    uint32_t room, chunk, moved = 0;
+    ssize_t done;
+    uint8_t *ptr;
+    int32_t err = ESUCCESS;
+
+    if (!(room = wait_room(pipe)))
+        return -EPIPE;
+    if (room > size)
+        room = size;
+    while (moved < room) {
+        if (!(ptr = head_ptr(pipe))) {
+            err = ENOMEM;
+            break;
+        }
+        chunk = PIPE_CHUNK(pipe->head, room-moved);
+        if ((err = file_read(in, ptr, chunk, &done)) || !done)
+            break;
+        produced(pipe, done);
+        moved += done;
+        if (done < chunk)
+            break;
+    }
+
+    return moved ? moved : -err;
+
+}
+
+static int32_t splice_pipes(pipe_t *src, pipe_t *dest, uint32_t size) {
+
+    /* move data between two pipes. whole pages are passed over
+     * by swapping page pointers, the rest is copied.
+     */
+    uint32_t avail, room, chunk, moved = 0;
+    uint8_t *ptr, *tmp;
+    int32_t status;
+
+    if (!(avail = wait_data(src)))
+        return 0;
+    if (!(room = wait_room(dest)))
+        return -EPIPE;
+    if (avail > size)
+        avail = size;
+    while (moved < avail && moved < room) {
+        if (!(src->tail % PAGE_SIZE) && !(dest->head % PAGE_SIZE) &&
+            avail-moved >= PAGE_SIZE && room-moved >= PAGE_SIZE) {
+            /* the page under src's tail is fully written and the page
+             * under dest's head is fully free; no one else can touch
+             * either of them while we hold both locks.
+             */
+            status = arch_get_int_status();
+            arch_disable_interrupts();
+            tmp = PIPE_PAGE(dest, dest->head);
+            PIPE_PAGE(dest, dest->head) = PIPE_PAGE(src, src->tail);
+            PIPE_PAGE(src, src->tail) = tmp;
+            arch_set_int_status(status);
+            chunk = PAGE_SIZE;
+        } else {
+            if (!(ptr = head_ptr(dest)))
+                break;
+            chunk = PIPE_CHUNK(src->tail, avail-moved);
+            chunk = PIPE_CHUNK(dest->head, room-moved < chunk ?
+                                           room-moved : chunk);
+            memcpy(ptr, PIPE_PTR(src, src->tail), chunk);
+        }
+        consumed(src, chunk);
+        produced(dest, chunk);
+        moved += chunk;
+    }
+
+    return moved ? moved : -ENOMEM;
+
+}
+
+int32_t splice(int32_t fd_in, int32_t fd_out, uint32_t size) {
+
+    /* move up to size bytes from fd_in to fd_out without passing
+     * them through user space. at least one of them must be a pipe.
+     * blocks until something can be moved, returns the count of
+     * bytes moved (0 at the end of input).
+     */
+    file_t *in, *out;
+    pipe_t *src = NULL, *dest = NULL;
+    int32_t ret;
+
+    /* fds must be valid open descriptors: */
+    if (fd_in < 0 || fd_in >= FD_MAX || !(in = curproc->file[fd_in]) ||
+        fd_out < 0 || fd_out >= FD_MAX || !(out = curproc->file[fd_out]))
+        return -EBADF;
+
+    /* find out the pipes */
+    if (is_pipe(in, PIPE_READ))
+        src = PIPE_OF(in);
+    if (is_pipe(out, PIPE_WRITE))
+        dest = PIPE_OF(out);
+    if ((!src && !dest) || !size)
+        return -EINVAL;
+
+    /* lock the ends we are using and do the move */
+    if (src)
+        sema_down(&src->rsema);
+    if (dest)
+        sema_down(&dest->wsema);
+
+    if (src && dest)
+        ret = splice_pipes(src, dest, size);
+    else if (src)
+        ret = splice_to_file(src, out, size);
+    else
+        ret = splice_from_file(in, dest, size);
+
+    if (dest)
+        sema_up(&dest->wsema);
+    if (src)
+        sema_up(&src->rsema);
+
+    return ret;
+
+}
+
+/***************************************************************************/
+/*                            fsd_t structure                              */
+/***************************************************************************/
+
+fsd_t pipefs_t = {
+
+    /* alias:        */ "pipefs",
+    /* flags:        */ 0,
+
+    /* read_super:   */ NULL,
+    /* write_super:  */ NULL,
+    /* put_super:    */ NULL,
+    /* read_inode:   */ pipefs_read_inode,
+    /* update_inode: */ pipefs_update_inode,
+    /* put_inode:    */ pipefs_put_inode,
+
+    /* lookup:       */ pipefs_lookup,
+    /* mknod:        */ pipefs_mknod,
+    /* link:         */ pipefs_link,
+    /* unlink:       */ pipefs_unlink,
+    /* mkdir:        */ pipefs_mkdir,
+    /* rmdir:        */ pipefs_rmdir,
+    /* truncate:     */ pipefs_truncate,
+
+    /* open:         */ pipefs_open,
+    /* release:      */ pipefs_release,
+    /* read:         */ pipefs_read,
+    /* write:        */ pipefs_write,
+    /* seek:         */ pipefs_seek,
+    /* pread:        */ NULL,
+    /* pwrite:       */ NULL,
+    /* readdir:      */ pipefs_readdir,
+    /* getdents:     */ pipefs_getdents,
+    /* ioctl:        */ pipefs_ioctl,
+    /* poll:         */ pipefs_poll
+
+};
@@ -0,0 +1,160 @@
+/*
+ *        +----------------------------------------------------------+
+ *        | +------------------------------------------------------+ |
+ *        | |  Quafios Kernel 2.0.1.                               | |
+ *        | |  -> Filesystem: poll().                              | |
+ *        | +------------------------------------------------------+ |
+ *        +----------------------------------------------------------+
+ *
+ * This file is part of Quafios 2.0.1 source code.
+ * Copyright (C) 2015  Mostafa Abd El-Aziz Mohamed.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Quafios.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Visit http://www.quafios.com/ for contact information.
+ *
+ */
+
+#include <arch/type.h>
+#include <lib/string.h>
+#include <sys/error.h>
+#include <sys/mm.h>
+#include <sys/fs.h>
+#include <sys/scheduler.h>
+#include <sys/waitq.h>
+#include <sys/poll.h>
+
+/***************************************************************************/
+/*                             file_poll()                                 */
+/***************************************************************************/
+
+int32_t file_poll(file_t *file, poll_table_t *pt) {
+
+    switch(file->inode->mode & FT_MASK) {
+        case FT_REGULAR:
+        case FT_DIR:
+        return POLLIN | POLLOUT;
+
+        case FT_SPECIAL:
+        return dev_poll(file->inode->dev, pt);
+
+        case FT_FIFO:
+        return file->inode->sb->fsdriver->poll(file, pt);
+    }
+
+    return POLLERR;
+
+}
+
+/***************************************************************************/
+/*                                poll()                                   */
+/***************************************************************************/
+
+static int32_t poll_one(pollfd_t *pfd, poll_table_t *pt) {
+
+    /* readiness of one entry, returns its revents */
+    if (pfd->fd == POLL_INBOX)
+        return curproc->inbox.count ? pfd->events & POLLIN : 0;
+
+    if (pfd->fd < 0)
+        return 0; /* ignored */
+
+    if (pfd->fd >= FD_MAX || curproc->file[pfd->fd] == NULL)
+        return POLLNVAL;
+
+    return file_poll(curproc->file[pfd->fd], pt) &
+           (pfd->events | POLLERR | POLLHUP);
+
+}
+
+int32_t poll(pollfd_t *fds, uint32_t nfds, int32_t timeout) {
+
+    /* wait until one of the fds is ready, the inbox has a message,
+     * or timeout milliseconds pass (-1 waits forever, 0 doesn't
+     * wait at all). returns the count of ready entries.
+     */
+    pollfd_t *kfds;
+    poll_table_t pt, *ptp;
+    waiter_t timer;
+    uint32_t i;
+    int32_t status, count, inbox = 0;
+
+    /* check the arguments */
+    if (nfds > POLL_MAX)
+        return -EINVAL;
+
+    /* work on a kernel copy so that no page faults happen
+     * while interrupts are disabled. every entry may register
+     * at two queues (reading and writing ends).
+     */
+    if (!(kfds = kmalloc(nfds*(sizeof(pollfd_t) + 2*sizeof(waiter_t))+1)))
+        return -ENOMEM;
+    memcpy(kfds, fds, nfds*sizeof(pollfd_t));
+    for (i = 0; i < nfds; i++)
+        if (kfds[i].fd == POLL_INBOX)
+            inbox = 1;
+
+    /* initialize the poll table */
+    pt.waiter = (waiter_t *) &kfds[nfds];
+    pt.count  = 0;
+    pt.max    = 2*nfds;
+    ptp       = &pt;
+    timer.queue = NULL;
+
+    /* enter critical region */
+    status = arch_get_int_status();
+    arch_disable_interrupts();
+
+    /* arm the timeout */
+    if (timeout > 0)
+        waitq_timeout(&timer, ticks + (timeout+9)/10);
+
+    while (1) {
+        /* check all entries, register at the queues on the first pass */
+        count = 0;
+        for (i = 0; i < nfds; i++)
+            if (kfds[i].revents = poll_one(&kfds[i], ptp))
+                count++;
+        ptp = NULL;
+
+        /* done? */
+        if (count || !timeout || (timeout > 0 && ticks >= timer.when))
+            break;
+
+        /* sleep until a queue is woken, a message arrives or
+         * the timeout expires.
+         */
+        if (inbox)
+            curproc->blocked_for_msg = 1;
+        handoff(NULL, 1);
+    }
+
+    /* leave all queues */
+    curproc->blocked_for_msg = 0;
+    for (i = 0; i < pt.count; i++)
+        waitq_remove(&pt.waiter[i]);
+    waitq_remove(&timer);
+
+    /* exit critical region */
+    arch_set_int_status(status);
+
+    /* copy the results */
+    for (i = 0; i < nfds; i++)
+        fds[i].revents = kfds[i].revents;
+    kfree(kfds);
+
+    /* done */
+    return count;
+
+}
@@ -27,9 +27,14 @@
  */
 
 #include <arch/type.h>
+#include <arch/page.h>
+#include <sys/mm.h>
 #include <sys/fs.h>
 #include <sys/scheduler.h>
 
+/* buffer used by copy_file_range() */
+#define COPY_CHUNK      (16*PAGE_SIZE)
+
 /***************************************************************************/
 /*                             file_read()                                 */
 /***************************************************************************/
@@ -41,6 +46,7 @@ int32_t file_read(file_t *file, void *buf, size_t count, ssize_t *done) {
 
     switch(file->inode->mode & FT_MASK) {
         case FT_REGULAR:
+        case FT_FIFO:
         err = file->inode->sb->fsdriver->read(file, buf, count);
         *done = (ssize_t) (file->pos - oldpos);
         break;
@@ -98,6 +104,7 @@ int32_t file_write(file_t *file, void *buf, size_t count, ssize_t *done) {
 
     switch(file->inode->mode & FT_MASK) {
         case FT_REGULAR:
+        case FT_FIFO:
         err = file->inode->sb->fsdriver->write(file, buf, count);
         break;
 
@@ -142,6 +149,257 @@ int32_t write(int32_t fd, void *buf, size_t count) {
 
 }
 
+/***************************************************************************/
+/*                             file_pread()                                */
+/***************************************************************************/
+
+int32_t file_pread(file_t *file, void *buf, size_t count, pos_t pos,
+                   ssize_t *done) {
+
+    int32_t err;
+    fsd_t *fsd = file->inode->sb->fsdriver;
+    pos_t oldpos;
+
+    *done = 0;
+    switch(file->inode->mode & FT_MASK) {
+        case FT_REGULAR:
+        if (fsd->pread) {
+            err = fsd->pread(file, buf, count, pos, done);
+        } else {
+            /* no positional read, borrow file->pos */
+            oldpos = file->pos;
+            fsd->seek(file, pos);
+            err = fsd->read(file, buf, count);
+            *done = (ssize_t) (file->pos - pos);
+            fsd->seek(file, oldpos);
+        }
+        break;
+
+        case FT_FIFO:
+        err = ESPIPE;
+        break;
+
+        case FT_DIR:
+        err = EISDIR;
+        break;
+
+        case FT_SPECIAL:
+        dev_read(file->inode->dev, pos, count, buf);
+        err = ESUCCESS;
+        *done = count;
+        break;
+    }
+
+    return err;
+
+}
+
+/***************************************************************************/
+/*                                pread()                                  */
+/***************************************************************************/
+
+int32_t pread(int32_t fd, void *buf, size_t count, pos_t pos) {
+
+    int32_t err;
+    ssize_t done;
+
+    /* fd must be a valid open descriptor: */
+    if (fd < 0 || fd >= FD_MAX || curproc->file[fd] == NULL)
+        return -EBADF;
+
+    /* do the read: */
+    err = file_pread(curproc->file[fd], buf, count, pos, &done);
+
+    /* return result: */
+    if (!err) {
+        return done;
+    } else {
+        return -err;
+    }
+
+}
+
+/***************************************************************************/
+/*                            file_pwrite()                                */
+/***************************************************************************/
+
+int32_t file_pwrite(file_t *file, void *buf, size_t count, pos_t pos,
+                    ssize_t *done) {
+
+    int32_t err;
+    fsd_t *fsd = file->inode->sb->fsdriver;
+    pos_t oldpos;
+
+    *done = 0;
+    switch(file->inode->mode & FT_MASK) {
+        case FT_REGULAR:
+        if (fsd->pwrite) {
+            err = fsd->pwrite(file, buf, count, pos, done);
+        } else {
+            /* no positional write, borrow file->pos */
+            oldpos = file->pos;
+            fsd->seek(file, pos);
+            err = fsd->write(file, buf, count);
+            *done = (ssize_t) (file->pos - pos);
+            fsd->seek(file, oldpos);
+        }
+        break;
+
+        case FT_FIFO:
+        err = ESPIPE;
+        break;
+
+        case FT_DIR:
+        err = EISDIR;
+        break;
+
+        case FT_SPECIAL:
+        dev_write(file->inode->dev, pos, count, buf);
+        err = ESUCCESS;
+        *done = count;
+        break;
+    }
+
+    return err;
+
+}
+
+/***************************************************************************/
+/*                               pwrite()                                  */
+/***************************************************************************/
+
+int32_t pwrite(int32_t fd, void *buf, size_t count, pos_t pos) {
+
+    int32_t err;
+    ssize_t done;
+
+    /* fd must be a valid open descriptor: */
+    if (fd < 0 || fd >= FD_MAX || curproc->file[fd] == NULL)
+        return -EBADF;
+
+    /* do the write: */
+    err = file_pwrite(curproc->file[fd], buf, count, pos, &done);
+
+    /* return result: */
+    if (!err) {
+        return done;
+    } else {
+        return -err;
+    }
+
+}
+
+/***************************************************************************/
+/*                             file_readv()                                */
+/***************************************************************************/
+
+int32_t file_readv(file_t *file, iovec_t *iov, int32_t iovcnt,
+                   ssize_t *done) {
+
+    int32_t i, err = ESUCCESS;
+    ssize_t part;
+
+    /* fill the buffers in order, stop at the first short read: */
+    *done = 0;
+    for (i = 0; i < iovcnt; i++) {
+        if (!iov[i].len)
+            continue;
+        if (err = file_read(file, iov[i].base, iov[i].len, &part))
+            break;
+        *done += part;
+        if (part < iov[i].len)
+            break;
+    }
+
+    /* an error after some data only makes the count short */
+    return *done ? ESUCCESS : err;
+
+}
+
+/***************************************************************************/
+/*                                readv()                                  */
+/***************************************************************************/
+
+int32_t readv(int32_t fd, iovec_t *iov, int32_t iovcnt) {
+
+    int32_t err;
+    ssize_t done;
+
+    /* fd must be a valid open descriptor: */
+    if (fd < 0 || fd >= FD_MAX || curproc->file[fd] == NULL)
+        return -EBADF;
+
+    /* sane count of buffers? */
+    if (iovcnt < 0 || iovcnt > IOV_MAX)
+        return -EINVAL;
+
+    /* do the read: */
+    err = file_readv(curproc->file[fd], iov, iovcnt, &done);
+
+    /* return result: */
+    if (!err) {
+        return done;
+    } else {
+        return -err;
+    }
+
+}
+
+/***************************************************************************/
+/*                             file_writev()                               */
+/***************************************************************************/
+
+int32_t file_writev(file_t *file, iovec_t *iov, int32_t iovcnt,
+                    ssize_t *done) {
+
+    int32_t i, err = ESUCCESS;
+    ssize_t part;
+
+    /* write the buffers in order, stop at the first short write: */
+    *done = 0;
+    for (i = 0; i < iovcnt; i++) {
+        if (!iov[i].len)
+            continue;
+        err = file_write(file, iov[i].base, iov[i].len, &part);
+        *done += part;
+        if (err || part < iov[i].len)
+            break;
+    }
+
+    /* an error after some data only makes the count short */
+    return *done ? ESUCCESS : err;
+
+}
+
+/***************************************************************************/
+/*                               writev()                                  */
+/***************************************************************************/
+
+int32_t writev(int32_t fd, iovec_t *iov, int32_t iovcnt) {
+
+    int32_t err;
+    ssize_t done;
+
+    /* fd must be a valid open descriptor: */
+    if (fd < 0 || fd >= FD_MAX || curproc->file[fd] == NULL)
+        return -EBADF;
+
+    /* sane count of buffers? */
+    if (iovcnt < 0 || iovcnt > IOV_MAX)
+        return -EINVAL;
+
+    /* do the write: */
+    err = file_writev(curproc->file[fd], iov, iovcnt, &done);
+
+    /* return result: */
+    if (!err) {
+        return done;
+    } else {
+        return -err;
+    }
+
+}
+
 /***************************************************************************/
 /*                             file_seek()                                 */
 /***************************************************************************/
@@ -174,6 +432,7 @@ void file_seek(file_t *file, pos_t offset, pos_t *result, int32_t whence) {
         break;
 
         case FT_DIR:
+        case FT_FIFO:
         break;
 
         case FT_SPECIAL:
@@ -203,3 +462,86 @@ int32_t seek(int32_t fd, pos_t offset, pos_t *result, int32_t whence) {
     return 0;
 
 }
+
+/***************************************************************************/
+/*                           file_copy_range()                             */
+/***************************************************************************/
+
+int32_t file_copy_range(file_t *in, pos_t pin, file_t *out, pos_t pout,
+                        size_t len, ssize_t *done) {
+
+    /* copy len bytes from in at pin to out at pout, through a kernel
+     * buffer and the page caches of both files. chunks are aligned
+     * to pages of the input.
+     */
+    uint8_t *buf;
+    uint32_t size = COPY_CHUNK;
+    size_t chunk;
+    ssize_t rd, wr;
+    int32_t err = ESUCCESS;
+
+    /* overlapping ranges of the same file? */
+    *done = 0;
+    if (in->inode == out->inode && pin < pout + len && pout < pin + len)
+        return EINVAL;
+
+    /* the buffer, a single page if memory is short: */
+    if (!(buf = kmalloc(size)) && !(buf = kmalloc(size = PAGE_SIZE)))
+        return ENOMEM;
+
+    while (*done < len) {
+        chunk = size - (pin + *done) % PAGE_SIZE;
+        if (chunk > len - *done)
+            chunk = len - *done;
+        if ((err = file_pread(in, buf, chunk, pin + *done, &rd)) || !rd)
+            break;
+        err = file_pwrite(out, buf, rd, pout + *done, &wr);
+        *done += wr;
+        if (err || wr < rd || rd < chunk)
+            break;
+    }
+
+    kfree(buf);
+
+    /* an error after some data only makes the count short */
+    return *done ? ESUCCESS : err;
+
+}
+
+/***************************************************************************/
+/*                           copy_file_range()                             */
+/***************************************************************************/
+
+int32_t copy_file_range(int32_t fd_in, pos_t *off_in,
+                        int32_t fd_out, pos_t *off_out, size_t len) {
+
+    /* a NULL offset means the file position, which is then moved */
+    file_t *in, *out;
+    int32_t err;
+    ssize_t done;
+
+    /* fds must be valid open descriptors: */
+    if (fd_in < 0 || fd_in >= FD_MAX || !(in = curproc->file[fd_in]) ||
+        fd_out < 0 || fd_out >= FD_MAX || !(out = curproc->file[fd_out]))
+        return -EBADF;
+
+    /* do the copy: */
+    err = file_copy_range(in,  off_in  ? *off_in  : in->pos,
+                          out, off_out ? *off_out : out->pos, len, &done);
+    if (err)
+        return -err;
+
+    /* move the offsets: */
+    if (off_in)
+        *off_in += done;
+    else
+        in->pos += done;
+    if (off_out)
+        *off_out += done;
+    else
+        out->pos += done;
+
+    /* return result: */
+    return done;
+
+}
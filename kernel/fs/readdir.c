@@ -27,6 +27,7 @@
  */
 
 #include <arch/type.h>
+#include <lib/string.h>
 #include <sys/fs.h>
 #include <sys/scheduler.h>
 
@@ -59,3 +60,67 @@ int32_t readdir(int32_t fd, dirent_t *dirp) {
     return -file_readdir(curproc->file[fd], dirp);
 
 }
+
+/***************************************************************************/
+/*                             dirent_pack()                               */
+/***************************************************************************/
+
+int32_t dirent_pack(void *buf, int32_t size, int32_t *done,
+                    ino_t ino, char *name) {
+
+    /* append a record to a getdents() buffer, 0 if it doesn't fit. */
+    int32_t namelen = strlen(name);
+    int32_t reclen  = DIRENT_REC_LEN(namelen);
+    dirent_rec_t *rec = (dirent_rec_t *) ((uint8_t *) buf + *done);
+
+    if (*done + reclen > size)
+        return 0;
+
+    rec->ino     = ino;
+    rec->reclen  = reclen;
+    rec->namelen = namelen;
+    memcpy(rec->name, name, namelen+1);
+    *done += reclen;
+    return 1;
+
+}
+
+/***************************************************************************/
+/*                           file_getdents()                               */
+/***************************************************************************/
+
+int32_t file_getdents(file_t *file, void *buf, int32_t size, int32_t *done) {
+
+    /* file must be directory: */
+    *done = 0;
+    if ((file->inode->mode & FT_MASK) != FT_DIR)
+        return ENOTDIR;
+
+    /* give control to filesystem driver. */
+    return file->inode->sb->fsdriver->getdents(file, buf, size, done);
+
+}
+
+/***************************************************************************/
+/*                              getdents()                                 */
+/***************************************************************************/
+
+int32_t getdents(int32_t fd, void *buf, int32_t size) {
+
+    int32_t err, done;
+
+    /* fd must be a valid open descriptor: */
+    if (fd < 0 || fd >= FD_MAX || curproc->file[fd] == NULL)
+        return -EBADF;
+
+    /* fill the buffer: */
+    err = file_getdents(curproc->file[fd], buf, size, &done);
+
+    /* return result: */
+    if (!err) {
+        return done;
+    } else {
+        return -err;
+    }
+
+}
@@ -56,7 +56,7 @@ int32_t stat(char *pathname, stat_t *buf) {
     int32_t err;
 
     /* get the inode structure: */
-    if (err = namei(NULL, pathname, &namei_data))
+    if (err = namei(NULL, pathname, 0, &namei_data))
         return -err;
 
     /* do the stat: */
@@ -65,9 +65,6 @@ int32_t stat(char *pathname, stat_t *buf) {
     /* drop the inode: */
     iput(namei_data.inode);
 
-    /* free the memory used by namei returned path: */
-    kfree(namei_data.path);
-
     /* done: */
     return ESUCCESS;
 
@@ -29,6 +29,8 @@
 #include <arch/type.h>
 #include <sys/mm.h>
 #include <sys/fs.h>
+#include <sys/dcache.h>
+#include <sys/icache.h>
 
 /* Supported Filesystems:  */
 /* ----------------------- */
@@ -36,7 +38,8 @@ fsd_t *fsdrivers[] = {
     &tmpfs_t,
     &devfs_t,
     &sysfs_t,
-    &diskfs_t
+    &diskfs_t,
+    &iso9660_t
 };
 
 /* root mount point: */
@@ -92,12 +95,11 @@ int32_t mount(char *devfile, char *mntpoint, char *fstype,
 
         /* get the inode of the device file: */
         namei_data;
-        err = namei(NULL, devfile, &namei_data);
+        err = namei(NULL, devfile, 0, &namei_data);
 
         /* exists? */
         if (err)
             return -ENODEV;
-        kfree(namei_data.path); /* not needed now. */
 
         /* device file? */
         i = namei_data.inode;
@@ -121,13 +123,12 @@ int32_t mount(char *devfile, char *mntpoint, char *fstype,
         /* get the inode of the mount point: */
         namei_t namei_data;
         int32_t err;
-        if (err = namei(NULL, mntpoint, &namei_data))
+        if (err = namei(NULL, mntpoint, 0, &namei_data))
             return -err;
 
         /* extract data: */
         mp_inode = namei_data.inode;
         vfsparent = namei_data.mp;
-        kfree(namei_data.path); /* not needed now. */
 
         /* must be directory: */
         if ((mp_inode->mode & FT_MASK) != FT_DIR) {
@@ -205,13 +206,12 @@ int32_t umount(char *target) {
 
     /* get the inode of `target': */
     int32_t err;
-    if (err = namei(NULL, target, &namei_data))
+    if (err = namei(NULL, target, 0, &namei_data))
         return -err;
 
     /* extract data: */
     inode = namei_data.inode;
     vfsmount = namei_data.mp;
-    kfree(namei_data.path); /* not needed now. */
 
     /* root directory? */
     if (inode->ino != inode->sb->root_ino) {
@@ -223,6 +223,12 @@ int32_t umount(char *target) {
     sb = inode->sb;
     iput(inode);
 
+    /* write back changes, the file system holds on to the inodes
+     * that have some until then:
+     */
+    if (sb->mounts == 1 && sb->fsdriver->sync)
+        sb->fsdriver->sync(sb, NULL);
+
     /* put super block: */
     if (sb->mounts > 1) {
         sb->mounts--;
@@ -231,6 +237,8 @@ int32_t umount(char *target) {
     } else {
         if (sb->dev)
             sb->dev->sb = NULL;
+        dcache_purge(sb, DCACHE_ANY);
+        icache_purge(sb);
         sb->fsdriver->put_super(sb);
     }
 
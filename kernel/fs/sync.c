@@ -0,0 +1,137 @@
+/*
+ *        +----------------------------------------------------------+
+ *        | +------------------------------------------------------+ |
+ *        | |  Quafios Kernel 2.0.1.                               | |
+ *        | |  -> Filesystem: sync().                              | |
+ *        | +------------------------------------------------------+ |
+ *        +----------------------------------------------------------+
+ *
+ * This file is part of Quafios 2.0.1 source code.
+ * Copyright (C) 2015  Mostafa Abd El-Aziz Mohamed.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Quafios.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Visit http://www.quafios.com/ for contact information.
+ *
+ */
+
+#include <arch/type.h>
+#include <sys/error.h>
+#include <sys/fs.h>
+#include <sys/device.h>
+#include <sys/scheduler.h>
+#include <sys/waitq.h>
+
+/* file systems keep changes in memory and write them back later;
+ * the flusher task does so every SYNC_INTERVAL ticks, and earlier
+ * when the page cache says too much is waiting (sync_wake()).
+ */
+#define SYNC_INTERVAL   500 /* ticks (5 seconds). */
+
+static waitq_t sync_wq = {NULL, NULL, 0};
+
+/***************************************************************************/
+/*                              sync_all()                                 */
+/***************************************************************************/
+
+int32_t sync_all() {
+
+    /* write back every mounted file system */
+    device_t *dev;
+    super_block_t *sb;
+    int32_t err = ESUCCESS, e;
+
+    for (dev = (device_t *) devices.first; dev; dev = dev->next) {
+        if (!(sb = dev->sb) || !sb->fsdriver->sync)
+            continue;
+        if (e = sb->fsdriver->sync(sb, NULL))
+            err = e;
+    }
+    return err;
+
+}
+
+/***************************************************************************/
+/*                                sync()                                   */
+/***************************************************************************/
+
+int32_t sync() {
+
+    /* sync() System Call. */
+    sync_all();
+    return 0;
+
+}
+
+/***************************************************************************/
+/*                                fsync()                                  */
+/***************************************************************************/
+
+int32_t fsync(int32_t fd) {
+
+    /* fsync() System Call: write back one file. */
+    inode_t *inode;
+
+    /* fd must be a valid open descriptor: */
+    if (fd < 0 || fd >= FD_MAX || curproc->file[fd] == NULL)
+        return -EBADF;
+
+    /* file systems without a sync hook write through: */
+    inode = curproc->file[fd]->inode;
+    if (!inode->sb->fsdriver->sync)
+        return 0;
+    return -inode->sb->fsdriver->sync(inode->sb, inode);
+
+}
+
+/***************************************************************************/
+/*                               flusher                                   */
+/***************************************************************************/
+
+void sync_wake() {
+    /* start writing back now rather than when the interval ends */
+    wake_up(&sync_wq);
+}
+
+static void flusher() {
+
+    /* the flusher kernel task */
+    waiter_t w, timer;
+    int32_t status;
+
+    while (1) {
+        /* sleep until woken or the interval ends */
+        status = arch_get_int_status();
+        arch_disable_interrupts();
+        waitq_add(&sync_wq, &w);
+        waitq_timeout(&timer, ticks + SYNC_INTERVAL);
+        handoff(NULL, 1);
+        waitq_remove(&w);
+        waitq_remove(&timer);
+        arch_set_int_status(status);
+
+        /* write back: */
+        sync_all();
+    }
+
+}
+
+void sync_init() {
+
+    /* start the flusher: */
+    if (kthread(flusher) < 0)
+        printk("Couldn't start the flusher, writes are kept in memory "
+               "until sync().\n");
+
+}
@@ -30,6 +30,7 @@
 #include <lib/string.h>
 #include <sys/mm.h>
 #include <sys/fs.h>
+#include <sys/dcache.h>
 #include <fs/tmpfs.h>
 
 super_block_t *sysfs_sb = NULL;
@@ -259,6 +260,15 @@ int32_t sysfs_readdir(file_t *file, dirent_t *dirent) {
     return tmpfs_readdir(file, dirent);
 }
 
+/***************************************************************************/
+/*                               getdents()                                */
+/***************************************************************************/
+
+int32_t sysfs_getdents(file_t *file, void *buf, int32_t size,
+                       int32_t *done) {
+    return tmpfs_getdents(file, buf, size, done);
+}
+
 /***************************************************************************/
 /*                                 ioctl()                                 */
 /***************************************************************************/
@@ -296,7 +306,10 @@ fsd_t sysfs_t = {
     /* read:         */ sysfs_read,
     /* write:        */ sysfs_write,
     /* seek:         */ sysfs_seek,
+    /* pread:        */ NULL,
+    /* pwrite:       */ NULL,
     /* readdir:      */ sysfs_readdir,
+    /* getdents:     */ sysfs_getdents,
     /* ioctl:        */ sysfs_ioctl
 
 };
@@ -328,6 +341,7 @@ void sysfs_reg(char *name, char *(*read)(uint32_t *size)) {
         inode_t *root = (inode_t *) iget(sysfs_sb, sysfs_sb->root_ino);
         inode_t *child;
         tmpfs_mknod(root, sysfile->name, FT_REGULAR, 0);
+        dcache_invalidate(root, sysfile->name);
         tmpfs_lookup(root, sysfile->name, &child);
         sysfile->ino = child->ino;
         iput(child);
@@ -360,6 +374,7 @@ void sysfs_unreg(char *name) {
     if (sysfs_sb) {
         inode_t *root = (inode_t *) iget(sysfs_sb, sysfs_sb->root_ino);
         tmpfs_unlink(root, name);
+        dcache_invalidate(root, name);
         iput(root);
     }
 }
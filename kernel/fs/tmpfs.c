@@ -27,6 +27,7 @@
  */
 
 #include <arch/type.h>
+#include <arch/page.h>
 #include <lib/string.h>
 #include <sys/mm.h>
 #include <sys/fs.h>
@@ -36,6 +37,354 @@
  * is the same value of its memory address.
  */
 
+/***************************************************************************/
+/*                               data pages                                */
+/***************************************************************************/
+
+static void touch(void *buf, uint32_t size, int32_t write) {
+
+    /* fault in the (at most two) pages of a buffer that is to be
+     * copied through the physical memory window, a fault in the
+     * middle of the copy would move the window.
+     */
+    volatile uint8_t *ptr = buf;
+    uint8_t val;
+
+    val = ptr[0];
+    if (write)
+        ptr[0] = val;
+    val = ptr[size-1];
+    if (write)
+        ptr[size-1] = val;
+
+}
+
+static int32_t radix_fits(tmpfs_pages_t *pages, uint32_t index) {
+
+    /* is the tree high enough to reach page "index"? */
+    if (!pages->height)
+        return 0;
+    if (pages->height*TMPFS_RADIX_SHIFT >= 32)
+        return 1;
+    return index < (1U << (pages->height*TMPFS_RADIX_SHIFT));
+
+}
+
+static tmpfs_radix_t *radix_node() {
+
+    /* a new node with all slots empty */
+    tmpfs_radix_t *node = kmalloc(sizeof(tmpfs_radix_t));
+    if (node)
+        memset(node, 0, sizeof(tmpfs_radix_t));
+    return node;
+
+}
+
+static uint32_t page_find(tmpfs_inode_t *tmpfs_inode, uint32_t index) {
+
+    /* the frame of the page at "index", 0 if it is a hole. */
+    tmpfs_pages_t *pages = &tmpfs_inode->u.pages;
+    void *p = pages->root;
+    uint32_t h;
+
+    if (!radix_fits(pages, index))
+        return 0;
+    for (h = pages->height; p && h; h--)
+        p = ((tmpfs_radix_t *) p)->slot[(index >> ((h-1)*TMPFS_RADIX_SHIFT)) &
+                                        TMPFS_RADIX_MASK];
+    return (uint32_t) p;
+
+}
+
+static uint32_t page_get(tmpfs_inode_t *tmpfs_inode, uint32_t index) {
+
+    /* the frame of the page at "index", a zeroed one is added if it
+     * is a hole. returns 0 if there is no memory.
+     */
+    tmpfs_pages_t *pages = &tmpfs_inode->u.pages;
+    tmpfs_radix_t *node;
+    void **slot;
+    uint32_t h;
+
+    /* add levels on top until the index fits: */
+    while (!radix_fits(pages, index)) {
+        if (!(node = radix_node()))
+            return 0;
+        node->slot[0] = pages->root;
+        pages->root = node;
+        pages->height++;
+    }
+
+    /* walk down, filling in what is missing: */
+    slot = (void **) &pages->root;
+    for (h = pages->height; h; h--) {
+        node = *slot;
+        slot = &node->slot[(index >> ((h-1)*TMPFS_RADIX_SHIFT)) &
+                           TMPFS_RADIX_MASK];
+        if (*slot)
+            continue;
+        if (h > 1) {
+            if (!(*slot = radix_node()))
+                return 0;
+        } else {
+            /* a frame of its own, not heap memory: it may be mapped
+             * into processes, and outlive the file there.
+             */
+            if (pmem_free_pages() < TMPFS_RESERVE)
+                return 0;
+            *slot = (void *) ppalloc();
+            pmem_clear(*slot, PAGE_SIZE);
+            pages->count++;
+        }
+    }
+    return (uint32_t) *slot;
+
+}
+
+static int32_t radix_free(tmpfs_pages_t *pages, void **slot,
+                          uint32_t h, uint64_t base, uint32_t from) {
+
+    /* free the pages from index "from" on under *slot, which is a
+     * node of height h (or a page if h is 0) starting at page "base".
+     * returns nonzero if *slot itself is gone.
+     */
+    tmpfs_radix_t *node = *slot;
+    uint64_t span;
+    int32_t i, used = 0;
+
+    if (!h) {
+        if (base < from)
+            return 0;
+        ppfree(*slot); /* mappings may still hold it */
+        *slot = NULL;
+        pages->count--;
+        return 1;
+    }
+
+    span = ((uint64_t) 1) << ((h-1)*TMPFS_RADIX_SHIFT);
+    for (i = 0; i < TMPFS_RADIX_SLOTS; i++) {
+        if (node->slot[i] && base + (i+1)*span > from)
+            radix_free(pages, &node->slot[i], h-1, base + i*span, from);
+        if (node->slot[i])
+            used++;
+    }
+    if (used)
+        return 0;
+    kfree(node);
+    *slot = NULL;
+    return 1;
+
+}
+
+static void pages_free(tmpfs_inode_t *tmpfs_inode, uint32_t from) {
+
+    /* drop the pages from index "from" on */
+    tmpfs_pages_t *pages = &tmpfs_inode->u.pages;
+    tmpfs_radix_t *node;
+    int32_t i;
+
+    if (pages->root)
+        radix_free(pages, (void **) &pages->root, pages->height, 0, from);
+
+    /* a root that only leads to slot 0 is a level too many */
+    while (pages->root && pages->height > 1) {
+        node = pages->root;
+        for (i = 1; i < TMPFS_RADIX_SLOTS && !node->slot[i]; i++);
+        if (i < TMPFS_RADIX_SLOTS)
+            break;
+        pages->root = node->slot[0];
+        pages->height--;
+        kfree(node);
+    }
+    if (!pages->root)
+        pages->height = 0;
+
+}
+
+/***************************************************************************/
+/*                              directories                                */
+/***************************************************************************/
+
+static uint32_t namehash(char *name) {
+    /* FNV-1a */
+    uint32_t h = 2166136261U;
+    while (*name)
+        h = (h ^ (uint8_t) *name++) * 16777619U;
+    return h;
+}
+
+static tmpfs_dentry_t *dir_find(tmpfs_inode_t *tmpfs_inode, char *name) {
+
+    /* the live entry called "name", NULL if there is none. */
+    tmpfs_dir_t *dir = &tmpfs_inode->u.dir;
+    uint32_t h = namehash(name);
+    tmpfs_dentry_t *d = dir->hash[h & (dir->buckets-1)];
+
+    while (d && (d->hash != h || strcmp(d->name, name)))
+        d = d->hnext;
+    return d;
+
+}
+
+static void dir_grow(tmpfs_dir_t *dir) {
+
+    /* double the buckets, the old table stays if there is no memory */
+    uint32_t buckets = dir->buckets*2, i;
+    tmpfs_dentry_t **hash = kmalloc(buckets*sizeof(tmpfs_dentry_t *));
+    tmpfs_dentry_t *d;
+
+    if (!hash)
+        return;
+    for (i = 0; i < buckets; i++)
+        hash[i] = NULL;
+
+    /* rehash the live entries: */
+    for (d = dir->first; d; d = d->next) {
+        if (!d->inode)
+            continue;
+        i = d->hash & (buckets-1);
+        d->hnext = hash[i];
+        hash[i]  = d;
+    }
+
+    kfree(dir->hash);
+    dir->hash    = hash;
+    dir->buckets = buckets;
+
+}
+
+static int32_t dir_add(tmpfs_inode_t *tmpfs_inode, char *name,
+                       tmpfs_ino_t ino) {
+
+    /* append a new entry, the name must not exist yet. */
+    tmpfs_dir_t *dir = &tmpfs_inode->u.dir;
+    uint32_t len = strlen(name), i;
+    tmpfs_dentry_t *d;
+
+    /* allocate the entry, long names live outside of it: */
+    if (!(d = kmalloc(sizeof(tmpfs_dentry_t))))
+        return ENOMEM;
+    if (len < TMPFS_DNAME_INLINE) {
+        d->name = d->iname;
+    } else if (!(d->name = kmalloc(len+1))) {
+        kfree(d);
+        return ENOMEM;
+    }
+    strcpy(d->name, name);
+    d->inode = ino;
+    d->hash  = namehash(name);
+    d->pin   = 0;
+
+    /* keep chains short: */
+    if (dir->count >= dir->buckets*2)
+        dir_grow(dir);
+
+    /* hash it: */
+    i = d->hash & (dir->buckets-1);
+    d->hnext = dir->hash[i];
+    dir->hash[i] = d;
+
+    /* and put it last in order: */
+    d->next = NULL;
+    d->prev = dir->last;
+    if (dir->last)
+        dir->last->next = d;
+    else
+        dir->first = d;
+    dir->last = d;
+
+    dir->count++;
+    return ESUCCESS;
+
+}
+
+static void dentry_free(tmpfs_dir_t *dir, tmpfs_dentry_t *d) {
+
+    /* take the entry out of the order list and free it */
+    if (d->prev)
+        d->prev->next = d->next;
+    else
+        dir->first = d->next;
+    if (d->next)
+        d->next->prev = d->prev;
+    else
+        dir->last = d->prev;
+
+    if (d->name != d->iname)
+        kfree(d->name);
+    kfree(d);
+
+}
+
+static void dir_del(tmpfs_inode_t *tmpfs_inode, tmpfs_dentry_t *d) {
+
+    /* remove a live entry, a cursor standing on it keeps it around */
+    tmpfs_dir_t *dir = &tmpfs_inode->u.dir;
+    tmpfs_dentry_t **p = &dir->hash[d->hash & (dir->buckets-1)];
+
+    while (*p != d)
+        p = &(*p)->hnext;
+    *p = d->hnext;
+
+    d->inode = 0;
+    dir->count--;
+    if (!d->pin)
+        dentry_free(dir, d);
+
+}
+
+static void dir_free(tmpfs_inode_t *tmpfs_inode) {
+
+    /* free all entries and the table, nobody may have it open. */
+    tmpfs_dir_t *dir = &tmpfs_inode->u.dir;
+
+    while (dir->first)
+        dentry_free(dir, dir->first);
+    kfree(dir->hash);
+
+}
+
+static int32_t dir_init(tmpfs_inode_t *tmpfs_inode, tmpfs_ino_t parent) {
+
+    /* an empty directory: only <.> and <..> */
+    tmpfs_dir_t *dir = &tmpfs_inode->u.dir;
+    uint32_t i;
+
+    dir->hash = kmalloc(TMPFS_DHASH_MIN*sizeof(tmpfs_dentry_t *));
+    if (!dir->hash)
+        return ENOMEM;
+    for (i = 0; i < TMPFS_DHASH_MIN; i++)
+        dir->hash[i] = NULL;
+    dir->buckets = TMPFS_DHASH_MIN;
+    dir->count   = 0;
+    dir->first   = NULL;
+    dir->last    = NULL;
+
+    if (dir_add(tmpfs_inode, ".", (tmpfs_ino_t) tmpfs_inode) ||
+        dir_add(tmpfs_inode, "..", parent)) {
+        dir_free(tmpfs_inode);
+        return ENOMEM;
+    }
+    return ESUCCESS;
+
+}
+
+static void cursor_set(file_t *file, tmpfs_dentry_t *d) {
+
+    /* move the readdir cursor of an open directory to "d" */
+    tmpfs_inode_t *tmpfs_inode = (tmpfs_inode_t *) file->inode->ino;
+    tmpfs_dentry_t *old = file->info.tmpfs.curdent;
+
+    if (d)
+        d->pin++;
+    file->info.tmpfs.curdent = d;
+
+    /* the last cursor leaving a removed entry frees it: */
+    if (old && !--old->pin && !old->inode)
+        dentry_free(&tmpfs_inode->u.dir, old);
+
+}
+
 /***************************************************************************/
 /*                              read_super                                 */
 /***************************************************************************/
@@ -45,8 +394,6 @@ super_block_t *tmpfs_read_super(device_t *dev) {
     /* local variables */
     super_block_t *sb;
     tmpfs_inode_t *tmpfs_inode;
-    tmpfs_dentry_t *dot;
-    tmpfs_dentry_t *dotdot;
 
     /* allocate memory for superblock: */
     sb = kmalloc(sizeof(super_block_t));
@@ -71,50 +418,13 @@ super_block_t *tmpfs_read_super(device_t *dev) {
     tmpfs_inode->mode  = FT_DIR;
     tmpfs_inode->size  = 0;
     tmpfs_inode->devid = 0;
-    linkedlist_init(&(tmpfs_inode->u.blocks));
 
-    /* create <.> directory entry: */
-    dot = kmalloc(sizeof(tmpfs_dentry_t));
-    if (!dot) {
-        kfree(tmpfs_inode);
-        kfree(sb);
-        return NULL;
-    }
-    dot->inode = (ino_t) tmpfs_inode;
-    dot->name  = kmalloc(2);
-    if (!(dot->name)) {
-        kfree(dot);
-        kfree(tmpfs_inode);
-        kfree(sb);
-        return NULL;
-    }
-    dot->name[0] = '.';
-    dot->name[1] = 0;
-    linkedlist_addlast(&(tmpfs_inode->u.dentries), dot);
-
-    /* create <..> entry: */
-    dotdot = kmalloc(sizeof(tmpfs_dentry_t));
-    if (!dotdot) {
-        kfree(dot->name);
-        kfree(dot);
-        kfree(tmpfs_inode);
-        kfree(sb);
-        return NULL;
-    }
-    dotdot->inode = (ino_t) tmpfs_inode;
-    dotdot->name  = kmalloc(3);
-    if (!(dotdot->name)) {
-        kfree(dotdot);
-        kfree(dot->name);
-        kfree(dot);
+    /* create <.> and <..>, both are the root itself: */
+    if (dir_init(tmpfs_inode, (tmpfs_ino_t) tmpfs_inode)) {
         kfree(tmpfs_inode);
         kfree(sb);
         return NULL;
     }
-    dotdot->name[0] = '.';
-    dotdot->name[1] = '.';
-    dotdot->name[2] = 0;
-    linkedlist_addlast(&(tmpfs_inode->u.dentries), dotdot);
 
     /* Update super block: */
     sb->root_ino = (ino_t) tmpfs_inode;
@@ -203,8 +513,6 @@ int32_t tmpfs_put_inode(inode_t *inode) {
 
     /* local variables */
     tmpfs_inode_t *node;
-    tmpfs_block_t *p;
-    tmpfs_block_t *next;
 
     /* inode is still referenced? */
     if (inode->icount || inode->ref)
@@ -213,23 +521,15 @@ int32_t tmpfs_put_inode(inode_t *inode) {
     /* erases a tmpfs inode from memory: */
     node = (tmpfs_inode_t *) inode->ino;
 
-    /* if there are data blocks, deallocate them: */
-    if ((node->mode & FT_MASK) == FT_REGULAR) {
-        p = node->u.blocks.first;
-        while (p) {
-            next = p->next;
-            kfree(p->data);
-            kfree(p);
-            p = next;
-        }
-    }
+    /* if there are data pages, deallocate them: */
+    if ((node->mode & FT_MASK) == FT_REGULAR)
+        pages_free(node, 0);
 
     /* if directory, delete . && .. */
     if ((node->mode & FT_MASK) == FT_DIR) {
-        if (node->u.dentries.count > 2)
+        if (node->u.dir.count > 2)
             return ENOTEMPTY;
-        kfree(node->u.dentries.first);
-        kfree(node->u.dentries.last);
+        dir_free(node);
     }
 
     /* deallocate the node: */
@@ -254,13 +554,8 @@ int32_t tmpfs_lookup(inode_t *dir, char *name, inode_t **ret) {
     if ((dir->mode & FT_MASK) != FT_DIR)
         return ENOTDIR;
 
-    /* compare "name" with all directory entries in inode: */
-    p = tmpfs_inode->u.dentries.first;
-    while(p && ((p->inode <= 1) || strcmp(name, p->name)))
-        p = p->next;
-
-    /* found? */
-    if (!p)
+    /* look "name" up in the directory: */
+    if (!(p = dir_find(tmpfs_inode, name)))
         return ENOENT; /* not found! */
 
     /* get inode: */
@@ -287,8 +582,6 @@ int32_t tmpfs_mknod(inode_t *dir, char *name, int32_t mode, int32_t devid) {
     inode_t *inode;
     tmpfs_inode_t *dir_tmpfs_inode = (tmpfs_inode_t *) dir->ino;
     tmpfs_inode_t *nod_tmpfs_inode;
-    char *fsname;
-    tmpfs_dentry_t *p;
 
     /* parent must be a directory. */
     if ((dir->mode & FT_MASK) != FT_DIR)
@@ -299,19 +592,17 @@ int32_t tmpfs_mknod(inode_t *dir, char *name, int32_t mode, int32_t devid) {
         return ENOENT;
 
     /* name shouldn't exist. */
-    err = tmpfs_lookup(dir, name, NULL);
-    if (!err) {
+    if (dir_find(dir_tmpfs_inode, name))
         return EEXIST;
-    } else if (err != ENOENT) {
-        return err;
-    }
 
     /* allocate a new inode: */
     ino = (tmpfs_ino_t) kmalloc(sizeof(tmpfs_inode_t));
     if (!ino)
         return ENOSPC;
     nod_tmpfs_inode = (tmpfs_inode_t *) ino;
-    linkedlist_init(&(nod_tmpfs_inode->u.blocks));
+    nod_tmpfs_inode->u.pages.root   = NULL;
+    nod_tmpfs_inode->u.pages.height = 0;
+    nod_tmpfs_inode->u.pages.count  = 0;
 
     /* get the inode: */
     inode = (inode_t *) iget(dir->sb, ino);
@@ -323,36 +614,17 @@ int32_t tmpfs_mknod(inode_t *dir, char *name, int32_t mode, int32_t devid) {
     inode->devid = devid;
     tmpfs_update_inode(inode);
 
-    /* put the inode: */
-    iput(inode);
-
-    /* allocate space for name: */
-    fsname = kmalloc(strlen(name)+1);
-    if (!fsname)
-        return ENOMEM;
-    strcpy(fsname, name);
-
-    /* look up for an empty entry */
-    p = dir_tmpfs_inode->u.dentries.first;
-    while(p && (p->inode > 1))
-        p = p->next;
-
-    /* no empty entry? allocate a new one! */
-    if (!p) {
-        if (!(p = kmalloc(sizeof(tmpfs_dentry_t)))) {
-            kfree(fsname);
-            return ENOMEM;
-        }
-        linkedlist_addlast(&(dir_tmpfs_inode->u.dentries), p);
-        tmpfs_update_inode(dir);
+    /* add the entry, or drop the inode again: */
+    if (err = dir_add(dir_tmpfs_inode, name, ino)) {
+        inode->ref = 0;
+        tmpfs_update_inode(inode);
     }
 
-    /* fill in the entry: */
-    p->inode = ino;
-    p->name  = fsname;
+    /* put the inode: */
+    iput(inode);
 
     /* done */
-    return ESUCCESS;
+    return err;
 
 }
 
@@ -365,8 +637,6 @@ int32_t tmpfs_link(inode_t *inode, inode_t *dir, char *name) {
     /* local variables */
     int32_t err;
     tmpfs_inode_t *dir_tmpfs_inode = (tmpfs_inode_t *) dir->ino;
-    char *fsname;
-    tmpfs_dentry_t *p;
 
     /* parent must be a directory. */
     if ((dir->mode & FT_MASK) != FT_DIR)
@@ -377,46 +647,21 @@ int32_t tmpfs_link(inode_t *inode, inode_t *dir, char *name) {
         return ENOENT;
 
     /* name shouldn't exist. */
-    err = tmpfs_lookup(dir, name, NULL);
-    if (!err) {
+    if (dir_find(dir_tmpfs_inode, name))
         return EEXIST;
-    } else if (err != ENOENT) {
-        return err;
-    }
 
     /* inode should not be directory: */
     if ((inode->mode & FT_MASK) == FT_DIR)
         return EISDIR;
 
+    /* add the entry: */
+    if (err = dir_add(dir_tmpfs_inode, name, inode->ino))
+        return err;
+
     /* increase references count: */
     inode->ref++;
     tmpfs_update_inode(inode);
 
-    /* allocate space for name: */
-    fsname = kmalloc(strlen(name)+1);
-    if (!fsname)
-        return ENOMEM;
-    strcpy(fsname, name);
-
-    /* look up for an empty entry */
-    p = dir_tmpfs_inode->u.dentries.first;
-    while(p && (p->inode > 1))
-        p = p->next;
-
-    /* no empty entry? allocate a new one! */
-    if (!p) {
-        if (!(p = kmalloc(sizeof(tmpfs_dentry_t)))) {
-            kfree(fsname);
-            return ENOMEM;
-        }
-        linkedlist_addlast(&(dir_tmpfs_inode->u.dentries), p);
-        tmpfs_update_inode(dir);
-    }
-
-    /* fill in the entry: */
-    p->inode = inode->ino;
-    p->name  = fsname;
-
     /* done */
     return ESUCCESS;
 
@@ -443,12 +688,7 @@ int32_t tmpfs_unlink(inode_t *dir, char *name) {
         return ENOENT;
 
     /* look up for the matching entry: */
-    p = dir_tmpfs_inode->u.dentries.first;
-    while(p && (p->inode==0 || p->inode==1 || strcmp(name, p->name)))
-        p = p->next;
-
-    /* found? */
-    if (!p)
+    if (!(p = dir_find(dir_tmpfs_inode, name)))
         return ENOENT; /* not found! */
 
     /* get the inode */
@@ -468,8 +708,7 @@ int32_t tmpfs_unlink(inode_t *dir, char *name) {
     iput(inode);
 
     /* remove entry */
-    p->inode = 1;
-    kfree(p->name);
+    dir_del(dir_tmpfs_inode, p);
 
     /* done: */
     return ESUCCESS;
@@ -488,8 +727,6 @@ int32_t tmpfs_mkdir(inode_t *dir, char *name, int32_t mode) {
     tmpfs_inode_t *nod_tmpfs_inode;
     tmpfs_ino_t ino;
     inode_t *inode;
-    char *fsname;
-    tmpfs_dentry_t *p, *dot, *dotdot;
 
     /* parent must be a directory. */
     if ((dir->mode & FT_MASK) != FT_DIR)
@@ -500,19 +737,20 @@ int32_t tmpfs_mkdir(inode_t *dir, char *name, int32_t mode) {
         return ENOENT;
 
     /* name shouldn't exist. */
-    err = tmpfs_lookup(dir, name, NULL);
-    if (!err) {
+    if (dir_find(dir_tmpfs_inode, name))
         return EEXIST;
-    } else if (err != ENOENT) {
-        return err;
-    }
 
     /* allocate a new inode: */
     ino = (tmpfs_ino_t) kmalloc(sizeof(tmpfs_inode_t));
     if (!ino)
         return ENOSPC;
     nod_tmpfs_inode = (tmpfs_inode_t *) ino;
-    linkedlist_init(&(nod_tmpfs_inode->u.blocks));
+
+    /* create <.> and <..> entries: */
+    if (dir_init(nod_tmpfs_inode, (tmpfs_ino_t) dir_tmpfs_inode)) {
+        kfree(nod_tmpfs_inode);
+        return ENOMEM;
+    }
 
     /* get the inode: */
     inode = (inode_t *) iget(dir->sb, ino);
@@ -524,67 +762,17 @@ int32_t tmpfs_mkdir(inode_t *dir, char *name, int32_t mode) {
     inode->devid = 0;
     tmpfs_update_inode(inode);
 
-    /* put the inode: */
-    iput(inode);
-
-    /* create <.> directory entry: */
-    dot = kmalloc(sizeof(tmpfs_dentry_t));
-    if (!dot) {
-        return ENOMEM;
-    }
-    dot->inode = (ino_t) nod_tmpfs_inode;
-    dot->name  = kmalloc(2);
-    if (!(dot->name)) {
-        kfree(dot);
-        return ENOMEM;
+    /* add the entry to the parent, or drop the directory again: */
+    if (err = dir_add(dir_tmpfs_inode, name, ino)) {
+        inode->ref = 0;
+        tmpfs_update_inode(inode);
     }
-    dot->name[0] = '.';
-    dot->name[1] = 0;
-    linkedlist_addlast(&(nod_tmpfs_inode->u.dentries), dot);
 
-    /* create <..> entry: */
-    dotdot = kmalloc(sizeof(tmpfs_dentry_t));
-    if (!dotdot) {
-        return ENOMEM;
-    }
-    dotdot->inode = (ino_t) dir_tmpfs_inode;
-    dotdot->name  = kmalloc(3);
-    if (!(dotdot->name)) {
-        kfree(dotdot);
-        return ENOMEM;
-    }
-    dotdot->name[0] = '.';
-    dotdot->name[1] = '.';
-    dotdot->name[2] = 0;
-    linkedlist_addlast(&(nod_tmpfs_inode->u.dentries), dotdot);
-
-    /* allocate space for name of the directory: */
-    fsname = kmalloc(strlen(name)+1);
-    if (!fsname)
-        return ENOMEM;
-    strcpy(fsname, name);
-
-    /* look up for an empty entry in the parent */
-    p = dir_tmpfs_inode->u.dentries.first;
-    while(p && (p->inode > 1))
-        p = p->next;
-
-    /* no empty entry? allocate a new one! */
-    if (!p) {
-        if (!(p = kmalloc(sizeof(tmpfs_dentry_t)))) {
-            kfree(fsname);
-            return ENOMEM;
-        }
-        linkedlist_addlast(&(dir_tmpfs_inode->u.dentries), p);
-        tmpfs_update_inode(dir);
-    }
-
-    /* fill in the entry: */
-    p->inode = ino;
-    p->name  = fsname;
+    /* put the inode: */
+    iput(inode);
 
     /* done */
-    return ESUCCESS;
+    return err;
 
 }
 
@@ -598,9 +786,8 @@ int32_t tmpfs_rmdir(inode_t *dir, char *name) {
     int32_t err;
     tmpfs_inode_t *dir_tmpfs_inode = (tmpfs_inode_t *) dir->ino;
     tmpfs_inode_t *nod_tmpfs_inode;
-    tmpfs_dentry_t *p, *pp;
+    tmpfs_dentry_t *p;
     inode_t *inode;
-    pos_t entcount = 0;
 
     /* parent must be a directory. */
     if ((dir->mode & FT_MASK) != FT_DIR)
@@ -611,12 +798,7 @@ int32_t tmpfs_rmdir(inode_t *dir, char *name) {
         return ENOENT;
 
     /* look up for the matching entry: */
-    p = dir_tmpfs_inode->u.dentries.first;
-    while(p && (p->inode==0 || p->inode==1 || strcmp(name, p->name)))
-        p = p->next;
-
-    /* found? */
-    if (!p)
+    if (!(p = dir_find(dir_tmpfs_inode, name)))
         return ENOENT; /* not found! */
 
     /* get the inode */
@@ -628,17 +810,9 @@ int32_t tmpfs_rmdir(inode_t *dir, char *name) {
         return ENOTDIR;
     }
 
-    /* get count of entries in the target: */
-    nod_tmpfs_inode = (tmpfs_inode_t *) inode->ino;
-    pp = nod_tmpfs_inode->u.dentries.first;
-    while (pp) {
-        if (pp->inode != 0 && pp->inode != 1)
-            entcount++;
-        pp = pp->next;
-    }
-
     /* directory is not empty? */
-    if (entcount > 2) {
+    nod_tmpfs_inode = (tmpfs_inode_t *) inode->ino;
+    if (nod_tmpfs_inode->u.dir.count > 2) {
         iput(inode);
         return ENOTEMPTY;
     }
@@ -651,8 +825,7 @@ int32_t tmpfs_rmdir(inode_t *dir, char *name) {
     iput(inode);
 
     /* remove entry from parent directory */
-    p->inode = 1;
-    kfree(p->name);
+    dir_del(dir_tmpfs_inode, p);
 
     /* done: */
     return ESUCCESS;
@@ -666,11 +839,8 @@ int32_t tmpfs_rmdir(inode_t *dir, char *name) {
 int32_t tmpfs_truncate(inode_t *inode, pos_t length) {
 
     tmpfs_inode_t *tmpfs_inode = (tmpfs_inode_t *) inode->ino;
-    tmpfs_block_t *prev = NULL;
-    tmpfs_block_t *blk;
-    pos_t off = 0;
-    pos_t blkcount;
-    int32_t i;
+    uint32_t poff = length%PAGE_SIZE;
+    uint32_t page;
 
     /* must be regular file */
     if ((inode->mode & FT_MASK) != FT_REGULAR) {
@@ -678,31 +848,17 @@ int32_t tmpfs_truncate(inode_t *inode, pos_t length) {
         return EINVAL;
     }
 
-    /* count of the blocks in the new file */
-    blkcount = length/inode->blksize + ((length%inode->blksize)?1:0);
+    /* drop the pages past the new end, growing leaves a hole: */
+    pages_free(tmpfs_inode, (length + PAGE_SIZE - 1)/PAGE_SIZE);
 
-    /* shrink if the file is larger */
-    while (tmpfs_inode->u.blocks.count > blkcount) {
-        /* remove from tail */
-        blk = tmpfs_inode->u.blocks.last;
-        linkedlist_aremove(&(tmpfs_inode->u.blocks), blk);
-        kfree(blk->data);
-        kfree(blk);
-    }
-
-    /* expand if the file is smaller */
-    while (tmpfs_inode->u.blocks.count < blkcount) {
-        /* add to tail */
-        blk = kmalloc(sizeof(tmpfs_block_t));
-        blk->data = kmalloc(inode->blksize);
-        linkedlist_addlast(&(tmpfs_inode->u.blocks), blk);
-        for (i = 0; i < inode->blksize; i++)
-            blk->data[i] = 0;
-    }
+    /* the page the file now ends in is cleared past the end: */
+    if (poff && length < inode->size &&
+        (page = page_find(tmpfs_inode, length/PAGE_SIZE)))
+        pmem_clear((void *) (page + poff), PAGE_SIZE - poff);
 
     /* update file size... */
     inode->size = length;
-    inode->blocks = blkcount;
+    inode->blocks = length/inode->blksize + ((length%inode->blksize)?1:0);
     tmpfs_update_inode(inode);
 
     /* done */
@@ -722,9 +878,10 @@ int32_t tmpfs_open(file_t *file) {
     /* get tmpfs inode of the file */
     tmpfs_inode_t *tmpfs_inode = (tmpfs_inode_t *) inode->ino;
 
-    /* seek the first block */
-    file->info.tmpfs.curblk  = tmpfs_inode->u.blocks.first;
-    file->info.tmpfs.curdent = tmpfs_inode->u.dentries.first;
+    /* first directory entry, data pages need no cursor */
+    file->info.tmpfs.curdent = NULL;
+    if ((inode->mode & FT_MASK) == FT_DIR)
+        cursor_set(file, tmpfs_inode->u.dir.first);
     file->info.tmpfs.off = 0;
 
     /* done */
@@ -738,23 +895,22 @@ int32_t tmpfs_open(file_t *file) {
 
 int32_t tmpfs_release(file_t *file) {
 
-    /* nothing to do here */
+    /* let go of the directory entry the cursor stands on */
+    cursor_set(file, NULL);
     return ESUCCESS;
 
 }
 
-
 /***************************************************************************/
 /*                                 read()                                  */
 /***************************************************************************/
 
-int32_t tmpfs_read(file_t *file, void *buf, int32_t size) {
+static int32_t read_at(file_t *file, void *buf, int32_t size, pos_t *pos) {
 
-    pos_t off = file->pos;
+    pos_t off = *pos;
     int32_t rem = size; /* remaining */
-    int32_t blksize = file->inode->blksize;
     tmpfs_inode_t *nod_tmpfs_inode = (tmpfs_inode_t *) file->inode->ino;
-    int32_t i, j;
+    uint32_t page;
     pos_t tsize;
 
     /* size should be a valid number */
@@ -769,16 +925,19 @@ int32_t tmpfs_read(file_t *file, void *buf, int32_t size) {
     if (off + rem > file->inode->size)
         rem = file->inode->size - off;
 
-    /* read block by block.. */
+    /* read page by page.. */
     while (rem) {
 
-        /* try to not skip current block. */
-        if ((tsize = blksize-off%blksize) > rem)
+        /* try to not skip current page. */
+        if ((tsize = PAGE_SIZE-off%PAGE_SIZE) > rem)
             tsize = rem;
 
-        /* do the read! */
-        for (i=off%blksize,j=0; i<off%blksize+tsize; i++,j++) {
-            ((uint8_t *) buf)[j] = file->info.tmpfs.curblk->data[i];
+        /* do the read! holes read as zeros. */
+        if (page = page_find(nod_tmpfs_inode, off/PAGE_SIZE)) {
+            touch(buf, tsize, 1);
+            pmem_read(buf, (void *) (page + (uint32_t) (off%PAGE_SIZE)), tsize);
+        } else {
+            memset(buf, 0, tsize);
         }
 
         /* update remaining: */
@@ -786,82 +945,111 @@ int32_t tmpfs_read(file_t *file, void *buf, int32_t size) {
         off += tsize;
         buf = ((uint8_t *) buf) + tsize;
 
-        /* move to next block */
-        if (!(off % blksize))
-            file->info.tmpfs.curblk = file->info.tmpfs.curblk->next;
-
     }
 
     /* update file position */
-    file->pos = off;
+    *pos = off;
 
     /* done */
     return ESUCCESS;
 
 }
 
+int32_t tmpfs_read(file_t *file, void *buf, int32_t size) {
+    return read_at(file, buf, size, &file->pos);
+}
+
+/***************************************************************************/
+/*                                 pread()                                 */
+/***************************************************************************/
+
+int32_t tmpfs_pread(file_t *file, void *buf, int32_t size, pos_t pos,
+                    int32_t *done) {
+
+    /* like read(), at "pos" and leaving file->pos alone */
+    pos_t off = pos;
+    int32_t err = read_at(file, buf, size, &off);
+
+    *done = (int32_t) (off - pos);
+    return err;
+
+}
+
 /***************************************************************************/
 /*                                 write()                                 */
 /***************************************************************************/
 
-int32_t tmpfs_write(file_t *file, void *buf, int32_t size) {
+static int32_t write_at(file_t *file, void *buf, int32_t size, pos_t *pos) {
 
-    pos_t off = file->pos;
+    pos_t off = *pos;
     int32_t rem = size; /* remaining */
     int32_t blksize = file->inode->blksize;
     tmpfs_inode_t *nod_tmpfs_inode = (tmpfs_inode_t *) file->inode->ino;
-    int32_t i, j;
+    int32_t err = ESUCCESS;
+    uint32_t page;
     pos_t tsize;
 
     /* size should be a valid number */
     if (size <= 0)
         return EINVAL;
 
-    /* update file size... */
-    if (off + rem > file->inode->size) {
-        file->inode->size   = off+rem;
-        file->inode->blocks = (file->inode->size/blksize) +
-                              ((file->inode->size%blksize) ? 1:0);
-        tmpfs_update_inode(file->inode);
-    }
-
-    /* write block by block.. */
+    /* write page by page.. */
     while (rem) {
 
-        /* try to not skip current block. */
-        if ((tsize = blksize-off%blksize) > rem)
+        /* try to not skip current page. */
+        if ((tsize = PAGE_SIZE-off%PAGE_SIZE) > rem)
             tsize = rem;
 
-        /* if block is empty, allocate */
-        if (!file->info.tmpfs.curblk) {
-            /* allocate new block */
-            tmpfs_block_t *tmpfs_block = kmalloc(sizeof(tmpfs_block_t));
-            tmpfs_block->data = kmalloc(blksize);
-            linkedlist_addlast(&(nod_tmpfs_inode->u.blocks), tmpfs_block);
-            file->info.tmpfs.curblk = tmpfs_block;
+        /* get the page, allocate if it is a hole */
+        if (!(page = page_get(nod_tmpfs_inode, off/PAGE_SIZE))) {
+            err = ENOSPC;
+            break;
         }
 
         /* do the write! */
-        for (i=off%blksize,j=0; i<off%blksize+tsize; i++,j++) {
-            file->info.tmpfs.curblk->data[i] = ((uint8_t *) buf)[j];
-        }
+        touch(buf, tsize, 0);
+        pmem_write((void *) (page + (uint32_t) (off%PAGE_SIZE)), buf, tsize);
 
         /* update remaining: */
         rem -= tsize;
         off += tsize;
         buf = ((uint8_t *) buf) + tsize;
 
-        /* move to next block */
-        if (!(off % blksize))
-            file->info.tmpfs.curblk = file->info.tmpfs.curblk->next;
+    }
 
+    /* update file size... */
+    if (off > file->inode->size) {
+        file->inode->size   = off;
+        file->inode->blocks = (file->inode->size/blksize) +
+                              ((file->inode->size%blksize) ? 1:0);
+        tmpfs_update_inode(file->inode);
     }
 
     /* update file position */
-    file->pos = off;
+    *pos = off;
 
     /* done */
-    return ESUCCESS;
+    return err;
+
+}
+
+int32_t tmpfs_write(file_t *file, void *buf, int32_t size) {
+    return write_at(file, buf, size, &file->pos);
+}
+
+/***************************************************************************/
+/*                                pwrite()                                 */
+/***************************************************************************/
+
+int32_t tmpfs_pwrite(file_t *file, void *buf, int32_t size, pos_t pos,
+                     int32_t *done) {
+
+    /* like write(), at "pos" and leaving file->pos alone */
+    pos_t off = pos;
+    int32_t err = write_at(file, buf, size, &off);
+
+    *done = (int32_t) (off - pos);
+    return err;
 
 }
 
@@ -871,33 +1059,20 @@ int32_t tmpfs_write(file_t *file, void *buf, int32_t size) {
 
 int32_t tmpfs_seek(file_t *file, pos_t newpos) {
 
-    tmpfs_inode_t *tmpfs_inode = (tmpfs_inode_t *) file->inode->ino;
-
     /* truncate if seek goes past EOF */
     if (newpos > file->inode->size) {
         /*tmpfs_truncate(file->inode, newpos);*/
         return EINVAL;
     }
 
-    /* seek the first block */
-    file->info.tmpfs.curblk = tmpfs_inode->u.blocks.first;
-    file->info.tmpfs.off = 0;
-
-    /* loop over blocks of the file until we reach the block we want */
-    while (file->info.tmpfs.curblk) {
-
-        if (file->info.tmpfs.off + file->inode->blksize > newpos) {
-            /* we are done */
-            file->info.tmpfs.off = newpos;
-            break;
-        }
+    /* rewinding a directory restarts readdir: */
+    if ((file->inode->mode & FT_MASK) == FT_DIR)
+        cursor_set(file, ((tmpfs_inode_t *)
+                          file->inode->ino)->u.dir.first);
 
-        file->info.tmpfs.off += file->inode->blksize;
-        file->info.tmpfs.curblk = file->info.tmpfs.curblk->next;
-    }
-
-    /* return */
-    file->pos = file->info.tmpfs.off;
+    /* pages are looked up by offset, nothing to walk */
+    file->info.tmpfs.off = newpos;
+    file->pos = newpos;
     return ESUCCESS;
 
 }
@@ -906,24 +1081,54 @@ int32_t tmpfs_seek(file_t *file, pos_t newpos) {
 /*                                readdir()                                */
 /***************************************************************************/
 
+static tmpfs_dentry_t *cursor_next(file_t *file) {
+
+    /* skip entries removed since the cursor got there */
+    tmpfs_dentry_t *d = file->info.tmpfs.curdent;
+    while (d && !d->inode)
+        d = d->next;
+    return d;
+
+}
+
 int32_t tmpfs_readdir(file_t *file, dirent_t *dirent) {
 
     /* read next entry */
-    while (file->info.tmpfs.curdent) {
-        if (file->info.tmpfs.curdent->inode > 1) {
-            /* return the entry */
-            dirent->ino = file->info.tmpfs.curdent->inode;
-            strcpy(dirent->name, file->info.tmpfs.curdent->name);
-            file->info.tmpfs.curdent = file->info.tmpfs.curdent->next;
-            return 1;
-        } else {
-            /* next entry */
-            file->info.tmpfs.curdent = file->info.tmpfs.curdent->next;
-        }
+    tmpfs_dentry_t *d = cursor_next(file);
+
+    /* no more entries? */
+    if (!d) {
+        cursor_set(file, NULL);
+        return 0;
     }
 
-    /* no more entries */
-    return 0;
+    /* return the entry, entries added meanwhile come later */
+    dirent->ino = d->inode;
+    strcpy(dirent->name, d->name);
+    cursor_set(file, d->next);
+    return 1;
+
+}
+
+/***************************************************************************/
+/*                               getdents()                                */
+/***************************************************************************/
+
+int32_t tmpfs_getdents(file_t *file, void *buf, int32_t size,
+                       int32_t *done) {
+
+    /* pack entries as long as they fit */
+    tmpfs_dentry_t *d;
+
+    *done = 0;
+    while ((d = cursor_next(file)) &&
+           dirent_pack(buf, size, done, d->inode, d->name))
+        cursor_set(file, d->next);
+    if (!d)
+        cursor_set(file, NULL);
+
+    /* not even one entry fits? */
+    return (d && !*done) ? EINVAL : ESUCCESS;
 
 }
 
@@ -938,6 +1143,38 @@ int32_t tmpfs_ioctl(file_t *file, int32_t cmd, void *arg) {
 
 }
 
+/***************************************************************************/
+/*                            tmpfs_getpage()                              */
+/***************************************************************************/
+
+int32_t tmpfs_getpage(inode_t *inode, pos_t pos, uint32_t *frame) {
+
+    /* give a mapping the frame that holds the data itself, so writes
+     * through a shared mapping and through the file meet. private
+     * mappings map it copy-on-write. a fault must not grow the file:
+     * past the end and in holes the caller is told to fall back to a
+     * private page of its own, which is read (as zeros) from the file.
+     */
+    tmpfs_inode_t *tmpfs_inode = (tmpfs_inode_t *) inode->ino;
+    uint32_t page;
+
+    /* beyond the end of file? */
+    if (pos >= inode->size)
+        return EINVAL;
+
+    /* a hole has no frame to share: */
+    if (!(page = page_find(tmpfs_inode, pos/PAGE_SIZE)))
+        return ENOENT;
+
+    /* the mapping holds its own reference to the frame, which stays
+     * alive after the file drops it until the mapping is gone too.
+     */
+    *frame = page;
+    ppref((void *) page);
+    return ESUCCESS;
+
+}
+
 /***************************************************************************/
 /*                              tmpfsls()                                  */
 /***************************************************************************/
@@ -956,7 +1193,7 @@ void tmpfsls(char *path) {
 
     printk("$ ls %s\n", path);
 
-    err = namei(NULL, path, &namei_data);
+    err = namei(NULL, path, NAMEI_PATH, &namei_data);
     if (err) {
         printk("doesn't exist!\n");
         return;
@@ -974,7 +1211,7 @@ void tmpfsls(char *path) {
     printk("listing %s\n", fpath);
 
     node = (tmpfs_inode_t *) inode->ino;
-    x = node->u.dentries.first;
+    x = node->u.dir.first;
 
     while (x != NULL) {
         if (x->inode)
@@ -1020,7 +1257,13 @@ fsd_t tmpfs_t = {
     /* read:         */ tmpfs_read,
     /* write:        */ tmpfs_write,
     /* seek:         */ tmpfs_seek,
+    /* pread:        */ tmpfs_pread,
+    /* pwrite:       */ tmpfs_pwrite,
     /* readdir:      */ tmpfs_readdir,
-    /* ioctl:        */ tmpfs_ioctl
+    /* getdents:     */ tmpfs_getdents,
+    /* ioctl:        */ tmpfs_ioctl,
+    /* poll:         */ NULL,
+    /* sync:         */ NULL,
+    /* getpage:      */ tmpfs_getpage
 
 };
@@ -47,6 +47,14 @@
 #define ATA_CMD_IDENTIFY_PACKET 0xA1
 #define ATA_CMD_IDENTIFY        0xEC
 
+/* ATAPI (SCSI) packet commands */
+#define ATAPI_CMD_TEST_UNIT     0x00
+#define ATAPI_CMD_REQUEST_SENSE 0x03
+#define ATAPI_CMD_READ_CAPACITY 0x25
+#define ATAPI_CMD_READ10        0x28
+#define ATAPI_PACKET_SIZE       12
+#define ATAPI_SECTOR_SIZE       2048
+
 /* ATA request */
 typedef struct {
 #define ATA_PROTO_NODATA        0
@@ -76,6 +84,7 @@ typedef struct {
 #define ATA_WMODE_POLLING       0
 #define ATA_WMODE_IRQ           1
     uint32_t wmode;    /* waiting mode */
+    uint8_t  *packet;  /* ATAPI command packet (12 bytes) */
 } ata_req_t;
 
 /* drive structure */
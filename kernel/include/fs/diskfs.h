@@ -45,7 +45,10 @@ typedef struct diskfs_sb {
     #define QUAFS_MAGIC         0x19930430
     uint32_t     magic;
 
-    #define QUAFS_REVISION      0x0000
+    #define QUAFS_REVISION      0x0003 /* written by mkdiskfs.         */
+    #define QUAFS_REVISION_DXDIR 0x0001 /* indexed directories.      */
+    #define QUAFS_REVISION_EXTENTS 0x0002 /* extent-mapped files.    */
+    #define QUAFS_REVISION_INLINE 0x0003 /* data inside the inode.   */
     uint16_t     revision;
 
     #define QUAFS_OTHER         0
@@ -109,16 +112,64 @@ typedef struct diskfs_inode {
     #define DISKFS_LVL3         1
     #define DISKFS_PTR_L3       14
     diskfs_blk_t  ptr[DISKFS_PTRS];
+
+    /* flags are only valid since QUAFS_REVISION_DXDIR: */
+    #define DISKFS_INODE_DXDIR  0x0001 /* indexed directory. */
+    #define DISKFS_INODE_EXTENTS 0x0002 /* ptr[] holds extents. */
+    #define DISKFS_INODE_INLINE 0x0004 /* ptr[] holds the data. */
+    uint32_t      flags;
 } __attribute__ ((aligned (128))) diskfs_inode_t;
 
 typedef struct diskfs_inode_info {
     diskfs_blk_t  ptr[DISKFS_PTRS];
+    uint32_t      flags;
+    /* preallocation window of a regular file: pa_len blocks from
+     * disk block pa_start on, meant for file blocks pa_lblk on (in
+     * memory only, the blocks are free until taken). pa_size is the
+     * size the window had when it was made.
+     */
+    #define DISKFS_PREALLOC     16
+    #define DISKFS_PREALLOC_MAX 256
+    diskfs_blk_t  pa_lblk;
+    diskfs_blk_t  pa_start;
+    diskfs_blk_t  pa_len;
+    diskfs_blk_t  pa_size;
+    /* write-back: an inode with changes that are not on disk yet is
+     * listed at its super block, and the list holds a reference.
+     */
+    int32_t       dirty;       /* the inode itself changed.       */
+    int32_t       listed;      /* on the dirty list.              */
+    struct inode *dirty_next;
 } diskfs_inode_info_t;
 
+typedef struct diskfs_map {
+    diskfs_blk_t  start;       /* first block of the map on disk. */
+    diskfs_blk_t  blocks;      /* size of the map in blocks.      */
+    uint32_t      bits;        /* count of valid bits.            */
+    uint8_t     **buf;         /* blocks loaded so far, or NULL.  */
+    uint8_t      *dirty;       /* blocks changed since flushed.   */
+} diskfs_map_t;
+
+typedef struct diskfs_sb_info {
+    diskfs_map_t  imap;        /* inode map.                      */
+    diskfs_map_t  dmap;        /* data block map.                 */
+    int32_t       dirty;       /* maps or super block changed.    */
+    int32_t       locked;      /* a writer or write-back is busy. */
+    struct inode *dirty_inodes;/* changed files, newest first.    */
+    /* file pages written back at once: */
+    #define DISKFS_WB_PAGES     16
+} diskfs_sb_info_t;
+
 typedef struct diskfs_file_info {
     int32_t buf_empty;    /* buffer is empty? */
     diskfs_blk_t buf_blk; /* buffered block.  */
     char *buffer;         /* buffer.          */
+    /* read-ahead, in pages: */
+    #define DISKFS_RA_MIN  4
+    #define DISKFS_RA_MAX  32
+    uint32_t ra_next;     /* where a sequential read starts.  */
+    uint32_t ra_size;     /* current window, 0 if not in use. */
+    uint32_t ra_end;      /* pages before it were read ahead. */
 } diskfs_file_info_t;
 
 #define DISKFS_CLEAN_INODE(inode) (__extension__({      \
@@ -135,6 +186,121 @@ typedef struct diskfs_dirent {
 #define DISKFS_MAX_NAME   (sizeof(diskfs_dirent_t)-sizeof(diskfs_ino_t)-1)
 #define DIRENT_COUNT(BLK_SIZE) (BLK_SIZE/sizeof(diskfs_dirent_t))
 
+/* Indexed directories:
+ * block 0 is the root; it starts with the "." and ".." dirents,
+ * followed by a diskfs_dx_head_t and the index entries. every entry
+ * maps the names whose hash is >= entry.hash (and < next entry's)
+ * to a block of the directory. with depth 1 that block is a leaf,
+ * an ordinary block of dirents; with depth 2 it is an index node:
+ * a head and more entries, which point to leaves. entries are
+ * sorted by hash, the first one always has hash 0. names with the
+ * same hash are kept in the same leaf. the size of an indexed
+ * directory is blocks*block_size, and free dirents (ino 0 or 1)
+ * don't end it.
+ */
+typedef struct diskfs_dx_head {
+    #define DISKFS_DX_MAGIC     0xFFFFFFFF /* never a valid ino. */
+    uint32_t     magic;
+    uint16_t     depth;        /* root only. */
+    uint16_t     count;        /* entries in use. */
+} __attribute__((packed)) diskfs_dx_head_t;
+
+typedef struct diskfs_dx_entry {
+    uint32_t     hash;
+    diskfs_blk_t blk;          /* relative to the directory. */
+} __attribute__((packed)) diskfs_dx_entry_t;
+
+#define DISKFS_DX_ROOT(BUF) ((diskfs_dx_head_t *) (((char *) (BUF)) + \
+                             2*sizeof(diskfs_dirent_t)))
+#define DISKFS_DX_ROOT_LIMIT(BLK_SIZE) ((BLK_SIZE-2*sizeof(diskfs_dirent_t)-\
+                          sizeof(diskfs_dx_head_t))/sizeof(diskfs_dx_entry_t))
+#define DISKFS_DX_NODE_LIMIT(BLK_SIZE) ((BLK_SIZE-sizeof(diskfs_dx_head_t))/\
+                                        sizeof(diskfs_dx_entry_t))
+
+static __inline__ uint32_t diskfs_dx_hash(const char *name) {
+    /* FNV-1a */
+    uint32_t h = 2166136261U;
+    while (*name)
+        h = (h ^ (uint8_t) *name++) * 16777619U;
+    return h;
+}
+
+static __inline__ diskfs_dx_entry_t *
+diskfs_dx_find(diskfs_dx_head_t *head, uint32_t hash) {
+    /* binary search for the last entry with entry.hash <= hash */
+    diskfs_dx_entry_t *ent = (diskfs_dx_entry_t *) &head[1];
+    int32_t lo = 0, hi = head->count-1, mid;
+    while (lo < hi) {
+        mid = (lo+hi+1)/2;
+        if (ent[mid].hash <= hash)
+            lo = mid;
+        else
+            hi = mid-1;
+    }
+    return &ent[lo];
+}
+
+/* Inline data:
+ * since QUAFS_REVISION_INLINE, a regular file that has
+ * DISKFS_INODE_INLINE set keeps its data (size bytes, at most
+ * DISKFS_INLINE_MAX) in ptr[] and has no blocks. it is turned
+ * into a file with blocks when it grows beyond that.
+ */
+#define DISKFS_INLINE_MAX       (DISKFS_PTRS*sizeof(diskfs_blk_t))
+
+/* Extents:
+ * since QUAFS_REVISION_EXTENTS, ptr[] of an inode that has
+ * DISKFS_INODE_EXTENTS set holds the root of an extent tree
+ * instead of block pointers: a diskfs_ext_head_t followed by
+ * up to DISKFS_EXT_ROOT_LIMIT entries. in a leaf (depth 0) an
+ * entry maps the len file blocks starting at lblk to the disk
+ * blocks starting at start. in an index node (depth > 0) start
+ * is the disk block holding a node of depth-1, which maps the
+ * file blocks from lblk up to the next entry's lblk, and len is
+ * unused. entries are sorted by lblk and don't overlap; the
+ * first entry of a node also covers anything below its lblk.
+ * file blocks that no extent covers are holes.
+ */
+typedef struct diskfs_ext_head {
+    #define DISKFS_EXT_MAGIC    0xE47E
+    uint16_t     magic;
+    uint16_t     count;        /* entries in use. */
+    uint16_t     depth;        /* 0 for leaves.   */
+    uint16_t     unused;
+} __attribute__((packed)) diskfs_ext_head_t;
+
+typedef struct diskfs_extent {
+    diskfs_blk_t lblk;         /* first file block.  */
+    diskfs_blk_t start;        /* first disk block.  */
+    uint32_t     len;          /* count of blocks.   */
+} __attribute__((packed)) diskfs_extent_t;
+
+#define DISKFS_EXT_ROOT(PTR)   ((diskfs_ext_head_t *) (PTR))
+#define DISKFS_EXT_ROOT_LIMIT  ((DISKFS_PTRS*sizeof(diskfs_blk_t)-\
+                          sizeof(diskfs_ext_head_t))/sizeof(diskfs_extent_t))
+#define DISKFS_EXT_NODE_LIMIT(BLK_SIZE) ((BLK_SIZE-\
+                          sizeof(diskfs_ext_head_t))/sizeof(diskfs_extent_t))
+#define DISKFS_EXT_MAX_DEPTH   4
+
+static __inline__ diskfs_extent_t *
+diskfs_ext_find(diskfs_ext_head_t *head, diskfs_blk_t lblk) {
+    /* binary search for the last entry with entry.lblk <= lblk,
+     * the first entry if there is none, NULL if the node is empty.
+     */
+    diskfs_extent_t *ent = (diskfs_extent_t *) &head[1];
+    int32_t lo = 0, hi = head->count-1, mid;
+    if (!head->count)
+        return (diskfs_extent_t *) 0;
+    while (lo < hi) {
+        mid = (lo+hi+1)/2;
+        if (ent[mid].lblk <= lblk)
+            lo = mid;
+        else
+            hi = mid-1;
+    }
+    return &ent[lo];
+}
+
 typedef struct diskfs_lvl {
     int32_t level;
     int32_t ptr[4];
@@ -0,0 +1,128 @@
+/*
+ *        +----------------------------------------------------------+
+ *        | +------------------------------------------------------+ |
+ *        | |  Quafios Kernel 2.0.1.                               | |
+ *        | |  -> iso9660 header.                                  | |
+ *        | +------------------------------------------------------+ |
+ *        +----------------------------------------------------------+
+ *
+ * This file is part of Quafios 2.0.1 source code.
+ * Copyright (C) 2015  Mostafa Abd El-Aziz Mohamed.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Quafios.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Visit http://www.quafios.com/ for contact information.
+ *
+ */
+
+#ifndef ISO9660_H
+#define ISO9660_H
+
+#include <arch/type.h>
+
+/* logical sectors of the volume: */
+#define ISO9660_SECTOR          2048
+
+/* volume descriptors, from sector 16 on: */
+#define ISO9660_VD_START        16
+#define ISO9660_VD_PRIMARY      1
+#define ISO9660_VD_END          255
+#define ISO9660_VD_MAX          32 /* descriptors looked at for the PVD */
+
+/* directory record. numbers are stored both little and big endian,
+ * only the little endian copy is used.
+ */
+typedef struct iso9660_dirrec {
+    uint8_t  len;          /* length of the record.            */
+    uint8_t  ext_len;      /* extended attribute record length. */
+    uint32_t lba;          /* first sector of the extent.      */
+    uint32_t lba_be;
+    uint32_t size;         /* data length.                     */
+    uint32_t size_be;
+    uint8_t  date_time[7];
+    #define ISO9660_FLAG_HIDDEN 0x01
+    #define ISO9660_FLAG_DIR    0x02
+    #define ISO9660_FLAG_MULTI  0x80 /* more extents follow.  */
+    uint8_t  flags;
+    uint8_t  unit_size;    /* interleaving, not supported.     */
+    uint8_t  gap_size;
+    uint16_t volume_seq;
+    uint16_t volume_seq_be;
+    uint8_t  id_len;
+    char     id[1];        /* then padding and system use.     */
+} __attribute__((packed)) iso9660_dirrec_t;
+
+/* smallest directory record, with a 1-byte identifier: */
+#define ISO9660_DIRREC_MIN      34
+
+/* primary volume descriptor (as far as it is used): */
+typedef struct iso9660_pvd {
+    uint8_t  type;
+    char     id[5];        /* "CD001" */
+    uint8_t  version;
+    uint8_t  unused0;
+    char     system_id[32];
+    char     volume_id[32];
+    uint8_t  unused1[8];
+    uint32_t volume_blocks;
+    uint32_t volume_blocks_be;
+    uint8_t  unused2[32];
+    uint32_t set_size;
+    uint32_t volume_seq;
+    uint16_t block_size;
+    uint16_t block_size_be;
+    uint32_t path_table_size;
+    uint32_t path_table_size_be;
+    uint32_t path_table_l;
+    uint32_t opt_path_table_l;
+    uint32_t path_table_m;
+    uint32_t opt_path_table_m;
+    uint8_t  root[ISO9660_DIRREC_MIN]; /* root directory record. */
+} __attribute__((packed)) iso9660_pvd_t;
+
+/* Rock Ridge (SUSP) continuation areas followed for one record: */
+#define ISO9660_CE_MAX          8
+
+/* what the Rock Ridge entries of a record tell: */
+typedef struct iso9660_rr {
+    char     *name;        /* NM: alternate name, NAME_MAX+1 bytes. */
+    uint32_t namelen;      /* 0 if there is no NM entry.       */
+    uint32_t nlink;        /* PX: links, 0 if there is no PX.  */
+    uint32_t cl;           /* CL: relocated child directory.   */
+    uint32_t pl;           /* PL: real parent directory.       */
+    int32_t  re;           /* RE: a relocated directory?       */
+} iso9660_rr_t;
+
+typedef struct iso9660_sb_info {
+    int32_t  rr;           /* Rock Ridge extensions in use?    */
+    uint32_t rr_skip;      /* bytes to skip in system use areas. */
+} iso9660_sb_info_t;
+
+typedef struct iso9660_inode_info {
+    uint32_t lba;          /* first sector of the data.        */
+} iso9660_inode_info_t;
+
+typedef struct iso9660_file_info {
+    /* directories: the sector being walked through */
+    uint8_t *buffer;
+    int32_t  buf_sect;
+    /* regular files: read-ahead, in pages */
+    #define ISO9660_RA_MIN  4
+    #define ISO9660_RA_MAX  32
+    uint32_t ra_next;      /* where a sequential read starts.  */
+    uint32_t ra_size;      /* current window, 0 if not in use. */
+    uint32_t ra_end;       /* pages before it were read ahead. */
+} iso9660_file_info_t;
+
+#endif
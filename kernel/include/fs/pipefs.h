@@ -0,0 +1,45 @@
+/*
+ *        +----------------------------------------------------------+
+ *        | +------------------------------------------------------+ |
+ *        | |  Quafios Kernel 2.0.1.                               | |
+ *        | |  -> pipefs header.                                   | |
+ *        | +------------------------------------------------------+ |
+ *        +----------------------------------------------------------+
+ *
+ * This file is part of Quafios 2.0.1 source code.
+ * Copyright (C) 2015  Mostafa Abd El-Aziz Mohamed.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Quafios.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Visit http://www.quafios.com/ for contact information.
+ *
+ */
+
+#ifndef PIPEFS_H
+#define PIPEFS_H
+
+#include <arch/type.h>
+
+/* size of the ring of a pipe */
+#define PIPE_PAGES      16
+
+/* ends of a pipe */
+#define PIPE_READ       0
+#define PIPE_WRITE      1
+
+typedef struct pipefs_file_info {
+    int32_t end; /* PIPE_READ or PIPE_WRITE. */
+} pipefs_file_info_t;
+
+#endif
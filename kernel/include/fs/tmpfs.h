@@ -37,19 +37,59 @@ typedef uint32_t tmpfs_ino_t;
 typedef uint32_t tmpfs_mode_t;
 typedef uint64_t tmpfs_pos_t;
 
-/* Data block: */
-typedef struct tmpfs_block {
-    struct tmpfs_block *next;
-    uint8_t *data;
-} tmpfs_block_t;
+/* Data pages:
+ * the data of a regular file is kept in whole page frames, found
+ * through a radix tree indexed by page offset. slots of the nodes at
+ * the last level hold physical frame addresses, those of the other
+ * nodes point to nodes of the next level. pages that were never
+ * written are holes. the frames are reached through the physical
+ * memory window, and may be mapped into processes as they are.
+ */
+#define TMPFS_RESERVE       1024 /* frames (4MB) left for the others. */
+#define TMPFS_RADIX_SHIFT   6
+#define TMPFS_RADIX_SLOTS   (1 << TMPFS_RADIX_SHIFT)
+#define TMPFS_RADIX_MASK    (TMPFS_RADIX_SLOTS - 1)
+
+typedef struct tmpfs_radix {
+    void *slot[TMPFS_RADIX_SLOTS];
+} tmpfs_radix_t;
+
+typedef struct tmpfs_pages {
+    tmpfs_radix_t *root;
+    uint32_t height;    /* levels of nodes, 0 if there is no root. */
+    uint32_t count;     /* pages allocated.                        */
+} tmpfs_pages_t;
+
+/* Directories:
+ * entries are hashed by name in a table that doubles as the
+ * directory grows, and also kept in creation order for readdir.
+ * names up to TMPFS_DNAME_INLINE-1 bytes are stored in the entry.
+ * an open directory pins the entry its cursor stands on; removing
+ * a pinned entry only unhashes it (inode becomes 0) and the last
+ * cursor to leave frees it.
+ */
+#define TMPFS_DNAME_INLINE  20
+#define TMPFS_DHASH_MIN     8   /* initial buckets. */
 
-/* Directory Entry: */
 typedef struct tmpfs_dentry {
+    struct tmpfs_dentry *hnext; /* hash chain.                 */
+    struct tmpfs_dentry *prev;  /* creation order.             */
     struct tmpfs_dentry *next;
-    tmpfs_ino_t inode;
-    char *name;
+    tmpfs_ino_t inode;          /* 0 if removed.               */
+    uint32_t hash;              /* hash of the name.           */
+    uint32_t pin;               /* cursors standing here.      */
+    char *name;                 /* iname or a kmalloc'd copy.  */
+    char iname[TMPFS_DNAME_INLINE];
 } tmpfs_dentry_t;
 
+typedef struct tmpfs_dir {
+    tmpfs_dentry_t **hash;
+    uint32_t buckets;           /* a power of two.             */
+    uint32_t count;             /* live entries, . and .. too. */
+    tmpfs_dentry_t *first;
+    tmpfs_dentry_t *last;
+} tmpfs_dir_t;
+
 /* tmpfs inode: */
 typedef struct tmpfs_inode {
 
@@ -61,8 +101,8 @@ typedef struct tmpfs_inode {
 
     /* data: */
     union {
-        _linkedlist(tmpfs_block_t) blocks;
-        _linkedlist(tmpfs_dentry_t) dentries;
+        tmpfs_pages_t pages;
+        tmpfs_dir_t dir;
     } u;
 
 } tmpfs_inode_t;
@@ -72,7 +112,6 @@ typedef struct tmpfs_inode_info {
 } tmpfs_inode_info_t;
 
 typedef struct tmpfs_file_info {
-    tmpfs_block_t *curblk;
     tmpfs_dentry_t *curdent;
     uint32_t off;
     char *dummy_p;
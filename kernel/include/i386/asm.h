@@ -43,6 +43,12 @@
 
 #define nop()   __asm__ ("nop\n\t")
 
+#define rdtsc() (__extension__({                        \
+            uint64_t __res;                             \
+            __asm__ __volatile__ ("rdtsc":"=A"(__res)); \
+            __res;                                      \
+        }))
+
 #define call(addr) __asm__("call *%%eax"::"a"(addr));
 
 #define inb(port) (__extension__({                      \
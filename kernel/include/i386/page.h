@@ -59,7 +59,9 @@ struct page_entry {
 #define PAGE_ENTRY_P    0x001
 #define PAGE_ENTRY_RW   0x002
 #define PAGE_ENTRY_US   0x004
+#define PAGE_ENTRY_D    0x040 /* Dirty (set by the CPU on write) */
 #define PAGE_ENTRY_AF   0x200 /* Allocated Flag */
+#define PAGE_ENTRY_COW  0x400 /* Copy-on-Write Flag */
 
 #define PAGE_ENTRY_KERNEL_MODE  (PAGE_ENTRY_P | PAGE_ENTRY_RW)
 #define PAGE_ENTRY_USER_MODE    (PAGE_ENTRY_P | PAGE_ENTRY_RW | PAGE_ENTRY_US)
@@ -50,7 +50,10 @@
 #define CR0_CD          0x40000000  /* Cache disable.         */
 #define CR0_PG          0x80000000  /* Paging.                */
 
-#define CR0_GENERIC     (CR0_PE /* | CR0_NW | CR0_CD */ | CR0_PG)
+/* WP makes the kernel honour read-only user pages too, so that writes
+ * done on behalf of a process (e.g. receive()) break copy-on-write.
+ */
+#define CR0_GENERIC     (CR0_PE /* | CR0_NW | CR0_CD */ | CR0_WP | CR0_PG)
 
 /* GDT:  */
 /* ----- */
@@ -30,11 +30,29 @@
 #define SPINLOCK_H
 
 #include <i386/type.h>
+#include <sys/lockprof.h>
 
-typedef int32_t spinlock_t;
+/* ticket spinlock: an acquirer takes the next ticket and spins until
+ * owner reaches it, so waiters get the lock in FIFO order.
+ */
+typedef struct spinlock {
+    volatile uint16_t owner;  /* ticket being served. */
+    volatile uint16_t next;   /* next ticket to take. */
+    LOCKPROF_FIELDS
+} spinlock_t;
+
+#define SPINLOCK_INIT   {0, 0}
 
 void spinlock_init(spinlock_t *spinlock);
 void spinlock_acquire(spinlock_t *spinlock);
+int32_t spinlock_tryacquire(spinlock_t *spinlock);
 void spinlock_release(spinlock_t *spinlock);
+int32_t spinlock_acquire_irqsave(spinlock_t *spinlock);
+void spinlock_release_irqrestore(spinlock_t *spinlock, int32_t status);
+
+/* atomic primitives */
+int32_t arch_atomic_xchg(volatile int32_t *ptr, int32_t val);
+int32_t arch_atomic_cmpxchg(volatile int32_t *ptr, int32_t old, int32_t val);
+void arch_cpu_relax();
 
 #endif
@@ -41,5 +41,7 @@ typedef struct {
 /* Prototypes */
 
 String toString(char *);
+void *memcpy(void *dest, const void *src, size_t n);
+void *memset(void *dest, int c, size_t n);
 
 #endif
@@ -28,6 +28,9 @@
 
 #include <arch/type.h>
 
+/* ioctl commands */
+#define RAMDISK_RELEASE 0x00 /* the image is not needed anymore */
+
 typedef struct {
     uint32_t base; /* optional.  */
     uint32_t size; /* mandatory. */
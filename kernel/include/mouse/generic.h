@@ -34,6 +34,9 @@
 #define MOUSE_GETX      0
 #define MOUSE_GETY      1
 #define MOUSE_REG       2
+#define MOUSE_CHAN      3  /* get the id of the packet channel. */
+
+#define MOUSE_CHAN_SLOTS    64
 
 typedef struct {
 
@@ -39,4 +39,13 @@ typedef struct disk {
     int32_t partitioned;
 } disk_t;
 
+/* pages written back by blkdev_sync() at once */
+#define BLKDEV_SYNC_PAGES   16
+
+uint32_t blkdev_read(device_t *dev, uint64_t off, uint32_t size, char *buff);
+uint32_t blkdev_write(device_t *dev, uint64_t off, uint32_t size, char *buff);
+uint32_t blkdev_write_direct(device_t *dev, uint64_t off, uint32_t size,
+                             char *buff);
+uint32_t blkdev_sync(device_t *dev);
+
 #endif
@@ -0,0 +1,63 @@
+/*
+ *        +----------------------------------------------------------+
+ *        | +------------------------------------------------------+ |
+ *        | |  Quafios Kernel 2.0.1.                               | |
+ *        | |  -> procman: shared memory channels header.          | |
+ *        | +------------------------------------------------------+ |
+ *        +----------------------------------------------------------+
+ *
+ * This file is part of Quafios 2.0.1 source code.
+ * Copyright (C) 2015  Mostafa Abd El-Aziz Mohamed.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Quafios.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Visit http://www.quafios.com/ for contact information.
+ *
+ */
+
+#ifndef CHAN_H
+#define CHAN_H
+
+#include <arch/type.h>
+
+/* a channel is a single-producer single-consumer ring of fixed-size
+ * slots, living in pages that are mapped by both ends. data never goes
+ * through the kernel: the producer only enters the kernel to ring the
+ * doorbell (chan_notify) when it finds the consumer asleep.
+ */
+typedef struct chan_ring {
+    volatile uint32_t head;     /* next slot to fill (producer).       */
+    volatile uint32_t tail;     /* next slot to drain (consumer).      */
+    volatile uint32_t sleeping; /* consumer is blocked in chan_wait(). */
+    uint32_t slot_size;         /* size of a slot in bytes.            */
+    uint32_t slots;             /* count of slots, a power of 2.       */
+    volatile uint32_t dropped;  /* pushes lost because ring was full.  */
+} chan_ring_t;
+
+/* slots follow the ring header. the kernel doesn't go by what the
+ * mappers write into it, these are for user space.
+ */
+#define CHAN_SLOT(ring, i)  ((void *) (((uint8_t *) ((ring)+1)) + \
+                            ((i) & ((ring)->slots-1))*(ring)->slot_size))
+#define CHAN_EMPTY(ring)    ((ring)->head == (ring)->tail)
+#define CHAN_FULL(ring)     ((ring)->head - (ring)->tail == (ring)->slots)
+
+/* limits */
+#define CHAN_MAX_PAGES      16
+
+/* roles for chan_map() */
+#define CHAN_CONSUMER       0
+#define CHAN_PRODUCER       1
+
+#endif
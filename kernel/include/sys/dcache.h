@@ -0,0 +1,61 @@
+/*
+ *        +----------------------------------------------------------+
+ *        | +------------------------------------------------------+ |
+ *        | |  Quafios Kernel 2.0.1.                               | |
+ *        | |  -> Directory entry cache header.                    | |
+ *        | +------------------------------------------------------+ |
+ *        +----------------------------------------------------------+
+ *
+ * This file is part of Quafios 2.0.1 source code.
+ * Copyright (C) 2015  Mostafa Abd El-Aziz Mohamed.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Quafios.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Visit http://www.quafios.com/ for contact information.
+ *
+ */
+
+#ifndef DCACHE_H
+#define DCACHE_H
+
+#include <arch/type.h>
+#include <sys/fs.h>
+
+/* longest name that is cached */
+#define DNAME_LEN       32
+
+/* matches any directory in dcache_purge() */
+#define DCACHE_ANY      0xFFFFFFFF
+
+/* a cached directory entry: name in directory (sb, dir) is the inode
+ * ino, or doesn't exist at all if ino is 0 (a negative entry).
+ * entries hold inode numbers, not inode references.
+ */
+typedef struct dentry {
+    struct dentry *hnext;   /* hash chain.                      */
+    struct dentry *prev;    /* LRU list, oldest first.          */
+    struct dentry *next;
+    super_block_t *sb;
+    ino_t    dir;
+    uint32_t hash;          /* hash of the name.                */
+    ino_t    ino;
+    char     name[DNAME_LEN];
+} dentry_t;
+
+int32_t dlookup(inode_t *dir, char *name, inode_t **ret);
+void dcache_invalidate(inode_t *dir, char *name);
+void dcache_purge(super_block_t *sb, ino_t dir);
+void dcache_init();
+
+#endif
@@ -38,6 +38,7 @@
 /* ------------------ */
 typedef struct device_str device_t;
 typedef struct driver_str driver_t;
+struct poll_table;
 
 /* Driver Structure:  */
 /* ------------------ */
@@ -50,6 +51,7 @@ struct driver_str {
     uint32_t (*write)(device_t *dev, uint64_t off, uint32_t size, char *buff);
     uint32_t (*ioctl)(device_t *dev, uint32_t cmd, void *data);
     uint32_t (*irq  )(device_t *dev, uint32_t irqn);
+    uint32_t (*poll )(device_t *dev, struct poll_table *pt); /* optional. */
 };
 
 /* Supported Drivers:  */
@@ -70,6 +72,7 @@ extern driver_t pstty_driver;
 extern driver_t vga_driver;
 extern driver_t ide_driver;
 extern driver_t atadisk_driver;
+extern driver_t atapicd_driver;
 extern driver_t ahci_driver;
 extern driver_t uhci_driver;
 extern driver_t ehci_driver;
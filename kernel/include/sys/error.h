@@ -51,5 +51,9 @@ typedef int32_t error_t;
 #define EMFILE          0x0F
 #define EBADF           0x10
 #define EIO             0x11
+#define EPIPE           0x12
+#define ENAMETOOLONG    0x13
+#define ESPIPE          0x14
+#define EMSGSIZE        0x15
 
 #endif
@@ -38,6 +38,8 @@
 #include <sys/mm.h>
 #include <fs/tmpfs.h>
 #include <fs/diskfs.h>
+#include <fs/pipefs.h>
+#include <fs/iso9660.h>
 
 /* Inode number: */
 typedef uint32_t ino_t;
@@ -46,6 +48,7 @@ typedef uint32_t ino_t;
 #define FT_REGULAR      0x0000
 #define FT_DIR          0x1000
 #define FT_SPECIAL      0x2000
+#define FT_FIFO         0x3000
 #define FT_MASK         0xF000
 typedef uint32_t mode_t;
 
@@ -60,6 +63,7 @@ typedef int64_t pos_t;
 
 /* file name: */
 #define FILENAME_MAX    4096 /* maximum file name */
+#define NAME_MAX        255  /* maximum path component */
 
 /* filesystem driver flags: */
 #define FSD_REQDEV      0x01
@@ -72,6 +76,8 @@ extern struct fsd tmpfs_t;
 extern struct fsd devfs_t;
 extern struct fsd sysfs_t;
 extern struct fsd diskfs_t;
+extern struct fsd pipefs_t;
+extern struct fsd iso9660_t;
 extern struct fsd *fsdrivers[];
 #define FSDRIVER_COUNT  (sizeof(fsdrivers)/sizeof(fsd_t*))
 
@@ -96,6 +102,25 @@ typedef struct dirent {
     char name[FILENAME_MAX+1];
 } dirent_t;
 
+/* getdents() records, packed one after another: */
+typedef struct dirent_rec {
+    ino_t    ino;
+    uint16_t reclen;  /* bytes up to the next record. */
+    uint16_t namelen; /* not counting the zero.       */
+    char     name[4]; /* namelen+1 bytes.             */
+} dirent_rec_t;
+
+#define DIRENT_REC_LEN(namelen) \
+    ((sizeof(ino_t)+2*sizeof(uint16_t)+(namelen)+1+3) & ~3)
+
+/* readv()/writev() buffers: */
+typedef struct iovec {
+    void   *base;
+    size_t  len;
+} iovec_t;
+
+#define IOV_MAX         1024 /* maximum buffers in one call */
+
 /* VFS Mount Point: */
 typedef struct vfsmount {
     struct vfsmount *vfsparent; /* parent mountpoint. */
@@ -114,12 +139,20 @@ typedef struct super_block {
     int32_t mounts;       /* mounts...                              */
     int32_t blksize;
     void *disksb;         /* a copy of disk superblock.             */
+
+    /* filesystem specific information: */
+    union {
+        diskfs_sb_info_t diskfs;
+        iso9660_sb_info_t iso9660;
+    } info;
 } super_block_t;
 
 /* VFS inode: */
 typedef struct inode {
-    /* for container linked list: */
-    struct inode *next;
+    /* inode cache: */
+    struct inode *next;     /* hash chain.                    */
+    struct inode *lru_prev; /* unused inodes, oldest first.   */
+    struct inode *lru_next;
 
     /* identity: */
     super_block_t *sb; /* filesystem to which this inode belongs. */
@@ -147,9 +180,13 @@ typedef struct inode {
     union {
         diskfs_inode_info_t diskfs;
         tmpfs_inode_info_t tmpfs;
+        iso9660_inode_info_t iso9660;
     } info;
 } inode_t;
 
+/* namei flags: */
+#define NAMEI_PATH      0x01 /* return the full path too. */
+
 /* namei data: */
 typedef struct namei {
     /* full path: */
@@ -183,6 +220,8 @@ typedef struct file {
     union {
         diskfs_file_info_t diskfs;
         tmpfs_file_info_t tmpfs;
+        pipefs_file_info_t pipefs;
+        iso9660_file_info_t iso9660;
     } info;
 } file_t;
 
@@ -217,8 +256,17 @@ typedef struct fsd {
     int32_t (*read)(file_t *file, void *buf, int32_t size);
     int32_t (*write)(file_t *file, void *buf, int32_t size);
     int32_t (*seek)(file_t *file, pos_t newpos);
+    int32_t (*pread)(file_t *file, void *buf, int32_t size, pos_t pos,
+                     int32_t *done);                      /* optional. */
+    int32_t (*pwrite)(file_t *file, void *buf, int32_t size, pos_t pos,
+                      int32_t *done);                     /* optional. */
     int32_t (*readdir)(file_t *dir, dirent_t *dirent);
+    int32_t (*getdents)(file_t *dir, void *buf, int32_t size, int32_t *done);
     int32_t (*ioctl)(file_t *file, int32_t cmd, void *arg);
+    int32_t (*poll)(file_t *file, struct poll_table *pt); /* optional. */
+    int32_t (*sync)(super_block_t *sb, inode_t *inode);   /* optional. */
+    int32_t (*getpage)(inode_t *inode, pos_t pos,
+                       uint32_t *frame);                  /* optional. */
 } fsd_t;
 
 #endif
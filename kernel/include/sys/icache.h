@@ -0,0 +1,53 @@
+/*
+ *        +----------------------------------------------------------+
+ *        | +------------------------------------------------------+ |
+ *        | |  Quafios Kernel 2.0.1.                               | |
+ *        | |  -> Inode cache header.                              | |
+ *        | +------------------------------------------------------+ |
+ *        +----------------------------------------------------------+
+ *
+ * This file is part of Quafios 2.0.1 source code.
+ * Copyright (C) 2015  Mostafa Abd El-Aziz Mohamed.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Quafios.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Visit http://www.quafios.com/ for contact information.
+ *
+ */
+
+
+#ifndef ICACHE_H
+#define ICACHE_H
+
+#include <arch/type.h>
+#include <sys/fs.h>
+
+/* hash table size, a power of two: */
+#define ICACHE_BITS     10
+#define ICACHE_HASH     (1 << ICACHE_BITS)
+
+/* unused inodes kept around, the oldest is dropped after: */
+#define ICACHE_MAX      1024
+
+/* unused inodes dropped at once when memory is short: */
+#define ICACHE_BATCH    32
+
+inode_t *iget(super_block_t *sb, ino_t ino);
+inode_t *igrab(inode_t *p);
+void iput(inode_t *p);
+void icache_purge(super_block_t *sb);
+uint32_t icache_shrink(uint32_t count);
+void icache_init();
+
+#endif
@@ -34,6 +34,25 @@ typedef struct msg {
     int32_t sender;
     uint32_t size;
     void *buf;
+    uint32_t cap;      /* receiving: how much buf can take. */
 } msg_t;
 
+/* kernel copy of a message waiting in an inbox. messages are kept in
+ * fixed-size slots: small payloads live inline in the slot, whole pages
+ * of big page-aligned payloads travel as copy-on-write frames, and
+ * anything else goes to a separate kernel buffer.
+ */
+#define MSG_SLOT_SIZE       256
+#define MSG_INLINE_SIZE     (MSG_SLOT_SIZE-6*sizeof(uint32_t))
+
+typedef struct kmsg {
+    struct kmsg *next;
+    int32_t sender;
+    uint32_t size;     /* total size of the message.             */
+    uint32_t pages;    /* how many leading pages are in frame[]. */
+    uint32_t *frame;   /* physical frames of the leading pages.  */
+    uint8_t *buf;      /* the rest of the message.               */
+    uint8_t data[MSG_INLINE_SIZE];
+} kmsg_t;
+
 #endif
@@ -0,0 +1,93 @@
+/*
+ *        +----------------------------------------------------------+
+ *        | +------------------------------------------------------+ |
+ *        | |  Quafios Kernel 2.0.1.                               | |
+ *        | |  -> Lock profiler header.                            | |
+ *        | +------------------------------------------------------+ |
+ *        +----------------------------------------------------------+
+ *
+ * This file is part of Quafios 2.0.1 source code.
+ * Copyright (C) 2015  Mostafa Abd El-Aziz Mohamed.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Quafios.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Visit http://www.quafios.com/ for contact information.
+ *
+ */
+
+#ifndef LOCKPROF_H
+#define LOCKPROF_H
+
+#include <arch/type.h>
+
+/* lock kinds */
+#define LOCK_SPIN       0
+#define LOCK_SEMA       1
+#define LOCK_MUTEX      2
+
+/* maximum count of (lock, call site) pairs to keep track of */
+#define LOCKPROF_MAX    256
+
+/* statistics of a lock, as acquired from one call site. times are
+ * in TSC cycles. wait time is measured from the call of the acquire
+ * function until it returns, hold time until the next release.
+ */
+typedef struct lockprof {
+    void     *lock;
+    void     *site;
+    int32_t  kind;
+    uint32_t acquired;
+    uint32_t contended;
+    uint64_t wait_total;
+    uint64_t wait_max;
+    uint64_t hold_total;
+    uint64_t hold_max;
+} lockprof_t;
+
+/* hooks used by lock primitives; they compile to nothing unless
+ * CONFIG_LOCKPROF is defined in kernel/config.h. a profiled lock
+ * has two extra fields: prof and since (see LOCKPROF_FIELDS).
+ */
+#ifdef CONFIG_LOCKPROF
+
+#define LOCKPROF_FIELDS                                             \
+    struct lockprof *prof;  /* statistics of the current holder. */ \
+    uint64_t since;         /* acquisition time.                 */
+
+#define LOCKPROF_CLOCK()    lockprof_clock()
+
+#define LOCKPROF_ACQUIRED(l, kind, site, contended, start)          \
+    lockprof_acquired((l), (kind), (site), (contended), (start),    \
+                      &(l)->prof, &(l)->since)
+
+#define LOCKPROF_RELEASED(l)                                        \
+    lockprof_released(&(l)->prof, (l)->since)
+
+uint64_t lockprof_clock();
+void lockprof_acquired(void *lock, int32_t kind, void *site,
+                       int32_t contended, uint64_t start,
+                       struct lockprof **prof, uint64_t *since);
+void lockprof_released(struct lockprof **prof, uint64_t since);
+void lockprof_init();
+
+#else
+
+#define LOCKPROF_FIELDS
+#define LOCKPROF_CLOCK()                                    0
+#define LOCKPROF_ACQUIRED(l, kind, site, contended, start)
+#define LOCKPROF_RELEASED(l)
+
+#endif
+
+#endif
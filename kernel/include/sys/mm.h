@@ -97,6 +97,8 @@ typedef struct file_mem {
     uint64_t pos;      /* position of the mapping (offset in the file) */
     uint32_t paddr;    /* phyiscal memory address */
     uint32_t ref;      /* how many people use this? */
+    uint32_t shared;   /* MAP_SHARED mapping? */
+    uint32_t direct;   /* paddr is the file's own page (getpage)? */
 } file_mem_t;
 
 /* Process memory Image: */
@@ -110,6 +112,10 @@ typedef struct {
     void *arch_reg;
 } umem_t;
 
+/* msync flags */
+#define MS_ASYNC        1 /* hand dirty pages over to the page cache */
+#define MS_SYNC         2 /* ... and wait for them to reach the disk */
+
 /* mmap arguments */
 typedef struct {
     void *base;
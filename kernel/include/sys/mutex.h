@@ -0,0 +1,59 @@
+/*
+ *        +----------------------------------------------------------+
+ *        | +------------------------------------------------------+ |
+ *        | |  Quafios Kernel 2.0.1.                               | |
+ *        | |  -> Mutex header.                                    | |
+ *        | +------------------------------------------------------+ |
+ *        +----------------------------------------------------------+
+ *
+ * This file is part of Quafios 2.0.1 source code.
+ * Copyright (C) 2015  Mostafa Abd El-Aziz Mohamed.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Quafios.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Visit http://www.quafios.com/ for contact information.
+ *
+ */
+
+#ifndef MUTEX_H
+#define MUTEX_H
+
+#include <arch/type.h>
+#include <arch/spinlock.h>
+#include <sys/proc.h>
+#include <sys/lockprof.h>
+
+/* state of a mutex */
+#define MUTEX_FREE      0
+#define MUTEX_LOCKED    1
+#define MUTEX_CONTENDED 2 /* locked and there may be sleepers. */
+
+/* times to retry before going to sleep */
+#define MUTEX_SPINS     100
+
+typedef struct mutex {
+    volatile int32_t state;
+    proc_t *owner;
+    spinlock_t spinlock; /* protects the sleepers queue. */
+    pd_t *head;
+    pd_t *tail;
+    LOCKPROF_FIELDS
+} mutex_t;
+
+void mutex_init(mutex_t *mutex);
+void mutex_lock(mutex_t *mutex);
+int32_t mutex_trylock(mutex_t *mutex);
+void mutex_unlock(mutex_t *mutex);
+
+#endif
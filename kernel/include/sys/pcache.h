@@ -0,0 +1,87 @@
+/*
+ *        +----------------------------------------------------------+
+ *        | +------------------------------------------------------+ |
+ *        | |  Quafios Kernel 2.0.1.                               | |
+ *        | |  -> Page cache header.                               | |
+ *        | +------------------------------------------------------+ |
+ *        +----------------------------------------------------------+
+ *
+ * This file is part of Quafios 2.0.1 source code.
+ * Copyright (C) 2015  Mostafa Abd El-Aziz Mohamed.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Quafios.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Visit http://www.quafios.com/ for contact information.
+ *
+ */
+
+#ifndef PCACHE_H
+#define PCACHE_H
+
+#include <arch/type.h>
+
+/* page flags */
+#define PG_VALID        0x01 /* data is up to date.                  */
+#define PG_BUSY         0x02 /* being filled by the process that got it. */
+#define PG_ORPHAN       0x04 /* invalidated while in use.            */
+#define PG_DIRTY        0x08 /* changed since it was last written.   */
+
+/* dirty pages are tracked by 512-byte sector */
+#define PCACHE_SECTOR   512
+
+/* dirty pages beyond which writers are to write back themselves */
+#define PCACHE_DIRTY_MAX 2048
+
+/* pages to reclaim at once under memory pressure */
+#define PCACHE_BATCH    32
+
+/* matches any id in pcache_invalidate() */
+#define PCACHE_ANY      0xFFFFFFFF
+
+/* a cached page of some object. block devices cache their contents
+ * under (device, 0, offset/PAGE_SIZE), filesystems cache file data
+ * under (super block, inode number, offset/PAGE_SIZE); the inode
+ * number is used rather than the inode_t so that pages survive the
+ * inode structure being released.
+ */
+typedef struct page {
+    struct page *hnext;     /* hash chain.                      */
+    struct page *prev;      /* LRU list, oldest first.          */
+    struct page *next;
+    struct page *dprev;     /* dirty list, oldest first.        */
+    struct page *dnext;
+    void     *owner;
+    uint32_t id;
+    uint32_t index;
+    int32_t  count;         /* users, the page is pinned while > 0. */
+    int32_t  flags;
+    uint32_t dirty;         /* dirty sectors, bit 0 is the first. */
+    uint8_t  *data;         /* PAGE_SIZE bytes, page aligned.   */
+} page_t;
+
+page_t *pcache_get(void *owner, uint32_t id, uint32_t index);
+page_t *pcache_grab(void *owner, uint32_t id, uint32_t index);
+page_t *pcache_find(void *owner, uint32_t id, uint32_t index);
+void pcache_ready(page_t *page, int32_t valid);
+void pcache_put(page_t *page);
+void pcache_dirty(page_t *page, uint32_t off, uint32_t size);
+uint32_t pcache_clean(page_t *page, uint32_t off, uint32_t size);
+uint32_t pcache_collect(void *owner, uint32_t id, page_t **list, uint32_t max);
+int32_t pcache_congested();
+void pcache_invalidate(void *owner, uint32_t id, uint32_t from);
+uint32_t pcache_shrink(uint32_t count);
+int32_t pcache_low();
+void pcache_init();
+
+#endif
@@ -0,0 +1,53 @@
+/*
+ *        +----------------------------------------------------------+
+ *        | +------------------------------------------------------+ |
+ *        | |  Quafios Kernel 2.0.1.                               | |
+ *        | |  -> Filesystem: poll() header.                       | |
+ *        | +------------------------------------------------------+ |
+ *        +----------------------------------------------------------+
+ *
+ * This file is part of Quafios 2.0.1 source code.
+ * Copyright (C) 2015  Mostafa Abd El-Aziz Mohamed.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Quafios.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Visit http://www.quafios.com/ for contact information.
+ *
+ */
+
+#ifndef POLL_H
+#define POLL_H
+
+#include <arch/type.h>
+
+typedef struct pollfd {
+    int32_t fd;       /* file descriptor, or POLL_INBOX.  */
+    int16_t events;   /* events to wait for.              */
+    int16_t revents;  /* events that happened (output).   */
+} pollfd_t;
+
+/* events */
+#define POLLIN          0x01    /* data can be read.               */
+#define POLLOUT         0x04    /* data can be written.            */
+#define POLLERR         0x08    /* error condition (output only).  */
+#define POLLHUP         0x10    /* other end hung up (output only). */
+#define POLLNVAL        0x20    /* fd is not open (output only).   */
+
+/* pseudo descriptor of the message inbox, POLLIN when it isn't empty */
+#define POLL_INBOX      (-2)
+
+/* maximum count of pollfd_t entries per call */
+#define POLL_MAX        64
+
+#endif
@@ -32,4 +32,9 @@
 #include <sys/device.h>
 extern device_t *system_console;
 
+uint32_t sputs(char *buf, char *str);
+uint32_t sputd(char *buf, int32_t value);
+uint32_t sputx(char *buf, uint32_t value);
+uint32_t sputq(char *buf, uint64_t value);
+
 #endif
@@ -84,15 +84,22 @@ typedef struct proc_s {
     /* when a syscall is called: */
     void *context;
 
+    /* kernel tasks start here, NULL for user processes: */
+    void (*kmain)();
+
     /* used by the scheduler: */
     int32_t  after_fork;
     uint32_t reg1;
     uint32_t reg2;
 
     /* message inbox */
-    int32_t inbox_lock;
+    spinlock_t inbox_lock;
     int32_t blocked_for_msg;
-    _linkedlist(msg_t) inbox;
+    _linkedlist(kmsg_t) inbox;
+
+    /* synchronous call in progress */
+    int32_t blocked_for_reply; /* pid of the callee, 0 if none */
+    kmsg_t *reply;
 
     /* children */
     int32_t blocked_for_child;
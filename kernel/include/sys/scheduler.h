@@ -43,5 +43,6 @@ extern pdlist_t q_ready, q_blocked;
 
 void scheduler();
 void sleep(uint64_t milliseconds);
+int32_t uptime();
 
 #endif
@@ -32,12 +32,14 @@
 #include <arch/type.h>
 #include <arch/spinlock.h>
 #include <sys/proc.h>
+#include <sys/lockprof.h>
 
 typedef struct semaphore {
     int32_t counter;
     spinlock_t spinlock;
     pd_t *head;
     pd_t *tail;
+    LOCKPROF_FIELDS
 } semaphore_t;
 
 void sema_init(semaphore_t *sema, int32_t counter);
@@ -0,0 +1,61 @@
+/*
+ *        +----------------------------------------------------------+
+ *        | +------------------------------------------------------+ |
+ *        | |  Quafios Kernel 2.0.1.                               | |
+ *        | |  -> Slab allocator header.                           | |
+ *        | +------------------------------------------------------+ |
+ *        +----------------------------------------------------------+
+ *
+ * This file is part of Quafios 2.0.1 source code.
+ * Copyright (C) 2015  Mostafa Abd El-Aziz Mohamed.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Quafios.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Visit http://www.quafios.com/ for contact information.
+ *
+ */
+
+
+#ifndef SLAB_H
+#define SLAB_H
+
+#include <arch/type.h>
+#include <arch/spinlock.h>
+
+/* a slab is one page of kernel memory cut into objects of the same
+ * size, with this header at the start. the header of an object's
+ * slab is found by rounding the object's address down to the page.
+ */
+typedef struct slab {
+    struct slab *prev;      /* slabs of the cache that have room. */
+    struct slab *next;
+    void    *free;          /* first free object.                 */
+    uint32_t used;          /* objects handed out.                */
+} slab_t;
+
+/* a cache of objects of one size: */
+typedef struct slab_cache {
+    uint32_t size;          /* object size, rounded up.           */
+    uint32_t per_slab;      /* objects that fit in a slab.        */
+    slab_t  *partial;       /* slabs with free objects.           */
+    uint32_t slabs;         /* pages owned by the cache.          */
+    uint32_t objs;          /* objects handed out.                */
+    spinlock_t lock;
+} slab_cache_t;
+
+void slab_init(slab_cache_t *cache, uint32_t size);
+void *slab_alloc(slab_cache_t *cache);
+void slab_free(slab_cache_t *cache, void *obj);
+
+#endif
@@ -67,5 +67,26 @@
 #define SYS_GETPID      0x21
 #define SYS_REBOOT      0x22
 #define SYS_MUNMAP      0x23
+#define SYS_CALL        0x24
+#define SYS_REPLY_WAIT  0x25
+#define SYS_CHAN_CREATE 0x26
+#define SYS_CHAN_MAP    0x27
+#define SYS_CHAN_WAIT   0x28
+#define SYS_CHAN_NOTIFY 0x29
+#define SYS_CHAN_CLOSE  0x2A
+#define SYS_POLL        0x2B
+#define SYS_PIPE        0x2C
+#define SYS_SPLICE      0x2D
+#define SYS_SYNC        0x2E
+#define SYS_FSYNC       0x2F
+#define SYS_GETDENTS    0x30
+#define SYS_PREAD       0x31
+#define SYS_PWRITE      0x32
+#define SYS_READV       0x33
+#define SYS_WRITEV      0x34
+#define SYS_COPY_RANGE  0x35
+#define SYS_MSYNC       0x36
+#define SYS_UPTIME      0x37
+#define SYS_CHAN_GRANT  0x38
 
 #endif
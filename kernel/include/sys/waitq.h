@@ -0,0 +1,69 @@
+/*
+ *        +----------------------------------------------------------+
+ *        | +------------------------------------------------------+ |
+ *        | |  Quafios Kernel 2.0.1.                               | |
+ *        | |  -> procman: wait queues header.                     | |
+ *        | +------------------------------------------------------+ |
+ *        +----------------------------------------------------------+
+ *
+ * This file is part of Quafios 2.0.1 source code.
+ * Copyright (C) 2015  Mostafa Abd El-Aziz Mohamed.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Quafios.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Visit http://www.quafios.com/ for contact information.
+ *
+ */
+
+#ifndef WAITQ_H
+#define WAITQ_H
+
+#include <arch/type.h>
+
+/* a wait queue is a list of processes sleeping on some event. the
+ * waiter_t nodes are owned by the sleepers (usually on their stacks),
+ * so one process can sleep on many queues at once (poll).
+ */
+typedef struct waiter {
+    struct waiter *next;
+    struct proc_s *proc;    /* the sleeping process.            */
+    struct waitq *queue;    /* the queue this node is linked to. */
+    uint64_t when;          /* deadline in ticks (timeouts).    */
+} waiter_t;
+
+/* same layout as _linkedlist(waiter_t) */
+typedef struct waitq {
+    waiter_t *first;
+    waiter_t *last;
+    unsigned int count;
+} waitq_t;
+
+/* collects the queues a poll() caller sleeps on */
+typedef struct poll_table {
+    waiter_t *waiter;       /* array of nodes.         */
+    uint32_t count;         /* nodes in use.           */
+    uint32_t max;           /* size of the array.      */
+} poll_table_t;
+
+#ifdef QUAFIOS_KERNEL
+void waitq_init(waitq_t *q);
+void waitq_add(waitq_t *q, waiter_t *w);
+void waitq_remove(waiter_t *w);
+void waitq_sleep(waitq_t *q);
+void waitq_timeout(waiter_t *w, uint64_t when);
+void wake_up(waitq_t *q);
+void poll_wait(poll_table_t *pt, waitq_t *q);
+#endif
+
+#endif
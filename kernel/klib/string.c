@@ -55,6 +55,31 @@ void strncpy(char *dest, char *src, int32_t count) {
         *dest = 0;
 }
 
+void *memcpy(void *dest, const void *src, size_t n) {
+    uint8_t *d = dest;
+    const uint8_t *s = src;
+    /* move whole words when both sides are aligned */
+    if (!(((uint32_t) d | (uint32_t) s) & 3)) {
+        while (n >= 4) {
+            *((uint32_t *) d) = *((const uint32_t *) s);
+            d += 4;
+            s += 4;
+            n -= 4;
+        }
+    }
+    /* remaining bytes */
+    while (n--)
+        *d++ = *s++;
+    return dest;
+}
+
+void *memset(void *dest, int c, size_t n) {
+    uint8_t *d = dest;
+    while (n--)
+        *d++ = (uint8_t) c;
+    return dest;
+}
+
 #if 0
 int strSplit(char *pars, char splitter, int *count_ret, char ***vector_ret) {
 
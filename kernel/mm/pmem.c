@@ -32,6 +32,7 @@
 #include <sys/mm.h>
 #include <arch/page.h>
 #include <sys/bootinfo.h>
+#include <lib/string.h>
 
 #include <i386/asm.h> /* FIXME: arch-dependant stuff! */
 #include <i386/stack.h> /* FIXME: arch-dependant stuff! */
@@ -39,7 +40,9 @@
 uint32_t pmem_usable_pages = 0;
 uint32_t ram_size = 0;
 
-/* 4MB memory map: */
+/* 4MB memory map: a free frame's entry is its node in pfreelist,
+ * an allocated frame's entry is its reference count.
+ */
 uint32_t pmmap[MEMORY_PAGES];
 
 /* Free page list: */
@@ -122,6 +125,57 @@ void pmem_writel(void *p_addr, uint32_t val) {
     pmem_writeb(((uint8_t *)p_addr)+3, (val>>24) & 0xFF);
 }
 
+void pmem_read(void *buf, void *p_addr, uint32_t size) {
+
+    /* copy "size" bytes from physical memory into buf.
+     * the caller must make sure buf is present and writable,
+     * a page fault in the middle would steal the window.
+     */
+    uint32_t eflags = get_eflags();
+    cli();
+
+    while (size) {
+        uint32_t p_page = ((uint32_t) p_addr) & PAGE_BASE_MASK;
+        uint32_t p_off  = ((uint32_t) p_addr) & (PAGE_SIZE-1);
+        uint32_t count  = PAGE_SIZE - p_off;
+        if (count > size)
+            count = size;
+        if (p_page != cur_physical_page)
+            arch_set_page(NULL, physical_page, cur_physical_page=p_page);
+        memcpy(buf, &physical_page[p_off], count);
+        buf = ((uint8_t *) buf) + count;
+        p_addr = ((uint8_t *) p_addr) + count;
+        size -= count;
+    }
+
+    set_eflags(eflags);
+
+}
+
+void pmem_write(void *p_addr, void *buf, uint32_t size) {
+
+    /* copy "size" bytes from buf into physical memory. */
+    uint32_t eflags = get_eflags();
+    cli();
+
+    while (size) {
+        uint32_t p_page = ((uint32_t) p_addr) & PAGE_BASE_MASK;
+        uint32_t p_off  = ((uint32_t) p_addr) & (PAGE_SIZE-1);
+        uint32_t count  = PAGE_SIZE - p_off;
+        if (count > size)
+            count = size;
+        if (p_page != cur_physical_page)
+            arch_set_page(NULL, physical_page, cur_physical_page=p_page);
+        memcpy(&physical_page[p_off], buf, count);
+        buf = ((uint8_t *) buf) + count;
+        p_addr = ((uint8_t *) p_addr) + count;
+        size -= count;
+    }
+
+    set_eflags(eflags);
+
+}
+
 void *ppalloc() {
 
     linknode *entry;
@@ -136,6 +190,9 @@ void *ppalloc() {
     entry = pfreelist.first;
     linkedlist_remove(&pfreelist, pfreelist.first, NULL);
 
+    /* while allocated, the map entry counts the users of the frame */
+    *((uint32_t *) entry) = 1;
+
     set_eflags(eflags);
 
     return (void *)((((uint32_t) entry) - ((uint32_t) &pmmap))*
@@ -144,12 +201,38 @@ void *ppalloc() {
 }
 
 
+void ppref(void *base) {
+
+    /* one more user of a frame (shared or copy-on-write mappings) */
+    uint32_t eflags = get_eflags();
+    cli();
+
+    pmmap[((uint32_t)base)/PAGE_SIZE]++;
+
+    set_eflags(eflags);
+
+}
+
+uint32_t ppcount(void *base) {
+
+    /* how many users share this frame? */
+    return pmmap[((uint32_t)base)/PAGE_SIZE];
+
+}
+
 void ppfree(void *base) {
 
     linknode *entry;
     uint32_t eflags = get_eflags();
     cli();
 
+    /* the frame is still mapped somewhere else? */
+    if (pmmap[((uint32_t)base)/PAGE_SIZE] > 1) {
+        pmmap[((uint32_t)base)/PAGE_SIZE]--;
+        set_eflags(eflags);
+        return;
+    }
+
     entry=(linknode*)((uint32_t)&pmmap[((uint32_t)base)/PAGE_SIZE]);
     linkedlist_add(&pfreelist, entry);
 
@@ -158,6 +241,88 @@ void ppfree(void *base) {
 
 }
 
+void pmem_clear(void *p_addr, uint32_t size) {
+
+    /* fill "size" bytes of physical memory with zeros. */
+    uint32_t eflags = get_eflags();
+    cli();
+
+    while (size) {
+        uint32_t p_page = ((uint32_t) p_addr) & PAGE_BASE_MASK;
+        uint32_t p_off  = ((uint32_t) p_addr) & (PAGE_SIZE-1);
+        uint32_t count  = PAGE_SIZE - p_off;
+        if (count > size)
+            count = size;
+        if (p_page != cur_physical_page)
+            arch_set_page(NULL, physical_page, cur_physical_page=p_page);
+        memset(&physical_page[p_off], 0, count);
+        p_addr = ((uint8_t *) p_addr) + count;
+        size -= count;
+    }
+
+    set_eflags(eflags);
+
+}
+
+uint32_t pmem_free_pages() {
+
+    /* count of free page frames */
+    return pfreelist.count;
+
+}
+
+void pmem_release(int32_t res) {
+
+    /* hand the frames of reserved region "res" back once what the
+     * boot loader put there is not needed anymore. only whole frames
+     * that are RAM and belong to no other reserved region are freed.
+     */
+    uint64_t base = bootinfo->res[res].base;
+    uint64_t end  = bootinfo->res[res].end;
+    uint64_t frame;
+    int32_t i;
+    uint32_t eflags = get_eflags();
+    cli();
+
+    /* the region is gone: */
+    bootinfo->res[res].end = bootinfo->res[res].base;
+
+    base = (base+PAGE_SIZE-1) & PAGE_BASE_MASK; /* to upper. */
+    end  = end & PAGE_BASE_MASK; /* align to lower. */
+
+    for (frame = base/PAGE_SIZE; frame < end/PAGE_SIZE; frame++) {
+
+        if (frame >= MEMORY_PAGES || pmmap[frame] != 0xFFFFFFFF)
+            continue;
+
+        /* still part of another region? */
+        for (i = 0; i < BI_RESCOUNT; i++)
+            if (frame >= bootinfo->res[i].base/PAGE_SIZE &&
+                frame < (bootinfo->res[i].end+PAGE_SIZE-1)/PAGE_SIZE)
+                break;
+        if (i < BI_RESCOUNT)
+            continue;
+
+        /* RAM? */
+        for (i = 0; i < bootinfo->mem_ents; i++)
+            if (frame >= (bootinfo->mem_ent[i].base+PAGE_SIZE-1)/PAGE_SIZE &&
+                frame < bootinfo->mem_ent[i].end/PAGE_SIZE)
+                break;
+        if (i == bootinfo->mem_ents)
+            continue;
+
+        /* a free page frame! */
+        linkedlist_addlast(&pfreelist, (linknode *) &pmmap[frame]);
+        pmem_usable_pages++;
+        if (ram_size < frame+1)
+            ram_size = frame+1;
+
+    }
+
+    set_eflags(eflags);
+
+}
+
 void pmem_init() {
 
     int32_t i;
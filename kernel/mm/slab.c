@@ -0,0 +1,161 @@
+/*
+ *        +----------------------------------------------------------+
+ *        | +------------------------------------------------------+ |
+ *        | |  Quafios Kernel 2.0.1.                               | |
+ *        | |  -> memman: slab allocator.                          | |
+ *        | +------------------------------------------------------+ |
+ *        +----------------------------------------------------------+
+ *
+ * This file is part of Quafios 2.0.1 source code.
+ * Copyright (C) 2015  Mostafa Abd El-Aziz Mohamed.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Quafios.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Visit http://www.quafios.com/ for contact information.
+ *
+ */
+
+
+#include <arch/type.h>
+#include <arch/page.h>
+#include <arch/spinlock.h>
+#include <sys/mm.h>
+#include <sys/slab.h>
+
+/* small objects of one kind (inodes for instance) are packed into
+ * pages instead of each taking a power-of-two block from kmalloc().
+ * pages come from kmalloc(PAGE_SIZE), which returns them page
+ * aligned. a slab that becomes empty is given back, unless it is
+ * the only one with room left.
+ */
+#define SLAB_ALIGN      8
+#define SLAB_ROUND(n)   (((n) + SLAB_ALIGN - 1) & ~(SLAB_ALIGN - 1))
+#define SLAB_FIRST      SLAB_ROUND(sizeof(slab_t))
+
+/***************************************************************************/
+/*                              Helpers                                    */
+/***************************************************************************/
+
+static slab_t *slab_of(void *obj) {
+    /* the page the object lives in */
+    return (slab_t *) ((uint8_t *) obj - ((uint32_t) obj & (PAGE_SIZE-1)));
+}
+
+static void list_add(slab_cache_t *cache, slab_t *slab) {
+    slab->prev = NULL;
+    slab->next = cache->partial;
+    if (cache->partial)
+        cache->partial->prev = slab;
+    cache->partial = slab;
+}
+
+static void list_del(slab_cache_t *cache, slab_t *slab) {
+    if (slab->prev)
+        slab->prev->next = slab->next;
+    else
+        cache->partial = slab->next;
+    if (slab->next)
+        slab->next->prev = slab->prev;
+}
+
+static void carve(slab_cache_t *cache, slab_t *slab) {
+    /* chain all objects of a new slab into its free list */
+    uint8_t *obj = (uint8_t *) slab + SLAB_FIRST;
+    uint32_t i;
+    slab->free = NULL;
+    slab->used = 0;
+    for (i = 0; i < cache->per_slab; i++) {
+        *((void **) obj) = slab->free;
+        slab->free = obj;
+        obj += cache->size;
+    }
+}
+
+/***************************************************************************/
+/*                              Interface                                  */
+/***************************************************************************/
+
+void slab_init(slab_cache_t *cache, uint32_t size) {
+    cache->size     = SLAB_ROUND(size < sizeof(void *) ? sizeof(void *) : size);
+    cache->per_slab = (PAGE_SIZE - SLAB_FIRST)/cache->size;
+    cache->partial  = NULL;
+    cache->slabs    = 0;
+    cache->objs     = 0;
+    spinlock_init(&cache->lock);
+}
+
+void *slab_alloc(slab_cache_t *cache) {
+
+    /* get an object, NULL if there is no memory. */
+    slab_t *slab, *new = NULL;
+    void *obj;
+    int32_t status;
+
+    status = spinlock_acquire_irqsave(&cache->lock);
+    while (!(slab = cache->partial)) {
+        /* all slabs are full, add one */
+        if (new) {
+            cache->slabs++;
+            list_add(cache, slab = new);
+            new = NULL;
+            break;
+        }
+        spinlock_release_irqrestore(&cache->lock, status);
+        if (!(new = kmalloc(PAGE_SIZE)))
+            return NULL;
+        carve(cache, new);
+        /* someone might have freed an object meanwhile, look again */
+        status = spinlock_acquire_irqsave(&cache->lock);
+    }
+
+    /* take the first free object */
+    obj = slab->free;
+    slab->free = *((void **) obj);
+    slab->used++;
+    cache->objs++;
+    if (!slab->free)
+        list_del(cache, slab);
+    spinlock_release_irqrestore(&cache->lock, status);
+
+    if (new)
+        kfree(new);
+    return obj;
+
+}
+
+void slab_free(slab_cache_t *cache, void *obj) {
+
+    /* give an object back */
+    slab_t *slab = slab_of(obj), *dead = NULL;
+    int32_t status;
+
+    status = spinlock_acquire_irqsave(&cache->lock);
+    if (!slab->free)
+        list_add(cache, slab); /* it was full. */
+    *((void **) obj) = slab->free;
+    slab->free = obj;
+    slab->used--;
+    cache->objs--;
+    if (!slab->used && (slab->prev || slab->next)) {
+        /* empty, and there is room elsewhere */
+        list_del(cache, slab);
+        cache->slabs--;
+        dead = slab;
+    }
+    spinlock_release_irqrestore(&cache->lock, status);
+
+    if (dead)
+        kfree(dead);
+
+}
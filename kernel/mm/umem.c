@@ -138,6 +138,8 @@ uint32_t mmap(uint32_t base, uint32_t size, uint32_t type,
     if (type & MMAP_TYPE_FILE) {
         if (fd < 0 || fd >= FD_MAX || curproc->file[fd] == NULL)
             return 0;
+        if ((curproc->file[fd]->inode->mode & FT_MASK) == FT_FIFO)
+            return 0; /* pipes can't be mapped */
     }
 
     if (!base) {
@@ -200,6 +202,8 @@ uint32_t mmap(uint32_t base, uint32_t size, uint32_t type,
                     region->pos = off;
                     region->paddr = 0;
                     region->ref = 1;
+                    region->shared = 1;
+                    region->direct = 0;
 
                     /* add to the inode */
                     linkedlist_add(&(inode->sma), region);
@@ -214,6 +218,8 @@ uint32_t mmap(uint32_t base, uint32_t size, uint32_t type,
                 region->pos = off;
                 region->paddr = 0;
                 region->ref = 1;
+                region->shared = 0;
+                region->direct = 0;
             }
             /* attach the virtual page to the mapping */
             arch_vmpage_attach_file(umem, (int32_t) addr, region);
@@ -250,6 +256,54 @@ int32_t munmap(uint32_t base, uint32_t size) {
     return ESUCCESS;
 }
 
+int32_t msync(uint32_t base, uint32_t size, uint32_t flags) {
+
+    /* write the dirty pages of shared file mappings in the given
+     * range back to their files. with MS_SYNC, the files are also
+     * written to the disk before returning.
+     */
+    uint32_t addr, pages;
+    int32_t err, ret = ESUCCESS;
+    file_t *file;
+    inode_t *last = NULL;
+    umem_t *umem = &(curproc->umem); /* current process umem image. */
+
+    /* validate arguments */
+    if ((flags & ~(MS_ASYNC | MS_SYNC)) || flags == (MS_ASYNC | MS_SYNC))
+        return -EINVAL;
+    if (base & (~PAGE_BASE_MASK))
+        return -EINVAL;
+    pages = (size+PAGE_SIZE-1)/PAGE_SIZE;
+    size = pages*PAGE_SIZE;
+    if (base < USER_MEMORY_BASE || base + size < base ||
+        base + size > KERNEL_MEMORY_BASE)
+        return -ENOMEM;
+
+    /* write back page by page */
+    for (addr = base; addr < base + size; addr+=PAGE_SIZE) {
+        if (!arch_vmpage_isMapped(umem, addr))
+            return -ENOMEM;
+        if ((err = arch_vmpage_sync(umem, addr, &file)))
+            ret = err;
+        if (!file || file->inode == last)
+            continue;
+        /* a new file, the previous one is complete */
+        if ((flags & MS_SYNC) && last && last->sb->fsdriver->sync &&
+            (err = last->sb->fsdriver->sync(last->sb, last)))
+            ret = err;
+        last = file->inode;
+    }
+
+    /* the last file */
+    if ((flags & MS_SYNC) && last && last->sb->fsdriver->sync &&
+        (err = last->sb->fsdriver->sync(last->sb, last)))
+        ret = err;
+
+    /* done */
+    return -ret;
+
+}
+
 uint32_t brk(uint32_t addr) {
 
     /* change the value of break address. this increases
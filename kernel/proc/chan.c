@@ -0,0 +1,439 @@
+/*
+ *        +----------------------------------------------------------+
+ *        | +------------------------------------------------------+ |
+ *        | |  Quafios Kernel 2.0.1.                               | |
+ *        | |  -> procman: shared memory channels.                 | |
+ *        | +------------------------------------------------------+ |
+ *        +----------------------------------------------------------+
+ *
+ * This file is part of Quafios 2.0.1 source code.
+ * Copyright (C) 2015  Mostafa Abd El-Aziz Mohamed.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Quafios.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Visit http://www.quafios.com/ for contact information.
+ *
+ */
+
+#include <arch/type.h>
+#include <arch/page.h>
+#include <lib/string.h>
+#include <sys/error.h>
+#include <sys/proc.h>
+#include <sys/mm.h>
+#include <sys/chan.h>
+#include <sys/scheduler.h>
+
+/* the ring header lives in pages that every mapper can write, so the
+ * kernel keeps its own copy of the geometry and, as the producer, of
+ * the head. only the tail and the sleeping flag are read back from the
+ * ring, and they are never trusted as more than numbers.
+ */
+typedef struct chan {
+    struct chan *next;
+    int32_t id;
+    int32_t owner;       /* pid of the creator, -1 for the kernel.  */
+    int32_t granted;     /* pid of the peer allowed to map, or -1.  */
+    proc_t *consumer;    /* the process that waits on the ring.     */
+    chan_ring_t *ring;   /* kernel view of the ring.                */
+    uint32_t pages;      /* size of the ring in pages.              */
+    uint32_t frame[CHAN_MAX_PAGES]; /* frames of the ring.          */
+    uint32_t slot_size;  /* size of a slot in bytes.                */
+    uint32_t slots;      /* count of slots, a power of 2.           */
+    uint32_t head;       /* next slot the kernel fills.             */
+    uint32_t dropped;    /* statistics: pushes lost, ring was full. */
+    uint32_t pushed;     /* statistics: slots filled by the kernel. */
+    uint32_t wakeups;    /* statistics: doorbells that woke the consumer. */
+} chan_t;
+
+static _linkedlist(chan_t) chans;
+static int32_t last_id = 0;
+
+static chan_t *chan_get(int32_t id) {
+    /* must be called with interrupts disabled */
+    chan_t *chan = chans.first;
+    while (chan && chan->id != id)
+        chan = chan->next;
+    return chan;
+}
+
+static void doorbell(chan_t *chan) {
+    /* wake the consumer up if it went to sleep on the ring.
+     * must be called with interrupts disabled.
+     */
+    if (chan->ring->sleeping && chan->consumer) {
+        chan->ring->sleeping = 0;
+        chan->consumer->blocked_for_msg = 0;
+        chan->wakeups++;
+        unblock(chan->consumer->pid);
+    }
+}
+
+int32_t chan_alloc(uint32_t slot_size, uint32_t slots, int32_t owner) {
+
+    chan_t *chan;
+    uint32_t size, i;
+    int32_t status;
+
+    /* slots must be a power of 2 */
+    if (!slot_size || !slots || (slots & (slots-1)))
+        return -EINVAL;
+
+    /* the ring is allocated in whole pages */
+    size = sizeof(chan_ring_t) + slot_size*slots;
+    if (slot_size > CHAN_MAX_PAGES*PAGE_SIZE ||
+        slots > CHAN_MAX_PAGES*PAGE_SIZE || size > CHAN_MAX_PAGES*PAGE_SIZE)
+        return -EINVAL;
+    size = (size+PAGE_SIZE-1) & PAGE_BASE_MASK;
+
+    /* allocate the channel, and kernel address space for the ring */
+    if (!(chan = kmalloc(sizeof(chan_t))))
+        return -ENOMEM;
+    if (!(chan->ring = kmalloc(size))) {
+        kfree(chan);
+        return -ENOMEM;
+    }
+    chan->pages = size/PAGE_SIZE;
+
+    /* the ring lives in frames of its own rather than heap memory:
+     * every mapping holds a reference, and the frames only go back to
+     * the pool with the last one. they are present from now on, so
+     * the kernel never faults on the ring in an IRQ handler.
+     */
+    for (i = 0; i < chan->pages; i++) {
+        arch_vmpage_unmap(NULL, ((uint32_t) chan->ring) + i*PAGE_SIZE);
+        arch_vmpage_map(NULL, ((uint32_t) chan->ring) + i*PAGE_SIZE, 0);
+        chan->frame[i] = (uint32_t) ppalloc();
+        arch_set_page(NULL, ((uint32_t) chan->ring) + i*PAGE_SIZE,
+                      chan->frame[i]);
+    }
+    memset(chan->ring, 0, size);
+    chan->ring->slot_size = slot_size;
+    chan->ring->slots     = slots;
+
+    /* initialize the channel */
+    chan->owner     = owner;
+    chan->granted   = -1;
+    chan->consumer  = NULL;
+    chan->slot_size = slot_size;
+    chan->slots     = slots;
+    chan->head      = 0;
+    chan->dropped   = 0;
+    chan->pushed    = 0;
+    chan->wakeups   = 0;
+
+    /* add it to the list */
+    status = arch_get_int_status();
+    arch_disable_interrupts();
+    chan->id = ++last_id;
+    linkedlist_addlast(&chans, chan);
+    arch_set_int_status(status);
+
+    /* done */
+    return chan->id;
+
+}
+
+int32_t chan_push(int32_t id, void *data) {
+
+    /* kernel-side producer, may be called by IRQ handlers. the slot
+     * is found from the kernel's own head and geometry; a tail the
+     * consumer has messed up only makes the ring look full.
+     */
+    chan_t *chan;
+    chan_ring_t *ring;
+    uint8_t *slot;
+    int32_t status, err = ESUCCESS;
+
+    /* enter critical region */
+    status = arch_get_int_status();
+    arch_disable_interrupts();
+
+    if (!(chan = chan_get(id))) {
+        err = ENOENT;
+    } else if (chan->head - (ring = chan->ring)->tail >= chan->slots) {
+        ring->dropped = ++chan->dropped;
+        err = ENOSPC;
+    } else {
+        slot = ((uint8_t *) (ring+1)) +
+               (chan->head & (chan->slots-1))*chan->slot_size;
+        memcpy(slot, data, chan->slot_size);
+        ring->head = ++chan->head;
+        chan->pushed++;
+        doorbell(chan);
+    }
+
+    /* exit critical region */
+    arch_set_int_status(status);
+
+    return -err;
+
+}
+
+int32_t chan_allow(int32_t id, int32_t owner, int32_t pid) {
+
+    /* let process "pid" map the channel, in place of whoever was
+     * allowed to before. only the owner can do so, drivers for the
+     * channels of the kernel.
+     */
+    chan_t *chan;
+    int32_t status, err = ESUCCESS;
+
+    status = arch_get_int_status();
+    arch_disable_interrupts();
+    if (!(chan = chan_get(id)))
+        err = ENOENT;
+    else if (chan->owner != owner)
+        err = EINVAL;
+    else
+        chan->granted = pid;
+    arch_set_int_status(status);
+
+    return -err;
+
+}
+
+static void chan_free(chan_t *chan) {
+
+    /* must be called with interrupts disabled. the kernel drops its
+     * own references to the frames and hands fresh (not yet backed)
+     * pages back to the heap; processes that still map the ring keep
+     * the frames alive until they unmap them.
+     */
+    uint32_t i;
+    linkedlist_aremove(&chans, chan);
+    /* let a sleeping consumer find out that the channel is gone */
+    doorbell(chan);
+    for (i = 0; i < chan->pages; i++) {
+        arch_vmpage_unmap(NULL, ((uint32_t) chan->ring) + i*PAGE_SIZE);
+        arch_vmpage_map(NULL, ((uint32_t) chan->ring) + i*PAGE_SIZE, 0);
+    }
+    kfree(chan->ring);
+    kfree(chan);
+
+}
+
+/* ================================================================= */
+/*                           System Calls                            */
+/* ================================================================= */
+
+int32_t chan_create(uint32_t slot_size, uint32_t slots) {
+    return chan_alloc(slot_size, slots, curproc->pid);
+}
+
+int32_t chan_map(int32_t id, int32_t role, void **addr) {
+
+    /* only the owner and the process it granted the channel to may
+     * map it. the kernel is the only producer of its own channels.
+     */
+    chan_t *chan;
+    uint32_t base, i, pages;
+    int32_t status, err = ESUCCESS;
+
+    /* reserve virtual memory for the ring */
+    status = arch_get_int_status();
+    arch_disable_interrupts();
+    chan = chan_get(id);
+    arch_set_int_status(status);
+    if (!chan)
+        return -ENOENT;
+    pages = chan->pages;
+    if (!(base = mmap(0, pages*PAGE_SIZE, MMAP_TYPE_ANONYMOUS,
+                      MMAP_FLAGS_READ | MMAP_FLAGS_WRITE | MMAP_FLAGS_SHARED,
+                      0, (uint64_t) 0)))
+        return -ENOMEM;
+
+    /* enter critical region */
+    status = arch_get_int_status();
+    arch_disable_interrupts();
+
+    if (chan != chan_get(id)) {
+        /* closed meanwhile */
+        err = ENOENT;
+    } else if (chan->owner != curproc->pid &&
+               chan->granted != curproc->pid) {
+        /* not ours, and not granted to us */
+        err = EINVAL;
+    } else if (role == CHAN_CONSUMER && chan->consumer) {
+        /* only one consumer is allowed */
+        err = EBUSY;
+    } else if ((role != CHAN_CONSUMER && role != CHAN_PRODUCER) ||
+               (role == CHAN_PRODUCER && chan->owner < 0)) {
+        err = EINVAL;
+    } else {
+        /* share the frames of the ring with the caller */
+        for (i = 0; i < pages; i++)
+            ppref((void *) chan->frame[i]);
+        if (arch_vmpage_attach(NULL, base, pages, chan->frame, 0)) {
+            for (i = 0; i < pages; i++)
+                ppfree((void *) chan->frame[i]);
+            err = ENOMEM;
+        } else if (role == CHAN_CONSUMER) {
+            chan->consumer = curproc;
+        }
+    }
+
+    /* exit critical region */
+    arch_set_int_status(status);
+
+    /* failed? */
+    if (err) {
+        munmap(base, pages*PAGE_SIZE);
+        return -err;
+    }
+
+    /* done */
+    *addr = (void *) base;
+    return ESUCCESS;
+
+}
+
+int32_t chan_wait(int32_t id) {
+
+    /* block until the ring has something or a message arrives */
+    chan_t *chan;
+    int32_t status, err = ESUCCESS;
+
+    /* enter critical region */
+    status = arch_get_int_status();
+    arch_disable_interrupts();
+
+    while (1) {
+        if (!(chan = chan_get(id))) {
+            err = ENOENT;
+            break;
+        }
+        if (chan->consumer != curproc) {
+            err = EINVAL;
+            break;
+        }
+        if ((chan->owner < 0 ? chan->head : chan->ring->head) !=
+            chan->ring->tail || curproc->inbox.count)
+            break;
+        /* sleep; either the doorbell or a new message wakes us up */
+        chan->ring->sleeping = 1;
+        curproc->blocked_for_msg = 1;
+        handoff(NULL, 1);
+    }
+
+    /* no longer sleeping */
+    if (chan)
+        chan->ring->sleeping = 0;
+    curproc->blocked_for_msg = 0;
+
+    /* exit critical region */
+    arch_set_int_status(status);
+
+    return -err;
+
+}
+
+int32_t chan_notify(int32_t id) {
+
+    /* doorbell, rung by a user-space producer */
+    chan_t *chan;
+    int32_t status;
+
+    status = arch_get_int_status();
+    arch_disable_interrupts();
+    if (chan = chan_get(id))
+        doorbell(chan);
+    arch_set_int_status(status);
+
+    return chan ? ESUCCESS : -ENOENT;
+
+}
+
+int32_t chan_grant(int32_t id, int32_t pid) {
+    return chan_allow(id, curproc->pid, pid);
+}
+
+int32_t chan_close(int32_t id) {
+
+    chan_t *chan;
+    int32_t status, err = ESUCCESS;
+
+    status = arch_get_int_status();
+    arch_disable_interrupts();
+    if (!(chan = chan_get(id)))
+        err = ENOENT;
+    else if (chan->owner != curproc->pid)
+        err = EINVAL;
+    else
+        chan_free(chan);
+    arch_set_int_status(status);
+
+    return -err;
+
+}
+
+/* ================================================================= */
+/*                            Bookkeeping                            */
+/* ================================================================= */
+
+void chan_exit(proc_t *proc) {
+
+    /* release the channels of a terminating process */
+    chan_t *chan, *next;
+    int32_t status;
+
+    status = arch_get_int_status();
+    arch_disable_interrupts();
+    for (chan = chans.first; chan; chan = next) {
+        next = chan->next;
+        if (chan->consumer == proc)
+            chan->consumer = NULL;
+        if (chan->owner == proc->pid)
+            chan_free(chan);
+    }
+    arch_set_int_status(status);
+
+}
+
+char *chan_stats(int32_t *size) {
+
+    chan_t *chan;
+    char *buf = kmalloc(4096);
+    *size = 0;
+    *size += sputs(&buf[*size], "id owner slots size pushed dropped wakeups\n");
+    for (chan = chans.first; chan && *size < 4000; chan = chan->next) {
+        *size += sputd(&buf[*size], chan->id);
+        *size += sputs(&buf[*size], " ");
+        *size += sputd(&buf[*size], chan->owner);
+        *size += sputs(&buf[*size], " ");
+        *size += sputd(&buf[*size], chan->slots);
+        *size += sputs(&buf[*size], " ");
+        *size += sputd(&buf[*size], chan->slot_size);
+        *size += sputs(&buf[*size], " ");
+        *size += sputd(&buf[*size], chan->pushed);
+        *size += sputs(&buf[*size], " ");
+        *size += sputd(&buf[*size], chan->dropped);
+        *size += sputs(&buf[*size], " ");
+        *size += sputd(&buf[*size], chan->wakeups);
+        *size += sputs(&buf[*size], "\n");
+    }
+    buf[*size] = 0;
+    return buf;
+
+}
+
+void chan_init() {
+
+    /* initialize channel list */
+    linkedlist_init((linkedlist *) &chans);
+
+    /* register in sysfs */
+    sysfs_reg("chan", chan_stats);
+
+}
@@ -45,6 +45,7 @@ void exit(int32_t status) {
         printk("%a", 0x0C);
         printk("init process just terminated!\n");
         printk("rebooting...\n");
+        sync_all();
         legacy_reboot();
     }
 
@@ -58,6 +59,12 @@ void exit(int32_t status) {
     /* close cwd */
     file_close(curproc->cwd);
 
+    /* drop undelivered messages, fail pending calls */
+    ipc_exit(curproc);
+
+    /* release owned channels, stop consuming the others */
+    chan_exit(curproc);
+
     /* TODO: make all children be owned by init. */
 
     /* unblock the parent if waiting */
@@ -108,11 +108,14 @@ int32_t fork() {
 
     /* inform the scheduler that this is a just-forked process: */
     newproc->after_fork = 1;
+    newproc->kmain = NULL;
 
     /* initialize inbox */
-    newproc->inbox_lock = 0;
+    spinlock_init(&newproc->inbox_lock);
     newproc->blocked_for_msg = 0;
     linkedlist_init(&(newproc->inbox));
+    newproc->blocked_for_reply = 0;
+    newproc->reply = NULL;
 
     /* children */
     newproc->blocked_for_child = 0;
@@ -134,3 +137,86 @@ int32_t fork() {
     /* return to the parent. */
     return newproc->pid;
 }
+
+/***************************************************************************/
+/*                                kthread()                                */
+/***************************************************************************/
+
+int32_t kthread(void (*func)()) {
+    /* start a kernel task that runs func() in kernel mode, on its
+     * own stack. it has no user memory and no open files besides the
+     * working directory of the caller, and func() must never return.
+     */
+    int32_t i;
+    proc_t *newproc;
+
+    /* create a new process structure: */
+    newproc = kmalloc(sizeof(proc_t));
+    if (newproc == NULL)
+        return -1;
+
+    /* no parent waits for it: */
+    newproc->parent = NULL;
+
+    /* initialize descriptors: */
+    newproc->plist.proc = newproc;
+    newproc->sched.proc = newproc;
+    newproc->irqd.proc  = newproc;
+    newproc->semad.proc = newproc;
+
+    /* empty user memory, just the kernel mappings: */
+    if (umem_init(&(newproc->umem))) {
+        kfree(newproc);
+        return -1;
+    }
+
+    /* kernel stack: */
+    newproc->kstack = (unsigned char *) kmalloc(KERNEL_STACK_SIZE);
+    if (newproc->kstack == NULL) {
+        umem_free(&(newproc->umem));
+        kfree(newproc);
+        return -1;
+    }
+    for (i = 0; i < KERNEL_STACK_SIZE; i++)
+        newproc->kstack[i] = 0;
+
+    /* no files: */
+    for (i = 0; i < FD_MAX; i++)
+        newproc->file[i] = NULL;
+    curproc->cwd->fcount++;
+    newproc->cwd = curproc->cwd;
+
+    /* set pid: */
+    newproc->pid = ++last_pid;
+
+    /* the scheduler calls func() the first time it runs: */
+    newproc->after_fork = 1;
+    newproc->kmain = func;
+
+    /* initialize inbox */
+    spinlock_init(&newproc->inbox_lock);
+    newproc->blocked_for_msg = 0;
+    linkedlist_init(&(newproc->inbox));
+    newproc->blocked_for_reply = 0;
+    newproc->reply = NULL;
+
+    /* children */
+    newproc->blocked_for_child = 0;
+
+    /* not blocked */
+    newproc->blocked = 0;
+    newproc->lock_to_unlock = NULL;
+
+    /* exit status: */
+    newproc->terminated = 0;
+    newproc->status = 0;
+
+    /* add the new process to the list of processes: */
+    linkedlist_addlast((linkedlist*)&proclist, (linknode*)&(newproc->plist));
+
+    /* add to scheduler's queue: */
+    linkedlist_addlast((linkedlist*)&q_ready, (linknode*)&(newproc->sched));
+
+    /* done */
+    return newproc->pid;
+}
@@ -39,7 +39,8 @@ void proc_init() {
     /* Process Manager Initialization */
     int32_t i, err = 0;
     char *initpath = "/bin/init";
-    int32_t bootdisk;
+    int32_t bootdisk, bootcd;
+    char *bootfs;
 
     /* (I) Initialize linked lists:  */
     /* ----------------------------- */
@@ -47,6 +48,14 @@ void proc_init() {
     linkedlist_init((linkedlist *) &q_ready);
     linkedlist_init((linkedlist *) &q_blocked);
 
+    /* initialize channels */
+    chan_init();
+
+#ifdef CONFIG_LOCKPROF
+    /* initialize lock profiler */
+    lockprof_init();
+#endif
+
     /* (II) Create "init" process:  */
     /* ---------------------------- */
     /* Allocate memory for process structures: */
@@ -83,11 +92,14 @@ void proc_init() {
 
     /* not forked: */
     initproc->after_fork = 0;
+    initproc->kmain = NULL;
 
     /* initialize inbox */
-    initproc->inbox_lock = 0;
+    spinlock_init(&initproc->inbox_lock);
     initproc->blocked_for_msg = 0;
     linkedlist_init(&(initproc->inbox));
+    initproc->blocked_for_reply = 0;
+    initproc->reply = NULL;
 
     /* children */
     initproc->blocked_for_child = 0;
@@ -121,8 +133,13 @@ void proc_init() {
 
     /* (VI) Mount boot disk:  */
     /* ---------------------- */
-    /* detect bootdisk */
-    bootdisk = detect_bootdisk();
+    /* detect bootdisk, a live CD is preferred to its ramdisk */
+    if ((bootdisk = bootcd = detect_bootcd()) >= 0) {
+        bootfs = "iso9660";
+    } else {
+        bootdisk = detect_bootdisk();
+        bootfs = "diskfs";
+    }
     if (bootdisk < 0) {
         printk("%aError: Couldn't detect boot medium.\n", 0x0C);
         printk("Kernel halt.%a", 0x0F);
@@ -132,12 +149,19 @@ void proc_init() {
     /* create a device file for bootdisk */
     mknod("/bootdisk", FT_SPECIAL, bootdisk);
 
-    /* mount as diskfs filesystem */
-    mount("/bootdisk", "/", "diskfs", 0, NULL);
+    /* mount the root filesystem */
+    err = mount("/bootdisk", "/", bootfs, 0, NULL);
+
+    /* the ramdisk of a live CD is not needed anymore */
+    if (!err && bootdisk == bootcd)
+        release_ramdisk();
 
     /* chdir to the new root */
     chdir("/");
 
+    /* start writing back file system changes */
+    sync_init();
+
     /* (VII) Execute "init" program to initialize the operating system:  */
     /* ---------------------------------------------------------------- */
     /*synctest();*/
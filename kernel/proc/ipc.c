@@ -27,57 +27,230 @@
  */
 
 #include <arch/type.h>
+#include <arch/page.h>
+#include <lib/string.h>
 #include <sys/error.h>
 #include <sys/proc.h>
 #include <sys/mm.h>
 #include <sys/ipc.h>
 #include <sys/scheduler.h>
 
-int32_t send(int32_t pid, msg_t *msg) {
+/* page-aligned user messages of at least MSG_REMAP_MIN bytes have their
+ * whole pages shared copy-on-write with the receiver instead of copied.
+ */
+#define MSG_REMAP_MIN   (4*PAGE_SIZE)
 
-    msg_t *kmsg;
-    proc_t *recp;
-    int i;
+/* free message slots are recycled instead of going back to kfree() */
+#define MSG_SLOT_CACHE  64
 
-    /* find the proc structure of the receiver */
-    if (!(recp = (proc_t *) get_proc(pid)))
-        return -EINVAL;
+static kmsg_t *free_slots = NULL;
+static int32_t free_slots_count = 0;
 
-    /* allocate kernel structure for the message */
-    kmsg = kmalloc(sizeof(msg_t));
+static kmsg_t *slot_alloc() {
+    kmsg_t *kmsg;
+    int32_t status;
+    /* enter critical region (send() is also called by IRQ handlers) */
+    status = arch_get_int_status();
+    arch_disable_interrupts();
+    /* reuse a cached slot if possible */
+    if (kmsg = free_slots) {
+        free_slots = kmsg->next;
+        free_slots_count--;
+    }
+    /* exit critical region */
+    arch_set_int_status(status);
     if (!kmsg)
-        return -ENOMEM;
+        kmsg = kmalloc(sizeof(kmsg_t));
+    return kmsg;
+}
 
-    /* allocate kernel buffer */
-    kmsg->buf = kmalloc(msg->size);
-    if (!(kmsg->buf)) {
+static void slot_free(kmsg_t *kmsg) {
+    int32_t status;
+    /* release the buffers attached to the slot */
+    if (kmsg->buf && kmsg->buf != kmsg->data)
+        kfree(kmsg->buf);
+    if (kmsg->frame)
+        kfree(kmsg->frame);
+    /* cache the slot */
+    status = arch_get_int_status();
+    arch_disable_interrupts();
+    if (free_slots_count < MSG_SLOT_CACHE) {
+        kmsg->next = free_slots;
+        free_slots = kmsg;
+        free_slots_count++;
+        kmsg = NULL;
+    }
+    arch_set_int_status(status);
+    if (kmsg)
         kfree(kmsg);
-        return -ENOMEM;
+}
+
+static int32_t can_remap(void *buf, uint32_t size) {
+    /* only whole pages of user memory can be shared */
+    uint32_t base = (uint32_t) buf;
+    return !(base & ~PAGE_BASE_MASK) && size >= MSG_REMAP_MIN &&
+           base >= USER_MEMORY_BASE && base + size <= KERNEL_MEMORY_BASE &&
+           base + size > base;
+}
+
+static void touch_pages(void *buf, uint32_t size, int32_t write) {
+    /* fault in (and break copy-on-write of) every page in the range */
+    volatile uint8_t *ptr = buf;
+    uint32_t off = 0;
+    while (off < size) {
+        uint8_t val = ptr[off];
+        if (write)
+            ptr[off] = val;
+        off = (off + PAGE_SIZE) & PAGE_BASE_MASK;
+    }
+}
+
+static kmsg_t *msg_pack(msg_t *msg, int32_t *err) {
+
+    kmsg_t *kmsg;
+    uint32_t rest;
+
+    /* allocate kernel structure for the message */
+    kmsg = slot_alloc();
+    if (!kmsg) {
+        *err = ENOMEM;
+        return NULL;
     }
 
     /* initialize message structure */
     kmsg->sender = curproc->pid;
     kmsg->size   = msg->size;
+    kmsg->pages  = 0;
+    kmsg->frame  = NULL;
+    kmsg->buf    = NULL;
+
+    /* big page-aligned message? share its pages */
+    if (can_remap(msg->buf, msg->size)) {
+        uint32_t pages = msg->size/PAGE_SIZE;
+        kmsg->frame = kmalloc(pages*sizeof(uint32_t));
+        if (kmsg->frame) {
+            touch_pages(msg->buf, pages*PAGE_SIZE, 0);
+            if (!arch_vmpage_share(NULL, (uint32_t) msg->buf,
+                                   pages, kmsg->frame)) {
+                kmsg->pages = pages;
+            } else {
+                kfree(kmsg->frame);
+                kmsg->frame = NULL;
+            }
+        }
+    }
+
+    /* copy whatever is not carried by shared frames */
+    rest = msg->size - kmsg->pages*PAGE_SIZE;
+    if (rest <= MSG_INLINE_SIZE) {
+        kmsg->buf = kmsg->data;
+    } else if (!(kmsg->buf = kmalloc(rest))) {
+        while (kmsg->pages)
+            ppfree((void *) kmsg->frame[--kmsg->pages]);
+        slot_free(kmsg);
+        *err = ENOMEM;
+        return NULL;
+    }
+    memcpy(kmsg->buf, ((uint8_t *) msg->buf) + kmsg->pages*PAGE_SIZE, rest);
+
+    /* done */
+    return kmsg;
 
-    /* copy message */
-    for (i = 0; i < msg->size; i++)
-        ((uint8_t *) kmsg->buf)[i] = ((uint8_t *) msg->buf)[i];
+}
+
+static void msg_drop(kmsg_t *kmsg);
+
+static int32_t msg_unpack(kmsg_t *kmsg, msg_t *msg) {
+
+    uint32_t i, shared;
+
+    /* the message must fit in the buffer, and shared frames are
+     * only handed to user space. messages that don't fit are lost.
+     */
+    msg->size   = kmsg->size;
+    msg->sender = kmsg->sender;
+    if (kmsg->size > msg->cap || (kmsg->pages &&
+        (uint32_t) msg->buf >= KERNEL_MEMORY_BASE)) {
+        msg_drop(kmsg);
+        return EMSGSIZE;
+    }
+
+    /* copy the message to its receiver */
+    shared = kmsg->pages*PAGE_SIZE;
+
+    /* hand the shared frames over, or copy them if the buffer
+     * can't take them.
+     */
+    if (kmsg->pages && (!can_remap(msg->buf, shared) ||
+        arch_vmpage_attach(NULL, (uint32_t) msg->buf,
+                           kmsg->pages, kmsg->frame, 1))) {
+        touch_pages(msg->buf, shared, 1);
+        for (i = 0; i < kmsg->pages; i++) {
+            pmem_read(((uint8_t *) msg->buf) + i*PAGE_SIZE,
+                      (void *) kmsg->frame[i], PAGE_SIZE);
+            ppfree((void *) kmsg->frame[i]);
+        }
+    }
+    memcpy(((uint8_t *) msg->buf) + shared, kmsg->buf, kmsg->size - shared);
+
+    /* deallocate kernel structures */
+    slot_free(kmsg);
+
+    /* done */
+    return ESUCCESS;
+
+}
+
+static void msg_drop(kmsg_t *kmsg) {
+
+    /* release a message without delivering it */
+    while (kmsg->pages)
+        ppfree((void *) kmsg->frame[--kmsg->pages]);
+    slot_free(kmsg);
+
+}
+
+static int32_t inbox_put(proc_t *recp, kmsg_t *kmsg) {
+
+    /* queue a message, returns nonzero if the receiver was
+     * blocked waiting for it (the caller is to wake it up).
+     */
+    int32_t waiting, status;
 
     /* lock receiver's inbox */
-    while (recp->inbox_lock);
-    recp->inbox_lock = 1;
+    status = spinlock_acquire_irqsave(&recp->inbox_lock);
 
     /* add the message to the inbox of the receiver */
     linkedlist_addlast(&(recp->inbox), kmsg);
 
-    /* unblock */
-    if (recp->blocked_for_msg) {
+    /* receiver is waiting? */
+    if (waiting = recp->blocked_for_msg)
         recp->blocked_for_msg = 0;
-        unblock(recp->pid);
-    }
 
     /* unlock the inbox */
-    recp->inbox_lock = 0;
+    spinlock_release_irqrestore(&recp->inbox_lock, status);
+
+    return waiting;
+
+}
+
+int32_t send(int32_t pid, msg_t *msg) {
+
+    kmsg_t *kmsg;
+    proc_t *recp;
+    int32_t err;
+
+    /* find the proc structure of the receiver */
+    if (!(recp = (proc_t *) get_proc(pid)))
+        return -EINVAL;
+
+    /* make a kernel copy of the message */
+    if (!(kmsg = msg_pack(msg, &err)))
+        return -err;
+
+    /* deliver and unblock */
+    if (inbox_put(recp, kmsg))
+        unblock(recp->pid);
 
     /* success */
     return ESUCCESS;
@@ -86,8 +259,8 @@ int32_t send(int32_t pid, msg_t *msg) {
 
 int32_t receive(msg_t *msg, int wait) {
 
-    msg_t *kmsg;
-    int32_t i;
+    kmsg_t *kmsg;
+    int32_t status;
 
     /* inbox is empty? */
     if (!(curproc->inbox.count)) {
@@ -99,9 +272,8 @@ int32_t receive(msg_t *msg, int wait) {
         }
     }
 
-    /* unlock the inbox */
-    while (curproc->inbox_lock);
-    curproc->inbox_lock = 1;
+    /* lock the inbox */
+    status = spinlock_acquire_irqsave(&curproc->inbox_lock);
 
     /* fetch the oldest message */
     kmsg = curproc->inbox.first;
@@ -110,19 +282,128 @@ int32_t receive(msg_t *msg, int wait) {
     linkedlist_aremove(&(curproc->inbox), kmsg);
 
     /* unlock inbox */
-    curproc->inbox_lock = 0;
+    spinlock_release_irqrestore(&curproc->inbox_lock, status);
 
-    /* copy the message to user space */
-    msg->size   = kmsg->size;
-    msg->sender = kmsg->sender;
-    for (i = 0; i < kmsg->size; i++)
-        ((uint8_t *) msg->buf)[i] = ((uint8_t *) kmsg->buf)[i];
+    /* copy the message to the receiver */
+    return -msg_unpack(kmsg, msg);
 
-    /* deallocate kernel structures */
-    kfree(kmsg->buf);
-    kfree(kmsg);
+}
 
-    /* done */
-    return ESUCCESS;
+int32_t call(int32_t pid, msg_t *msg, msg_t *reply) {
+
+    /* send a request and sleep until the receiver replies to it.
+     * if the receiver is waiting for messages, the CPU is handed
+     * over to it directly, and it hands it back on reply_wait().
+     */
+    kmsg_t *kmsg;
+    proc_t *recp;
+    int32_t err, status, waiting;
+
+    /* find the proc structure of the receiver */
+    if (!(recp = (proc_t *) get_proc(pid)) || recp == curproc)
+        return -EINVAL;
+
+    /* make a kernel copy of the message */
+    if (!(kmsg = msg_pack(msg, &err)))
+        return -err;
+
+    /* deliver and switch to the receiver */
+    status = arch_get_int_status();
+    arch_disable_interrupts();
+    curproc->reply = NULL;
+    curproc->blocked_for_reply = pid;
+    waiting = inbox_put(recp, kmsg);
+    while (curproc->blocked_for_reply) {
+        handoff(waiting ? recp : NULL, 1);
+        waiting = 0;
+    }
+    arch_set_int_status(status);
+
+    /* the receiver terminated without replying? */
+    if (!curproc->reply)
+        return -ENOENT;
+
+    /* copy the reply */
+    kmsg = curproc->reply;
+    curproc->reply = NULL;
+    return -msg_unpack(kmsg, reply);
+
+}
+
+int32_t reply_wait(int32_t pid, msg_t *reply, msg_t *msg) {
+
+    /* reply to a process blocked in call(), then wait for the next
+     * message (unless msg is NULL). while waiting, the CPU goes
+     * directly to the caller.
+     */
+    kmsg_t *kmsg;
+    proc_t *caller = NULL;
+    int32_t err, status;
+
+    /* deliver the reply */
+    if (pid) {
+        /* the caller must be waiting for us */
+        caller = (proc_t *) get_proc(pid);
+        if (!caller || caller->blocked_for_reply != curproc->pid)
+            return -EINVAL;
+
+        /* make a kernel copy of the reply */
+        if (!(kmsg = msg_pack(reply, &err)))
+            return -err;
+
+        /* attach it to the caller */
+        status = arch_get_int_status();
+        arch_disable_interrupts();
+        caller->reply = kmsg;
+        caller->blocked_for_reply = 0;
+        arch_set_int_status(status);
+    }
+
+    /* only reply? run the caller now, we stay ready */
+    if (!msg) {
+        if (caller)
+            handoff(caller, 0);
+        return ESUCCESS;
+    }
+
+    /* wait for the next message */
+    status = arch_get_int_status();
+    arch_disable_interrupts();
+    if (caller && curproc->inbox.count) {
+        /* more work is queued, don't go to sleep */
+        unblock(caller->pid);
+        caller = NULL;
+    }
+    while (!(curproc->inbox.count)) {
+        curproc->blocked_for_msg = 1;
+        handoff(caller, 1);
+        caller = NULL;
+    }
+    arch_set_int_status(status);
+
+    /* fetch it */
+    return receive(msg, 0);
+
+}
+
+void ipc_exit(proc_t *proc) {
+
+    /* release IPC state of a terminating process */
+    kmsg_t *kmsg;
+    pd_t *ptr;
+
+    /* drop undelivered messages */
+    while (kmsg = proc->inbox.first) {
+        linkedlist_aremove(&(proc->inbox), kmsg);
+        msg_drop(kmsg);
+    }
+
+    /* fail the calls that are waiting for this process */
+    for (ptr = proclist.first; ptr; ptr = ptr->next) {
+        if (ptr->proc->blocked_for_reply == proc->pid) {
+            ptr->proc->blocked_for_reply = 0;
+            unblock(ptr->proc->pid);
+        }
+    }
 
 }
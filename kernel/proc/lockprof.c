@@ -0,0 +1,185 @@
+/*
+ *        +----------------------------------------------------------+
+ *        | +------------------------------------------------------+ |
+ *        | |  Quafios Kernel 2.0.1.                               | |
+ *        | |  -> procman: lock profiler.                          | |
+ *        | +------------------------------------------------------+ |
+ *        +----------------------------------------------------------+
+ *
+ * This file is part of Quafios 2.0.1 source code.
+ * Copyright (C) 2015  Mostafa Abd El-Aziz Mohamed.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Quafios.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Visit http://www.quafios.com/ for contact information.
+ *
+ */
+
+#include <arch/type.h>
+#include <i386/asm.h>
+#include <sys/mm.h>
+#include <sys/printk.h>
+#include <sys/lockprof.h>
+
+#ifdef CONFIG_LOCKPROF
+
+/* statistics are kept in a fixed open-addressed table, so that
+ * profiling never allocates memory nor takes a lock itself; the
+ * table is only modified with interrupts disabled.
+ */
+static lockprof_t table[LOCKPROF_MAX];
+static uint32_t used = 0;
+static uint32_t lost = 0; /* acquisitions not recorded, table full. */
+
+static lockprof_t *lookup(void *lock, void *site, int32_t kind) {
+
+    uint32_t h, i;
+    lockprof_t *p;
+
+    h = (((uint32_t) lock) ^ ((uint32_t) site >> 2)) % LOCKPROF_MAX;
+    for (i = 0; i < LOCKPROF_MAX; i++) {
+        p = &table[(h+i) % LOCKPROF_MAX];
+        if (p->lock == lock && p->site == site) {
+            return p;
+        } else if (!p->lock) {
+            if (used == LOCKPROF_MAX-1)
+                break; /* keep a free slot to end searches */
+            used++;
+            p->lock = lock;
+            p->site = site;
+            p->kind = kind;
+            return p;
+        }
+    }
+
+    lost++;
+    return NULL;
+
+}
+
+uint64_t lockprof_clock() {
+    return rdtsc();
+}
+
+void lockprof_acquired(void *lock, int32_t kind, void *site,
+                       int32_t contended, uint64_t start,
+                       lockprof_t **prof, uint64_t *since) {
+
+    int32_t status;
+    uint64_t now = rdtsc(), wait = now - start;
+    lockprof_t *p;
+
+    status = arch_get_int_status();
+    arch_disable_interrupts();
+    if (p = lookup(lock, site, kind)) {
+        p->acquired++;
+        if (contended)
+            p->contended++;
+        p->wait_total += wait;
+        if (wait > p->wait_max)
+            p->wait_max = wait;
+    }
+    arch_set_int_status(status);
+
+    *prof  = p;
+    *since = now;
+
+}
+
+void lockprof_released(lockprof_t **prof, uint64_t since) {
+
+    int32_t status;
+    uint64_t hold = rdtsc() - since;
+    lockprof_t *p = *prof;
+
+    if (!p)
+        return; /* not recorded or not acquired (counting semaphore). */
+    *prof = NULL;
+
+    status = arch_get_int_status();
+    arch_disable_interrupts();
+    p->hold_total += hold;
+    if (hold > p->hold_max)
+        p->hold_max = hold;
+    arch_set_int_status(status);
+
+}
+
+/***************************************************************************/
+/*                              sysfs file                                 */
+/***************************************************************************/
+
+static char *lockprof_stats(uint32_t *size) {
+
+    /* list entries sorted by total wait time, descending */
+    static char *kinds[] = {"spin", "sema", "mutex"};
+    lockprof_t *sorted[LOCKPROF_MAX], *p;
+    int32_t count = 0, i, j, status;
+    char *buf = kmalloc(16384);
+    *size = 0;
+
+    /* insertion sort */
+    status = arch_get_int_status();
+    arch_disable_interrupts();
+    for (i = 0; i < LOCKPROF_MAX; i++) {
+        if (!(p = &table[i])->lock)
+            continue;
+        for (j = count++; j > 0 && sorted[j-1]->wait_total < p->wait_total;
+             j--)
+            sorted[j] = sorted[j-1];
+        sorted[j] = p;
+    }
+    arch_set_int_status(status);
+
+    *size += sputs(&buf[*size], "kind lock site acquired contended "
+                                "wait_total wait_max hold_total hold_max\n");
+    for (i = 0; i < count && *size < 16000; i++) {
+        p = sorted[i];
+        *size += sputs(&buf[*size], kinds[p->kind]);
+        *size += sputs(&buf[*size], " 0x");
+        *size += sputx(&buf[*size], (uint32_t) p->lock);
+        *size += sputs(&buf[*size], " 0x");
+        *size += sputx(&buf[*size], (uint32_t) p->site);
+        *size += sputs(&buf[*size], " ");
+        *size += sputq(&buf[*size], p->acquired);
+        *size += sputs(&buf[*size], " ");
+        *size += sputq(&buf[*size], p->contended);
+        *size += sputs(&buf[*size], " ");
+        *size += sputq(&buf[*size], p->wait_total);
+        *size += sputs(&buf[*size], " ");
+        *size += sputq(&buf[*size], p->wait_max);
+        *size += sputs(&buf[*size], " ");
+        *size += sputq(&buf[*size], p->hold_total);
+        *size += sputs(&buf[*size], " ");
+        *size += sputq(&buf[*size], p->hold_max);
+        *size += sputs(&buf[*size], "\n");
+    }
+    if (lost) {
+        *size += sputs(&buf[*size], "(");
+        *size += sputq(&buf[*size], lost);
+        *size += sputs(&buf[*size], " acquisitions not recorded)\n");
+    }
+    buf[*size] = 0;
+    return buf;
+
+}
+
+void lockprof_init() {
+
+    /* register in sysfs */
+    sysfs_reg("locks", lockprof_stats);
+
+}
+
+#endif
@@ -0,0 +1,142 @@
+/*
+ *        +----------------------------------------------------------+
+ *        | +------------------------------------------------------+ |
+ *        | |  Quafios Kernel 2.0.1.                               | |
+ *        | |  -> procman: mutexes.                                | |
+ *        | +------------------------------------------------------+ |
+ *        +----------------------------------------------------------+
+ *
+ * This file is part of Quafios 2.0.1 source code.
+ * Copyright (C) 2015  Mostafa Abd El-Aziz Mohamed.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Quafios.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Visit http://www.quafios.com/ for contact information.
+ *
+ */
+
+#include <arch/type.h>
+#include <arch/spinlock.h>
+#include <sys/mm.h>
+#include <sys/mutex.h>
+#include <sys/scheduler.h>
+
+/* a mutex is a sleeping lock for process context. an uncontended
+ * lock or unlock is a single atomic instruction, it doesn't disable
+ * interrupts nor touch the queue. a contended locker first spins for
+ * a while hoping the owner releases the mutex soon (as on another
+ * CPU, or from an interrupt), then sleeps. unlock hands the mutex
+ * over directly to the oldest sleeper, so sleepers are served in
+ * order and can't be overtaken by newcomers forever.
+ */
+
+void mutex_init(mutex_t *mutex) {
+    mutex->state = MUTEX_FREE;
+    mutex->owner = NULL;
+    spinlock_init(&mutex->spinlock);
+    mutex->head = NULL;
+    mutex->tail = NULL;
+}
+
+int32_t mutex_trylock(mutex_t *mutex) {
+    /* returns nonzero if the mutex has been acquired */
+    if (arch_atomic_cmpxchg(&mutex->state, MUTEX_FREE, MUTEX_LOCKED)) {
+        return 0;
+    } else {
+        mutex->owner = curproc;
+        return 1;
+    }
+}
+
+void mutex_lock(mutex_t *mutex) {
+
+    int32_t status, i;
+    uint64_t start = LOCKPROF_CLOCK();
+    void *site = __builtin_return_address(0);
+
+    /* fast path */
+    if (mutex_trylock(mutex)) {
+        LOCKPROF_ACQUIRED(mutex, LOCK_MUTEX, site, 0, start);
+        return;
+    }
+
+    /* optimistic spinning */
+    for (i = 0; i < MUTEX_SPINS; i++) {
+        arch_cpu_relax();
+        if (mutex->state == MUTEX_FREE && mutex_trylock(mutex)) {
+            LOCKPROF_ACQUIRED(mutex, LOCK_MUTEX, site, 1, start);
+            return;
+        }
+    }
+
+    /* special case: scheduler not initialized yet */
+    if (!scheduler_enabled) {
+        while (!mutex_trylock(mutex))
+            arch_cpu_relax();
+        LOCKPROF_ACQUIRED(mutex, LOCK_MUTEX, site, 1, start);
+        return;
+    }
+
+    /* slow path, mark the mutex as contended; if it happened
+     * to be released meanwhile, we own it now.
+     */
+    status = spinlock_acquire_irqsave(&mutex->spinlock);
+    if (arch_atomic_xchg(&mutex->state, MUTEX_CONTENDED) == MUTEX_FREE) {
+        mutex->owner = curproc;
+        spinlock_release_irqrestore(&mutex->spinlock, status);
+        LOCKPROF_ACQUIRED(mutex, LOCK_MUTEX, site, 1, start);
+        return;
+    }
+
+    /* sleep; mutex_unlock() makes us the owner before waking us up */
+    curproc->semad.next = NULL;
+    if (mutex->head) {
+        mutex->tail = mutex->tail->next = &curproc->semad;
+    } else {
+        mutex->head = mutex->tail = &curproc->semad;
+    }
+    block_unlock(&mutex->spinlock);
+    arch_set_int_status(status);
+    LOCKPROF_ACQUIRED(mutex, LOCK_MUTEX, site, 1, start);
+
+}
+
+void mutex_unlock(mutex_t *mutex) {
+
+    int32_t status;
+    proc_t *proc;
+
+    /* fast path: nobody is sleeping */
+    LOCKPROF_RELEASED(mutex);
+    mutex->owner = NULL;
+    if (arch_atomic_cmpxchg(&mutex->state, MUTEX_LOCKED,
+                            MUTEX_FREE) == MUTEX_LOCKED)
+        return;
+
+    /* hand the mutex over to the oldest sleeper */
+    status = spinlock_acquire_irqsave(&mutex->spinlock);
+    if (mutex->head) {
+        proc = mutex->head->proc;
+        mutex->head = mutex->head->next;
+        if (!mutex->head)
+            mutex->tail = NULL;
+        mutex->owner = proc;
+        mutex->state = mutex->head ? MUTEX_CONTENDED : MUTEX_LOCKED;
+        unblock(proc->pid);
+    } else {
+        mutex->state = MUTEX_FREE;
+    }
+    spinlock_release_irqrestore(&mutex->spinlock, status);
+
+}
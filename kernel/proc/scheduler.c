@@ -36,11 +36,14 @@ uint64_t ticks = 0;
 uint8_t  scheduler_enabled = 0;
 uint32_t flag = 0;
 
-spinlock_t sched_lock = 0;
+spinlock_t sched_lock = SPINLOCK_INIT;
 
 proc_t *curproc  = NULL;
 proc_t *lastproc = NULL;
 
+/* a process that should run next regardless of q_ready (see handoff()) */
+proc_t *handoff_proc = NULL;
+
 /* What is a task queue?
  * -----------------------
  * It is a queue of processes that are waiting for some event.
@@ -81,6 +84,16 @@ void scheduler() {
     if (!curproc->blocked && !curproc->terminated)
         ENQUEUE(q_ready, curproc->sched);
 
+    /* direct handoff? the chosen task never went through q_ready */
+    if (handoff_proc) {
+        lastproc = curproc;
+        curproc = handoff_proc;
+        handoff_proc = NULL;
+        arch_set_int_status(status);
+        arch_proc_switch(lastproc, curproc);
+        return;
+    }
+
     /* no ready processes? */
     if (!q_ready.count) {
         arch_set_int_status(status);
@@ -170,9 +183,47 @@ void block_unlock(spinlock_t *spinlock) {
     }
 }
 
+void handoff(proc_t *proc, int32_t block_self) {
+    int32_t status;
+
+    /* give the CPU straight to a blocked process, without enqueuing it
+     * in q_ready and waiting for its turn. used by synchronous IPC,
+     * where the other side is known to be the next to do useful work.
+     * if proc is not blocked, this is just a normal yield()/block().
+     */
+    status = arch_get_int_status();
+    arch_disable_interrupts();
+
+    if (block_self)
+        curproc->blocked = 1;
+
+    if (proc && proc->blocked && proc != curproc) {
+        proc->blocked = 0;
+        handoff_proc = proc;
+    }
+
+    /* call scheduler immediately */
+    yield();
+
+    /* all processes are blocked? */
+    while (curproc->blocked) {
+        arch_enable_interrupts();
+        yield();
+        arch_disable_interrupts();
+    }
+
+    /* exit critical region */
+    arch_set_int_status(status);
+}
+
 void sleep(uint64_t milliseconds) {
     uint64_t start = ticks;
     uint64_t end = ticks+milliseconds/10;
     while (ticks <= end)
         yield();
 }
+
+int32_t uptime() {
+    /* milliseconds since the scheduler started ticking */
+    return (int32_t) (ticks*(SCHEDULER_INTERVAL_NS/1000000));
+}
@@ -41,20 +41,20 @@ void sema_init(semaphore_t *sema, int32_t counter) {
 
 void sema_down(semaphore_t *sema) {
     int32_t status;
-    /* enter critical region */
-    status = arch_get_int_status();
-    arch_disable_interrupts(); /* disabling interrupts is important here,
-                                * to allow calling sema_up() from interrupt
-                                * context.
-                                */
-    spinlock_acquire(&sema->spinlock);
+    uint64_t start = LOCKPROF_CLOCK();
+    /* enter critical region. disabling interrupts is important
+     * here, to allow calling sema_up() from interrupt context.
+     */
+    status = spinlock_acquire_irqsave(&sema->spinlock);
     /* decrease semaphore counter */
     sema->counter--;
     /* special case: scheduler not initialized yet */
     if (!scheduler_enabled) {
-        spinlock_release(&sema->spinlock);
-        arch_set_int_status(status);
+        spinlock_release_irqrestore(&sema->spinlock, status);
         while (sema->counter < 0);
+        LOCKPROF_ACQUIRED(sema, LOCK_SEMA, __builtin_return_address(0),
+                          0, start);
+        return; /* the lock is already released. */
     }
     /* block? */
     if (sema->counter < 0) {
@@ -68,19 +68,21 @@ void sema_down(semaphore_t *sema) {
         /* exit critical region with a block */
         block_unlock(&sema->spinlock);
         arch_set_int_status(status);
+        LOCKPROF_ACQUIRED(sema, LOCK_SEMA, __builtin_return_address(0),
+                          1, start);
     } else {
         /* exit critical region normally */
-        spinlock_release(&sema->spinlock);
-        arch_set_int_status(status);
+        spinlock_release_irqrestore(&sema->spinlock, status);
+        LOCKPROF_ACQUIRED(sema, LOCK_SEMA, __builtin_return_address(0),
+                          0, start);
     }
 }
 
 void sema_up(semaphore_t *sema) {
     int32_t status;
     /* enter critical region */
-    status = arch_get_int_status();
-    arch_disable_interrupts();
-    spinlock_acquire(&sema->spinlock);
+    status = spinlock_acquire_irqsave(&sema->spinlock);
+    LOCKPROF_RELEASED(sema);
     /* increase counter */
     sema->counter++;
     /* queue is not empty? */
@@ -92,6 +94,5 @@ void sema_up(semaphore_t *sema) {
         unblock(proc->pid);
     }
     /* exit critical region normally */
-    spinlock_release(&sema->spinlock);
-    arch_set_int_status(status);
+    spinlock_release_irqrestore(&sema->spinlock, status);
 }
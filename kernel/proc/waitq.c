@@ -0,0 +1,116 @@
+/*
+ *        +----------------------------------------------------------+
+ *        | +------------------------------------------------------+ |
+ *        | |  Quafios Kernel 2.0.1.                               | |
+ *        | |  -> procman: wait queues.                            | |
+ *        | +------------------------------------------------------+ |
+ *        +----------------------------------------------------------+
+ *
+ * This file is part of Quafios 2.0.1 source code.
+ * Copyright (C) 2015  Mostafa Abd El-Aziz Mohamed.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Quafios.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Visit http://www.quafios.com/ for contact information.
+ *
+ */
+
+#include <arch/type.h>
+#include <sys/proc.h>
+#include <sys/scheduler.h>
+#include <sys/waitq.h>
+
+/* waiters that have a deadline, checked at each scheduler tick */
+static waitq_t timeouts = {NULL, NULL, 0};
+
+void waitq_init(waitq_t *q) {
+    q->first = NULL;
+    q->last  = NULL;
+    q->count = 0;
+}
+
+void waitq_add(waitq_t *q, waiter_t *w) {
+    int32_t status;
+    w->proc  = curproc;
+    w->queue = q;
+    status = arch_get_int_status();
+    arch_disable_interrupts();
+    linkedlist_addlast(q, w);
+    arch_set_int_status(status);
+}
+
+void waitq_remove(waiter_t *w) {
+    int32_t status;
+    status = arch_get_int_status();
+    arch_disable_interrupts();
+    if (w->queue) {
+        linkedlist_aremove(w->queue, w);
+        w->queue = NULL;
+    }
+    arch_set_int_status(status);
+}
+
+void waitq_sleep(waitq_t *q) {
+
+    /* sleep on q until somebody calls wake_up(q). the caller is to
+     * disable interrupts before it checks the condition it waits for,
+     * otherwise the wake up might come in between and be lost.
+     */
+    waiter_t w;
+    waitq_add(q, &w);
+    handoff(NULL, 1);
+    waitq_remove(&w);
+
+}
+
+void waitq_timeout(waiter_t *w, uint64_t when) {
+    /* wake the caller up once ticks reaches "when" */
+    w->when = when;
+    waitq_add(&timeouts, w);
+}
+
+void wake_up(waitq_t *q) {
+
+    /* wake up all processes sleeping on q, they remain in the queue
+     * until they remove themselves.
+     */
+    waiter_t *w;
+    int32_t status;
+
+    status = arch_get_int_status();
+    arch_disable_interrupts();
+    for (w = q->first; w; w = w->next)
+        if (w->proc->blocked)
+            unblock(w->proc->pid);
+    arch_set_int_status(status);
+
+}
+
+void waitq_tick() {
+
+    /* called by the timer IRQ before the scheduler runs */
+    waiter_t *w;
+    for (w = timeouts.first; w; w = w->next)
+        if (ticks >= w->when && w->proc->blocked)
+            unblock(w->proc->pid);
+
+}
+
+void poll_wait(poll_table_t *pt, waitq_t *q) {
+    /* drivers call this from their poll() routine to register
+     * the poller at the queue that signals readiness.
+     */
+    if (pt && pt->count < pt->max)
+        waitq_add(q, &(pt->waiter[pt->count++]));
+}
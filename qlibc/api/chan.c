@@ -0,0 +1,115 @@
+/*
+ *        +----------------------------------------------------------+
+ *        | +------------------------------------------------------+ |
+ *        | |  Quafios C Standard Library.                         | |
+ *        | |  -> API: Shared memory channels.                     | |
+ *        | +------------------------------------------------------+ |
+ *        +----------------------------------------------------------+
+ *
+ * This file is part of Quafios 2.0.1 source code.
+ * Copyright (C) 2015  Mostafa Abd El-Aziz Mohamed.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Quafios.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Visit http://www.quafios.com/ for contact information.
+ *
+ */
+
+#include <api/chan.h>
+#include <api/syscall.h>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+
+int chan_create(unsigned int slot_size, unsigned int slots) {
+    int ret = syscall(SYS_CHAN_CREATE, slot_size, slots);
+    if (ret < 0) {
+        errno = -ret;
+        return -1;
+    }
+    return ret;
+}
+
+chan_ring_t *chan_map(int id, int role) {
+    void *addr;
+    int ret = syscall(SYS_CHAN_MAP, id, role, &addr);
+    if (ret < 0) {
+        errno = -ret;
+        return NULL;
+    }
+    return addr;
+}
+
+int chan_wait(int id) {
+    int ret = syscall(SYS_CHAN_WAIT, id);
+    if (ret < 0) {
+        errno = -ret;
+        return -1;
+    }
+    return 0;
+}
+
+int chan_notify(int id) {
+    int ret = syscall(SYS_CHAN_NOTIFY, id);
+    if (ret < 0) {
+        errno = -ret;
+        return -1;
+    }
+    return 0;
+}
+
+int chan_close(int id) {
+    int ret = syscall(SYS_CHAN_CLOSE, id);
+    if (ret < 0) {
+        errno = -ret;
+        return -1;
+    }
+    return 0;
+}
+
+int chan_grant(int id, int pid) {
+    int ret = syscall(SYS_CHAN_GRANT, id, pid);
+    if (ret < 0) {
+        errno = -ret;
+        return -1;
+    }
+    return 0;
+}
+
+int chan_put(int id, chan_ring_t *ring, void *data) {
+    /* producer side: fill the next slot, no system call
+     * unless the consumer has to be woken up.
+     */
+    if (CHAN_FULL(ring)) {
+        ring->dropped++;
+        errno = ENOSPC;
+        return -1;
+    }
+    memcpy(CHAN_SLOT(ring, ring->head), data, ring->slot_size);
+    ring->head++;
+    if (ring->sleeping)
+        return chan_notify(id);
+    return 0;
+}
+
+int chan_get(chan_ring_t *ring, void *data) {
+    /* consumer side: drain one slot, never blocks */
+    if (CHAN_EMPTY(ring)) {
+        errno = ENOENT;
+        return -1;
+    }
+    memcpy(data, CHAN_SLOT(ring, ring->tail), ring->slot_size);
+    ring->tail++;
+    return 0;
+}
@@ -29,6 +29,26 @@
 #include <api/fs.h>
 #include <api/syscall.h>
 #include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* readdir() fetches entries with getdents(), a buffer per descriptor */
+#define DIRBUF_SIZE     4096
+
+typedef struct dirbuf {
+    int pos;
+    int len;
+    char data[DIRBUF_SIZE];
+} dirbuf_t;
+
+static dirbuf_t *dirbufs[FD_MAX];
+
+static void dirbuf_drop(int fd) {
+    if (fd >= 0 && fd < FD_MAX && dirbufs[fd]) {
+        free(dirbufs[fd]);
+        dirbufs[fd] = NULL;
+    }
+}
 
 /**************************************************************************/
 /*                               fs/super.c                               */
@@ -126,6 +146,7 @@ int open(char *pathname, int flags) {
 
 int close(int fd) {
     int ret = syscall(SYS_CLOSE, fd);
+    dirbuf_drop(fd);
     if (ret < 0) {
         errno = -ret;
         return -1;
@@ -191,9 +212,47 @@ ssize_t write(int fd, char *buf, size_t size) {
     return ret;
 }
 
+ssize_t pread(int fd, char *buf, size_t size, pos_t offset) {
+    int ret = syscall(SYS_PREAD, fd, buf, size, (pos_t) offset);
+    if (ret < 0) {
+        errno = -ret;
+        return -1;
+    }
+    return ret;
+}
+
+ssize_t pwrite(int fd, char *buf, size_t size, pos_t offset) {
+    int ret = syscall(SYS_PWRITE, fd, buf, size, (pos_t) offset);
+    if (ret < 0) {
+        errno = -ret;
+        return -1;
+    }
+    return ret;
+}
+
+ssize_t readv(int fd, iovec_t *iov, int iovcnt) {
+    int ret = syscall(SYS_READV, fd, iov, iovcnt);
+    if (ret < 0) {
+        errno = -ret;
+        return -1;
+    }
+    return ret;
+}
+
+ssize_t writev(int fd, iovec_t *iov, int iovcnt) {
+    int ret = syscall(SYS_WRITEV, fd, iov, iovcnt);
+    if (ret < 0) {
+        errno = -ret;
+        return -1;
+    }
+    return ret;
+}
+
 pos_t seek(int fd, pos_t offset, int whence) {
     pos_t ret_offset;
     int ret = syscall(SYS_SEEK,fd,(pos_t)offset,&ret_offset,whence);
+    if (ret >= 0)
+        dirbuf_drop(fd); /* buffered entries belong to the old offset */
     if (ret < 0) {
         errno = -ret;
         return -1;
@@ -206,13 +265,50 @@ pos_t seek(int fd, pos_t offset, int whence) {
 /*                             fs/readdir.c                               */
 /**************************************************************************/
 
-int readdir(int fd, dirent_t *dirp) {
-    int ret = syscall(SYS_READDIR, fd, dirp);
+int getdents(int fd, void *buf, unsigned int size) {
+    int ret = syscall(SYS_GETDENTS, fd, buf, size);
     if (ret < 0) {
         errno = -ret;
         return -1;
     }
-    return 0;
+    return ret;
+}
+
+int readdir(int fd, dirent_t *dirp) {
+    /* returns 1 for an entry, 0 at the end or on error */
+    dirbuf_t *db;
+    dirent_rec_t *rec;
+    int ret;
+
+    if (fd < 0 || fd >= FD_MAX) {
+        errno = EBADF;
+        return 0;
+    }
+
+    /* first call on this descriptor? */
+    if (!(db = dirbufs[fd])) {
+        if (!(db = malloc(sizeof(dirbuf_t)))) {
+            errno = ENOMEM;
+            return 0;
+        }
+        db->pos = db->len = 0;
+        dirbufs[fd] = db;
+    }
+
+    /* refill: */
+    if (db->pos >= db->len) {
+        if ((ret = getdents(fd, db->data, DIRBUF_SIZE)) <= 0)
+            return 0;
+        db->pos = 0;
+        db->len = ret;
+    }
+
+    /* next record: */
+    rec = (dirent_rec_t *) &db->data[db->pos];
+    db->pos += rec->reclen;
+    dirp->ino = rec->ino;
+    memcpy(dirp->name, rec->name, rec->namelen+1);
+    return 1;
 }
 
 /**************************************************************************/
@@ -270,6 +366,8 @@ int dup(int oldfd) {
 
 int dup2(int oldfd, int newfd) {
     int ret = syscall(SYS_DUP2, oldfd, newfd);
+    if (ret >= 0 && oldfd != newfd)
+        dirbuf_drop(newfd);
     if (ret < 0) {
         errno = -ret;
         return -1;
@@ -290,6 +388,68 @@ int ioctl(int fd, unsigned int cmd, void *data) {
     return 0;
 }
 
+/**************************************************************************/
+/*                              fs/poll.c                                 */
+/**************************************************************************/
+
+int poll(pollfd_t *fds, unsigned int nfds, int timeout) {
+    int ret = syscall(SYS_POLL, fds, nfds, timeout);
+    if (ret < 0) {
+        errno = -ret;
+        return -1;
+    }
+    return ret;
+}
+
+/**************************************************************************/
+/*                              fs/pipefs.c                               */
+/**************************************************************************/
+
+int pipe(int fds[2]) {
+    int ret = syscall(SYS_PIPE, fds);
+    if (ret < 0) {
+        errno = -ret;
+        return -1;
+    }
+    return 0;
+}
+
+int splice(int fd_in, int fd_out, unsigned int size) {
+    int ret = syscall(SYS_SPLICE, fd_in, fd_out, size);
+    if (ret < 0) {
+        errno = -ret;
+        return -1;
+    }
+    return ret;
+}
+
+ssize_t copy_file_range(int fd_in, pos_t *off_in,
+                        int fd_out, pos_t *off_out, size_t len) {
+    int ret = syscall(SYS_COPY_RANGE, fd_in, off_in, fd_out, off_out, len);
+    if (ret < 0) {
+        errno = -ret;
+        return -1;
+    }
+    return ret;
+}
+
+/**************************************************************************/
+/*                               fs/sync.c                                */
+/**************************************************************************/
+
+void sync() {
+    syscall(SYS_SYNC);
+}
+
+int fsync(int fd) {
+    int ret = syscall(SYS_FSYNC, fd);
+    if (ret < 0) {
+        errno = -ret;
+        return -1;
+    }
+    return 0;
+}
+
 /**************************************************************************/
 /*                              fs/exec.c                                 */
 /**************************************************************************/
@@ -92,3 +92,15 @@ int munmap(void *base, unsigned int size) {
     return 0;
 
 }
+
+int msync(void *base, unsigned int size, int flags) {
+
+    int ret;
+    ret = syscall(SYS_MSYNC, base, size, flags);
+    if (ret < 0) {
+        errno = -ret;
+        return -1;
+    }
+    return 0;
+
+}
@@ -70,6 +70,24 @@ int receive(msg_t *msg, int wait) {
     return 0;
 }
 
+int call(int pid, msg_t *msg, msg_t *reply) {
+    int ret = syscall(SYS_CALL, pid, msg, reply);
+    if (ret < 0) {
+        errno = -ret;
+        return -1;
+    }
+    return 0;
+}
+
+int reply_wait(int pid, msg_t *reply, msg_t *msg) {
+    int ret = syscall(SYS_REPLY_WAIT, pid, reply, msg);
+    if (ret < 0) {
+        errno = -ret;
+        return -1;
+    }
+    return 0;
+}
+
 int getpid() {
     return syscall(SYS_GETPID);
 }
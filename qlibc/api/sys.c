@@ -38,3 +38,7 @@ int reboot() {
     }
     return ret;
 }
+
+int uptime() {
+    return syscall(SYS_UPTIME);
+}
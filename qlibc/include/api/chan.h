@@ -0,0 +1,44 @@
+/*
+ *        +----------------------------------------------------------+
+ *        | +------------------------------------------------------+ |
+ *        | |  Quafios C Standard Library.                         | |
+ *        | |  -> API: channels header.                            | |
+ *        | +------------------------------------------------------+ |
+ *        +----------------------------------------------------------+
+ *
+ * This file is part of Quafios 2.0.1 source code.
+ * Copyright (C) 2015  Mostafa Abd El-Aziz Mohamed.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Quafios.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Visit http://www.quafios.com/ for contact information.
+ *
+ */
+
+#ifndef __API_CHAN_H
+#define __API_CHAN_H
+
+#include <sys/chan.h>  /* channel ring layout.  */
+#include <sys/error.h> /* kernel error codes.   */
+
+int chan_create(unsigned int slot_size, unsigned int slots);
+chan_ring_t *chan_map(int id, int role);
+int chan_wait(int id);
+int chan_notify(int id);
+int chan_close(int id);
+int chan_grant(int id, int pid);
+int chan_put(int id, chan_ring_t *ring, void *data);
+int chan_get(chan_ring_t *ring, void *data);
+
+#endif
@@ -31,6 +31,7 @@
 
 #include <sys/fs.h>    /* kernel filesystem structures. */
 #include <sys/error.h> /* kernel error codes.           */
+#include <sys/poll.h>  /* pollfd_t and poll events.     */
 
 int mount(char *devfile, char *mntpoint, char *fstype,
           unsigned int flags, void *data);
@@ -49,7 +50,12 @@ int truncate(char *pathname, pos_t length);
 int ftruncate(int fd, pos_t length);
 ssize_t read(int fd, char *buf, size_t size);
 ssize_t write(int fd, char *buf, size_t size);
+ssize_t pread(int fd, char *buf, size_t size, pos_t offset);
+ssize_t pwrite(int fd, char *buf, size_t size, pos_t offset);
+ssize_t readv(int fd, iovec_t *iov, int iovcnt);
+ssize_t writev(int fd, iovec_t *iov, int iovcnt);
 pos_t seek(int fd, pos_t offset, int whence);
+int getdents(int fd, void *buf, unsigned int size);
 int readdir(int fd, dirent_t *dirp);
 int stat(char *pathname, stat_t *buf);
 int fstat(int fd, stat_t *buf);
@@ -58,6 +64,13 @@ int fstatfs(int fd, statfs_t *buf);
 int dup(int oldfd);
 int dup2(int oldfd, int newfd);
 int ioctl(int fd, unsigned int cmd, void *data);
+int poll(pollfd_t *fds, unsigned int nfds, int timeout);
+int pipe(int fds[2]);
+int splice(int fd_in, int fd_out, unsigned int size);
+ssize_t copy_file_range(int fd_in, pos_t *off_in,
+                        int fd_out, pos_t *off_out, size_t len);
+void sync();
+int fsync(int fd);
 int execve(char *filename, char *argv[], char *envp[]);
 
 #endif
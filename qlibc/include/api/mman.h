@@ -38,5 +38,6 @@ void *sbrk(int increment);
 void *mmap(void *base, unsigned int size, unsigned int type,
            unsigned int flags, int fd, pos_t off);
 int munmap(void *base, unsigned int size);
+int msync(void *base, unsigned int size, int flags);
 
 #endif
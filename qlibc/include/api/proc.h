@@ -37,6 +37,8 @@ void _exit(int status);
 int waitpid(int pid, int *status);
 int send(int pid, msg_t *msg);
 int receive(msg_t *msg, int wait);
+int call(int pid, msg_t *msg, msg_t *reply);
+int reply_wait(int pid, msg_t *reply, msg_t *msg);
 int getpid();
 
 #endif
@@ -32,5 +32,6 @@
 #include <sys/error.h> /* kernel error codes.        */
 
 int reboot();
+int uptime(); /* milliseconds since boot. */
 
 #endif
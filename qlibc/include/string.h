@@ -36,5 +36,7 @@ size_t strlen(const char *str);
 char *strcpy(char *destination, const char *source);
 char *strcat(char *destination, const char *source);
 char *strtok(char *str, const char *delimiters);
+void *memcpy(void *destination, const void *source, size_t num);
+void *memset(void *ptr, int value, size_t num);
 
 #endif
@@ -55,6 +55,30 @@ char *strcat(char *destination, const char *source) {
     return strcpy(&destination[strlen(destination)], source);
 }
 
+void *memcpy(void *destination, const void *source, size_t num) {
+    unsigned char *d = destination;
+    const unsigned char *s = source;
+    /* move whole words when both sides are aligned */
+    if (!(((unsigned int) d | (unsigned int) s) & 3)) {
+        while (num >= 4) {
+            *((unsigned int *) d) = *((const unsigned int *) s);
+            d += 4;
+            s += 4;
+            num -= 4;
+        }
+    }
+    while (num--)
+        *d++ = *s++;
+    return destination;
+}
+
+void *memset(void *ptr, int value, size_t num) {
+    unsigned char *p = ptr;
+    while (num--)
+        *p++ = (unsigned char) value;
+    return ptr;
+}
+
 char *strtok(char *str, const char *delimiters) {
 
     char *curToken;
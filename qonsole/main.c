@@ -33,9 +33,7 @@
 #include <api/fs.h>
 #include <tty/vtty.h>
 #include <tty/pstty.h>
-#include <timer/generic.h>
 
-int timer_fd;
 int scheduled = 0;
 
 int pstty_fd;
@@ -88,13 +86,6 @@ void pstty_init() {
 
 }
 
-void timer_init() {
-
-    /* open vtty driver */
-    timer_fd = open("/dev/timer", 0);
-
-}
-
 void exec_shell(char *fname) {
 
     /* fork */
@@ -156,6 +147,13 @@ static uint32_t color_palette[] = {
      0xFFFFFFFF
 };
 
+void flush() {
+    /* push the dirty rectangle to winman */
+    window_flush(win, x1, y1, x2-x1, y2-y1);
+    x1 = x2 = y1 = y2 = -1;
+    scheduled = 0;
+}
+
 void draw_char(char chr, char attr, int x, int y) {
 
     unsigned int chr_pos_x = (font_width)*x;
@@ -207,10 +205,7 @@ void draw_char(char chr, char attr, int x, int y) {
 
     /* flush */
     if (!scheduled) {
-        timer_alert_t alert;
-        alert.prefix = 0x11;
-        alert.time = 10;
-        ioctl(timer_fd, TIMER_ALERT, &alert);
+        set_timeout(10, flush);
         scheduled = 1;
     }
 
@@ -317,10 +312,15 @@ void pstty_set_char_at_off(char x, char y, char c) {
 }
 
 void pstty_get_cursor() {
-    char cursor[2];
-    cursor[0] = vga_col;
-    cursor[1] = vga_row;
-    ioctl(pstty_fd, TTY_SETCURSOR, cursor);
+    /* the writer is blocked in call() waiting for the answer */
+    pstty_packet_t packet = {0};
+    msg_t msg;
+    packet.cmd = PSTTY_GET_CURSOR;
+    packet.x   = vga_col;
+    packet.y   = vga_row;
+    msg.buf  = &packet;
+    msg.size = sizeof(packet);
+    reply_wait(event_sender, &msg, NULL);
 }
 
 void pstty_set_cursor(char x, char y) {
@@ -340,14 +340,6 @@ void pstty_event(void *packet) {
     char x    = ((pstty_packet_t *) packet)->x;
     char y    = ((pstty_packet_t *) packet)->y;
 
-    if (((pstty_packet_t *) packet)->prefix == 0x11) {
-        /* timer alert */
-        window_flush(win, x1, y1, x2-x1, y2-y1);
-        x1 = x2 = y1 = y2 = -1;
-        scheduled = 0;
-        return;
-    }
-
     /* process the cmd */
     switch (cmd) {
 
@@ -395,9 +387,6 @@ int main(int argc, char *argv[]) {
     /* initialize the font */
     font_init();
 
-    /* initialize timer */
-    timer_init();
-
     /* choose title */
     if (argv[1]) {
         strcpy(&title[strlen(title)], " - ");
@@ -4,14 +4,137 @@
 #include <ctype.h>
 #include "rash.h"
 
+static void execcmd(char **argv, char **pathv) {
+
+    /* run a command inside a child process, never returns */
+    char cmdpath[FILENAME_MAX+1];
+    void (*func)(char *argv[]);
+    int i;
+
+    /* internal function? */
+    if (func = getfunc(argv[0])) {
+        func(argv);
+        exit(0);
+    }
+
+    /* check if command contains a '/' */
+    for (i = 0; argv[0][i] && argv[0][i] != '/'; i++);
+    if (argv[0][i] == '/') {
+        /* relative or absolute path */
+        do_execv(argv[0], argv);
+    } else {
+        /* use $PATH environment variable */
+        for (i = 0; pathv[i]; i++) {
+            strcpy(cmdpath, pathv[i]);
+            if (pathv[i][strlen(pathv[i])-1] != '/')
+                strcat(cmdpath, "/");
+            strcat(cmdpath, argv[0]);
+            if (do_exists(cmdpath)) /* try this path */ {
+                do_execv(cmdpath, argv);
+                break;
+            }
+        }
+    }
+
+    /* cannot execute comamnd */
+    fprintf(stderr, "%s: command not found.\n", argv[0]);
+    exit(127);
+
+}
+
+static int splitcmd(char *cmd, char **stages) {
+
+    /* split cmd at every '|' that is not quoted */
+    int count = 1;
+    int quoted = 0;
+    int i;
+
+    stages[0] = cmd;
+    for (i = 0; cmd[i]; i++) {
+        if (cmd[i] == '\"') {
+            quoted = !quoted;
+        } else if (cmd[i] == '|' && !quoted) {
+            if (count == MAX_STAGES) {
+                fprintf(stderr, "Error: Too many commands in pipeline!\n");
+                return 0;
+            }
+            cmd[i] = 0;
+            stages[count++] = &cmd[i+1];
+        }
+    }
+    return count;
+
+}
+
+static void pipeline(char ***argvs, int count, int wait, char **pathv) {
+
+    /* connect count commands with pipes and run them */
+    rash_pid_t pids[MAX_STAGES];
+    int fds[2];
+    int in = -1;
+    int status;
+    int i;
+
+    for (i = 0; i < count; i++) {
+        /* pipe to the next command */
+        fds[0] = fds[1] = -1;
+        if (i < count-1 && do_pipe(fds)) {
+            fprintf(stderr, "Error: Cannot create pipe!\n");
+            pids[i] = -1;
+        } else if ((pids[i] = do_fork()) < 0) {
+            fprintf(stderr, "Error: Cannot fork!\n");
+        }
+        if (pids[i] < 0) {
+            /* stop here; closing the read end the commands already
+             * started write to lets them fail instead of blocking.
+             */
+            if (in >= 0)
+                do_close(in);
+            if (fds[0] >= 0) {
+                do_close(fds[0]);
+                do_close(fds[1]);
+            }
+            in = -1;
+            count = i;
+            break;
+        }
+        if (!pids[i]) {
+            /* child, attach pipe ends to stdin and stdout */
+            if (in >= 0) {
+                do_dup2(in, 0);
+                do_close(in);
+            }
+            if (fds[1] >= 0) {
+                do_close(fds[0]);
+                do_dup2(fds[1], 1);
+                do_close(fds[1]);
+            }
+            execcmd(argvs[i], pathv);
+        }
+        /* parent, only keeps the read end for the next command */
+        if (in >= 0)
+            do_close(in);
+        if (fds[1] >= 0)
+            do_close(fds[1]);
+        in = fds[0];
+    }
+
+    /* wait for the children if no & in the command */
+    if (wait)
+        for (i = 0; i < count; i++)
+            do_waitpid(pids[i], &status);
+
+}
+
 void proccmd(char *cmd, char **pathv) {
 
     /* process a command */
-    char cmdpath[FILENAME_MAX+1];
-    char **argv;
+    char *stages[MAX_STAGES];
+    char **argvs[MAX_STAGES];
     void (*func)(char *argv[]);
     int wait = 1;
     int status;
+    int count;
     rash_pid_t pid;
     int i;
 
@@ -27,55 +150,51 @@ void proccmd(char *cmd, char **pathv) {
         wait = 0;
     }
 
-    /* tokenize cmd */
-    argv = tokenize(cmd, " \n\t\r\v\f");
-    if (argv == NULL) {
+    /* split cmd into the commands of a pipeline */
+    if (!(count = splitcmd(cmd, stages)))
         return;
-    }
 
-    /* return if argv is too small */
-    if (!argv[0]) {
-        freev(argv);
-        return;
+    /* tokenize the commands */
+    for (i = 0; i < count; i++) {
+        argvs[i] = tokenize(stages[i], " \n\t\r\v\f");
+        if (argvs[i] == NULL || (!argvs[i][0] && count > 1)) {
+            /* error, or an empty command inside a pipeline */
+            if (argvs[i]) {
+                fprintf(stderr, "Error: Invalid pipeline!\n");
+                freev(argvs[i]);
+            }
+            while (i--)
+                freev(argvs[i]);
+            return;
+        }
     }
 
     /* execute command */
-    if (func = getfunc(argv[0])) {
+    if (count > 1) {
+        /* pipeline */
+        pipeline(argvs, count, wait, pathv);
+    } else if (!argvs[0][0]) {
+        /* argv is too small */
+    } else if (func = getfunc(argvs[0][0])) {
         /* internal function */
-        func(argv);
+        func(argvs[0]);
     } else {
         /* not internal */
-        if (pid = do_fork()) {
+        if ((pid = do_fork()) < 0) {
+            fprintf(stderr, "Error: Cannot fork!\n");
+        } else if (pid) {
             /* parent, wait for child if no & in the command */
             if (wait)
                 do_waitpid(pid, &status);
         } else {
-            /* child, check if command contains a '/' */
-            for (i = 0; argv[0][i] && argv[0][i] != '/'; i++);
-            if (argv[0][i] == '/') {
-                /* relative or absolute path */
-                do_execv(argv[0], argv);
-            } else {
-                /* use $PATH environment variable */
-                for (i = 0; pathv[i]; i++) {
-                    strcpy(cmdpath, pathv[i]);
-                    if (pathv[i][strlen(pathv[i])-1] != '/')
-                        strcat(cmdpath, "/");
-                    strcat(cmdpath, argv[0]);
-                    if (do_exists(cmdpath)) /* try this path */ {
-                        do_execv(cmdpath, argv);
-                        break;
-                    }
-                }
-            }
-            /* cannot execute comamnd */
-            fprintf(stderr, "%s: command not found.\n", argv[0]);
-            exit(127);
+            /* child */
+            execcmd(argvs[0], pathv);
         }
     }
 
     /* deallocate argv */
-    freev(argv);
+    for (i = 0; i < count; i++)
+        freev(argvs[i]);
 
     /* done */
     return;
@@ -30,6 +30,18 @@ rash_pid_t do_waitpid(rash_pid_t pid, int *status) {
     return waitpid(pid, status);
 }
 
+int do_pipe(int fds[2]) {
+    return pipe(fds);
+}
+
+int do_dup2(int oldfd, int newfd) {
+    return dup2(oldfd, newfd);
+}
+
+int do_close(int fd) {
+    return close(fd);
+}
+
 int do_exists(char *path) {
     stat_t st = {0};
     if (stat(path, &st)) {
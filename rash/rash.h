@@ -6,6 +6,7 @@
 /* macros */
 #define MAX_CMD_LINE    513
 #define MAX_CMD         4096
+#define MAX_STAGES      16
 
 /* colors */
 #define COLOR_WHITE     0
@@ -45,6 +46,9 @@ rash_pid_t do_waitpid(rash_pid_t pid, int *stat);
 void do_getcwd(char *cwd, int size);
 int do_chdir(char *dir);
 void do_setcolor(int color);
+int do_pipe(int fds[2]);
+int do_dup2(int oldfd, int newfd);
+int do_close(int fd);
 
 #endif
 
@@ -28,6 +28,18 @@ void do_waitpid(rash_pid_t pid) {
     waitpid(pid, &status, 0);
 }
 
+int do_pipe(int fds[2]) {
+    return pipe(fds);
+}
+
+int do_dup2(int oldfd, int newfd) {
+    return dup2(oldfd, newfd);
+}
+
+int do_close(int fd) {
+    return close(fd);
+}
+
 void do_setcolor(int color) {
 
     switch(color) {
@@ -251,6 +251,53 @@ diskfs_blk_t get_block(diskfs_sb_t *sb) {
 
 }
 
+diskfs_blk_t alloc_extent(diskfs_sb_t *sb,
+                          diskfs_ino_t ino,
+                          diskfs_inode_t *inode,
+                          diskfs_blk_t blk_off,
+                          diskfs_blk_t count) {
+
+    /* allocate "count" disk blocks in a row for the blocks of
+     * the file from "blk_off" on, and map them in the extents
+     * of the inode. blocks are allocated one after the other,
+     * so a file that is written in order gets a single extent.
+     * returns the first disk block.
+     */
+
+    diskfs_ext_head_t *root = DISKFS_EXT_ROOT(inode->ptr);
+    diskfs_extent_t *ent = (diskfs_extent_t *) &root[1];
+    diskfs_extent_t *last = root->count ? &ent[root->count-1] : NULL;
+    diskfs_blk_t first;
+
+    if (sb->free_data_blocks < count ||
+        sb->next_free_block + count > sb->data_blocks) {
+        printf("Error: Disk space is not enough!\n");
+        exit(-1);
+    }
+    first = sb->next_free_block + sb->data_start;
+    sb->next_free_block += count;
+    sb->free_data_blocks -= count;
+
+    if (last && last->lblk + last->len == blk_off &&
+        last->start + last->len == first) {
+        /* the last extent just grows: */
+        last->len += count;
+    } else if (root->count < DISKFS_EXT_ROOT_LIMIT) {
+        /* a new extent: */
+        ent[root->count].lblk  = blk_off;
+        ent[root->count].start = first;
+        ent[root->count].len   = count;
+        root->count++;
+    } else {
+        printf("Error: too many extents!\n");
+        exit(-1);
+    }
+
+    update_inode(sb, ino, inode);
+    return first;
+
+}
+
 diskfs_blk_t alloc_file_block(diskfs_sb_t *sb,
                               diskfs_ino_t ino,
                               diskfs_inode_t *inode,
@@ -266,11 +313,21 @@ diskfs_blk_t alloc_file_block(diskfs_sb_t *sb,
 
     int32_t ptrs_per_block = sb->block_size/sizeof(diskfs_blk_t);
     diskfs_lvl_t lvl = diskfs_blk_to_lvl(sb, blk_off);
-    uint8_t *tmp = malloc(sb->block_size);
+    uint8_t *tmp;
     int32_t init = 0, i;
     diskfs_blk_t  blk;
     diskfs_blk_t *ptr;
+    diskfs_extent_t *ext;
+
+    /* extents? */
+    if (inode->flags & DISKFS_INODE_EXTENTS) {
+        ext = diskfs_ext_find(DISKFS_EXT_ROOT(inode->ptr), blk_off);
+        if (ext && ext->lblk <= blk_off && blk_off - ext->lblk < ext->len)
+            return ext->start + (blk_off - ext->lblk);
+        return alloc_extent(sb, ino, inode, blk_off, 1);
+    }
 
+    tmp = malloc(sb->block_size);
     for (i = 0; i <= lvl.level; i++) {
 
         /* load the table into memory: */
@@ -356,10 +413,162 @@ void write_bitmap(diskfs_sb_t *sb,
 /*                                Copy Files                               */
 /***************************************************************************/
 
+typedef struct dxent {
+    uint32_t hash;
+    diskfs_dirent_t dirent;
+} dxent_t;
+
+int dxcmp(const void *a, const void *b) {
+    uint32_t x = ((dxent_t *) a)->hash, y = ((dxent_t *) b)->hash;
+    return x < y ? -1 : x > y;
+}
+
+void write_file_block(diskfs_sb_t *sb, diskfs_ino_t ino,
+                      diskfs_inode_t *inode, diskfs_blk_t blk_off,
+                      void *buf) {
+    diskfs_blk_t disk_blk = alloc_file_block(sb, ino, inode, blk_off);
+    if (!disk_blk) {
+        printf("Error: Disk space is not enough!\n");
+        exit(-1);
+    }
+    write_cluster(sb, disk_blk, buf);
+}
+
+diskfs_ino_t cp(diskfs_sb_t *sb, diskfs_ino_t parent, char *name);
+
+void mkdir_dx(diskfs_sb_t *sb, diskfs_ino_t ino, diskfs_inode_t *inode,
+              diskfs_ino_t parent, int32_t fd) {
+
+    /* copy the entries of the directory open at fd and build an
+     * indexed directory out of them (see diskfs.h). leaves are
+     * filled to 3/4, so that new entries don't split them at once.
+     */
+    int32_t bs = sb->block_size, per_leaf = DIRENT_COUNT(bs)*3/4;
+    int32_t count = 0, size = 16, leaves = 0, nodes = 0, i, j, k;
+    dxent_t *ents = malloc(size*sizeof(dxent_t));
+    uint32_t *first; /* hash of first entry in every leaf. */
+    uint8_t *block = calloc(1, bs);
+    diskfs_dirent_t *dir = (diskfs_dirent_t *) block;
+    diskfs_dx_head_t *head;
+    diskfs_dx_entry_t *ent;
+    struct dirent *dirp;
+    DIR *dirpp = fdopendir(fd);
+
+    /* copy the entries: */
+    while (dirp = readdir(dirpp)) {
+
+        /* ignore "." & ".." */
+        if (!strcmp(dirp->d_name, ".") || !strcmp(dirp->d_name, ".."))
+            continue;
+
+        /* TODO: ignore long names. */
+
+        /* a new entry... create a new inode in the disk: */
+        if (count == size)
+            ents = realloc(ents, (size *= 2)*sizeof(dxent_t));
+        memset(&ents[count], 0, sizeof(dxent_t));
+        strcpy(ents[count].dirent.name, dirp->d_name);
+        ents[count].hash = diskfs_dx_hash(dirp->d_name);
+        fchdir(fd);
+        ents[count].dirent.ino = cp(sb, ino, dirp->d_name);
+        count++;
+
+    }
+    closedir(dirpp);
+
+    /* cut the sorted entries into leaves, same hashes together: */
+    qsort(ents, count, sizeof(dxent_t), dxcmp);
+    first = malloc((count+1)*sizeof(uint32_t));
+    i = 0;
+    do {
+        first[leaves] = leaves ? ents[i].hash : 0;
+        leaves++;
+        j = i + per_leaf;
+        while (j < count && ents[j].hash == ents[j-1].hash)
+            j++;
+        if (j - i > DIRENT_COUNT(bs)) {
+            printf("Error: too many names with the same hash!\n");
+            exit(-1);
+        }
+        i = j;
+    } while (i < count);
+
+    /* index nodes needed? */
+    if (leaves > DISKFS_DX_ROOT_LIMIT(bs)) {
+        nodes = (leaves + DISKFS_DX_NODE_LIMIT(bs) - 1) /
+                DISKFS_DX_NODE_LIMIT(bs);
+        if (nodes > DISKFS_DX_ROOT_LIMIT(bs)) {
+            printf("Error: directory is too large!\n");
+            exit(-1);
+        }
+    }
+
+    /* the root: block 0 */
+    dir[0].ino = ino;
+    strcpy(dir[0].name, ".");
+    dir[1].ino = parent;
+    strcpy(dir[1].name, "..");
+    head = DISKFS_DX_ROOT(block);
+    ent = (diskfs_dx_entry_t *) &head[1];
+    head->magic = DISKFS_DX_MAGIC;
+    if (!nodes) {
+        head->depth = 1;
+        head->count = leaves;
+        for (i = 0; i < leaves; i++) {
+            ent[i].hash = first[i];
+            ent[i].blk  = 1+i;
+        }
+    } else {
+        head->depth = 2;
+        head->count = nodes;
+        for (i = 0; i < nodes; i++) {
+            ent[i].hash = first[i*DISKFS_DX_NODE_LIMIT(bs)];
+            ent[i].blk  = 1+i;
+        }
+    }
+    write_file_block(sb, ino, inode, 0, block);
+
+    /* index nodes: blocks 1..nodes */
+    for (i = 0; i < nodes; i++) {
+        memset(block, 0, bs);
+        head = (diskfs_dx_head_t *) block;
+        ent = (diskfs_dx_entry_t *) &head[1];
+        head->magic = DISKFS_DX_MAGIC;
+        head->depth = 0;
+        head->count = 0;
+        for (j = i*DISKFS_DX_NODE_LIMIT(bs);
+             j < leaves && head->count < DISKFS_DX_NODE_LIMIT(bs); j++) {
+            ent[head->count].hash = first[j];
+            ent[head->count++].blk = 1+nodes+j;
+        }
+        write_file_block(sb, ino, inode, 1+i, block);
+    }
+
+    /* leaves: */
+    for (i = 0, k = 0; i < leaves; i++) {
+        memset(block, 0, bs);
+        for (j = 0; k < count && (i == leaves-1 || ents[k].hash < first[i+1]);)
+            dir[j++] = ents[k++].dirent;
+        write_file_block(sb, ino, inode, 1+nodes+i, block);
+    }
+
+    /* update the inode: */
+    inode->blocks = 1+nodes+leaves;
+    inode->size   = inode->blocks*bs;
+    inode->flags |= DISKFS_INODE_DXDIR;
+    update_inode(sb, ino, inode);
+
+    free(first);
+    free(ents);
+    free(block);
+
+}
+
 diskfs_ino_t cp(diskfs_sb_t *sb, diskfs_ino_t parent, char *name) {
 
     diskfs_ino_t   ino;
     diskfs_inode_t inode;
+    diskfs_ext_head_t *root;
 
     struct stat stat;
     int32_t fd;
@@ -367,13 +576,9 @@ diskfs_ino_t cp(diskfs_sb_t *sb, diskfs_ino_t parent, char *name) {
     off_t rem;
     int32_t  i;
 
-    diskfs_blk_t blk;
     diskfs_blk_t disk_blk;
     uint8_t *block = malloc(sb->block_size);
 
-    DIR *dirpp;
-    diskfs_dirent_t *dir;
-
     /* Open the file:  */
     /* --------------- */
     /* do the open */
@@ -409,24 +614,43 @@ diskfs_ino_t cp(diskfs_sb_t *sb, diskfs_ino_t parent, char *name) {
     inode.devid  = 0;
     for(i = 0; i < DISKFS_PTRS; i++)
         inode.ptr[i] = 0;
+
+    /* files are mapped by extents: */
+    root = DISKFS_EXT_ROOT(inode.ptr);
+    root->magic = DISKFS_EXT_MAGIC;
+    root->count = 0;
+    root->depth = 0;
+    inode.flags = DISKFS_INODE_EXTENTS;
     update_inode(sb, ino, &inode);
 
+    /* Tiny File? Keep data in the inode:  */
+    /* ----------------------------------- */
+    if (S_ISREG(stat.st_mode) && stat.st_size <= DISKFS_INLINE_MAX) {
+        for(i = 0; i < DISKFS_PTRS; i++)
+            inode.ptr[i] = 0;
+        read(fd, inode.ptr, stat.st_size); /* linux. */
+        inode.size  = stat.st_size;
+        inode.flags = DISKFS_INODE_INLINE;
+        update_inode(sb, ino, &inode);
+        close(fd);
+        free(block);
+        return ino;
+    }
+
     /* Regular File? Copy data to disk:  */
     /* --------------------------------- */
     rem = stat.st_size;
     i = 0;
+
+    /* all the blocks of the file in one extent: */
+    if (S_ISREG(stat.st_mode) && rem)
+        disk_blk = alloc_extent(sb, ino, &inode, 0,
+                                (rem + sb->block_size - 1)/sb->block_size);
+
     while (S_ISREG(stat.st_mode) && rem) {
 
         int32_t readsize = rem > sb->block_size ? sb->block_size : rem;
 
-        /* allocate block: */
-        disk_blk = alloc_file_block(sb, ino, &inode, i++);
-        if (!disk_blk) {
-            /* no enough space */
-            free(block);
-            return ino;
-        }
-
         /* update the inode: */
         inode.size += readsize;
         inode.blocks++;
@@ -439,89 +663,16 @@ diskfs_ino_t cp(diskfs_sb_t *sb, diskfs_ino_t parent, char *name) {
             block[readsize++] = 0; /* zero padding. */
 
         /* write the block to disk: */
-        write_cluster(sb, disk_blk, block);
+        write_cluster(sb, disk_blk + i++, block);
 
     }
 
     /* Directory? create dir entries:  */
     /* ------------------------------- */
     if (S_ISDIR(stat.st_mode))
-        dirpp = fdopendir(fd);
-
-    /* directory block is actually an array of directory entries: */
-    dir = (diskfs_dirent_t *) block;
-
-    /* counters: */
-    blk = 0; /* counter for blocks */
-    i = 0; /* counter for entires in every block. */
-
-    /* allocate a block for the dir entry: */
-    disk_blk = alloc_file_block(sb, ino, &inode, blk);
-    if (!disk_blk) {
-        free(block);
-        return ino;
-    }
-
-    /* zeroise the block */
-    while(i < sb->block_size)
-        block[i++] = 0;
-    i = 0;
-
-    /* insert the "." and ".." */
-    dir[i].ino = ino;
-    strcpy(dir[i++].name, ".");
-    dir[i].ino = parent;
-    strcpy(dir[i++].name, "..");
-
-    while(S_ISDIR(stat.st_mode)) {
-
-        /* get next dir entry: */
-        struct dirent *dirp = readdir(dirpp);
-
-        /* ignore "." & ".." */
-        if (dirp &&
-            (!strcmp(dirp->d_name, ".") || !strcmp(dirp->d_name, "..")))
-            continue;
-
-        /* TODO: ignore long names. */
-
-        /* end of block? */
-        if (i == DIRENT_COUNT(sb->block_size) || (!dirp)) {
-
-            /* write the block to disk. */
-            write_cluster(sb, disk_blk, block);
-
-            /* done? */
-            if (!dirp)
-                break;
-
-            /* counters: */
-            blk++; /* counter for blocks                  */
-            i = 0; /* counter for entires in every block. */
-
-            /* allocate a block for the dir entry: */
-            disk_blk = alloc_file_block(sb, ino, &inode, blk);
-            if (!disk_blk) {
-                free(block);
-                return ino;
-            }
-
-            /* zeroise the block */
-            while(i < sb->block_size)
-                block[i++] = 0;
-            i = 0;
-        }
-
-        /* a new entry... create a new inode in the disk: */
-        fchdir(fd);
-        strcpy(dir[i].name, dirp->d_name);
-        dir[i].ino = cp(sb, ino, dirp->d_name);
-        i++;
-    }
+        mkdir_dx(sb, ino, &inode, parent, fd);
 
     /* done */
-    if (S_ISDIR(stat.st_mode))
-        closedir(dirpp);
     free(block);
     return ino;
 }
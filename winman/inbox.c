@@ -40,11 +40,20 @@ void inbox_listen() {
 
     /* initialize msg */
     msg.buf = &packet;
+    msg.cap = sizeof(packet);
 
     /* check the inbox */
     while (1) {
 
-        receive(&msg, 1);
+        if (mouse_poll() < 0) {
+            /* mouse packets come through the inbox */
+            if (receive(&msg, 1))
+                continue;
+        } else if (receive(&msg, 0)) {
+            /* nothing to do, sleep on the mouse ring */
+            mouse_wait();
+            continue;
+        }
 
         if (packet[0] == PREFIX_MOUSE)
             mouse_event((mouse_packet_t *) &packet);
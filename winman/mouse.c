@@ -29,6 +29,7 @@
 #include <gui.h>
 #include <api/fs.h>
 #include <api/proc.h>
+#include <api/chan.h>
 #include <mouse/generic.h>
 #include <video/generic.h>
 
@@ -38,6 +39,10 @@ pixbuf_t *cursor;
 pixbuf_t *tmp; /* a pixbuf for temporary operations */
 int mouse_fd;
 
+/* packet ring shared with the mouse driver */
+int mouse_chan = -1;
+chan_ring_t *mouse_ring = NULL;
+
 int old_x = 0;
 int old_y = 0;
 
@@ -279,7 +284,37 @@ void mouse_init() {
     /* create the temporary pixbuf */
     tmp = pixbuf_alloc(cursor->width, cursor->height);
 
-    /* register winman at mouse driver */
-    ioctl(mouse_fd, MOUSE_REG, (void *) PREFIX_MOUSE);
+    /* get packets through a shared ring, or through the inbox if
+     * the driver doesn't support it.
+     */
+    if (ioctl(mouse_fd, MOUSE_CHAN, &mouse_chan) ||
+        !(mouse_ring = chan_map(mouse_chan, CHAN_CONSUMER))) {
+        /* register winman at mouse driver */
+        ioctl(mouse_fd, MOUSE_REG, (void *) PREFIX_MOUSE);
+    }
+
+}
+
+int mouse_poll() {
+
+    /* handle all packets waiting in the ring. returns -1 if the
+     * mouse packets come through the inbox instead.
+     */
+    mouse_packet_t packet;
+
+    if (!mouse_ring)
+        return -1;
+
+    while (!chan_get(mouse_ring, &packet))
+        mouse_event(&packet);
+
+    return 0;
+
+}
+
+void mouse_wait() {
+
+    /* sleep until the mouse ring or the inbox has something */
+    chan_wait(mouse_chan);
 
 }
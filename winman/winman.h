@@ -53,6 +53,8 @@ void vga_plot(pixbuf_t *pixbuf, unsigned int x, unsigned int y);
 void keyboard_event(keyboard_packet_t *packet);
 
 void mouse_event(mouse_packet_t *packet);
+int mouse_poll();
+void mouse_wait();
 
 pixbuf_t *get_osm();
 